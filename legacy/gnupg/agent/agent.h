@@ -113,6 +113,10 @@ struct agent_options {
      enabled (which is the default) we send an option to Pinentry
      to allow it to enable such a cache.  */
   int allow_external_cache;
+
+  /* If set, the unprotected key is cached along with the passphrase
+     so that the S2K needs not be run again for every operation.  */
+  int cache_unprotected_keys;
 };
 extern struct agent_options agent_opt;
 #define opt agent_opt
@@ -251,7 +255,7 @@ gpg_error_t agent_write_status(ctrl_t ctrl, const char *keyword, ...)
     GPGRT_ATTR_SENTINEL(0);
 gpg_error_t agent_print_status(ctrl_t ctrl, const char *keyword,
                                const char *format, ...) GPGRT_ATTR_PRINTF(3, 4);
-void start_command_handler(ctrl_t);
+void start_command_handler(ctrl_t, gnupg_fd_t);
 gpg_error_t pinentry_loopback(ctrl_t, const char *keyword,
                               unsigned char **buffer, size_t *size,
                               size_t max_length);
@@ -326,6 +330,11 @@ void agent_flush_cache(void);
 int agent_put_cache(const char *key, cache_mode_t cache_mode, const char *data,
                     int ttl);
 char *agent_get_cache(const char *key, cache_mode_t cache_mode);
+void agent_put_cache_key(const char *key, cache_mode_t cache_mode,
+                         const unsigned char *tag, const unsigned char *keybuf,
+                         size_t keylen);
+unsigned char *agent_get_cache_key(const char *key, cache_mode_t cache_mode,
+                                   const unsigned char *tag, size_t *r_keylen);
 void agent_store_cache_hit(const char *key);
 
 /*-- pksign.c --*/
@@ -361,6 +370,29 @@ int agent_protect(const unsigned char *plainkey, const char *passphrase,
 int agent_unprotect(ctrl_t ctrl, const unsigned char *protectedkey,
                     const char *passphrase, gnupg_isotime_t protected_at,
                     unsigned char **result, size_t *resultlen);
+
+/* A key to be protected by agent_protect_keys.  */
+struct protect_job_s {
+  const unsigned char *plainkey;
+  const char *passphrase;
+  unsigned char *result; /* Malloced protected key.  */
+  size_t resultlen;
+  gpg_error_t err;
+};
+gpg_error_t agent_protect_keys(struct protect_job_s *jobs, size_t njobs,
+                               unsigned long s2k_count, int use_ocb);
+
+/* A key to be unprotected by agent_unprotect_keys.  */
+struct unprotect_job_s {
+  const unsigned char *protectedkey;
+  const char *passphrase;
+  char *protected_at;    /* NULL or a gnupg_isotime_t.  */
+  unsigned char *result; /* Malloced unprotected key.  */
+  size_t resultlen;
+  gpg_error_t err;
+};
+gpg_error_t agent_unprotect_keys(ctrl_t ctrl, struct unprotect_job_s *jobs,
+                                 size_t njobs);
 int agent_private_key_type(const unsigned char *privatekey);
 unsigned char *make_shadow_info(const char *serialno, const char *idstring);
 int agent_shadow_key(const unsigned char *pubkey,
@@ -19,7 +19,14 @@
 
 #include <config.h>
 
+#include <atomic>
+#include <functional>
+#include <limits>
 #include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <assert.h>
 #include <stdio.h>
@@ -43,8 +50,8 @@ static const size_t ENCRYPTION_KEYSIZE = 128 / 8;
    necessary infrastructure to make it more secure.  */
 static Botan::SymmetricKey *encryption_handle;
 
-/* A mutex used to serialize access to the cache.  */
-static std::mutex cache_lock;
+/* Used to create ENCRYPTION_HANDLE only once.  */
+static std::mutex encryption_lock;
 
 struct secret_data_s {
   int totallen; /* This includes the padding and space for AESWRAP. */
@@ -53,20 +60,60 @@ struct secret_data_s {
 
 typedef struct cache_item_s *ITEM;
 struct cache_item_s {
-  ITEM next;
   time_t created;
   time_t accessed;
+  time_t scheduled; /* Time of the pending expiry check or 0.  */
   int ttl; /* max. lifetime given in seconds, -1 one means infinite */
   struct secret_data_s *pw;
+  /* With --cache-unprotected-keys the unprotected key which PW
+     unlocked, its length and a hash of the protected key it was
+     derived from.  This is released together with PW.  */
+  struct secret_data_s *sk;
+  size_t sklen;
+  unsigned char sktag[32];
   cache_mode_t cache_mode;
   char key[1];
 };
 
+/* A pending expiry check for the item with KEY and CACHE_MODE.  An
+   entry is stale unless WHEN matches the item's SCHEDULED.  */
+struct expiry_s {
+  time_t when;
+  std::string key;
+  cache_mode_t cache_mode;
+
+  bool operator>(const expiry_s &other) const { return when > other.when; }
+};
+
+/* The cache is split into stripes by a hash of the key so that
+   connections working with different keys do not serialize on one
+   lock.  Each stripe maps a key to its items (there may be one per
+   cache mode) and keeps a min-heap of the pending expiry checks.  */
+#define CACHE_STRIPES 16
+
+struct cache_stripe_s {
+  std::mutex lock;
+  std::unordered_map<std::string, std::vector<ITEM>> items;
+  std::priority_queue<expiry_s, std::vector<expiry_s>,
+                      std::greater<expiry_s>>
+      expiry;
+};
+
 /* The cache himself.  */
-static ITEM thecache;
+static struct cache_stripe_s thecache[CACHE_STRIPES];
+
+/* The earliest time a check in any of the stripes is due.  */
+static std::atomic<time_t> next_expiry{0};
+
+/* The options the expiry checks have been scheduled for.  If they
+   change all items are checked again.  */
+static std::mutex schedule_lock;
+static unsigned long scheduled_max_ttl;
+static int scheduled_keys;
 
 /* NULL or the last cache key stored by agent_store_cache_hit.  */
 static char *last_stored_cache_key;
+static std::mutex last_stored_lock;
 
 void deinitialize_module_cache(void) {
   delete encryption_handle;
@@ -80,8 +127,7 @@ void deinitialize_module_cache(void) {
    connections.  Thus we should get into listen state as soon as
    possible.  */
 static gpg_error_t init_encryption(void) {
-  gpg_error_t err;
-  void *key;
+  std::lock_guard<std::mutex> lock(encryption_lock);
 
   if (encryption_handle) return 0;
 
@@ -93,10 +139,26 @@ static gpg_error_t init_encryption(void) {
 
 static void release_data(struct secret_data_s *data) { xfree(data); }
 
-static gpg_error_t new_data(const char *string, struct secret_data_s **r_data) {
+/* Release the passphrase of item R and the unprotected key derived
+   from it.  */
+static void release_item_data(ITEM r) {
+  if (r->pw) {
+    release_data(r->pw);
+    r->pw = NULL;
+  }
+  if (r->sk) {
+    release_data(r->sk);
+    r->sk = NULL;
+    r->sklen = 0;
+  }
+}
+
+/* Encrypt LENGTH bytes at BUFFER into a new secret data object which
+   is stored at R_DATA.  */
+static gpg_error_t new_data(const void *buffer, size_t length,
+                            struct secret_data_s **r_data) {
   gpg_error_t err;
   struct secret_data_s *d, *d_enc;
-  size_t length;
   int total;
   size_t d_len;
 
@@ -105,8 +167,6 @@ static gpg_error_t new_data(const char *string, struct secret_data_s **r_data) {
   err = init_encryption();
   if (err) return err;
 
-  length = strlen(string) + 1;
-
   /* We pad the data to 32 bytes so that it get more complicated
      finding something out by watching allocation patterns.  This is
      usually not possible but we better assume nothing about our secure
@@ -116,7 +176,7 @@ static gpg_error_t new_data(const char *string, struct secret_data_s **r_data) {
 
   d_len = sizeof *d + total - 1;
   d = (secret_data_s *)Botan::allocate_memory(1, d_len);
-  memcpy(d->data, string, length);
+  memcpy(d->data, buffer, length);
 
   d_enc = (secret_data_s *)xtrymalloc(sizeof *d_enc + total - 1);
   if (!d_enc) {
@@ -144,74 +204,194 @@ static gpg_error_t new_data(const char *string, struct secret_data_s **r_data) {
   return 0;
 }
 
-/* Check whether there are items to expire.  */
-static void housekeeping(void) {
-  ITEM r, rprev;
-  time_t current = gnupg_get_time();
+/* Decrypt the secret data object D into a new buffer allocated in
+   secure memory which is stored at R_VALUE.  The buffer has a length
+   of D->TOTALLEN - 8 bytes.  */
+static gpg_error_t decrypt_data(struct secret_data_s *d, char **r_value) {
+  gpg_error_t err;
+  char *value;
+
+  *r_value = NULL;
+
+  if (d->totallen < 32) return GPG_ERR_INV_LENGTH;
+  if ((err = init_encryption())) return err;
+  if (!(value = (char *)xtrymalloc_secure(d->totallen - 8)))
+    return gpg_error_from_syserror();
+
+  const Botan::secure_vector<uint8_t> enc(d->data, d->data + d->totallen);
+  Botan::secure_vector<uint8_t> val =
+      Botan::rfc3394_keyunwrap(enc, *encryption_handle);
+  assert(val.size() == d->totallen - 8);
+  memcpy(value, val.data(), val.size());
+  *r_value = value;
+  return 0;
+}
+
+/* Return the stripe for KEY.  */
+static struct cache_stripe_s *stripe_for(const std::string &key) {
+  return &thecache[std::hash<std::string>()(key) % CACHE_STRIPES];
+}
+
+/* Lower NEXT_EXPIRY to WHEN.  */
+static void lower_next_expiry(time_t when) {
+  time_t cur = next_expiry.load();
+
+  while (when < cur && !next_expiry.compare_exchange_weak(cur, when))
+    ;
+}
 
+/* Return the time at which item R needs to be checked next or 0 if
+   it never expires.  This mirrors the conditions in check_item.  */
+static time_t item_deadline(ITEM r) {
+  time_t when = 0;
+
+  if (r->pw) {
+    when = r->created + opt.max_cache_ttl + 1;
+    if (r->ttl >= 0 && r->accessed + r->ttl + 1 < when)
+      when = r->accessed + r->ttl + 1;
+  } else if (r->ttl >= 0)
+    when = r->accessed + 60 * 30 + 1;
+  return when;
+}
+
+/* Make sure an expiry check for item R is pending in STRIPE.  This
+   must be called after a change which may let R expire earlier.  The
+   caller must hold the lock of STRIPE.  */
+static void schedule_item(struct cache_stripe_s *stripe, ITEM r) {
+  time_t when = item_deadline(r);
+
+  if (!when || (r->scheduled && r->scheduled <= when)) return;
+
+  r->scheduled = when;
+  stripe->expiry.push({when, r->key, r->cache_mode});
+  lower_next_expiry(when);
+}
+
+/* Expire the data of item R as of CURRENT.  Returns true if the item
+   itself should be removed.  */
+static int check_item(ITEM r, time_t current) {
   /* First expire the actual data */
-  for (r = thecache; r; r = r->next) {
-    if (r->pw && r->ttl >= 0 && r->accessed + r->ttl < current) {
-      if (DBG_CACHE)
-        log_debug("  expired '%s' (%ds after last access)\n", r->key, r->ttl);
-      release_data(r->pw);
-      r->pw = NULL;
-      r->accessed = current;
-    }
+  if (r->pw && r->ttl >= 0 && r->accessed + r->ttl < current) {
+    if (DBG_CACHE)
+      log_debug("  expired '%s' (%ds after last access)\n", r->key, r->ttl);
+    release_item_data(r);
+    r->accessed = current;
   }
 
   /* Second, make sure that we also remove them based on the created stamp so
      that the user has to enter it from time to time. */
-  for (r = thecache; r; r = r->next) {
-    unsigned long maxttl;
-
-    maxttl = opt.max_cache_ttl;
-    if (r->pw && r->created + maxttl < current) {
-      if (DBG_CACHE)
-        log_debug("  expired '%s' (%lus after creation)\n", r->key,
-                  opt.max_cache_ttl);
-      release_data(r->pw);
-      r->pw = NULL;
-      r->accessed = current;
-    }
+  if (r->pw && r->created + (time_t)opt.max_cache_ttl < current) {
+    if (DBG_CACHE)
+      log_debug("  expired '%s' (%lus after creation)\n", r->key,
+                opt.max_cache_ttl);
+    release_item_data(r);
+    r->accessed = current;
+  }
+
+  if (r->sk && !opt.cache_unprotected_keys) {
+    release_data(r->sk);
+    r->sk = NULL;
+    r->sklen = 0;
   }
 
   /* Third, make sure that we don't have too many items in the list.
      Expire old and unused entries after 30 minutes */
-  for (rprev = NULL, r = thecache; r;) {
-    if (!r->pw && r->ttl >= 0 && r->accessed + 60 * 30 < current) {
-      ITEM r2 = r->next;
-      if (DBG_CACHE)
-        log_debug("  removed '%s' (mode %d) (slot not used for 30m)\n", r->key,
-                  r->cache_mode);
+  if (!r->pw && r->ttl >= 0 && r->accessed + 60 * 30 < current) {
+    if (DBG_CACHE)
+      log_debug("  removed '%s' (mode %d) (slot not used for 30m)\n", r->key,
+                r->cache_mode);
+    return 1;
+  }
+  return 0;
+}
+
+/* Run the expiry checks of STRIPE which are due at CURRENT.  With
+   RESCHEDULE set all items are checked.  The caller must hold the lock
+   of STRIPE.  */
+static void expire_stripe(struct cache_stripe_s *stripe, time_t current,
+                          int reschedule) {
+  if (reschedule) {
+    for (auto &it : stripe->items)
+      for (ITEM r : it.second) {
+        r->scheduled = current;
+        stripe->expiry.push({current, r->key, r->cache_mode});
+      }
+  }
+
+  while (!stripe->expiry.empty() && stripe->expiry.top().when <= current) {
+    expiry_s e = stripe->expiry.top();
+    stripe->expiry.pop();
+
+    auto it = stripe->items.find(e.key);
+    if (it == stripe->items.end()) continue;
+    auto &vec = it->second;
+    size_t i;
+    for (i = 0; i < vec.size(); i++)
+      if (vec[i]->cache_mode == e.cache_mode && vec[i]->scheduled == e.when)
+        break;
+    if (i == vec.size()) continue; /* Stale.  */
+
+    ITEM r = vec[i];
+    r->scheduled = 0;
+    if (check_item(r, current)) {
+      vec.erase(vec.begin() + i);
+      if (vec.empty()) stripe->items.erase(it);
       xfree(r);
-      if (!rprev)
-        thecache = r2;
-      else
-        rprev->next = r2;
-      r = r2;
-    } else {
-      rprev = r;
-      r = r->next;
+    } else
+      schedule_item(stripe, r);
+  }
+}
+
+/* Check whether there are items to expire.  This must be called
+   without holding a stripe lock.  */
+static void housekeeping(void) {
+  time_t current = gnupg_get_time();
+  time_t when;
+  int reschedule = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(schedule_lock);
+    if (scheduled_max_ttl != opt.max_cache_ttl ||
+        scheduled_keys != opt.cache_unprotected_keys) {
+      scheduled_max_ttl = opt.max_cache_ttl;
+      scheduled_keys = opt.cache_unprotected_keys;
+      reschedule = 1;
     }
   }
+
+  if (!reschedule && current < next_expiry.load()) return;
+
+  /* Checks scheduled by other threads while we walk the stripes lower
+     NEXT_EXPIRY again.  */
+  when = std::numeric_limits<time_t>::max();
+  next_expiry.store(when);
+  for (int i = 0; i < CACHE_STRIPES; i++) {
+    struct cache_stripe_s *stripe = &thecache[i];
+    std::lock_guard<std::mutex> lock(stripe->lock);
+
+    expire_stripe(stripe, current, reschedule);
+    if (!stripe->expiry.empty() && stripe->expiry.top().when < when)
+      when = stripe->expiry.top().when;
+  }
+  lower_next_expiry(when);
 }
 
 void agent_flush_cache(void) {
-  ITEM r;
-  int res;
-
   if (DBG_CACHE) log_debug("agent_flush_cache\n");
 
-  std::lock_guard<std::mutex> lock(cache_lock);
-
-  for (r = thecache; r; r = r->next) {
-    if (r->pw) {
-      if (DBG_CACHE) log_debug("  flushing '%s'\n", r->key);
-      release_data(r->pw);
-      r->pw = NULL;
-      r->accessed = 0;
-    }
+  for (int i = 0; i < CACHE_STRIPES; i++) {
+    struct cache_stripe_s *stripe = &thecache[i];
+    std::lock_guard<std::mutex> lock(stripe->lock);
+
+    for (auto &it : stripe->items)
+      for (ITEM r : it.second) {
+        if (r->pw) {
+          if (DBG_CACHE) log_debug("  flushing '%s'\n", r->key);
+          release_item_data(r);
+          r->accessed = 0;
+          schedule_item(stripe, r);
+        }
+      }
   }
 }
 
@@ -222,6 +402,23 @@ static int cache_mode_equal(cache_mode_t a, cache_mode_t b) {
           (b == CACHE_MODE_ANY && a != CACHE_MODE_IGNORE) || a == b);
 }
 
+/* Return the item for KEY and CACHE_MODE from STRIPE or NULL.  If
+   WITH_PW is set only items with a passphrase are considered.  The
+   caller must hold the lock of STRIPE.  */
+static ITEM find_item(struct cache_stripe_s *stripe, const std::string &key,
+                      cache_mode_t cache_mode, int with_pw) {
+  auto it = stripe->items.find(key);
+
+  if (it == stripe->items.end()) return NULL;
+  for (ITEM r : it->second) {
+    if ((!with_pw || r->pw) &&
+        ((cache_mode != CACHE_MODE_USER && cache_mode != CACHE_MODE_NONCE) ||
+         cache_mode_equal(r->cache_mode, cache_mode)))
+      return r;
+  }
+  return NULL;
+}
+
 /* Store the string DATA in the cache under KEY and mark it with a
    maximum lifetime of TTL seconds.  If there is already data under
    this key, it will be replaced.  Using a DATA of NULL deletes the
@@ -232,9 +429,6 @@ int agent_put_cache(const char *key, cache_mode_t cache_mode, const char *data,
                     int ttl) {
   gpg_error_t err = 0;
   ITEM r;
-  int res;
-
-  std::lock_guard<std::mutex> lock(cache_lock);
 
   if (DBG_CACHE)
     log_debug("agent_put_cache '%s' (mode %d) requested ttl=%d\n", key,
@@ -242,27 +436,28 @@ int agent_put_cache(const char *key, cache_mode_t cache_mode, const char *data,
   housekeeping();
 
   if (!ttl) ttl = opt.def_cache_ttl;
-  if ((!ttl && data) || cache_mode == CACHE_MODE_IGNORE) goto out;
+  if ((!ttl && data) || cache_mode == CACHE_MODE_IGNORE) return 0;
 
-  for (r = thecache; r; r = r->next) {
-    if (((cache_mode != CACHE_MODE_USER && cache_mode != CACHE_MODE_NONCE) ||
-         cache_mode_equal(r->cache_mode, cache_mode)) &&
-        !strcmp(r->key, key))
-      break;
-  }
+  std::string skey(key);
+  struct cache_stripe_s *stripe = stripe_for(skey);
+  std::lock_guard<std::mutex> lock(stripe->lock);
+
+  r = find_item(stripe, skey, cache_mode, 0);
   if (r) /* Replace.  */
   {
-    if (r->pw) {
-      release_data(r->pw);
-      r->pw = NULL;
-    }
+    release_item_data(r);
     if (data) {
       r->created = r->accessed = gnupg_get_time();
       r->ttl = ttl;
-      r->cache_mode = cache_mode;
-      err = new_data(data, &r->pw);
+      if (r->cache_mode != cache_mode) {
+        /* The pending check is recorded under the old mode.  */
+        r->cache_mode = cache_mode;
+        r->scheduled = 0;
+      }
+      err = new_data(data, strlen(data) + 1, &r->pw);
       if (err) log_error("error replacing cache item: %s\n", gpg_strerror(err));
     }
+    schedule_item(stripe, r);
   } else if (data) /* Insert.  */
   {
     r = (ITEM)xtrycalloc(1, sizeof *r + strlen(key));
@@ -273,18 +468,17 @@ int agent_put_cache(const char *key, cache_mode_t cache_mode, const char *data,
       r->created = r->accessed = gnupg_get_time();
       r->ttl = ttl;
       r->cache_mode = cache_mode;
-      err = new_data(data, &r->pw);
+      err = new_data(data, strlen(data) + 1, &r->pw);
       if (err)
         xfree(r);
       else {
-        r->next = thecache;
-        thecache = r;
+        stripe->items[skey].push_back(r);
+        schedule_item(stripe, r);
       }
     }
     if (err) log_error("error inserting cache item: %s\n", gpg_strerror(err));
   }
 
-out:
   return err;
 }
 
@@ -295,62 +489,118 @@ char *agent_get_cache(const char *key, cache_mode_t cache_mode) {
   gpg_error_t err;
   ITEM r;
   char *value = NULL;
-  int res;
   int last_stored = 0;
+  std::string skey;
 
   if (cache_mode == CACHE_MODE_IGNORE) return NULL;
 
-  std::lock_guard<std::mutex> lock(cache_lock);
-
   if (!key) {
-    key = last_stored_cache_key;
-    if (!key) goto out;
+    std::lock_guard<std::mutex> lock(last_stored_lock);
+    if (!last_stored_cache_key) return NULL;
+    skey = last_stored_cache_key;
     last_stored = 1;
-  }
+  } else
+    skey = key;
 
   if (DBG_CACHE)
-    log_debug("agent_get_cache '%s' (mode %d)%s ...\n", key, cache_mode,
-              last_stored ? " (stored cache key)" : "");
+    log_debug("agent_get_cache '%s' (mode %d)%s ...\n", skey.c_str(),
+              cache_mode, last_stored ? " (stored cache key)" : "");
   housekeeping();
 
-  for (r = thecache; r; r = r->next) {
-    if (r->pw &&
-        ((cache_mode != CACHE_MODE_USER && cache_mode != CACHE_MODE_NONCE) ||
-         cache_mode_equal(r->cache_mode, cache_mode)) &&
-        !strcmp(r->key, key)) {
-      /* Note: To avoid races KEY may not be accessed anymore below.  */
-      r->accessed = gnupg_get_time();
-      if (DBG_CACHE) log_debug("... hit\n");
-      if (r->pw->totallen < 32)
-        err = GPG_ERR_INV_LENGTH;
-      else if ((err = init_encryption()))
-        ;
-      else if (!(value = (char *)xtrymalloc_secure(r->pw->totallen - 8)))
-        err = gpg_error_from_syserror();
-      else {
-        const Botan::secure_vector<uint8_t> pw_data(r->pw->totallen);
-        memcpy((void *)(pw_data.data()), r->pw->data, r->pw->totallen);
-        Botan::secure_vector<uint8_t> val =
-            Botan::rfc3394_keyunwrap(pw_data, *encryption_handle);
-        assert(val.size() == r->pw->totallen - 8);
-        memcpy(value, val.data(), val.size());
-        err = 0;
-      }
-      if (err) {
-        xfree(value);
-        value = NULL;
-        log_error("retrieving cache entry '%s' failed: %s\n", key,
-                  gpg_strerror(err));
-      }
-      break;
-    }
+  struct cache_stripe_s *stripe = stripe_for(skey);
+  std::lock_guard<std::mutex> lock(stripe->lock);
+
+  r = find_item(stripe, skey, cache_mode, 1);
+  if (r) {
+    r->accessed = gnupg_get_time();
+    if (DBG_CACHE) log_debug("... hit\n");
+    err = decrypt_data(r->pw, &value);
+    if (err)
+      log_error("retrieving cache entry '%s' failed: %s\n", skey.c_str(),
+                gpg_strerror(err));
   }
   if (DBG_CACHE && value == NULL) log_debug("... miss\n");
 
-out:
   return value;
 }
 
+/* Store the unprotected key KEYBUF of length KEYLEN with the cached
+   passphrase for KEY which was used to unprotect it.  TAG is the
+   SHA-256 hash of the protected key.  The entry shares the lifetime
+   of the passphrase; nothing is stored if there is no such
+   passphrase or --cache-unprotected-keys is not active.  */
+void agent_put_cache_key(const char *key, cache_mode_t cache_mode,
+                         const unsigned char *tag, const unsigned char *keybuf,
+                         size_t keylen) {
+  gpg_error_t err;
+  ITEM r;
+
+  if (!opt.cache_unprotected_keys || cache_mode == CACHE_MODE_IGNORE ||
+      cache_mode == CACHE_MODE_NONCE)
+    return;
+
+  std::string skey(key);
+  struct cache_stripe_s *stripe = stripe_for(skey);
+  std::lock_guard<std::mutex> lock(stripe->lock);
+
+  r = find_item(stripe, skey, cache_mode, 1);
+  if (!r) return;
+
+  if (DBG_CACHE) log_debug("agent_put_cache_key '%s'\n", key);
+  if (r->sk) {
+    release_data(r->sk);
+    r->sk = NULL;
+    r->sklen = 0;
+  }
+  err = new_data(keybuf, keylen, &r->sk);
+  if (err) {
+    log_error("error caching unprotected key: %s\n", gpg_strerror(err));
+    return;
+  }
+  r->sklen = keylen;
+  memcpy(r->sktag, tag, sizeof r->sktag);
+}
+
+/* Return the unprotected key cached with the passphrase for KEY if
+   it was derived from the protected key with the SHA-256 hash TAG.
+   The key is returned in secure memory and its length stored at
+   R_KEYLEN.  Returns NULL on a miss.  */
+unsigned char *agent_get_cache_key(const char *key, cache_mode_t cache_mode,
+                                   const unsigned char *tag,
+                                   size_t *r_keylen) {
+  gpg_error_t err;
+  ITEM r;
+  char *value = NULL;
+
+  *r_keylen = 0;
+  if (!opt.cache_unprotected_keys || cache_mode == CACHE_MODE_IGNORE ||
+      cache_mode == CACHE_MODE_NONCE)
+    return NULL;
+
+  housekeeping();
+
+  std::string skey(key);
+  struct cache_stripe_s *stripe = stripe_for(skey);
+  std::lock_guard<std::mutex> lock(stripe->lock);
+
+  r = find_item(stripe, skey, cache_mode, 1);
+  if (!r || !r->sk || memcmp(r->sktag, tag, sizeof r->sktag)) {
+    if (DBG_CACHE) log_debug("agent_get_cache_key '%s' ... miss\n", key);
+    return NULL;
+  }
+
+  r->accessed = gnupg_get_time();
+  if (DBG_CACHE) log_debug("agent_get_cache_key '%s' ... hit\n", key);
+  err = decrypt_data(r->sk, &value);
+  if (err) {
+    log_error("retrieving cached key '%s' failed: %s\n", key,
+              gpg_strerror(err));
+    return NULL;
+  }
+  *r_keylen = r->sklen;
+  return (unsigned char *)value;
+}
+
 /* Store the key for the last successful cache hit.  That value is
    used by agent_get_cache if the requested KEY is given as NULL.
    NULL may be used to remove that key. */
@@ -358,26 +608,15 @@ void agent_store_cache_hit(const char *key) {
   char *neu;
   char *old;
 
-  /* To make sure the update is atomic under the non-preemptive thread
-   * model, we must make sure not to surrender control to a different
-   * thread.  Therefore, we avoid calling the allocator during the
-   * update.
-   *
-   * Background: xtrystrdup uses gcry_strdup which may use the secure
-   * memory allocator of Libgcrypt.  That allocator takes locks and
-   * since version 1.14 libgpg-error is nPth aware and thus taking a
-   * lock may now lead to thread switch.  Note that this only happens
-   * when secure memory is _allocated_ (the standard allocator uses
-   * malloc which is not nPth aware) but not when calling _xfree_
-   * because gcry_free needs to check whether the pointer is in secure
-   * memory and thus needs to take a lock.
-   */
+  /* Allocate outside of the lock; xtrystrdup may use the secure
+     memory allocator of Libgcrypt which takes its own locks.  */
   neu = key ? xtrystrdup(key) : NULL;
 
-  /* Atomic update.  */
-  old = last_stored_cache_key;
-  last_stored_cache_key = neu;
-  /* Done.  */
+  {
+    std::lock_guard<std::mutex> lock(last_stored_lock);
+    old = last_stored_cache_key;
+    last_stored_cache_key = neu;
+  }
 
   xfree(old);
 }
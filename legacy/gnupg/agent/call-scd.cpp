@@ -92,7 +92,8 @@ struct inq_needpin_parm_s {
    anchored at this variable. */
 static struct scd_local_s *scd_local_list;
 
-/* A Mutex used inside the start_scd function. */
+/* A Mutex used inside the start_scd function.  It also protects
+   SCD_LOCAL_LIST.  */
 static std::mutex start_scd_lock;
 
 /* The context of the primary connection.  This is also used as a flag
@@ -165,6 +166,8 @@ static int start_scd(ctrl_t ctrl) {
         (struct scd_local_s *)xtrycalloc(1, sizeof *ctrl->scd_local);
     if (!ctrl->scd_local) return gpg_error_from_syserror();
     ctrl->scd_local->ctrl_backlink = ctrl;
+
+    std::lock_guard<std::mutex> lock(start_scd_lock);
     ctrl->scd_local->next_local = scd_local_list;
     scd_local_list = ctrl->scd_local;
   }
@@ -271,6 +274,10 @@ leave:
    a cleanup of resources used by the current connection. */
 int agent_reset_scd(ctrl_t ctrl) {
   if (ctrl->scd_local) {
+    /* Other connections may be using the list and the primary
+       context concurrently.  */
+    std::lock_guard<std::mutex> lock(start_scd_lock);
+
     if (ctrl->scd_local->ctx) {
       /* We can't disconnect the primary context because libassuan
          does a waitpid on it and thus the system would hang.
@@ -47,8 +47,9 @@
 #define MAXLEN_CIPHERTEXT 4096
 /* Maximum allowed size of the key parameters.  */
 #define MAXLEN_KEYPARAM 1024
-/* Maximum allowed size of key data as used in inquiries (bytes). */
-#define MAXLEN_KEYDATA 8192
+/* Maximum allowed size of key data as used in inquiries (bytes).
+   IMPORT_KEY may receive all keys of a keyblock at once.  */
+#define MAXLEN_KEYDATA 65536
 
 /* A shortcut to call assuan_set_error using an gpg_error_t and a
    text string.  */
@@ -1329,6 +1330,274 @@ static gpg_error_t cmd_scd(assuan_context_t ctx, char *line) {
   return rc;
 }
 
+/* Return the offset of the first octet at or after OFF in the
+   KEYDATALEN octets of KEYDATA which is not a zero.  The keys in
+   KEYDATA may be padded with zeros as done by make_canon_sexp_pad.  */
+static size_t skip_key_padding(const unsigned char *keydata,
+                               size_t keydatalen, size_t off) {
+  while (off < keydatalen && !keydata[off]) off++;
+  return off;
+}
+
+/* A key of a multi-key import.  */
+struct import_key_s {
+  const unsigned char *keydata; /* The key as received.  */
+  size_t keydatalen;
+  gcry_sexp_t openpgp_sexp; /* The key if in OpenPGP transfer format.  */
+  unsigned char grip[20];
+  unsigned char *key; /* The key converted for unattended import.  */
+};
+
+/* Return true if the OpenPGP transfer key S_PGP is protected.  */
+static int openpgp_key_is_protected(gcry_sexp_t s_pgp) {
+  gcry_sexp_t list;
+  const char *value;
+  size_t valuelen;
+  int is_protected;
+
+  list = gcry_sexp_find_token(s_pgp, "protection", 0);
+  value = list ? gcry_sexp_nth_data(list, 1, &valuelen) : NULL;
+  is_protected = !(value && valuelen == 4 && !memcmp(value, "none", 4));
+  gcry_sexp_release(list);
+  return is_protected;
+}
+
+/* Import the OpenPGP key K the way IMPORT_KEY imports a single key,
+   asking for the passphrase if it is not in the cache.  If
+   R_PASSPHRASE is not NULL the passphrase is stored there; it is NULL
+   if the key is not protected.  */
+static gpg_error_t import_openpgp_key(ctrl_t ctrl, assuan_context_t ctx,
+                                      struct import_key_s *k, int force,
+                                      char **cache_nonce_addr,
+                                      char **r_passphrase) {
+  gpg_error_t err;
+  unsigned char *key = NULL;
+  unsigned char *finalkey = NULL;
+  size_t keylen, finalkeylen;
+  char *passphrase = NULL;
+
+  if (r_passphrase) *r_passphrase = NULL;
+
+  err = convert_from_openpgp(ctrl, k->openpgp_sexp, force, k->grip,
+                             ctrl->server_local->keydesc, *cache_nonce_addr,
+                             &key, &passphrase);
+  if (err) goto leave;
+  keylen = gcry_sexp_canon_len(key, 0, NULL, &err);
+  if (!keylen) goto leave;
+
+  if (passphrase) {
+    if (!*cache_nonce_addr) {
+      char buf[12];
+      gcry_create_nonce(buf, 12);
+      *cache_nonce_addr = bin2hex(buf, 12, NULL);
+    }
+    if (*cache_nonce_addr &&
+        !agent_put_cache(*cache_nonce_addr, CACHE_MODE_NONCE, passphrase,
+                         CACHE_TTL_NONCE))
+      assuan_write_status(ctx, "CACHE_NONCE", *cache_nonce_addr);
+
+    err = agent_protect(key, passphrase, &finalkey, &finalkeylen,
+                        ctrl->s2k_count, -1);
+    if (!err)
+      err = agent_write_private_key(k->grip, finalkey, finalkeylen, force);
+  } else
+    err = agent_write_private_key(k->grip, key, keylen, force);
+
+leave:
+  xfree(finalkey);
+  xfree(key);
+  if (!err && r_passphrase)
+    *r_passphrase = passphrase;
+  else
+    xfree(passphrase);
+  return err;
+}
+
+/* Import the NKEYS keys in OpenPGP transfer format at KEYS.  Most of
+   the time is spent in the S2K derivations for unprotecting and
+   protecting the keys, which are run in parallel for all keys with
+   the passphrase of the first one.  */
+static gpg_error_t import_openpgp_keys(ctrl_t ctrl, assuan_context_t ctx,
+                                       struct import_key_s *keys,
+                                       size_t nkeys, int unattended, int force,
+                                       char **cache_nonce_addr) {
+  gpg_error_t err;
+  struct unprotect_job_s *jobs = NULL;
+  char *passphrase = NULL;
+  size_t i, j, njobs, keylen;
+
+  /* Convert all keys without asking for a passphrase.  This checks
+     whether they exist already and yields keys in the openpgp-native
+     format, which agent_unprotect converts to our own protection
+     format.  */
+  for (i = 0; i < nkeys; i++) {
+    err = convert_from_openpgp(ctrl, keys[i].openpgp_sexp, force, keys[i].grip,
+                               NULL, NULL, &keys[i].key, NULL);
+    if (err) return err;
+  }
+
+  if (unattended) {
+    for (i = 0; i < nkeys; i++) {
+      keylen = gcry_sexp_canon_len(keys[i].key, 0, NULL, &err);
+      if (!keylen) return err;
+      err = agent_write_private_key(keys[i].grip, keys[i].key, keylen, force);
+      if (err) return err;
+    }
+    return 0;
+  }
+
+  /* The keys of a keyblock usually share one passphrase.  Ask for it
+     with the first key.  */
+  err = import_openpgp_key(ctrl, ctx, keys, force, cache_nonce_addr,
+                           &passphrase);
+  if (err) return err;
+
+  jobs = (struct unprotect_job_s *)xtrycalloc(nkeys, sizeof *jobs);
+  if (!jobs) {
+    err = gpg_error_from_syserror();
+    goto leave;
+  }
+  for (i = 1, njobs = 0; passphrase && i < nkeys; i++)
+    if (openpgp_key_is_protected(keys[i].openpgp_sexp)) {
+      jobs[njobs].protectedkey = keys[i].key;
+      jobs[njobs].passphrase = passphrase;
+      njobs++;
+    }
+  /* This converts the keys and stores them protected again.  */
+  agent_unprotect_keys(ctrl, jobs, njobs);
+
+  /* Import the remaining keys one by one.  These are keys with
+     another passphrase or none.  convert_from_openpgp_native does not
+     return an error if it fails to store a key, thus check that it
+     is there now.  */
+  for (i = 1, j = 0; i < nkeys; i++) {
+    if (passphrase && openpgp_key_is_protected(keys[i].openpgp_sexp) &&
+        !jobs[j++].err && !agent_key_available(keys[i].grip))
+      continue;
+    err = import_openpgp_key(ctrl, ctx, keys + i, force, cache_nonce_addr,
+                             NULL);
+    if (err) break;
+  }
+
+leave:
+  if (jobs)
+    for (j = 0; j < nkeys; j++) xfree(jobs[j].result);
+  xfree(jobs);
+  xfree(passphrase);
+  return err;
+}
+
+/* Import the NKEYS keys in our own format at KEYS, protecting them
+   with the same new passphrase in parallel.  */
+static gpg_error_t import_plain_keys(ctrl_t ctrl, struct import_key_s *keys,
+                                     size_t nkeys, int force) {
+  gpg_error_t err = 0;
+  struct protect_job_s *jobs = NULL;
+  char *passphrase = NULL;
+  char *prompt;
+  size_t i;
+
+  for (i = 0; !force && i < nkeys; i++)
+    if (!agent_key_available(keys[i].grip)) return GPG_ERR_EEXIST;
+
+  prompt = xtryasprintf(_("Please enter the passphrase to protect the "
+                          "imported object within the %s system."),
+                        GNUPG_NAME);
+  if (!prompt) return gpg_error_from_syserror();
+  err = agent_ask_new_passphrase(ctrl, prompt, &passphrase);
+  xfree(prompt);
+  if (err) return err;
+
+  if (!passphrase) {
+    for (i = 0; !err && i < nkeys; i++)
+      err = agent_write_private_key(keys[i].grip, keys[i].keydata,
+                                    keys[i].keydatalen, force);
+    return err;
+  }
+
+  jobs = (struct protect_job_s *)xtrycalloc(nkeys, sizeof *jobs);
+  if (!jobs) {
+    err = gpg_error_from_syserror();
+    goto leave;
+  }
+  for (i = 0; i < nkeys; i++) {
+    jobs[i].plainkey = keys[i].keydata;
+    jobs[i].passphrase = passphrase;
+  }
+  err = agent_protect_keys(jobs, nkeys, ctrl->s2k_count, -1);
+  for (i = 0; !err && i < nkeys; i++)
+    err = agent_write_private_key(keys[i].grip, jobs[i].result,
+                                  jobs[i].resultlen, force);
+
+leave:
+  if (jobs)
+    for (i = 0; i < nkeys; i++) xfree(jobs[i].result);
+  xfree(jobs);
+  xfree(passphrase);
+  return err;
+}
+
+/* Import all keys in the KEYDATALEN octets of KEYDATA.  The keys are
+   either all in OpenPGP transfer format or all in our own format.  */
+static gpg_error_t import_keys(ctrl_t ctrl, assuan_context_t ctx,
+                               const unsigned char *keydata,
+                               size_t keydatalen, int unattended, int force,
+                               char **cache_nonce_addr) {
+  gpg_error_t err = 0;
+  struct import_key_s *keys;
+  size_t nkeys, nopenpgp, i, n, off;
+  const char *tag;
+  size_t taglen;
+
+  for (nkeys = 0, off = 0; off < keydatalen;
+       off = skip_key_padding(keydata, keydatalen, off + n), nkeys++) {
+    n = gcry_sexp_canon_len(keydata + off, keydatalen - off, NULL, &err);
+    if (!n) return err;
+  }
+
+  keys = (struct import_key_s *)xtrycalloc(nkeys, sizeof *keys);
+  if (!keys) return gpg_error_from_syserror();
+
+  for (i = nopenpgp = 0, off = 0; i < nkeys; i++) {
+    keys[i].keydata = keydata + off;
+    keys[i].keydatalen = gcry_sexp_canon_len(keydata + off, keydatalen - off,
+                                             NULL, NULL);
+    off = skip_key_padding(keydata, keydatalen, off + keys[i].keydatalen);
+
+    err = keygrip_from_canon_sexp(keys[i].keydata, keys[i].keydatalen,
+                                  keys[i].grip);
+    if (!err) continue;
+    if (gcry_sexp_sscan(&keys[i].openpgp_sexp, NULL,
+                        (const char *)keys[i].keydata, keys[i].keydatalen))
+      goto leave; /* Note that ERR is still set.  */
+    tag = gcry_sexp_nth_data(keys[i].openpgp_sexp, 0, &taglen);
+    if (!tag || taglen != 19 || memcmp(tag, "openpgp-private-key", 19))
+      goto leave;
+    err = 0;
+    nopenpgp++;
+  }
+
+  if (nopenpgp && nopenpgp != nkeys)
+    err = set_error(GPG_ERR_ASS_PARAMETER,
+                    "OpenPGP keys may not be mixed with other keys");
+  else if (nopenpgp)
+    err = import_openpgp_keys(ctrl, ctx, keys, nkeys, unattended, force,
+                              cache_nonce_addr);
+  else if (unattended)
+    err = set_error(GPG_ERR_ASS_PARAMETER,
+                    "\"--unattended\" may only be used with OpenPGP keys");
+  else
+    err = import_plain_keys(ctrl, keys, nkeys, force);
+
+leave:
+  for (i = 0; i < nkeys; i++) {
+    gcry_sexp_release(keys[i].openpgp_sexp);
+    xfree(keys[i].key);
+  }
+  xfree(keys);
+  return err;
+}
+
 static const char hlp_import_key[] =
     "IMPORT_KEY [--unattended] [--force] [<cache_nonce>]\n"
     "\n"
@@ -1336,7 +1605,12 @@ static const char hlp_import_key[] =
     "no arguments but uses the inquiry \"KEYDATA\" to ask for the actual\n"
     "key data.  The key must be a canonical S-expression.  The\n"
     "option --unattended tries to import the key as-is without any\n"
-    "re-encryption.  Existing key can be overwritten with --force.";
+    "re-encryption.  Existing key can be overwritten with --force.\n"
+    "\n"
+    "The key data may also hold several keys, each padded with zeros\n"
+    "to a multiple of 8 octets, which are either all OpenPGP keys or\n"
+    "none.  They are protected with the same passphrase, and none is\n"
+    "imported if one of them exists and --force is not given.";
 static gpg_error_t cmd_import_key(assuan_context_t ctx, char *line) {
   ctrl_t ctrl = (ctrl_t)assuan_get_pointer(ctx);
   gpg_error_t err;
@@ -1373,6 +1647,12 @@ static gpg_error_t cmd_import_key(assuan_context_t ctx, char *line) {
   realkeylen = gcry_sexp_canon_len(key, keylen, NULL, &err);
   if (!realkeylen) goto leave; /* Invalid canonical encoded S-expression.  */
 
+  if (skip_key_padding(key, keylen, realkeylen) < keylen) {
+    err = import_keys(ctrl, ctx, key, keylen, opt_unattended, force,
+                      &cache_nonce);
+    goto leave;
+  }
+
   err = keygrip_from_canon_sexp(key, realkeylen, grip);
   if (err) {
     /* This might be due to an unsupported S-expression format.
@@ -1833,8 +2113,12 @@ static int register_commands(assuan_context_t ctx) {
 }
 
 /* Startup the server.  CTRL is the control structure for this
-   connection; it has only the basic initialization. */
-void start_command_handler(ctrl_t ctrl) {
+   connection; it has only the basic initialization.  If FD is
+   GNUPG_INVALID_FD the connection is made through stdin and stdout,
+   otherwise FD is a socket connection accepted by the daemon.  In the
+   latter case errors only terminate this connection; the socket is
+   closed on return.  */
+void start_command_handler(ctrl_t ctrl, gnupg_fd_t fd) {
   int rc;
   assuan_context_t ctx = NULL;
   assuan_fd_t filedes[2];
@@ -1842,21 +2126,30 @@ void start_command_handler(ctrl_t ctrl) {
   rc = assuan_new(&ctx);
   if (rc) {
     log_error("failed to allocate assuan context: %s\n", gpg_strerror(rc));
-    agent_exit(2);
+    if (fd == GNUPG_INVALID_FD) agent_exit(2);
+    close(FD2INT(fd));
+    return;
   }
 
-  filedes[0] = assuan_fdopen(0);
-  filedes[1] = assuan_fdopen(1);
-  rc = assuan_init_pipe_server(ctx, filedes);
-  if (rc) {
-    log_error("failed to initialize the server: %s\n", gpg_strerror(rc));
-    agent_exit(2);
+  if (fd == GNUPG_INVALID_FD) {
+    filedes[0] = assuan_fdopen(0);
+    filedes[1] = assuan_fdopen(1);
+    rc = assuan_init_pipe_server(ctx, filedes);
+  } else {
+    rc = assuan_init_socket_server(ctx, fd, ASSUAN_SOCKET_SERVER_ACCEPTED);
+    if (rc) close(FD2INT(fd));
   }
-  rc = register_commands(ctx);
+  if (!rc) {
+    rc = register_commands(ctx);
+    if (rc)
+      log_error("failed to register commands with Assuan: %s\n",
+                gpg_strerror(rc));
+  } else
+    log_error("failed to initialize the server: %s\n", gpg_strerror(rc));
   if (rc) {
-    log_error("failed to register commands with Assuan: %s\n",
-              gpg_strerror(rc));
-    agent_exit(2);
+    if (fd == GNUPG_INVALID_FD) agent_exit(2);
+    assuan_release(ctx);
+    return;
   }
 
   assuan_set_pointer(ctx, ctrl);
@@ -390,11 +390,18 @@ static int unprotect(ctrl_t ctrl, const char *cache_nonce,
   unsigned char *result;
   size_t resultlen;
   char hexgrip[40 + 1];
+  unsigned char keytag[32];
 
   if (r_passphrase) *r_passphrase = NULL;
 
   bin2hex(grip, 20, hexgrip);
 
+  /* The unprotected key is cached under a hash of the protected key
+     so that a changed key file is never answered from the cache.  */
+  if (opt.cache_unprotected_keys)
+    gcry_md_hash_buffer(GCRY_MD_SHA256, keytag, *keybuf,
+                        gcry_sexp_canon_len(*keybuf, 0, NULL, NULL));
+
   /* Initially try to get it using a cache nonce.  */
   if (cache_nonce) {
     char *pw;
@@ -420,11 +427,24 @@ static int unprotect(ctrl_t ctrl, const char *cache_nonce,
   if (cache_mode != CACHE_MODE_IGNORE) {
     char *pw;
 
+    /* Skip the S2K if we still have the unprotected key.  */
+    if (opt.cache_unprotected_keys && !r_passphrase) {
+      result = agent_get_cache_key(hexgrip, cache_mode, keytag, &resultlen);
+      if (result) {
+        if (cache_mode == CACHE_MODE_NORMAL) agent_store_cache_hit(hexgrip);
+        xfree(*keybuf);
+        *keybuf = result;
+        return 0;
+      }
+    }
+
   retry:
     pw = agent_get_cache(hexgrip, cache_mode);
     if (pw) {
       rc = agent_unprotect(ctrl, *keybuf, pw, NULL, &result, &resultlen);
       if (!rc) {
+        if (opt.cache_unprotected_keys)
+          agent_put_cache_key(hexgrip, cache_mode, keytag, result, resultlen);
         if (cache_mode == CACHE_MODE_NORMAL) agent_store_cache_hit(hexgrip);
         if (r_passphrase)
           *r_passphrase = pw;
@@ -519,6 +539,10 @@ static int unprotect(ctrl_t ctrl, const char *cache_nonce,
       /* Passphrase is fine.  */
       agent_put_cache(hexgrip, cache_mode, pi->pin,
                       lookup_ttl ? lookup_ttl(hexgrip) : 0);
+      if (opt.cache_unprotected_keys)
+        agent_put_cache_key(
+            hexgrip, cache_mode, keytag, arg.unprotected_key,
+            gcry_sexp_canon_len(arg.unprotected_key, 0, NULL, NULL));
       agent_store_cache_hit(hexgrip);
       if (r_passphrase && *pi->pin) *r_passphrase = xtrystrdup(pi->pin);
     }
@@ -20,6 +20,13 @@
 
 #include <config.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -39,6 +46,12 @@
 #endif
 #include <aclapi.h>
 #include <sddl.h>
+#else /*!HAVE_W32_SYSTEM*/
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #endif /*!HAVE_W32_SYSTEM*/
 #include <unistd.h>
 
@@ -68,6 +81,8 @@ enum cmd_and_opt_values {
   oNoDetach,
   oLogFile,
   oServer,
+  oDaemon,
+  oWorkerThreads,
   oBatch,
 
   oLCctype,
@@ -82,6 +97,7 @@ enum cmd_and_opt_values {
   oAllowMarkTrusted,
   oNoAllowMarkTrusted,
   oNoAllowExternalCache,
+  oCacheUnprotectedKeys,
   oDisableScdaemon,
   oWriteEnvFile
 };
@@ -95,6 +111,7 @@ static ARGPARSE_OPTS opts[] = {
     ARGPARSE_group(301, N_("@Options:\n ")),
 
     ARGPARSE_s_n(oServer, "server", N_("run in server mode (foreground)")),
+    ARGPARSE_s_n(oDaemon, "daemon", N_("run in daemon mode (background)")),
     ARGPARSE_s_n(oVerbose, "verbose", N_("verbose")),
     ARGPARSE_s_n(oQuiet, "quiet", N_("be somewhat more quiet")),
     ARGPARSE_s_s(oOptions, "options", N_("|FILE|read options from FILE")),
@@ -104,6 +121,7 @@ static ARGPARSE_OPTS opts[] = {
     ARGPARSE_s_s(oDebugLevel, "debug-level", "@"),
 
     ARGPARSE_s_n(oNoDetach, "no-detach", N_("do not detach from the console")),
+    ARGPARSE_s_u(oWorkerThreads, "worker-threads", "@"),
     ARGPARSE_s_s(oLogFile, "log-file", N_("use a log file for the server")),
     ARGPARSE_s_n(oDisableScdaemon, "disable-scdaemon",
                  /* */ N_("do not use the SCdaemon")),
@@ -124,6 +142,7 @@ static ARGPARSE_OPTS opts[] = {
                  /* */ N_("do not use the PIN cache when signing")),
     ARGPARSE_s_n(oNoAllowExternalCache, "no-allow-external-cache",
                  /* */ N_("disallow the use of an external password cache")),
+    ARGPARSE_s_n(oCacheUnprotectedKeys, "cache-unprotected-keys", "@"),
     ARGPARSE_s_n(oNoAllowMarkTrusted, "no-allow-mark-trusted",
                  /* */ N_("disallow clients to mark keys as \"trusted\"")),
     ARGPARSE_s_n(oAllowMarkTrusted, "allow-mark-trusted", "@"),
@@ -153,6 +172,10 @@ static struct debug_flags_s debug_flags[] = {
 #define MIN_PASSPHRASE_NONALPHA (1)
 #define MAX_PASSPHRASE_DAYS (0)
 
+/* The number of connections served concurrently in daemon mode.  */
+#define DEFAULT_WORKER_THREADS 8
+#define MAX_WORKER_THREADS 64
+
 /* Default values for options passed to the pinentry. */
 static char *default_lc_ctype;
 static char *default_lc_messages;
@@ -167,6 +190,31 @@ static const char *debug_level;
    the log file after a SIGHUP if it didn't changed. Malloced. */
 static char *current_logfile;
 
+#ifndef HAVE_W32_SYSTEM
+/* Name of the socket we are listening on in daemon mode.  Malloced.
+   The socket is removed by the cleanup function.  */
+static char *socket_name;
+
+/* The signal handler writes to this pipe to wake up the accept
+   loop.  */
+static int shutdown_pipe[2] = {-1, -1};
+
+/* Connections accepted by the daemon but not yet picked up by a
+   worker thread.  The accept loop stops accepting while MAX
+   connections are waiting, so that a burst of clients can't make us
+   take an unlimited number of file descriptors.  ACTIVE holds duplicates of the
+   connections being served, so that they can be shut down on exit
+   while the worker still owns the original descriptor.  */
+static struct {
+  std::mutex lock;
+  std::condition_variable not_empty;
+  std::deque<gnupg_fd_t> fds;
+  std::vector<int> active;
+  size_t max;
+  int stopping;
+} pending_connections;
+#endif /*!HAVE_W32_SYSTEM*/
+
 /*
    Local prototypes.
  */
@@ -175,6 +223,10 @@ static void create_directories(void);
 
 static void agent_init_default_ctrl(ctrl_t ctrl);
 static void agent_deinit_default_ctrl(ctrl_t ctrl);
+#ifndef HAVE_W32_SYSTEM
+static int create_server_socket(const char *name);
+static void handle_connections(int listen_fd, unsigned int nthreads);
+#endif
 
 /* Return strings describing this program.  The case values are
    described in common/argparse.c:strusage.  The values here override
@@ -264,6 +316,9 @@ static void cleanup(void) {
   if (done) return;
   done = 1;
   deinitialize_module_cache();
+#ifndef HAVE_W32_SYSTEM
+  if (socket_name) gnupg_remove(socket_name);
+#endif
 }
 
 /* Handle options which are allowed to be reset after program start.
@@ -290,6 +345,7 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
     opt.ignore_cache_for_signing = 0;
     opt.allow_mark_trusted = 1;
     opt.allow_external_cache = 1;
+    opt.cache_unprotected_keys = 0;
     opt.disable_scdaemon = 0;
     return 1;
   }
@@ -352,6 +408,10 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
       opt.allow_external_cache = 0;
       break;
 
+    case oCacheUnprotectedKeys:
+      opt.cache_unprotected_keys = 1;
+      break;
+
     default:
       return 0; /* not handled */
   }
@@ -374,6 +434,8 @@ int agent_main(int argc, char **argv) {
   int parse_debug = 0;
   int default_config = 1;
   int pipe_server = 0;
+  int is_daemon = 0;
+  unsigned int worker_threads = DEFAULT_WORKER_THREADS;
   int nodetach = 0;
   int csh_style = 0;
   char *logfile = NULL;
@@ -505,6 +567,12 @@ next_pass:
       case oServer:
         pipe_server = 1;
         break;
+      case oDaemon:
+        is_daemon = 1;
+        break;
+      case oWorkerThreads:
+        worker_threads = pargs.r.ret_ulong;
+        break;
 
       case oLCctype:
         default_lc_ctype = xstrdup(pargs.r.ret_str);
@@ -556,7 +624,13 @@ next_pass:
         log_info(_("Note: '%s' is not considered an option\n"), argv[i]);
   }
 
-  if (!pipe_server) {
+  if (worker_threads < 1 || worker_threads > MAX_WORKER_THREADS) {
+    log_info(_("invalid number of worker threads; using %u\n"),
+             DEFAULT_WORKER_THREADS);
+    worker_threads = DEFAULT_WORKER_THREADS;
+  }
+
+  if (!pipe_server && !is_daemon) {
     /* We have been called without any command and thus we merely
        check whether an agent is already running.  We do this right
        here so that we don't clobber a logfile with this check but
@@ -603,10 +677,73 @@ next_pass:
       agent_exit(1);
     }
     agent_init_default_ctrl(ctrl);
-    start_command_handler(ctrl);
+    start_command_handler(ctrl, GNUPG_INVALID_FD);
     agent_deinit_default_ctrl(ctrl);
     xfree(ctrl);
   }
+#ifndef HAVE_W32_SYSTEM
+  else {
+    /* This is the socket server which serves several clients at
+       once.  */
+    char *name;
+    int fd;
+
+    name = make_filename(gnupg_homedir(), GPG_AGENT_SOCK_NAME, NULL);
+    fd = create_server_socket(name);
+    if (fd == -1) agent_exit(2);
+
+    if (!nodetach) {
+      pid_t pid;
+
+      fflush(NULL);
+      pid = fork();
+      if (pid == (pid_t)-1) {
+        log_error("fork failed: %s\n", strerror(errno));
+        exit(1);
+      } else if (pid) {
+        /* We are the parent.  The socket is ready, thus clients may
+           connect as soon as we return.  The socket belongs to the
+           child now and is not removed by our cleanup.  */
+        close(fd);
+        xfree(name);
+        exit(0);
+      }
+
+      if (setsid() == -1) {
+        log_error("setsid() failed: %s\n", strerror(errno));
+        exit(1);
+      }
+
+      /* Detach from the console.  Without a log file this also
+         silences the log.  */
+      {
+        int devnull = open("/dev/null", O_RDWR);
+
+        if (devnull != -1) {
+          dup2(devnull, 0);
+          dup2(devnull, 1);
+          if (!logfile) dup2(devnull, 2);
+          if (devnull > 2) close(devnull);
+        }
+      }
+      if (chdir("/")) {
+        log_error("chdir to / failed: %s\n", strerror(errno));
+        exit(1);
+      }
+    }
+    socket_name = name;
+
+    log_info("%s %s started\n", strusage(11), strusage(13));
+    handle_connections(fd, worker_threads);
+    log_info("%s %s stopped\n", strusage(11), strusage(13));
+    agent_exit(0);
+  }
+#else  /*HAVE_W32_SYSTEM*/
+  else {
+    log_error("daemon mode is not supported on this platform\n");
+    agent_exit(2);
+  }
+#endif /*HAVE_W32_SYSTEM*/
   /* NOTREACHED */
 
   return 0;
@@ -654,6 +791,240 @@ static void agent_deinit_default_ctrl(ctrl_t ctrl) {
   if (ctrl->lc_messages) xfree(ctrl->lc_messages);
 }
 
+#ifndef HAVE_W32_SYSTEM
+/* Signal handler to terminate the daemon.  It may run in any thread,
+   thus it only wakes up the accept loop.  */
+static void handle_signal(int signo) {
+  int save_errno = errno;
+  char c = 0;
+
+  (void)signo;
+  if (write(shutdown_pipe[1], &c, 1) == -1) {
+    /* The pipe is full, so the accept loop has already been woken
+       up.  */
+  }
+  errno = save_errno;
+}
+
+/* Create a Unix domain socket with NAME and listen on it.  A stale
+   socket from an earlier run is removed.  Returns the file descriptor
+   or -1 on error.  */
+static int create_server_socket(const char *name) {
+  struct sockaddr_un addr;
+  int fd, rc;
+
+  if (strlen(name) + 1 >= sizeof addr.sun_path) {
+    log_error(_("socket name '%s' is too long\n"), name);
+    return -1;
+  }
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    log_error(_("can't create socket: %s\n"), strerror(errno));
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, name);
+
+  rc = bind(fd, (struct sockaddr *)&addr, sizeof addr);
+  if (rc == -1 && errno == EADDRINUSE) {
+    /* Check whether another agent is listening on this socket.  */
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != -1) {
+      log_error(_("a gpg-agent is already running - "
+                  "not starting a new one\n"));
+      close(fd);
+      return -1;
+    }
+
+    /* No, this is a stale socket.  */
+    close(fd);
+    gnupg_remove(name);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+      log_error(_("can't create socket: %s\n"), strerror(errno));
+      return -1;
+    }
+    rc = bind(fd, (struct sockaddr *)&addr, sizeof addr);
+  }
+  if (rc == -1) {
+    log_error(_("error binding socket to '%s': %s\n"), name, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  if (chmod(name, S_IRUSR | S_IWUSR) == -1)
+    log_error(_("can't set permissions of '%s': %s\n"), name,
+              strerror(errno));
+
+  if (listen(fd, SOMAXCONN) == -1) {
+    log_error(_("listen() failed: %s\n"), strerror(errno));
+    gnupg_remove(name);
+    close(fd);
+    return -1;
+  }
+
+  if (opt.verbose) log_info(_("listening on socket '%s'\n"), name);
+  return fd;
+}
+
+/* Serve the accepted connection FD with a fresh control structure.  */
+static void serve_connection(gnupg_fd_t fd) {
+  ctrl_t ctrl;
+
+  ctrl = (ctrl_t)xtrycalloc(1, sizeof *ctrl);
+  if (!ctrl) {
+    log_error("error allocating connection control data: %s\n",
+              strerror(errno));
+    close(FD2INT(fd));
+    return;
+  }
+
+  agent_init_default_ctrl(ctrl);
+  if (opt.verbose) log_info(_("handler for fd %d started\n"), FD2INT(fd));
+  start_command_handler(ctrl, fd);
+  if (opt.verbose) log_info(_("handler for fd %d terminated\n"), FD2INT(fd));
+  agent_deinit_default_ctrl(ctrl);
+  xfree(ctrl);
+}
+
+/* The worker threads take connections from PENDING_CONNECTIONS and
+   serve them one after the other until stop_workers is called.  */
+static void worker_thread(void) {
+  gnupg_fd_t fd;
+  int dupfd;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(pending_connections.lock);
+
+      pending_connections.not_empty.wait(lock, [] {
+        return pending_connections.stopping ||
+               !pending_connections.fds.empty();
+      });
+      if (pending_connections.stopping) return;
+      fd = pending_connections.fds.front();
+      pending_connections.fds.pop_front();
+      dupfd = dup(FD2INT(fd));
+      if (dupfd != -1) pending_connections.active.push_back(dupfd);
+    }
+
+    serve_connection(fd);
+
+    if (dupfd != -1) {
+      std::lock_guard<std::mutex> lock(pending_connections.lock);
+      auto &active = pending_connections.active;
+
+      active.erase(std::find(active.begin(), active.end(), dupfd));
+      close(dupfd);
+    }
+  }
+}
+
+/* Stop the WORKERS.  Connections not yet picked up are closed and
+   the connections being served are shut down, so that their command
+   handlers see EOF and return.  A command which is still waiting for
+   the user, e.g. in a pinentry, delays the exit until it has
+   finished.  */
+static void stop_workers(std::vector<std::thread> &workers) {
+  {
+    std::lock_guard<std::mutex> lock(pending_connections.lock);
+
+    pending_connections.stopping = 1;
+    for (auto fd : pending_connections.fds) close(FD2INT(fd));
+    pending_connections.fds.clear();
+    for (auto fd : pending_connections.active) shutdown(fd, SHUT_RDWR);
+  }
+  pending_connections.not_empty.notify_all();
+
+  for (auto &worker : workers) worker.join();
+}
+
+/* The accept loop of the daemon.  Connections on LISTEN_FD are handed
+   to NTHREADS worker threads, each with its own control structure.
+   The state shared between connections (the cache, the trustlist and
+   the scdaemon connection) has its own locking.  Returns after
+   SIGTERM or SIGINT, once all worker threads have stopped.  */
+static void handle_connections(int listen_fd, unsigned int nthreads) {
+  std::vector<std::thread> workers;
+  struct sigaction sa;
+  sigset_t sigs, oldsigs;
+  struct pollfd pfd[2];
+  unsigned int i;
+  int fd, full;
+
+  /* A client going away must not kill us.  */
+  signal(SIGPIPE, SIG_IGN);
+
+  if (pipe(shutdown_pipe) == -1) {
+    log_error("error creating a pipe: %s\n", strerror(errno));
+    return;
+  }
+  fcntl(shutdown_pipe[1], F_SETFL, O_NONBLOCK);
+
+  memset(&sa, 0, sizeof sa);
+  sa.sa_handler = handle_signal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGINT, &sa, NULL);
+
+  /* The workers inherit our signal mask.  Keep the signals away from
+     them, so that they are delivered to the accept loop.  */
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGTERM);
+  sigaddset(&sigs, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &sigs, &oldsigs);
+  pending_connections.max = nthreads;
+  for (i = 0; i < nthreads; i++) workers.emplace_back(worker_thread);
+  pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+
+  pfd[0].fd = listen_fd;
+  pfd[1].fd = shutdown_pipe[0];
+  pfd[1].events = POLLIN;
+  for (;;) {
+    /* Only this thread adds connections, thus the queue can't fill
+       up before we add the next one.  While it is full we merely
+       look for a shutdown request from time to time.  */
+    {
+      std::lock_guard<std::mutex> lock(pending_connections.lock);
+
+      full = pending_connections.fds.size() >= pending_connections.max;
+    }
+    pfd[0].events = full ? 0 : POLLIN;
+    if (poll(pfd, 2, full ? 100 : -1) == -1) {
+      if (errno != EINTR) {
+        log_error("poll failed: %s\n", strerror(errno));
+        gnupg_sleep(1);
+      }
+      continue;
+    }
+    if (pfd[1].revents) break;
+    if (!pfd[0].revents) continue;
+
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd == -1) {
+      if (errno != EINTR && errno != ECONNABORTED) {
+        log_error("accept failed: %s\n", strerror(errno));
+        gnupg_sleep(1);
+      }
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(pending_connections.lock);
+
+      pending_connections.fds.push_back(INT2FD(fd));
+    }
+    pending_connections.not_empty.notify_one();
+  }
+
+  close(listen_fd);
+  stop_workers(workers);
+}
+#endif /*!HAVE_W32_SYSTEM*/
+
 /* Under W32, this function returns the handle of the scdaemon
    notification event.  Calling it the first time creates that
    event.  */
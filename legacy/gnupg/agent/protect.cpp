@@ -18,6 +18,11 @@
  * along with this program; if not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <assert.h>
 #include <config.h>
 #include <ctype.h>
@@ -35,6 +40,7 @@
 #else
 #include <sys/times.h>
 #endif
+#include <time.h>
 
 #include <botan/hash.h>
 
@@ -49,6 +55,12 @@
 #define PROT_CIPHER_STRING "aes"
 #define PROT_CIPHER_KEYLEN (128 / 8)
 
+/* The file in the home directory with the results of the S2K
+   calibration.  Each line holds the host name, the name of the hash
+   algorithm and the calibrated count.  The home directory may be
+   shared between hosts, thus the host name.  */
+#define S2K_CALIBRATION_FILE "s2k-calibration"
+
 /* Decode an rfc4880 encoded S2K count.  */
 #define S2K_DECODE_COUNT(_val) ((16ul + ((_val)&15)) << (((_val) >> 4) + 6))
 
@@ -71,6 +83,8 @@ static const struct {
 struct calibrate_time_s {
 #ifdef HAVE_W32_SYSTEM
   FILETIME creation_time, exit_time, kernel_time, user_time;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+  struct timespec cputime;
 #else
   clock_t ticks;
 #endif
@@ -80,11 +94,15 @@ static int hash_passphrase(const char *passphrase, int hashalgo, int s2kmode,
                            const unsigned char *s2ksalt, unsigned long s2kcount,
                            unsigned char *key, size_t keylen);
 
-/* Get the process time and store it in DATA.  */
+/* Get the process time and store it in DATA.  Where possible we use
+   the time of the calling thread so that other connections served
+   concurrently by the agent do not disturb the measurement.  */
 static void calibrate_get_time(struct calibrate_time_s *data) {
 #ifdef HAVE_W32_SYSTEM
   GetProcessTimes(GetCurrentProcess(), &data->creation_time, &data->exit_time,
                   &data->kernel_time, &data->user_time);
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &data->cputime);
 #else
   struct tms tmp;
 
@@ -112,6 +130,10 @@ static unsigned long calibrate_elapsed_time(
            stoptime.user_time.dwLowDateTime);
     return (unsigned long)((t2 - t1) / 10000);
   }
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+  return (unsigned long)(
+      (stoptime.cputime.tv_sec - starttime->cputime.tv_sec) * 1000 +
+      (stoptime.cputime.tv_nsec - starttime->cputime.tv_nsec) / 1000000);
 #else
   return (unsigned long)((((double)(stoptime.ticks - starttime->ticks)) /
                           CLOCKS_PER_SEC) *
@@ -119,15 +141,16 @@ static unsigned long calibrate_elapsed_time(
 #endif
 }
 
-/* Run a test hashing for COUNT and return the time required in
-   milliseconds.  */
-static unsigned long calibrate_s2k_count_one(unsigned long count) {
+/* Run a test hashing with HASHALGO for COUNT and return the time
+   required in milliseconds.  */
+static unsigned long calibrate_s2k_count_one(int hashalgo,
+                                             unsigned long count) {
   int rc;
   char keybuf[PROT_CIPHER_KEYLEN];
   struct calibrate_time_s starttime;
 
   calibrate_get_time(&starttime);
-  rc = hash_passphrase("123456789abcdef0", GCRY_MD_SHA1, 3,
+  rc = hash_passphrase("123456789abcdef0", hashalgo, 3,
                        (const unsigned char *)("saltsalt"), count,
                        (unsigned char *)(keybuf), sizeof keybuf);
   if (rc) BUG();
@@ -136,12 +159,12 @@ static unsigned long calibrate_s2k_count_one(unsigned long count) {
 
 /* Measure the time we need to do the hash operations and deduce an
    S2K count which requires about 100ms of time.  */
-static unsigned long calibrate_s2k_count(void) {
+static unsigned long calibrate_s2k_count(int hashalgo) {
   unsigned long count;
   unsigned long ms;
 
   for (count = 65536; count; count *= 2) {
-    ms = calibrate_s2k_count_one(count);
+    ms = calibrate_s2k_count_one(hashalgo, count);
     if (opt.verbose > 1) log_info("S2K calibration: %lu -> %lums\n", count, ms);
     if (ms > 100) break;
   }
@@ -152,18 +175,131 @@ static unsigned long calibrate_s2k_count(void) {
   if (count < 65536) count = 65536;
 
   if (opt.verbose) {
-    ms = calibrate_s2k_count_one(count);
+    ms = calibrate_s2k_count_one(hashalgo, count);
     log_info("S2K calibration: %lu -> %lums\n", count, ms);
   }
 
   return count;
 }
 
+/* Store the name of this host in BUFFER of SIZE.  */
+static void get_calibration_host(char *buffer, size_t size) {
+  if (gethostname(buffer, size - 1)) strcpy(buffer, "localhost");
+  buffer[size - 1] = 0;
+  /* Our file format separates fields by white space.  */
+  for (; *buffer; buffer++)
+    if (spacep(buffer)) *buffer = '_';
+}
+
+/* Return the S2K count for HASHALGO on this host from the calibration
+   file or 0 if there is none.  */
+static unsigned long read_s2k_calibration(int hashalgo) {
+  char host[256];
+  char line[512];
+  char *fname;
+  FILE *fp;
+  char fhost[256], falgo[32];
+  unsigned long fcount;
+  unsigned long count = 0;
+
+  fname = make_filename(gnupg_homedir(), S2K_CALIBRATION_FILE, NULL);
+  fp = fopen(fname, "r");
+  xfree(fname);
+  if (!fp) return 0;
+
+  get_calibration_host(host, sizeof host);
+  while (fgets(line, sizeof line, fp)) {
+    if (*line == '#') continue;
+    if (sscanf(line, "%255s %31s %lu", fhost, falgo, &fcount) != 3) continue;
+    if (!strcmp(fhost, host) && !strcmp(falgo, gcry_md_algo_name(hashalgo))) {
+      count = fcount;
+      break;
+    }
+  }
+  fclose(fp);
+  return count;
+}
+
+/* Store COUNT as the S2K count for HASHALGO on this host in the
+   calibration file.  The records of other hosts are kept.  Errors
+   are not fatal; we merely calibrate again on the next start.  */
+static void write_s2k_calibration(int hashalgo, unsigned long count) {
+  char host[256];
+  char line[512];
+  char *fname, *tmpfname;
+  FILE *fp, *newfp;
+  char fhost[256], falgo[32];
+  unsigned long fcount;
+  const char *algoname = gcry_md_algo_name(hashalgo);
+
+  get_calibration_host(host, sizeof host);
+  fname = make_filename(gnupg_homedir(), S2K_CALIBRATION_FILE, NULL);
+  tmpfname = xstrconcat(fname, ".tmp", NULL);
+
+  newfp = fopen(tmpfname, "w");
+  if (!newfp) {
+    if (opt.verbose)
+      log_info("can't create '%s': %s\n", tmpfname, strerror(errno));
+    goto leave;
+  }
+  fputs("# S2K counts calibrated by " GPG_AGENT_NAME ".\n", newfp);
+
+  fp = fopen(fname, "r");
+  if (fp) {
+    while (fgets(line, sizeof line, fp)) {
+      if (*line == '#') continue;
+      if (sscanf(line, "%255s %31s %lu", fhost, falgo, &fcount) != 3) continue;
+      if (!strcmp(fhost, host) && !strcmp(falgo, algoname)) continue;
+      fprintf(newfp, "%s %s %lu\n", fhost, falgo, fcount);
+    }
+    fclose(fp);
+  }
+  fprintf(newfp, "%s %s %lu\n", host, algoname, count);
+
+  if (fclose(newfp)) {
+    log_error("error writing '%s': %s\n", tmpfname, strerror(errno));
+    gnupg_remove(tmpfname);
+  } else if (gnupg_rename_file(tmpfname, fname))
+    gnupg_remove(tmpfname);
+
+leave:
+  xfree(tmpfname);
+  xfree(fname);
+}
+
+/* Check that COUNT, taken from the calibration file, still requires
+   about 100ms for HASHALGO.  We only hash half of it to keep this
+   cheap and allow for a factor of two because the measurement may be
+   coarse.  A faster or slower machine, or a changed implementation,
+   leads to a new calibration.  */
+static int revalidate_s2k_count(int hashalgo, unsigned long count) {
+  unsigned long ms;
+
+  ms = 2 * calibrate_s2k_count_one(hashalgo, count / 2);
+  if (opt.verbose > 1)
+    log_info("S2K revalidation: %lu -> %lums\n", count, ms);
+  return ms >= 50 && ms <= 200;
+}
+
+/* Return the calibrated S2K count for HASHALGO.  */
+static unsigned long get_s2k_count(int hashalgo) {
+  unsigned long count;
+
+  count = read_s2k_calibration(hashalgo);
+  if (count >= 65536 && revalidate_s2k_count(hashalgo, count)) return count;
+
+  count = calibrate_s2k_count(hashalgo);
+  write_s2k_calibration(hashalgo, count);
+  return count;
+}
+
 /* Return the standard S2K count.  */
 unsigned long get_standard_s2k_count(void) {
+  static std::mutex lock;
   static unsigned long count;
+  std::lock_guard<std::mutex> guard(lock);
 
-  if (!count) count = calibrate_s2k_count();
+  if (!count) count = get_s2k_count(GCRY_MD_SHA1);
 
   /* Enforce a lower limit.  */
   return count < 65536 ? 65536 : count;
@@ -1066,6 +1202,83 @@ int agent_unprotect(ctrl_t ctrl, const unsigned char *protectedkey,
   return 0;
 }
 
+/* Call FUNC for each index from 0 to N-1.  The calls are spread over
+   up to one thread per core, thus FUNC must be safe to be called
+   concurrently.  */
+template <typename F>
+static void run_parallel(size_t n, F func) {
+  std::vector<std::thread> threads;
+  std::atomic<size_t> next{0};
+  size_t nthreads = std::thread::hardware_concurrency();
+  size_t i;
+
+  auto worker = [&]() {
+    for (size_t idx; (idx = next++) < n;) func(idx);
+  };
+
+  if (nthreads > n) nthreads = n;
+  for (i = 1; i < nthreads; i++) threads.emplace_back(worker);
+  worker();
+  for (auto &thread : threads) thread.join();
+}
+
+/* Protect all keys in JOBS with the same parameters as agent_protect.
+   The S2K derivations are independent and run in parallel, which
+   pays off when many keys are imported at once.  The result of each
+   key is stored in its job.  Returns 0 if all keys could be
+   protected or the first error.  */
+gpg_error_t agent_protect_keys(struct protect_job_s *jobs, size_t njobs,
+                               unsigned long s2k_count, int use_ocb) {
+  size_t i;
+
+  /* Calibrate before we start to keep the measurement undisturbed.  */
+  if (!s2k_count) s2k_count = get_standard_s2k_count();
+
+  run_parallel(njobs, [&](size_t idx) {
+    struct protect_job_s *job = jobs + idx;
+
+    job->result = NULL;
+    job->resultlen = 0;
+    job->err = agent_protect(job->plainkey, job->passphrase, &job->result,
+                             &job->resultlen, s2k_count, use_ocb);
+  });
+
+  for (i = 0; i < njobs; i++)
+    if (jobs[i].err) return jobs[i].err;
+  return 0;
+}
+
+/* Unprotect all keys in JOBS as agent_unprotect does, running the S2K
+   derivations in parallel.  The result of each key is stored in its
+   job.  Returns 0 if all keys could be unprotected or the first
+   error.  */
+gpg_error_t agent_unprotect_keys(ctrl_t ctrl, struct unprotect_job_s *jobs,
+                                 size_t njobs) {
+  size_t i;
+
+  run_parallel(njobs, [&](size_t idx) {
+    struct unprotect_job_s *job = jobs + idx;
+    struct server_control_s jobctrl;
+
+    /* An openpgp-native key is converted with the ctrl passed to
+       agent_unprotect, which is not meant to be shared between
+       threads.  The conversion needs only the S2K count, thus each
+       job gets its own ctrl with just that.  */
+    memset(&jobctrl, 0, sizeof jobctrl);
+    jobctrl.s2k_count = ctrl->s2k_count;
+
+    job->result = NULL;
+    job->resultlen = 0;
+    job->err =
+        agent_unprotect(&jobctrl, job->protectedkey, job->passphrase,
+                        job->protected_at, &job->result, &job->resultlen);
+  });
+
+  for (i = 0; i < njobs; i++)
+    if (jobs[i].err) return jobs[i].err;
+  return 0;
+}
+
 /* Check the type of the private key, this is one of the constants:
    PRIVATE_KEY_UNKNOWN if we can't figure out the type (this is the
    value 0), PRIVATE_KEY_CLEAR for an unprotected private key.
@@ -0,0 +1,233 @@
+/* t-gpg-agent.c - Tests for the gpg-agent daemon
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of GnuPG.
+ *
+ * GnuPG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GnuPG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+/* The daemon is started with fewer worker threads than there are
+   clients, so that connections have to wait for a free worker.  */
+#define N_WORKERS 4
+#define N_CLIENTS 8
+#define N_COMMANDS 50
+
+/* Read one line from FD into LINE, without the linefeed.  Returns
+   false on EOF or error.  */
+static bool read_line(int fd, std::string &line) {
+  char c;
+
+  line.clear();
+  for (;;) {
+    ssize_t n = read(fd, &c, 1);
+
+    if (n == -1 && errno == EINTR) continue;
+    if (n != 1) return false;
+    if (c == '\n') return true;
+    line += c;
+  }
+}
+
+static bool write_line(int fd, const std::string &line) {
+  std::string buf = line + "\n";
+
+  return write(fd, buf.data(), buf.size()) == (ssize_t)buf.size();
+}
+
+/* Send the command LINE on FD and return its data in DATA.  Returns
+   false if the command did not succeed.  */
+static bool transact(int fd, const std::string &line, std::string &data) {
+  std::string response;
+
+  data.clear();
+  if (!write_line(fd, line)) return false;
+  for (;;) {
+    if (!read_line(fd, response)) return false;
+    if (!response.compare(0, 2, "D "))
+      data += response.substr(2);
+    else if (response == "OK" || !response.compare(0, 3, "OK "))
+      return true;
+    else if (response[0] != '#' && response[0] != 'S')
+      return false;
+  }
+}
+
+class GpgAgentDaemon : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char tmpl[] = "/tmp/t-gpg-agent.XXXXXX";
+
+    /* The daemon shuts down connections on exit; writing to them must
+       not kill us.  */
+    signal(SIGPIPE, SIG_IGN);
+
+    ASSERT_NE(mkdtemp(tmpl), nullptr) << strerror(errno);
+    homedir = tmpl;
+    socket_name = homedir + "/" GPG_AGENT_SOCK_NAME;
+
+    pid = fork();
+    ASSERT_NE(pid, -1) << strerror(errno);
+    if (!pid) {
+      execl(NEOPG_BINARY, "neopg", "agent", "--homedir", homedir.c_str(),
+            "--daemon", "--no-detach", "--worker-threads",
+            std::to_string(N_WORKERS).c_str(), (char *)NULL);
+      _exit(127);
+    }
+  }
+
+  void TearDown() override {
+    std::string keydir = homedir + "/private-keys-v1.d";
+
+    if (pid > 0) {
+      kill(pid, SIGKILL);
+      waitpid(pid, NULL, 0);
+    }
+    if (!homedir.empty()) {
+      unlink(socket_name.c_str());
+      rmdir(keydir.c_str());
+      rmdir(homedir.c_str());
+    }
+  }
+
+  /* Connect to the daemon and read its greeting.  The daemon has to
+     start up first, thus we retry until the socket shows up.  Returns
+     the connection or -1.  */
+  int connect_agent(void) {
+    struct sockaddr_un addr;
+    std::string greeting;
+    int fd, i;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_name.c_str());
+    for (i = 0; i < 100; i++) {
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd == -1) return -1;
+      if (!connect(fd, (struct sockaddr *)&addr, sizeof addr)) {
+        if (read_line(fd, greeting) && !greeting.compare(0, 2, "OK"))
+          return fd;
+        close(fd);
+        return -1;
+      }
+      close(fd);
+      usleep(50000);
+    }
+    return -1;
+  }
+
+  /* Wait up to ten seconds for the daemon to exit and return its
+     status, or -1 if it is still running.  */
+  int wait_exit(void) {
+    int status, i;
+
+    for (i = 0; i < 200; i++) {
+      if (waitpid(pid, &status, WNOHANG) == pid) {
+        pid = 0;
+        return status;
+      }
+      usleep(50000);
+    }
+    return -1;
+  }
+
+  std::string homedir;
+  std::string socket_name;
+  pid_t pid = 0;
+};
+
+TEST_F(GpgAgentDaemon, ConcurrentClients) {
+  std::atomic<int> failures{0};
+  std::vector<std::thread> clients;
+  std::string version;
+  struct stat st;
+  int fd, i, status;
+
+  /* All clients must see the same answer as this first one.  */
+  fd = connect_agent();
+  ASSERT_NE(fd, -1);
+  ASSERT_TRUE(transact(fd, "GETINFO version", version));
+  close(fd);
+  ASSERT_FALSE(version.empty());
+
+  for (i = 0; i < N_CLIENTS; i++)
+    clients.emplace_back([this, &failures, &version] {
+      int fd = connect_agent();
+      int j;
+
+      if (fd == -1) {
+        failures++;
+        return;
+      }
+      for (j = 0; j < N_COMMANDS; j++) {
+        std::string data;
+
+        if (!transact(fd, "GETINFO version", data) || data != version)
+          failures++;
+      }
+      close(fd);
+    });
+  for (auto &client : clients) client.join();
+  EXPECT_EQ(failures, 0);
+
+  /* Keep one connection open while the daemon is told to terminate.
+     It must be shut down, so that its worker does not block the
+     exit.  */
+  fd = connect_agent();
+  ASSERT_NE(fd, -1);
+  ASSERT_TRUE(transact(fd, "NOP", version));
+
+  ASSERT_EQ(kill(pid, SIGTERM), 0);
+  status = wait_exit();
+  ASSERT_NE(status, -1) << "daemon did not terminate";
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  EXPECT_EQ(stat(socket_name.c_str(), &st), -1);
+
+  EXPECT_FALSE(transact(fd, "NOP", version));
+  close(fd);
+}
+
+TEST_F(GpgAgentDaemon, TerminateWhileIdle) {
+  int fd, status;
+
+  /* Make sure the daemon is up before it gets the signal.  */
+  fd = connect_agent();
+  ASSERT_NE(fd, -1);
+  close(fd);
+
+  ASSERT_EQ(kill(pid, SIGINT), 0);
+  status = wait_exit();
+  ASSERT_NE(status, -1) << "daemon did not terminate";
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
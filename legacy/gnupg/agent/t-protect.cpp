@@ -0,0 +1,238 @@
+/* t-protect.c - Tests for the batch key protection
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of GnuPG.
+ *
+ * GnuPG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GnuPG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "agent.h"
+
+#include "cvt-openpgp.h"
+
+/* The options are defined in gpg-agent.cpp, which is not part of
+   this test.  */
+struct agent_options opt;
+
+#define N_KEYS 6
+#define S2K_COUNT 65536
+
+/* The ctrls and S2K counts seen by convert_from_openpgp_native.  */
+static std::mutex native_lock;
+static std::vector<ctrl_t> native_ctrls;
+static std::vector<unsigned long> native_counts;
+
+/* Stub function.  Accept the passphrase "native" and return a fixed
+   key.  */
+gpg_error_t convert_from_openpgp_native(ctrl_t ctrl, gcry_sexp_t s_pgp,
+                                        const char *passphrase,
+                                        unsigned char **r_key) {
+  static const char key[] = "(11:private-key)";
+
+  (void)s_pgp;
+  {
+    std::lock_guard<std::mutex> lock(native_lock);
+    native_ctrls.push_back(ctrl);
+    native_counts.push_back(ctrl->s2k_count);
+  }
+  if (strcmp(passphrase, "native")) return GPG_ERR_BAD_PASSPHRASE;
+  *r_key = (unsigned char *)xtrymalloc(sizeof key);
+  if (!*r_key) return gpg_error_from_syserror();
+  memcpy(*r_key, key, sizeof key);
+  return 0;
+}
+
+static std::string canon(const unsigned char *buf) {
+  return std::string((const char *)buf,
+                     gcry_sexp_canon_len(buf, 0, NULL, NULL));
+}
+
+class ProtectTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    gcry_sexp_t parms, key, skey;
+    unsigned char buf[2048];
+    size_t n;
+    int i;
+
+    ASSERT_FALSE(
+        gcry_sexp_build(&parms, NULL, "(genkey (rsa (nbits 4:1024)))"));
+    for (i = 0; i < N_KEYS; i++) {
+      ASSERT_FALSE(gcry_pk_genkey(&key, parms));
+      skey = gcry_sexp_find_token(key, "private-key", 0);
+      ASSERT_NE(skey, nullptr);
+      n = gcry_sexp_sprint(skey, GCRYSEXP_FMT_CANON, buf, sizeof buf);
+      ASSERT_NE(n, 0u);
+      keys.push_back(std::string((char *)buf, n));
+      gcry_sexp_release(skey);
+      gcry_sexp_release(key);
+    }
+    gcry_sexp_release(parms);
+  }
+
+  void SetUp() override {
+    memset(&ctrl, 0, sizeof ctrl);
+    ctrl.s2k_count = S2K_COUNT;
+  }
+
+  /* Return the Ith key protected with PASSPHRASE by agent_protect.  */
+  std::string protect(int i, const char *passphrase) {
+    unsigned char *result = NULL;
+    size_t resultlen = 0;
+    std::string s;
+
+    EXPECT_EQ(agent_protect((const unsigned char *)keys[i].data(), passphrase,
+                            &result, &resultlen, S2K_COUNT, -1),
+              0);
+    if (result) s = std::string((char *)result, resultlen);
+    xfree(result);
+    return s;
+  }
+
+  /* Unprotect KEY with PASSPHRASE by agent_unprotect.  Returns the
+     error and stores the key at RESULT.  */
+  int unprotect(const std::string &key, const char *passphrase,
+                std::string &result, char *protected_at) {
+    unsigned char *buf;
+    size_t buflen;
+    int err;
+
+    err = agent_unprotect(&ctrl, (const unsigned char *)key.data(), passphrase,
+                          protected_at, &buf, &buflen);
+    result.clear();
+    if (!err) {
+      result = std::string((char *)buf, buflen);
+      xfree(buf);
+    }
+    return err;
+  }
+
+  static std::vector<std::string> keys;
+  struct server_control_s ctrl;
+};
+
+std::vector<std::string> ProtectTest::keys;
+
+static const char *passphrases[N_KEYS] = {"abc", "abc", "x", "def",
+                                          "abc", "a longer passphrase"};
+
+TEST_F(ProtectTest, ProtectKeysMatchesSerial) {
+  struct protect_job_s jobs[N_KEYS];
+  std::string serial, batch, plain;
+  int i;
+
+  memset(jobs, 0, sizeof jobs);
+  for (i = 0; i < N_KEYS; i++) {
+    jobs[i].plainkey = (const unsigned char *)keys[i].data();
+    jobs[i].passphrase = passphrases[i];
+  }
+  ASSERT_EQ(agent_protect_keys(jobs, N_KEYS, S2K_COUNT, -1), 0);
+
+  for (i = 0; i < N_KEYS; i++) {
+    ASSERT_EQ(jobs[i].err, 0);
+    ASSERT_NE(jobs[i].result, nullptr);
+    batch = std::string((char *)jobs[i].result, jobs[i].resultlen);
+    xfree(jobs[i].result);
+    EXPECT_EQ(canon((const unsigned char *)batch.data()).size(), batch.size());
+
+    /* Salt and IV differ, thus compare what comes out again.  */
+    serial = protect(i, passphrases[i]);
+    EXPECT_EQ(batch.size(), serial.size());
+    EXPECT_EQ(unprotect(batch, passphrases[i], plain, NULL), 0);
+    EXPECT_EQ(plain, keys[i]);
+    EXPECT_EQ(unprotect(serial, passphrases[i], plain, NULL), 0);
+    EXPECT_EQ(plain, keys[i]);
+    EXPECT_EQ(unprotect(batch, "wrong", plain, NULL), GPG_ERR_BAD_PASSPHRASE);
+  }
+}
+
+TEST_F(ProtectTest, UnprotectKeysMatchesSerial) {
+  static const char native_key[] =
+      "(21:protected-private-key(3:rsa(1:n1:\x01)(1:e1:\x03)"
+      "(9:protected14:openpgp-native(19:openpgp-private-key))))";
+  std::vector<std::string> protkeys;
+  std::vector<const char *> passes;
+  struct unprotect_job_s *jobs;
+  std::string plain;
+  gnupg_isotime_t *batch_at;
+  gnupg_isotime_t serial_at;
+  size_t i, n;
+  int err;
+
+  /* Keys with the right and with a wrong passphrase, a corrupted
+     key and openpgp-native keys.  */
+  for (i = 0; i < N_KEYS; i++) {
+    protkeys.push_back(protect(i, passphrases[i]));
+    passes.push_back(passphrases[i]);
+  }
+  protkeys.push_back(protkeys[0]);
+  passes.push_back("wrong");
+  protkeys.push_back(protkeys[1]);
+  protkeys.back()[protkeys.back().size() - 10] ^= 1;
+  passes.push_back(passphrases[1]);
+  for (i = 0; i < 4; i++) {
+    protkeys.push_back(std::string(native_key, sizeof native_key - 1));
+    passes.push_back(i % 2 ? "wrong" : "native");
+  }
+  n = protkeys.size();
+
+  jobs = (struct unprotect_job_s *)xcalloc(n, sizeof *jobs);
+  batch_at = (gnupg_isotime_t *)xcalloc(n, sizeof *batch_at);
+  for (i = 0; i < n; i++) {
+    jobs[i].protectedkey = (const unsigned char *)protkeys[i].data();
+    jobs[i].passphrase = passes[i];
+    jobs[i].protected_at = i % 2 ? batch_at[i] : NULL;
+  }
+  native_ctrls.clear();
+  native_counts.clear();
+  EXPECT_NE(agent_unprotect_keys(&ctrl, jobs, n), 0);
+
+  /* Each conversion of an openpgp-native key got a ctrl of its own
+     with the S2K count of ours.  */
+  ASSERT_EQ(native_ctrls.size(), 4u);
+  for (i = 0; i < native_ctrls.size(); i++) {
+    EXPECT_NE(native_ctrls[i], &ctrl);
+    EXPECT_EQ(native_counts[i], (unsigned long)S2K_COUNT);
+  }
+
+  for (i = 0; i < n; i++) {
+    err = unprotect(protkeys[i], passes[i], plain,
+                    jobs[i].protected_at ? serial_at : NULL);
+    EXPECT_EQ(jobs[i].err, err) << "job " << i;
+    if (!err) {
+      ASSERT_NE(jobs[i].result, nullptr);
+      EXPECT_EQ(std::string((char *)jobs[i].result, jobs[i].resultlen), plain);
+      if (jobs[i].protected_at) EXPECT_STREQ(batch_at[i], serial_at);
+    }
+    if (i < N_KEYS) {
+      EXPECT_EQ(err, 0);
+      EXPECT_EQ(plain, keys[i]);
+      if (jobs[i].protected_at) EXPECT_TRUE(*batch_at[i]);
+    }
+    xfree(jobs[i].result);
+  }
+  xfree(batch_at);
+  xfree(jobs);
+}
@@ -253,6 +253,9 @@ gpg_error_t start_new_gpg_agent(assuan_context_t *r_ctx,
 
   err = assuan_transact(ctx, "RESET", NULL, NULL, NULL, NULL, NULL, NULL);
   if (!err) {
+    /* Keys and ciphertexts are better sent as binary frames.  If the
+       agent does not agree, data lines are used as before.  */
+    assuan_negotiate_binary_data(ctx);
     err = send_pinentry_environment(ctx, opt_lc_ctype, opt_lc_messages);
     if (err == GPG_ERR_FORBIDDEN) {
       /* Check whether we are in restricted mode.  */
@@ -325,6 +328,10 @@ gpg_error_t start_new_dirmngr(assuan_context_t *r_ctx, int verbose, int debug) {
 
   if (debug) log_debug("connection to the dirmngr established\n");
 
+  /* Certificates and CRLs are better sent as binary frames.  If the
+     server does not agree, data lines are used as before.  */
+  assuan_negotiate_binary_data(ctx);
+
   *r_ctx = ctx;
   return 0;
 }
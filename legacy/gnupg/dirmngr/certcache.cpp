@@ -20,6 +20,8 @@
 #include <config.h>
 
 #include <mutex>
+#include <string>
+#include <unordered_map>
 
 #include <assert.h>
 #include <dirent.h>
@@ -66,6 +68,8 @@ struct cert_item_s {
   char *issuer_dn;          /* The malloced issuer DN.  */
   ksba_sexp_t sn;           /* The malloced serial number  */
   char *subject_dn;         /* The malloced subject DN - maybe NULL.  */
+  ksba_sexp_t subject_key_id; /* The malloced subjectKeyIdentifier -
+                                 maybe NULL.  */
 
   /* If this field is set the certificate has been taken from some
    * configuration and shall not be flushed from the cache.  */
@@ -81,6 +85,17 @@ typedef struct cert_item_s *cert_item_t;
    the first byte of the fingerprint.  */
 static cert_item_t cert_cache[256];
 
+/* Secondary indexes into CERT_CACHE for the lookups done while
+   building a chain.  They map the subject DN, the issuer DN, the
+   issuer DN plus serial number and the subjectKeyIdentifier to the
+   valid items.  DNs are compared as returned by ksba, which already
+   uses the RFC-2253 string form.  */
+typedef std::unordered_multimap<std::string, cert_item_t> cert_index_t;
+static cert_index_t subject_index;
+static cert_index_t issuer_index;
+static cert_index_t issuer_sn_index;
+static cert_index_t keyid_index;
+
 /* This is the global cache_lock variable.  */
 static std::mutex cache_lock;
 
@@ -147,6 +162,63 @@ unsigned char *cert_compute_fpr(ksba_cert_t cert, unsigned char *digest) {
   return digest;
 }
 
+/* Return the canonical S-expression SEXP as a string for use as an
+   index key.  */
+static std::string sexp_key(ksba_const_sexp_t sexp) {
+  size_t n = gcry_sexp_canon_len(sexp, 0, NULL, NULL);
+
+  return std::string((const char *)sexp, n);
+}
+
+/* Return the index key for ISSUER_DN and SERIALNO.  */
+static std::string issuer_sn_key(const char *issuer_dn,
+                                 ksba_const_sexp_t serialno) {
+  std::string key(issuer_dn);
+
+  key += '\0';
+  key += sexp_key(serialno);
+  return key;
+}
+
+/* Remove item CI stored under KEY from INDEX.  */
+static void index_remove(cert_index_t &index, const std::string &key,
+                         cert_item_t ci) {
+  auto range = index.equal_range(key);
+
+  for (auto it = range.first; it != range.second; ++it)
+    if (it->second == ci) {
+      index.erase(it);
+      return;
+    }
+}
+
+/* Add the valid item CI to the secondary indexes.  */
+static void index_cert_item(cert_item_t ci) {
+  if (ci->subject_dn) subject_index.emplace(ci->subject_dn, ci);
+  issuer_index.emplace(ci->issuer_dn, ci);
+  issuer_sn_index.emplace(issuer_sn_key(ci->issuer_dn, ci->sn), ci);
+  if (ci->subject_key_id) keyid_index.emplace(sexp_key(ci->subject_key_id), ci);
+}
+
+/* Remove item CI from the secondary indexes.  */
+static void unindex_cert_item(cert_item_t ci) {
+  if (ci->subject_dn) index_remove(subject_index, ci->subject_dn, ci);
+  index_remove(issuer_index, ci->issuer_dn, ci);
+  index_remove(issuer_sn_index, issuer_sn_key(ci->issuer_dn, ci->sn), ci);
+  if (ci->subject_key_id)
+    index_remove(keyid_index, sexp_key(ci->subject_key_id), ci);
+}
+
+/* Return the SEQ-th valid item stored under KEY in INDEX or NULL.  */
+static cert_item_t index_lookup(const cert_index_t &index,
+                                const std::string &key, unsigned int seq) {
+  auto range = index.equal_range(key);
+
+  for (auto it = range.first; it != range.second; ++it)
+    if (!seq--) return it->second;
+  return NULL;
+}
+
 /* Cleanup one slot.  This releases all resourses but keeps the actual
    slot in the cache marked for reuse. */
 static void clean_cache_slot(cert_item_t ci) {
@@ -154,6 +226,10 @@ static void clean_cache_slot(cert_item_t ci) {
 
   if (!ci->cert) return; /* Already cleaned.  */
 
+  if (ci->issuer_dn && ci->sn) unindex_cert_item(ci);
+
+  ksba_free(ci->subject_key_id);
+  ci->subject_key_id = NULL;
   ksba_free(ci->sn);
   ci->sn = NULL;
   ksba_free(ci->issuer_dn);
@@ -251,8 +327,11 @@ static gpg_error_t put_cert(ksba_cert_t cert, int permanent,
     return GPG_ERR_INV_CERT_OBJ;
   }
   ci->subject_dn = ksba_cert_get_subject(cert, 0);
+  if (ksba_cert_get_subj_key_id(cert, NULL, &ci->subject_key_id))
+    ci->subject_key_id = NULL;
   ci->permanent = !!permanent;
   ci->trustclasses = trustclass;
+  index_cert_item(ci);
 
   if (!permanent) total_nonperm_certificates++;
 
@@ -729,61 +808,63 @@ ksba_cert_t get_cert_byhexfpr(const char *string) {
 
 /* Return the certificate matching ISSUER_DN and SERIALNO.  */
 ksba_cert_t get_cert_bysn(const char *issuer_dn, ksba_sexp_t serialno) {
-  /* Simple and inefficient implementation.   fixme! */
   cert_item_t ci;
-  int i;
+
+  if (!gcry_sexp_canon_len(serialno, 0, NULL, NULL)) return NULL;
 
   std::lock_guard<std::mutex> lock(cache_lock);
-  for (i = 0; i < 256; i++) {
-    for (ci = cert_cache[i]; ci; ci = ci->next)
-      if (ci->cert && !strcmp(ci->issuer_dn, issuer_dn) &&
-          !compare_serialno(ci->sn, serialno)) {
-        ksba_cert_ref(ci->cert);
-        return ci->cert;
-      }
-  }
+  ci = index_lookup(issuer_sn_index, issuer_sn_key(issuer_dn, serialno), 0);
+  if (!ci) return NULL;
 
-  return NULL;
+  ksba_cert_ref(ci->cert);
+  return ci->cert;
 }
 
 /* Return the certificate matching ISSUER_DN.  SEQ should initially be
    set to 0 and bumped up to get the next issuer with that DN. */
 ksba_cert_t get_cert_byissuer(const char *issuer_dn, unsigned int seq) {
-  /* Simple and very inefficient implementation and API.  fixme! */
   cert_item_t ci;
-  int i;
 
   std::lock_guard<std::mutex> lock(cache_lock);
-  for (i = 0; i < 256; i++) {
-    for (ci = cert_cache[i]; ci; ci = ci->next)
-      if (ci->cert && !strcmp(ci->issuer_dn, issuer_dn))
-        if (!seq--) {
-          ksba_cert_ref(ci->cert);
-          return ci->cert;
-        }
-  }
+  ci = index_lookup(issuer_index, issuer_dn, seq);
+  if (!ci) return NULL;
 
-  return NULL;
+  ksba_cert_ref(ci->cert);
+  return ci->cert;
 }
 
 /* Return the certificate matching SUBJECT_DN.  SEQ should initially be
    set to 0 and bumped up to get the next subject with that DN. */
 ksba_cert_t get_cert_bysubject(const char *subject_dn, unsigned int seq) {
-  /* Simple and very inefficient implementation and API.  fixme! */
   cert_item_t ci;
-  int i;
 
   if (!subject_dn) return NULL;
 
   std::lock_guard<std::mutex> lock(cache_lock);
-  for (i = 0; i < 256; i++) {
-    for (ci = cert_cache[i]; ci; ci = ci->next)
-      if (ci->cert && ci->subject_dn && !strcmp(ci->subject_dn, subject_dn))
-        if (!seq--) {
-          ksba_cert_ref(ci->cert);
-          return ci->cert;
-        }
-  }
+  ci = index_lookup(subject_index, subject_dn, seq);
+  if (!ci) return NULL;
+
+  ksba_cert_ref(ci->cert);
+  return ci->cert;
+}
+
+/* Return the certificate matching SUBJECT_DN and the
+   subjectKeyIdentifier KEYID from the cache.  */
+static ksba_cert_t get_cert_bysubject_keyid(const char *subject_dn,
+                                            ksba_sexp_t keyid) {
+  cert_item_t ci;
+  std::string key;
+  unsigned int seq;
+
+  if (!subject_dn || !gcry_sexp_canon_len(keyid, 0, NULL, NULL)) return NULL;
+  key = sexp_key(keyid);
+
+  std::lock_guard<std::mutex> lock(cache_lock);
+  for (seq = 0; (ci = index_lookup(keyid_index, key, seq)); seq++)
+    if (ci->subject_dn && !strcmp(ci->subject_dn, subject_dn)) {
+      ksba_cert_ref(ci->cert);
+      return ci->cert;
+    }
 
   return NULL;
 }
@@ -1144,7 +1225,6 @@ ksba_cert_t find_cert_bysn(ctrl_t ctrl, const char *issuer_dn,
 ksba_cert_t find_cert_bysubject(ctrl_t ctrl, const char *subject_dn,
                                 ksba_sexp_t keyid) {
   gpg_error_t err;
-  int seq;
   ksba_cert_t cert = NULL;
   cert_fetch_context_t context = NULL;
   ksba_sexp_t subj;
@@ -1158,33 +1238,25 @@ ksba_cert_t find_cert_bysubject(ctrl_t ctrl, const char *subject_dn,
   if (ctrl->ocsp_certs && subject_dn) {
     cert_item_t ci;
     cert_ref_t cr;
-    int i;
+    unsigned int i;
 
     /* For efficiency reasons we won't use get_cert_bysubject here. */
     std::lock_guard<std::mutex> lock(cache_lock);
-    for (i = 0; i < 256; i++)
-      for (ci = cert_cache[i]; ci; ci = ci->next)
-        if (ci->cert && ci->subject_dn && !strcmp(ci->subject_dn, subject_dn))
-          for (cr = ctrl->ocsp_certs; cr; cr = cr->next)
-            if (!memcmp(ci->fpr, cr->fpr, 20)) {
-              ksba_cert_ref(ci->cert);
-              return ci->cert; /* We use this certificate. */
-            }
+    for (i = 0; (ci = index_lookup(subject_index, subject_dn, i)); i++)
+      for (cr = ctrl->ocsp_certs; cr; cr = cr->next)
+        if (!memcmp(ci->fpr, cr->fpr, 20)) {
+          ksba_cert_ref(ci->cert);
+          return ci->cert; /* We use this certificate. */
+        }
     if (DBG_LOOKUP)
       log_debug("find_cert_bysubject: certificate not in ocsp_certs\n");
   }
 
   /* No check whether the certificate is cached.  */
-  for (seq = 0; (cert = get_cert_bysubject(subject_dn, seq)); seq++) {
-    if (!keyid) break; /* No keyid requested, so return the first one found. */
-    if (!ksba_cert_get_subj_key_id(cert, NULL, &subj) &&
-        !cmp_simple_canon_sexp(keyid, subj)) {
-      xfree(subj);
-      break; /* Found matching cert. */
-    }
-    xfree(subj);
-    ksba_cert_release(cert);
-  }
+  if (keyid)
+    cert = get_cert_bysubject_keyid(subject_dn, keyid);
+  else
+    cert = get_cert_bysubject(subject_dn, 0);
   if (cert) return cert; /* Done.  */
 
   if (DBG_LOOKUP) log_debug("find_cert_bysubject: certificate not in cache\n");
@@ -84,13 +84,25 @@
       SHA-1 hash value of the issuer DN prefixed with a "crl-" and
       suffixed with a ".db".  Thus the length of the filename is 47.
 
+      A delta CRL is merged with the cached base CRL into a new DB
+      file, which then carries the CRL number of the delta CRL.
+      Entries with the reason removeFromCRL are not stored.
+
 
 */
 
 #include <config.h>
 
 #include <boost/format.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
 
 #include <assert.h>
 #include <dirent.h>
@@ -125,13 +137,8 @@
 #define DBDIRFILE "DIR.txt"
 #define DBDIRVERSION 1
 
-/* The number of DB files we may have open at one time.  We need to
-   limit this because there is no guarantee that the number of issuers
-   has a upper limit.  We are currently using mmap, so it is a good
-   idea anyway to limit the number of opened cache files. */
-#define MAX_OPEN_DB_FILES 5
-
 static const char oidstr_crlNumber[] = "2.5.29.20";
+static const char oidstr_deltaCRLIndicator[] = "2.5.29.27";
 /* static const char oidstr_issuingDistributionPoint[] = "2.5.29.28"; */
 static const char oidstr_authorityKeyIdentifier[] = "2.5.29.35";
 
@@ -159,14 +166,19 @@ struct crl_cache_entry_s {
   struct cdb *cdb; /* The cache file handle or NULL if not open. */
 
   unsigned int cdb_use_count; /* Current use count. */
-  unsigned int cdb_lru_count; /* Used for LRU purposes. */
-  int dbfile_checked;         /* Set to true if the dbfile_hash value has
-                                 been checked one. */
+  /* Links in the LRU list of the cache.  An entry is on that list
+     while its file is open but not in use.  */
+  struct crl_cache_entry_s *lru_prev, *lru_next;
+  int dbfile_checked; /* Set to true if the dbfile_hash value has
+                         been checked one. */
 };
 
 /* Definition of the entire cache object. */
 struct crl_cache_s {
   crl_cache_entry_t entries;
+  /* The open but unused cache files, least recently used first.  */
+  crl_cache_entry_t lru_head, lru_tail;
+  unsigned int open_count; /* Number of open cache files.  */
 };
 
 typedef struct crl_cache_s *crl_cache_t;
@@ -895,10 +907,15 @@ static int hash_dbfile(const char *fname, unsigned char *md5buffer) {
   return 0;
 }
 
-/* Compare the file FNAME against the dexified MD5 hash MD5HASH and
-   return 0 if they match. */
-static int check_dbfile(const char *fname, const char *md5hexvalue) {
+/* Compare the cache file FNAME, opened as CDB, against the dexified
+   MD5 hash MD5HASH and return 0 if they match.  The file is hashed
+   from its mapping so that it needs not to be read again.  */
+static int check_dbfile(const char *fname, struct cdb *cdb,
+                        const char *md5hexvalue) {
   unsigned char buffer1[16], buffer2[16];
+  char prefix[256];
+  gcry_md_hd_t md5;
+  gpg_error_t err;
 
   if (strlen(md5hexvalue) != 32) {
     log_error(_("invalid formatted checksum for '%s'\n"), fname);
@@ -906,68 +923,88 @@ static int check_dbfile(const char *fname, const char *md5hexvalue) {
   }
   Botan::hex_decode(buffer1, md5hexvalue, strlen(md5hexvalue), false);
 
-  if (hash_dbfile(fname, buffer2)) return -1;
+  err = gcry_md_open(&md5, GCRY_MD_MD5, 0);
+  if (err) {
+    log_error(_("error setting up MD5 hash context: %s\n"), gpg_strerror(err));
+    return -1;
+  }
+  /* The same layout information as in hash_dbfile.  */
+  sprintf(prefix, "%.100s/%.100s:%d", DBDIR_D, DBDIRFILE, DBDIRVERSION);
+  gcry_md_write(md5, prefix, strlen(prefix));
+  gcry_md_write(md5, cdb->cdb_mem, cdb->cdb_fsize);
+  gcry_md_final(md5);
+  memcpy(buffer2, gcry_md_read(md5, GCRY_MD_MD5), 16);
+  gcry_md_close(md5);
 
   return memcmp(buffer1, buffer2, 16);
 }
 
+/* Append ENTRY, whose cache file is open but not in use, to the LRU
+   list of CACHE.  */
+static void lru_append(crl_cache_t cache, crl_cache_entry_t entry) {
+  entry->lru_next = NULL;
+  entry->lru_prev = cache->lru_tail;
+  if (cache->lru_tail)
+    cache->lru_tail->lru_next = entry;
+  else
+    cache->lru_head = entry;
+  cache->lru_tail = entry;
+}
+
+/* Remove ENTRY from the LRU list of CACHE.  */
+static void lru_remove(crl_cache_t cache, crl_cache_entry_t entry) {
+  if (entry->lru_prev)
+    entry->lru_prev->lru_next = entry->lru_next;
+  else
+    cache->lru_head = entry->lru_next;
+  if (entry->lru_next)
+    entry->lru_next->lru_prev = entry->lru_prev;
+  else
+    cache->lru_tail = entry->lru_prev;
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+/* Close the cache file of ENTRY which must be open but not in use.  */
+static void close_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
+  int fd = cdb_fileno(entry->cdb);
+
+  lru_remove(cache, entry);
+  cdb_free(entry->cdb);
+  xfree(entry->cdb);
+  entry->cdb = NULL;
+  cache->open_count--;
+  if (close(fd))
+    log_error(_("error closing cache file: %s\n"), strerror(errno));
+}
+
 /* Open the cache file for ENTRY.  This function implements a caching
    strategy and might close unused cache files. It is required to use
-   unlock_db_file after using the file. */
+   unlock_db_file after using the file.  The files are mapped into
+   memory; with --crl-cache-max-open set to 0 they stay mapped until
+   the cache is released.  */
 static struct cdb *lock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
   char *fname;
   int fd;
-  int open_count;
-  crl_cache_entry_t e;
 
   if (entry->cdb) {
-    entry->cdb_use_count++;
+    if (!entry->cdb_use_count++) lru_remove(cache, entry);
     return entry->cdb;
   }
 
-  for (open_count = 0, e = cache->entries; e; e = e->next) {
-    if (e->cdb) open_count++;
-    /*       log_debug ("CACHE: cdb=%p use_count=%u lru_count=%u\n", */
-    /*                  e->cdb,e->cdb_use_count,e->cdb_lru_count); */
-  }
-
-  /* If there are too many file open, find the least recent used DB
-     file and close it.  Note that for Pth thread safeness we need to
-     use a loop here. */
-  while (open_count >= MAX_OPEN_DB_FILES) {
-    crl_cache_entry_t last_e = NULL;
-    unsigned int last_lru = (unsigned int)(-1);
-
-    for (e = cache->entries; e; e = e->next)
-      if (e->cdb && !e->cdb_use_count && e->cdb_lru_count < last_lru) {
-        last_lru = e->cdb_lru_count;
-        last_e = e;
-      }
-    if (!last_e) {
+  /* If there are too many file open, close the least recently used
+     ones.  */
+  while (opt.crl_cache_max_open &&
+         cache->open_count >= opt.crl_cache_max_open) {
+    if (!cache->lru_head) {
       log_error(_("too many open cache files; can't open anymore\n"));
       return NULL;
     }
-
-    /*       log_debug ("CACHE: closing file at cdb=%p\n", last_e->cdb); */
-
-    fd = cdb_fileno(last_e->cdb);
-    cdb_free(last_e->cdb);
-    xfree(last_e->cdb);
-    last_e->cdb = NULL;
-    if (close(fd))
-      log_error(_("error closing cache file: %s\n"), strerror(errno));
-    open_count--;
+    close_db_file(cache, cache->lru_head);
   }
 
   fname = make_db_file_name(entry->issuer_hash);
   if (opt.verbose) log_info(_("opening cache file '%s'\n"), fname);
 
-  if (!entry->dbfile_checked) {
-    if (!check_dbfile(fname, entry->dbfile_hash)) entry->dbfile_checked = 1;
-    /* Note, in case of an error we don't print an error here but
-       let require the caller to do that check. */
-  }
-
   entry->cdb = (cdb *)xtrycalloc(1, sizeof *entry->cdb);
   if (!entry->cdb) {
     xfree(fname);
@@ -990,10 +1027,18 @@ static struct cdb *lock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
     xfree(fname);
     return NULL;
   }
+
+  /* The checksum is verified only the first time the file is opened.  */
+  if (!entry->dbfile_checked) {
+    if (!check_dbfile(fname, entry->cdb, entry->dbfile_hash))
+      entry->dbfile_checked = 1;
+    /* Note, in case of an error we don't print an error here but
+       let require the caller to do that check. */
+  }
   xfree(fname);
 
   entry->cdb_use_count = 1;
-  entry->cdb_lru_count = 0;
+  cache->open_count++;
 
   return entry->cdb;
 }
@@ -1004,10 +1049,8 @@ static void unlock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
     log_error(_("calling unlock_db_file on a closed file\n"));
   else if (!entry->cdb_use_count)
     log_error(_("calling unlock_db_file on an unlocked file\n"));
-  else {
-    entry->cdb_use_count--;
-    entry->cdb_lru_count++;
-  }
+  else if (!--entry->cdb_use_count)
+    lru_append(cache, entry);
 
   /* If the entry was marked for deletion in the meantime do it now.
      We do this for the sake of Pth thread safeness. */
@@ -1024,6 +1067,7 @@ static void unlock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
     else
       eprev->next = enext;
     /* FIXME: Do we leak ENTRY? */
+    if (entry->cdb) close_db_file(cache, entry);
   }
 }
 
@@ -1386,6 +1430,141 @@ static void abort_sig_check(ksba_crl_t crl, gcry_md_hd_t md) {
   gcry_md_close(md);
 }
 
+/* The CRL parser hands its data over to the hashing and the DB
+   writing threads in batches of about this size.  */
+#define INGEST_BATCH_SIZE 65536
+
+/* The number of batches which may be pending for one thread before
+   the parser has to wait.  */
+#define INGEST_MAX_PENDING 8
+
+/* The serial numbers of a CRL are only collected for merging with a
+   base CRL if there are not more than this many.  Larger delta CRLs
+   are rejected.  */
+#define MAX_DELTA_CRL_ITEMS 100000
+
+/* One stage of the CRL ingest pipeline.  The parser appends data to
+   the current batch and commits it; a thread calls CONSUME on the
+   committed batches in order.  An error returned by CONSUME stops the
+   stage; it is returned by the following commits and by finish.  */
+class ingest_stage {
+ public:
+  explicit ingest_stage(std::function<gpg_error_t(const std::string &)> consume)
+      : consume_(consume), thread_(&ingest_stage::run, this) {
+    batch_.reserve(INGEST_BATCH_SIZE);
+  }
+
+  ~ingest_stage() { abort(); }
+
+  /* The batch to append data to.  Data must be appended in units
+     which CONSUME can process on their own.  */
+  std::string &batch() { return batch_; }
+
+  /* Hand the current batch over to the thread if it is large enough
+     or if FLUSH is set.  */
+  gpg_error_t commit(bool flush = false) {
+    std::unique_lock<std::mutex> lock(lock_);
+
+    if (batch_.size() < INGEST_BATCH_SIZE && !flush) return err_;
+    space_.wait(lock, [this] {
+      return pending_.size() < INGEST_MAX_PENDING || err_;
+    });
+    if (!err_ && !batch_.empty()) {
+      pending_.push_back(std::move(batch_));
+      ready_.notify_one();
+    }
+    batch_.clear();
+    batch_.reserve(INGEST_BATCH_SIZE);
+    return err_;
+  }
+
+  /* Process all remaining data and wait for the thread.  */
+  gpg_error_t finish() {
+    gpg_error_t err = commit(true);
+
+    stop(0);
+    return err ? err : err_;
+  }
+
+  /* Drop all pending data and wait for the thread.  */
+  void abort() { stop(GPG_ERR_CANCELED); }
+
+ private:
+  void stop(gpg_error_t err) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (err && !err_) err_ = err;
+      done_ = true;
+      ready_.notify_one();
+    }
+    if (thread_.joinable()) thread_.join();
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(lock_);
+
+    for (;;) {
+      ready_.wait(lock, [this] { return !pending_.empty() || done_; });
+      if (pending_.empty()) break;
+      std::string batch = std::move(pending_.front());
+      pending_.pop_front();
+      space_.notify_one();
+      if (err_) continue;
+
+      lock.unlock();
+      gpg_error_t err = consume_(batch);
+      lock.lock();
+      if (err && !err_) {
+        err_ = err;
+        space_.notify_one();
+      }
+    }
+  }
+
+  std::function<gpg_error_t(const std::string &)> consume_;
+  std::string batch_;
+  std::mutex lock_;
+  std::condition_variable ready_;
+  std::condition_variable space_;
+  std::deque<std::string> pending_;
+  bool done_{false};
+  gpg_error_t err_{0};
+  std::thread thread_;
+};
+
+/* The hash function given to ksba during the CRL parsing.  It moves
+   the hashing of the CRL to the thread of the ingest stage ARG.  */
+static void ingest_hash(void *arg, const void *buffer, size_t length) {
+  ingest_stage *hasher = (ingest_stage *)arg;
+
+  hasher->batch().append((const char *)buffer, length);
+  hasher->commit();
+}
+
+/* Store the CRL entries in BATCH into the DB CDB.  Each entry in
+   BATCH is the length of the serial number as a cdbi_t followed by
+   the serial number and the 16 byte record.  */
+static gpg_error_t ingest_write_items(struct cdb_make *cdb,
+                                      const std::string &batch) {
+  const char *p = batch.data();
+  const char *end = p + batch.size();
+  cdbi_t n;
+
+  while (p < end) {
+    memcpy(&n, p, sizeof n);
+    p += sizeof n;
+    if (cdb_make_add(cdb, p, n, p + n, 1 + 15)) {
+      gpg_error_t err = gpg_error_from_syserror();
+      log_error(_("error inserting item into "
+                  "temporary cache file: %s\n"),
+                gpg_strerror(err));
+      return err;
+    }
+    p += n + 1 + 15;
+  }
+  return 0;
+}
+
 /* Workhorse of the CRL loading machinery.  The CRL is read using the
    CRL object and stored in the data base file DB with the name FNAME
    (only used for printing error messages).  That DB should be a
@@ -1399,24 +1578,39 @@ static void abort_sig_check(ksba_crl_t crl, gcry_md_hd_t md) {
    caller should free *R_ISSUER even if the function returns with an
    error.  R_TRUST_ANCHOR is set on exit to NULL or a string with the
    hexified fingerprint of the root certificate, if checking this
-   certificate for trustiness is required.
+   certificate for trustiness is required.  R_NITEMS is set to the
+   number of items in the CRL and, if there are not more than
+   MAX_DELTA_CRL_ITEMS, R_SERIALS to their serial numbers as needed
+   for merging a delta CRL.
+
+   Parsing, hashing of the CRL and writing the DB run in parallel:
+   the parser hands the data to be hashed and the items to be stored
+   over to a thread each.
 */
 static int crl_parse_insert(ctrl_t ctrl, ksba_crl_t crl, struct cdb_make *cdb,
                             const char *fname, char **r_crlissuer,
                             ksba_isotime_t thisupdate,
-                            ksba_isotime_t nextupdate, char **r_trust_anchor) {
+                            ksba_isotime_t nextupdate, char **r_trust_anchor,
+                            std::unordered_set<std::string> *r_serials,
+                            unsigned long *r_nitems) {
   gpg_error_t err;
   ksba_stop_reason_t stopreason;
   ksba_cert_t crlissuer_cert = NULL;
   gcry_md_hd_t md = NULL;
   int algo = 0;
   size_t n;
+  std::unique_ptr<ingest_stage> hasher;
+  ingest_stage writer([cdb](const std::string &batch) {
+    return ingest_write_items(cdb, batch);
+  });
 
   (void)fname;
 
   *r_crlissuer = NULL;
   *thisupdate = *nextupdate = 0;
   *r_trust_anchor = NULL;
+  r_serials->clear();
+  *r_nitems = 0;
 
   /* Start of the KSBA parser loop. */
   do {
@@ -1430,6 +1624,11 @@ static int crl_parse_insert(ctrl_t ctrl, ksba_crl_t crl, struct cdb_make *cdb,
       case KSBA_SR_BEGIN_ITEMS: {
         err = start_sig_check(crl, &md, &algo);
         if (err) goto failure;
+        hasher.reset(new ingest_stage([md](const std::string &batch) {
+          gcry_md_write(md, batch.data(), batch.size());
+          return (gpg_error_t)0;
+        }));
+        ksba_crl_set_hash_function(crl, ingest_hash, hasher.get());
 
         err = ksba_crl_get_update_times(crl, thisupdate, nextupdate);
         if (err) {
@@ -1456,8 +1655,8 @@ static int crl_parse_insert(ctrl_t ctrl, ksba_crl_t crl, struct cdb_make *cdb,
         const unsigned char *p;
         ksba_isotime_t rdate;
         ksba_crl_reason_t reason;
-        int rc;
-        unsigned char record[1 + 15];
+        cdbi_t klen;
+        char record[1 + 15];
 
         err = ksba_crl_get_item(crl, &serial, rdate, &reason);
         if (err) {
@@ -1468,18 +1667,27 @@ static int crl_parse_insert(ctrl_t ctrl, ksba_crl_t crl, struct cdb_make *cdb,
         }
         p = serial_to_buffer(serial, &n);
         if (!p) BUG();
-        record[0] = (reason & 0xff);
-        memcpy(record + 1, rdate, 15);
-        rc = cdb_make_add(cdb, p, n, record, 1 + 15);
-        if (rc) {
-          err = gpg_error_from_errno(errno);
-          log_error(_("error inserting item into "
-                      "temporary cache file: %s\n"),
-                    strerror(errno));
-          goto failure;
-        }
 
+        if (++*r_nitems <= MAX_DELTA_CRL_ITEMS)
+          r_serials->emplace((const char *)p, n);
+        else if (!r_serials->empty())
+          r_serials->clear();
+
+        /* Entries removed by a delta CRL only mask those of the base
+           CRL and are not stored.  */
+        if (!(reason & KSBA_CRLREASON_REMOVE_FROM_CRL)) {
+          std::string &batch = writer.batch();
+
+          klen = n;
+          record[0] = (reason & 0xff);
+          memcpy(record + 1, rdate, 15);
+          batch.append((const char *)&klen, sizeof klen);
+          batch.append((const char *)p, n);
+          batch.append(record, sizeof record);
+          err = writer.commit();
+        }
         ksba_free(serial);
+        if (err) goto failure;
       } break;
 
       case KSBA_SR_END_ITEMS:
@@ -1547,6 +1755,11 @@ static int crl_parse_insert(ctrl_t ctrl, ksba_crl_t crl, struct cdb_make *cdb,
           goto failure;
         }
 
+        /* Hashing is complete after the last item.  */
+        hasher->finish();
+        hasher.reset();
+        ksba_crl_set_hash_function(crl, NULL, NULL);
+
         err = finish_sig_check(crl, md, algo, crlissuer_cert);
         if (err) {
           log_error(_("CRL signature verification failed: %s\n"),
@@ -1577,6 +1790,15 @@ static int crl_parse_insert(ctrl_t ctrl, ksba_crl_t crl, struct cdb_make *cdb,
   assert(!err);
 
 failure:
+  /* The stage threads must be done before MD and CDB are closed.  */
+  if (hasher) {
+    hasher->abort();
+    ksba_crl_set_hash_function(crl, NULL, NULL);
+  }
+  if (err)
+    writer.abort();
+  else
+    err = writer.finish();
   if (md) abort_sig_check(crl, md);
   ksba_cert_release(crlissuer_cert);
   return err;
@@ -1636,6 +1858,109 @@ static char *get_auth_key_id(ksba_crl_t crl, char **serialno) {
   return string;
 }
 
+/* Return the BaseCRLNumber of a delta CRL as an allocated hex string
+   at R_NUMBER or NULL if CRL is not a delta CRL.  */
+static gpg_error_t get_delta_base(ksba_crl_t crl, char **r_number) {
+  gpg_error_t err;
+  const char *oid;
+  const unsigned char *der;
+  size_t derlen, n, i;
+  int idx;
+
+  *r_number = NULL;
+  for (idx = 0;
+       !(err = ksba_crl_get_extension(crl, idx, &oid, NULL, &der, &derlen));
+       idx++) {
+    if (strcmp(oid, oidstr_deltaCRLIndicator)) continue;
+
+    /* The value is an INTEGER of at most 20 octets.  */
+    if (derlen < 3 || der[0] != 0x02 || der[1] > 20 || der[1] + 2 != derlen) {
+      log_error(_("invalid deltaCRLIndicator in CRL\n"));
+      return GPG_ERR_INV_CRL;
+    }
+    n = der[1];
+    *r_number = (char *)xtrymalloc(2 * n + 1);
+    if (!*r_number) return gpg_error_from_syserror();
+    for (i = 0; i < n; i++) sprintf(*r_number + 2 * i, "%02X", der[2 + i]);
+    return 0;
+  }
+  if (err == GPG_ERR_EOF || err == GPG_ERR_NO_DATA) err = 0;
+  return err;
+}
+
+/* Compare the CRL numbers A and B given as hex strings.  */
+static int compare_crl_numbers(const char *a, const char *b) {
+  size_t alen, blen;
+
+  while (*a == '0') a++;
+  while (*b == '0') b++;
+  alen = strlen(a);
+  blen = strlen(b);
+  if (alen != blen) return alen < blen ? -1 : 1;
+  return strcmp(a, b);
+}
+
+/* Add the entries of the cached CRL for ISSUER_HASH to the DB CDB
+   holding a delta CRL with SERIALS.  The cached CRL must not be older
+   than the BASE_NUMBER of the delta CRL.  Entries listed in the delta
+   CRL are skipped as the delta CRL supersedes them.  */
+static gpg_error_t merge_base_crl(
+    crl_cache_t cache, const char *issuer_hash, const char *base_number,
+    struct cdb_make *cdb, const std::unordered_set<std::string> &serials) {
+  gpg_error_t err = 0;
+  crl_cache_entry_t base;
+  struct cdb *basecdb;
+  struct cdb_find cdbfp;
+  std::string key;
+  unsigned char record[16];
+  unsigned long count = 0;
+  int rc;
+
+  base = find_entry(cache->entries, issuer_hash);
+  if (!base || base->invalid || !base->crl_number ||
+      compare_crl_numbers(base->crl_number, base_number) < 0) {
+    log_error(_("base CRL %s of delta CRL is not cached\n"), base_number);
+    return GPG_ERR_INV_CRL;
+  }
+
+  basecdb = lock_db_file(cache, base);
+  if (!basecdb) return GPG_ERR_INV_CRL;
+
+  rc = cdb_findinit(&cdbfp, basecdb, NULL, 0);
+  while (!rc && (rc = cdb_findnext(&cdbfp)) > 0) {
+    rc = 0;
+    if (cdb_datalen(basecdb) != sizeof record) continue;
+
+    key.resize(cdb_keylen(basecdb));
+    if (cdb_read(basecdb, &key[0], key.size(), cdb_keypos(basecdb)) ||
+        cdb_read(basecdb, record, sizeof record, cdb_datapos(basecdb))) {
+      err = gpg_error_from_syserror();
+      log_error(_("problem reading cache record: %s\n"), gpg_strerror(err));
+      break;
+    }
+    if (serials.count(key)) continue;
+
+    if (cdb_make_add(cdb, key.data(), key.size(), record, sizeof record)) {
+      err = gpg_error_from_syserror();
+      log_error(_("error inserting item into "
+                  "temporary cache file: %s\n"),
+                gpg_strerror(err));
+      break;
+    }
+    count++;
+  }
+  if (!err && rc < 0) {
+    err = gpg_error_from_syserror();
+    log_error(_("problem reading cache record: %s\n"), gpg_strerror(err));
+  }
+  unlock_db_file(cache, base);
+
+  if (!err && opt.verbose)
+    log_info(_("merged %lu entries of base CRL %s\n"), count,
+             base->crl_number);
+  return err;
+}
+
 /* Insert the CRL retrieved using URL into the cache specified by
    CACHE.  The CRL itself will be read from the stream FP and is
    expected in binary format.
@@ -1672,6 +1997,9 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
   const char *oid;
   int critical;
   char *trust_anchor = NULL;
+  char *delta_base = NULL;
+  std::unordered_set<std::string> serials;
+  unsigned long nitems;
 
   /* FIXME: We should acquire a mutex for the URL, so that we don't
      simultaneously enter the same CRL twice.  However this needs to be
@@ -1738,7 +2066,7 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
   cdb_make_start(&cdb, fd_cdb);
 
   err = crl_parse_insert(ctrl, crl, &cdb, fname, &issuer, thisupdate,
-                         nextupdate, &trust_anchor);
+                         nextupdate, &trust_anchor, &serials, &nitems);
   if (err) {
     log_error(_("crl_parse_insert failed: %s\n"), gpg_strerror(err));
     /* Error in cleanup ignored.  */
@@ -1746,6 +2074,32 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
     goto leave;
   }
 
+  {
+    /* Create an hex encoded SHA-1 hash of the issuer DN to be
+       used as the key for the cache. */
+    std::unique_ptr<Botan::HashFunction> sha1 =
+        Botan::HashFunction::create_or_throw("SHA-1");
+    std::string hexencoded = Botan::hex_encode(sha1->process(issuer));
+    issuer_hash = xstrdup(hexencoded.c_str());
+  }
+
+  /* A delta CRL only lists the changes since its base CRL; thus we
+     add the entries of the cached base CRL.  */
+  err = get_delta_base(crl, &delta_base);
+  if (!err && delta_base) {
+    if (nitems > MAX_DELTA_CRL_ITEMS) {
+      log_error(_("delta CRL with %lu entries is too large\n"), nitems);
+      err = GPG_ERR_INV_CRL;
+    } else
+      err = merge_base_crl(cache, issuer_hash, delta_base, &cdb, serials);
+  }
+  serials.clear();
+  if (err) {
+    /* Error in cleanup ignored.  */
+    cdb_make_finish(&cdb);
+    goto leave;
+  }
+
   /* Finish the database. */
   if (cdb_make_finish(&cdb)) {
     err = gpg_error_from_errno(errno);
@@ -1792,7 +2146,8 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
        !(err = ksba_crl_get_extension(crl, idx, &oid, &critical, NULL, NULL));
        idx++) {
     if (!critical || !strcmp(oid, oidstr_authorityKeyIdentifier) ||
-        !strcmp(oid, oidstr_crlNumber))
+        !strcmp(oid, oidstr_crlNumber) ||
+        !strcmp(oid, oidstr_deltaCRLIndicator))
       continue;
     log_error(_("unknown critical CRL extension %s\n"), oid);
     if (!err2) err2 = GPG_ERR_INV_CRL;
@@ -1804,15 +2159,6 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
     err = GPG_ERR_INV_CRL;
   }
 
-  {
-    /* Create an hex encoded SHA-1 hash of the issuer DN to be
-       used as the key for the cache. */
-    std::unique_ptr<Botan::HashFunction> sha1 =
-        Botan::HashFunction::create_or_throw("SHA-1");
-    std::string hexencoded = Botan::hex_encode(sha1->process(issuer));
-    issuer_hash = xstrdup(hexencoded.c_str());
-  }
-
   /* Create an ENTRY. */
   entry = (crl_cache_entry_t)xtrycalloc(1, sizeof *entry);
   if (!entry) {
@@ -1855,24 +2201,10 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
 
   /* Just in case close unused matching files.  Actually we need this
      only under Windows but saving file descriptors is never bad.  */
-  {
-    int any;
-    do {
-      any = 0;
-      for (e = cache->entries; e; e = e->next)
-        if (!e->cdb_use_count && e->cdb &&
-            !strcmp(e->issuer_hash, entry->issuer_hash)) {
-          int fd = cdb_fileno(e->cdb);
-          cdb_free(e->cdb);
-          xfree(e->cdb);
-          e->cdb = NULL;
-          if (close(fd))
-            log_error(_("error closing cache file: %s\n"), strerror(errno));
-          any = 1;
-          break;
-        }
-    } while (any);
-  }
+  for (e = cache->entries; e; e = e->next)
+    if (!e->cdb_use_count && e->cdb &&
+        !strcmp(e->issuer_hash, entry->issuer_hash))
+      close_db_file(cache, e);
 #ifdef HAVE_W32_SYSTEM
   gnupg_remove(newfname);
 #endif
@@ -1911,6 +2243,7 @@ leave:
   xfree(issuer_hash);
   xfree(checksum);
   xfree(trust_anchor);
+  xfree(delta_base);
   return err ? err : err2;
 }
 
@@ -98,6 +98,7 @@ enum cmd_and_opt_values {
   oOCSPMaxPeriod,
   oOCSPCurrentPeriod,
   oMaxReplies,
+  oCRLCacheMaxOpen,
   oHkpCaCert,
   oFakedSystemTime,
   oForce,
@@ -161,6 +162,7 @@ static ARGPARSE_OPTS opts[] = {
 
     ARGPARSE_s_i(oMaxReplies, "max-replies",
                  N_("|N|do not return more than N items in one query")),
+    ARGPARSE_s_u(oCRLCacheMaxOpen, "crl-cache-max-open", "@"),
 
     ARGPARSE_s_s(oKeyServer, "keyserver", "@"),
     ARGPARSE_s_s(oHkpCaCert, "hkp-cacert",
@@ -204,6 +206,12 @@ static struct debug_flags_s debug_flags[] = {
 
 #define DEFAULT_MAX_REPLIES 10
 
+/* The number of CRL cache files we may have open at one time.  We
+   need to limit this because there is no guarantee that the number of
+   issuers has a upper limit.  The files are mapped into memory, so it
+   is a good idea anyway to limit the number of opened cache files.  */
+#define DEFAULT_CRL_CACHE_MAX_OPEN 5
+
 #define DEFAULT_CONNECT_TIMEOUT (15 * 1000)      /* 15 seconds */
 #define DEFAULT_CONNECT_QUICK_TIMEOUT (2 * 1000) /*  2 seconds */
 
@@ -332,6 +340,7 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
     opt.ocsp_max_period = 90 * 86400;      /* 90 days.  */
     opt.ocsp_current_period = 3 * 60 * 60; /* 3 hours. */
     opt.max_replies = DEFAULT_MAX_REPLIES;
+    opt.crl_cache_max_open = DEFAULT_CRL_CACHE_MAX_OPEN;
     while (opt.ocsp_signer) {
       fingerprint_list_t tmp = opt.ocsp_signer->next;
       xfree(opt.ocsp_signer);
@@ -420,6 +429,9 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
     case oMaxReplies:
       opt.max_replies = pargs->r.ret_int;
       break;
+    case oCRLCacheMaxOpen:
+      opt.crl_cache_max_open = pargs->r.ret_ulong;
+      break;
 
     case oHkpCaCert: {
       /* FIXME: We are not supporting this anymore, but could.  */
@@ -96,6 +96,10 @@ struct dirmngr_options {
 
   int max_replies{0};
 
+  /* The number of CRL cache files kept open.  0 keeps all files open
+     once they have been used.  */
+  unsigned int crl_cache_max_open{0};
+
   const char *ocsp_responder{nullptr}; /* Standard OCSP responder's URL. */
   fingerprint_list_t ocsp_signer{
       nullptr}; /* The list of fingerprints with allowed
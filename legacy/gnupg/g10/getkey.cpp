@@ -19,7 +19,11 @@
  * along with this program; if not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <list>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <config.h>
 #include <ctype.h>
@@ -42,12 +46,11 @@
 #include "packet.h"
 #include "trustdb.h"
 
-#define MAX_PK_CACHE_ENTRIES PK_UID_CACHE_SIZE
-#define MAX_UID_CACHE_ENTRIES PK_UID_CACHE_SIZE
-
-#if MAX_PK_CACHE_ENTRIES < 2
-#error We need the cache for key creation
-#endif
+/* The size of the public key and user ID caches is set with
+   --key-cache-size.  We need at least a few entries in the public key
+   cache for key creation and in the user ID cache for listing.  */
+#define MIN_PK_CACHE_ENTRIES 2
+#define MIN_UID_CACHE_ENTRIES 5
 
 /* Flags values returned by the lookup code.  Note that the values are
  * directly used by the KEY_CONSIDERED status line.  */
@@ -93,34 +96,109 @@ struct getkey_ctx_s {
   std::vector<KEYDB_SEARCH_DESC> items;
 };
 
-typedef struct keyid_list {
-  struct keyid_list *next;
-  char fpr[MAX_FINGERPRINT_LEN];
-  u32 keyid[2];
-} * keyid_list_t;
+/* Both the public key cache and the user ID cache are kept in a list
+   ordered by the time of the last use, with the most recently used
+   entry at the front.  Hash maps from the key ID (and for the user ID
+   cache also from the fingerprint) into these lists provide constant
+   time lookups.  When a cache is full, the least recently used entry
+   at the back of the list is evicted.  */
+
+/* Return the key ID KEYID as a single value for use as a hash key.  */
+static inline uint64_t keyid_hash_key(const u32 *keyid) {
+  return ((uint64_t)keyid[0] << 32) | keyid[1];
+}
 
-#if MAX_PK_CACHE_ENTRIES
 typedef struct pk_cache_entry {
-  struct pk_cache_entry *next;
   u32 keyid[2];
   PKT_public_key *pk;
 } * pk_cache_entry_t;
-static pk_cache_entry_t pk_cache;
-static int pk_cache_entries; /* Number of entries in pk cache.  */
+typedef std::list<struct pk_cache_entry> pk_cache_list_t;
+static pk_cache_list_t pk_cache;
+static std::unordered_map<uint64_t, pk_cache_list_t::iterator> pk_cache_by_kid;
 static int pk_cache_disabled;
-#endif
 
-#if MAX_UID_CACHE_ENTRIES < 5
-#error we really need the userid cache
-#endif
+struct keyid_list {
+  char fpr[MAX_FINGERPRINT_LEN];
+  u32 keyid[2];
+};
 typedef struct user_id_db {
-  struct user_id_db *next;
-  keyid_list_t keyids;
-  int len;
-  char name[1];
+  /* The primary key and all subkeys of the keyblock.  */
+  std::vector<struct keyid_list> keyids;
+  /* The primary user ID.  */
+  std::string name;
 } * user_id_db_t;
-static user_id_db_t user_id_db;
-static int uid_cache_entries; /* Number of entries in uid cache. */
+typedef std::list<struct user_id_db> user_id_db_list_t;
+static user_id_db_list_t user_id_db;
+static std::unordered_map<uint64_t, user_id_db_list_t::iterator>
+    user_id_db_by_kid;
+static std::unordered_map<std::string, user_id_db_list_t::iterator>
+    user_id_db_by_fpr;
+
+/* Statistics for the key caches.  */
+static struct {
+  unsigned int pk_hits;
+  unsigned int pk_misses;
+  unsigned int pk_evictions;
+  unsigned int uid_hits;
+  unsigned int uid_misses;
+  unsigned int uid_evictions;
+} cache_stats;
+
+/* Return the maximum number of entries in the key caches.  */
+static size_t key_cache_size(size_t min) {
+  return opt.key_cache_size > min ? opt.key_cache_size : min;
+}
+
+/* Return the entry for KEYID in the public key cache and mark it as
+   the most recently used one, or NULL if it is not cached.  */
+static pk_cache_entry_t pk_cache_lookup(u32 *keyid) {
+  auto it = pk_cache_by_kid.find(keyid_hash_key(keyid));
+
+  if (it == pk_cache_by_kid.end()) {
+    cache_stats.pk_misses++;
+    return NULL;
+  }
+  cache_stats.pk_hits++;
+  pk_cache.splice(pk_cache.begin(), pk_cache, it->second);
+  return &*it->second;
+}
+
+/* Return the entry in the user ID cache with the key id KEYID or, if
+   KEYID is NULL, with the fingerprint FPR and mark it as the most
+   recently used one.  Returns NULL if not cached.  */
+static user_id_db_t uid_cache_lookup(u32 *keyid, const byte *fpr) {
+  user_id_db_list_t::iterator entry;
+
+  if (keyid) {
+    auto it = user_id_db_by_kid.find(keyid_hash_key(keyid));
+    if (it == user_id_db_by_kid.end()) {
+      cache_stats.uid_misses++;
+      return NULL;
+    }
+    entry = it->second;
+  } else {
+    auto it = user_id_db_by_fpr.find(
+        std::string((const char *)fpr, MAX_FINGERPRINT_LEN));
+    if (it == user_id_db_by_fpr.end()) {
+      cache_stats.uid_misses++;
+      return NULL;
+    }
+    entry = it->second;
+  }
+  cache_stats.uid_hits++;
+  user_id_db.splice(user_id_db.begin(), user_id_db, entry);
+  return &*entry;
+}
+
+/* Dump the statistics of the key caches.  */
+void getkey_dump_stats(void) {
+  log_info("pk_cache: entries=%u hits=%u misses=%u evictions=%u\n",
+           (unsigned int)pk_cache.size(), cache_stats.pk_hits,
+           cache_stats.pk_misses, cache_stats.pk_evictions);
+  log_info("uid_cache: entries=%u hits=%u misses=%u evictions=%u\n",
+           (unsigned int)user_id_db.size(), cache_stats.uid_hits,
+           cache_stats.uid_misses, cache_stats.uid_evictions);
+}
 
 static void merge_selfsigs(ctrl_t ctrl, kbnode_t keyblock);
 static int lookup(ctrl_t ctrl, getkey_ctx_t ctx, int want_secret,
@@ -142,8 +220,7 @@ static void print_status_key_considered(kbnode_t keyblock, unsigned int flags);
  * This cache is filled by get_pubkey and is read by get_pubkey and
  * get_pubkey_fast.  */
 void cache_public_key(PKT_public_key *pk) {
-#if MAX_PK_CACHE_ENTRIES
-  pk_cache_entry_t ce, ce2;
+  struct pk_cache_entry ce;
   u32 keyid[2];
 
   if (pk_cache_disabled) return;
@@ -158,39 +235,28 @@ void cache_public_key(PKT_public_key *pk) {
   } else
     return; /* Don't know how to get the keyid.  */
 
-  for (ce = pk_cache; ce; ce = ce->next)
-    if (ce->keyid[0] == keyid[0] && ce->keyid[1] == keyid[1]) {
-      if (DBG_CACHE) log_debug("cache_public_key: already in cache\n");
-      return;
-    }
+  auto it = pk_cache_by_kid.find(keyid_hash_key(keyid));
+  if (it != pk_cache_by_kid.end()) {
+    if (DBG_CACHE) log_debug("cache_public_key: already in cache\n");
+    pk_cache.splice(pk_cache.begin(), pk_cache, it->second);
+    return;
+  }
 
-  if (pk_cache_entries >= MAX_PK_CACHE_ENTRIES) {
-    int n;
-
-    /* Remove the last 50% of the entries.  */
-    for (ce = pk_cache, n = 0; ce && n < pk_cache_entries / 2; n++)
-      ce = ce->next;
-    if (ce && ce != pk_cache && ce->next) {
-      ce2 = ce->next;
-      ce->next = NULL;
-      ce = ce2;
-      for (; ce; ce = ce2) {
-        ce2 = ce->next;
-        free_public_key(ce->pk);
-        xfree(ce);
-        pk_cache_entries--;
-      }
-    }
-    log_assert(pk_cache_entries < MAX_PK_CACHE_ENTRIES);
-  }
-  pk_cache_entries++;
-  ce = (pk_cache_entry_t)xmalloc(sizeof *ce);
-  ce->next = pk_cache;
-  pk_cache = ce;
-  ce->pk = copy_public_key(NULL, pk);
-  ce->keyid[0] = keyid[0];
-  ce->keyid[1] = keyid[1];
-#endif
+  /* Evict the least recently used entries.  */
+  while (pk_cache.size() >= key_cache_size(MIN_PK_CACHE_ENTRIES)) {
+    pk_cache_entry_t old = &pk_cache.back();
+
+    pk_cache_by_kid.erase(keyid_hash_key(old->keyid));
+    free_public_key(old->pk);
+    pk_cache.pop_back();
+    cache_stats.pk_evictions++;
+  }
+
+  ce.keyid[0] = keyid[0];
+  ce.keyid[1] = keyid[1];
+  ce.pk = copy_public_key(NULL, pk);
+  pk_cache.push_front(ce);
+  pk_cache_by_kid[keyid_hash_key(keyid)] = pk_cache.begin();
 }
 
 /* Return a const utf-8 string with the text "[User ID not found]".
@@ -222,90 +288,69 @@ static const char *get_primary_uid(KBNODE keyblock, size_t *uidlen) {
   return s;
 }
 
-static void release_keyid_list(keyid_list_t k) {
-  while (k) {
-    keyid_list_t k2 = k->next;
-    xfree(k);
-    k = k2;
-  }
-}
-
 /****************
  * Store the association of keyid and userid
  * Feed only public keys to this function.
  */
 static void cache_user_id(KBNODE keyblock) {
-  user_id_db_t r;
+  struct user_id_db r;
   const char *uid;
   size_t uidlen;
-  keyid_list_t keyids = NULL;
   KBNODE k;
 
   for (k = keyblock; k; k = k->next) {
     if (k->pkt->pkttype == PKT_PUBLIC_KEY ||
         k->pkt->pkttype == PKT_PUBLIC_SUBKEY) {
-      keyid_list_t a = (keyid_list_t)xmalloc_clear(sizeof *a);
-      /* Hmmm: For a long list of keyids it might be an advantage
-       * to append the keys.  */
-      fingerprint_from_pk(k->pkt->pkt.public_key, (byte *)(a->fpr), NULL);
-      keyid_from_pk(k->pkt->pkt.public_key, a->keyid);
+      struct keyid_list a;
+
+      memset(&a, 0, sizeof a);
+      fingerprint_from_pk(k->pkt->pkt.public_key, (byte *)(a.fpr), NULL);
+      keyid_from_pk(k->pkt->pkt.public_key, a.keyid);
       /* First check for duplicates.  */
-      for (r = user_id_db; r; r = r->next) {
-        keyid_list_t b;
-
-        for (b = r->keyids; b; b = b->next) {
-          if (!memcmp(b->fpr, a->fpr, MAX_FINGERPRINT_LEN)) {
-            if (DBG_CACHE) log_debug("cache_user_id: already in cache\n");
-            release_keyid_list(keyids);
-            xfree(a);
-            return;
-          }
-        }
+      if (user_id_db_by_fpr.count(std::string(a.fpr, MAX_FINGERPRINT_LEN))) {
+        if (DBG_CACHE) log_debug("cache_user_id: already in cache\n");
+        return;
       }
       /* Now put it into the cache.  */
-      a->next = keyids;
-      keyids = a;
+      r.keyids.push_back(a);
     }
   }
-  if (!keyids) BUG(); /* No key no fun.  */
+  if (r.keyids.empty()) BUG(); /* No key no fun.  */
 
   uid = get_primary_uid(keyblock, &uidlen);
+  r.name.assign(uid, uidlen);
+
+  /* Evict the least recently used entries.  */
+  while (user_id_db.size() >= key_cache_size(MIN_UID_CACHE_ENTRIES)) {
+    user_id_db_t old = &user_id_db.back();
+
+    for (auto &a : old->keyids) {
+      auto it = user_id_db_by_kid.find(keyid_hash_key(a.keyid));
+      /* Another entry may have taken over the key id.  */
+      if (it != user_id_db_by_kid.end() && &*it->second == old)
+        user_id_db_by_kid.erase(it);
+      user_id_db_by_fpr.erase(std::string(a.fpr, MAX_FINGERPRINT_LEN));
+    }
+    user_id_db.pop_back();
+    cache_stats.uid_evictions++;
+  }
 
-  if (uid_cache_entries >= MAX_UID_CACHE_ENTRIES) {
-    /* fixme: use another algorithm to free some cache slots */
-    r = user_id_db;
-    user_id_db = r->next;
-    release_keyid_list(r->keyids);
-    xfree(r);
-    uid_cache_entries--;
-  }
-  r = (user_id_db_t)xmalloc(sizeof *r + uidlen - 1);
-  r->keyids = keyids;
-  r->len = uidlen;
-  memcpy(r->name, uid, r->len);
-  r->next = user_id_db;
-  user_id_db = r;
-  uid_cache_entries++;
+  user_id_db.push_front(std::move(r));
+  for (auto &a : user_id_db.front().keyids) {
+    user_id_db_by_kid[keyid_hash_key(a.keyid)] = user_id_db.begin();
+    user_id_db_by_fpr[std::string(a.fpr, MAX_FINGERPRINT_LEN)] =
+        user_id_db.begin();
+  }
 }
 
 /* Disable and drop the public key cache (which is filled by
    cache_public_key and get_pubkey).  Note: there is currently no way
    to re-enable this cache.  */
 void getkey_disable_caches() {
-#if MAX_PK_CACHE_ENTRIES
-  {
-    pk_cache_entry_t ce, ce2;
-
-    for (ce = pk_cache; ce; ce = ce2) {
-      ce2 = ce->next;
-      free_public_key(ce->pk);
-      xfree(ce);
-    }
-    pk_cache_disabled = 1;
-    pk_cache_entries = 0;
-    pk_cache = NULL;
-  }
-#endif
+  for (auto &ce : pk_cache) free_public_key(ce.pk);
+  pk_cache.clear();
+  pk_cache_by_kid.clear();
+  pk_cache_disabled = 1;
   /* fixme: disable user id cache ? */
 }
 
@@ -593,23 +638,19 @@ int get_pubkey(ctrl_t ctrl, PKT_public_key *pk, u32 *keyid) {
   int internal = 0;
   int rc = 0;
 
-#if MAX_PK_CACHE_ENTRIES
   if (pk) {
     /* Try to get it from the cache.  We don't do this when pk is
        NULL as it does not guarantee that the user IDs are
        cached. */
-    pk_cache_entry_t ce;
-    for (ce = pk_cache; ce; ce = ce->next) {
-      if (ce->keyid[0] == keyid[0] && ce->keyid[1] == keyid[1])
-      /* XXX: We don't check PK->REQ_USAGE here, but if we don't
-         read from the cache, we do check it!  */
-      {
-        copy_public_key(pk, ce->pk);
-        return 0;
-      }
+    pk_cache_entry_t ce = pk_cache_lookup(keyid);
+
+    /* XXX: We don't check PK->REQ_USAGE here, but if we don't read
+       from the cache, we do check it!  */
+    if (ce) {
+      copy_public_key(pk, ce->pk);
+      return 0;
     }
   }
-#endif
   /* More init stuff.  */
   if (!pk) {
     pk = (PKT_public_key *)xmalloc_clear(sizeof *pk);
@@ -676,22 +717,17 @@ int get_pubkey_fast(PKT_public_key *pk, u32 *keyid) {
   u32 pkid[2];
 
   log_assert(pk);
-#if MAX_PK_CACHE_ENTRIES
   {
     /* Try to get it from the cache */
-    pk_cache_entry_t ce;
-
-    for (ce = pk_cache; ce; ce = ce->next) {
-      if (ce->keyid[0] == keyid[0] && ce->keyid[1] == keyid[1]
-          /* Only consider primary keys.  */
-          && ce->pk->keyid[0] == ce->pk->main_keyid[0] &&
-          ce->pk->keyid[1] == ce->pk->main_keyid[1]) {
-        if (pk) copy_public_key(pk, ce->pk);
-        return 0;
-      }
+    pk_cache_entry_t ce = pk_cache_lookup(keyid);
+
+    /* Only consider primary keys.  */
+    if (ce && ce->pk->keyid[0] == ce->pk->main_keyid[0] &&
+        ce->pk->keyid[1] == ce->pk->main_keyid[1]) {
+      if (pk) copy_public_key(pk, ce->pk);
+      return 0;
     }
   }
-#endif
 
   hd = keydb_new();
   if (!hd) return gpg_error_from_syserror();
@@ -2774,6 +2810,10 @@ static void merge_selfsigs(ctrl_t ctrl, kbnode_t keyblock) {
     BUG();
   }
 
+  /* Verify the self-signatures in parallel; merge_selfsigs_main and
+     merge_selfsigs_subkey then use the cached results.  */
+  check_key_signatures_batch(ctrl, keyblock, 1);
+
   merge_selfsigs_main(ctrl, keyblock, &revoked, &rinfo);
 
   /* Now merge in the data from each of the subkeys.  */
@@ -3403,34 +3443,32 @@ gpg_error_t get_seckey_default_or_card(ctrl_t ctrl, PKT_public_key *pk,
 static char *get_user_id_string(ctrl_t ctrl, u32 *keyid, int mode,
                                 size_t *r_len) {
   user_id_db_t r;
-  keyid_list_t a;
   int pass = 0;
   char *p;
 
   /* Try it two times; second pass reads from the database.  */
   do {
-    for (r = user_id_db; r; r = r->next) {
-      for (a = r->keyids; a; a = a->next) {
-        if (a->keyid[0] == keyid[0] && a->keyid[1] == keyid[1]) {
-          if (mode == 2) {
-            /* An empty string as user id is possible.  Make
-               sure that the malloc allocates one byte and
-               does not bail out.  */
-            p = (char *)xmalloc(r->len ? r->len : 1);
-            memcpy(p, r->name, r->len);
-            if (r_len) *r_len = r->len;
-          } else {
-            if (mode)
-              p = xasprintf("%08lX%08lX %.*s", (unsigned long)keyid[0],
-                            (unsigned long)keyid[1], r->len, r->name);
-            else
-              p = xasprintf("%s %.*s", keystr(keyid), r->len, r->name);
-            if (r_len) *r_len = strlen(p);
-          }
-
-          return p;
-        }
+    r = uid_cache_lookup(keyid, NULL);
+    if (r) {
+      int len = r->name.size();
+
+      if (mode == 2) {
+        /* An empty string as user id is possible.  Make
+           sure that the malloc allocates one byte and
+           does not bail out.  */
+        p = (char *)xmalloc(len ? len : 1);
+        memcpy(p, r->name.data(), len);
+        if (r_len) *r_len = len;
+      } else {
+        if (mode)
+          p = xasprintf("%08lX%08lX %.*s", (unsigned long)keyid[0],
+                        (unsigned long)keyid[1], len, r->name.data());
+        else
+          p = xasprintf("%s %.*s", keystr(keyid), len, r->name.data());
+        if (r_len) *r_len = strlen(p);
       }
+
+      return p;
     }
   } while (++pass < 2 && !get_pubkey(ctrl, NULL, keyid));
 
@@ -3483,19 +3521,15 @@ char *get_user_id_byfpr(ctrl_t ctrl, const byte *fpr, size_t *rn) {
 
   /* Try it two times; second pass reads from the database.  */
   do {
-    for (r = user_id_db; r; r = r->next) {
-      keyid_list_t a;
-      for (a = r->keyids; a; a = a->next) {
-        if (!memcmp(a->fpr, fpr, MAX_FINGERPRINT_LEN)) {
-          /* An empty string as user id is possible.  Make
-             sure that the malloc allocates one byte and does
-             not bail out.  */
-          p = (char *)xmalloc(r->len ? r->len : 1);
-          memcpy(p, r->name, r->len);
-          *rn = r->len;
-          return p;
-        }
-      }
+    r = uid_cache_lookup(NULL, fpr);
+    if (r) {
+      /* An empty string as user id is possible.  Make
+         sure that the malloc allocates one byte and does
+         not bail out.  */
+      p = (char *)xmalloc(r->name.size() ? r->name.size() : 1);
+      memcpy(p, r->name.data(), r->name.size());
+      *rn = r->name.size();
+      return p;
     }
   } while (++pass < 2 &&
            !get_pubkey_byfprint(ctrl, NULL, NULL, fpr, MAX_FINGERPRINT_LEN));
@@ -53,6 +53,7 @@
 #include "main.h"
 #include "options.h"
 #include "packet.h"
+#include "tdbio.h"
 #include "trustdb.h"
 
 #if defined(HAVE_DOSISH_SYSTEM) || defined(__CYGWIN__)
@@ -293,6 +294,9 @@ enum cmd_and_opt_values {
   oTryAllSecrets,
   oTrustedKey,
   oNoSigCache,
+  oKeyCacheSize,
+  oNoTrustdbGraph,
+  oTrustdbCacheSize,
   oAutoCheckTrustDB,
   oNoAutoCheckTrustDB,
   oPreservePermissions,
@@ -618,6 +622,9 @@ const static ARGPARSE_OPTS opts[] = {
     ARGPARSE_s_n(oAutoKeyRetrieve, "auto-key-retrieve", "@"),
     ARGPARSE_s_n(oNoAutoKeyRetrieve, "no-auto-key-retrieve", "@"),
     ARGPARSE_s_n(oNoSigCache, "no-sig-cache", "@"),
+    ARGPARSE_s_u(oKeyCacheSize, "key-cache-size", "@"),
+    ARGPARSE_s_n(oNoTrustdbGraph, "no-trustdb-graph", "@"),
+    ARGPARSE_s_u(oTrustdbCacheSize, "trustdb-cache-size", "@"),
     ARGPARSE_s_n(oMergeOnly, "merge-only", "@"),
     ARGPARSE_s_n(oTryAllSecrets, "try-all-secrets", "@"),
     ARGPARSE_s_n(oPreservePermissions, "preserve-permissions", "@"),
@@ -2311,6 +2318,18 @@ next_pass:
         opt.no_sig_cache = true;
         break;
 
+      case oKeyCacheSize:
+        opt.key_cache_size = pargs.r.ret_ulong;
+        break;
+
+      case oNoTrustdbGraph:
+        opt.no_trustdb_graph = true;
+        break;
+
+      case oTrustdbCacheSize:
+        opt.tdb_cache_size = pargs.r.ret_ulong;
+        break;
+
       case oAllowFreeformUID:
         opt.allow_freeform_uid = true;
         break;
@@ -3480,9 +3499,11 @@ void g10_exit(int rc) {
 
   if ((opt.debug & DBG_MEMSTAT_VALUE)) {
     keydb_dump_stats();
+    getkey_dump_stats();
     sig_check_dump_stats();
     gcry_control(GCRYCTL_DUMP_MEMORY_STATS);
   }
+  if (DBG_CACHE) tdbio_dump_stats();
   if (opt.debug) gcry_control(GCRYCTL_DUMP_SECMEM_STATS);
 
   gcry_control(GCRYCTL_TERM_SECMEM);
@@ -2058,6 +2058,11 @@ static int chk_self_sigs(ctrl_t ctrl, kbnode_t keyblock, u32 *keyid,
   u32 bsdate = 0, rsdate = 0;
   kbnode_t bsnode = NULL, rsnode = NULL;
 
+  /* Verify the self-signatures in parallel; the check_key_signature
+     calls below then use the cached results.  */
+  if (keyblock->pkt->pkttype == PKT_PUBLIC_KEY)
+    check_key_signatures_batch(ctrl, keyblock, 1);
+
   for (n = keyblock; (n = find_next_kbnode(n, 0));) {
     if (n->pkt->pkttype == PKT_PUBLIC_SUBKEY) {
       knode = n;
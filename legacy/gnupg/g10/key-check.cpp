@@ -80,6 +80,13 @@ static int sig_comparison(const void *av, const void *bv) {
    signatures (it still checks all signatures for duplicates,
    however).
 
+   Unlike merge_selfsigs and import, this does not use
+   check_key_signatures_batch: a signature is tried against each
+   component in turn until one matches, which is how misplaced
+   signatures are found, and the signature cache flags are neither
+   used nor set.  It only runs when editing a key or when importing
+   with the repair-keys option, so it is not worth the trouble.
+
    Returns 1 if the keyblock was modified, 0 otherwise.  */
 int key_check_all_keysigs(ctrl_t ctrl, kbnode_t kb, int only_selected,
                           int only_selfsigs) {
@@ -27,6 +27,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include "../common/util.h"
 #include "../kbx/keybox.h"
 #include "gpg.h"
@@ -125,30 +127,62 @@ struct keydb_handle {
 /* Looking up keys is expensive.  To hide the cost, we cache whether
    keys exist in the key database.  Then, if we know a key does not
    exist, we don't have to spend time looking it up.  This
-   particularly helps the --list-sigs and --check-sigs commands.
-
-   The cache stores the results in a hash using separate chaining.
-   Concretely: we use the LSB of the keyid to index the hash table and
-   each bucket consists of a linked list of entries.  An entry
-   consists of the 64-bit key id.  If a key id is not in the cache,
+   particularly helps the --list-sigs and --check-sigs commands and
+   the verification of mails from many unknown signers.
+
+   The cache has two layers.  The first one is a Bloom filter over
+   the long key ids of all keys in all registered keyboxes.  It is
+   built with a single pass over the keyboxes the first time a key id
+   is looked up and answers most negative lookups without scanning
+   the keyboxes again.  A Bloom filter may give false positives, thus
+   for key ids which pass the filter we consult the second layer: an
+   open-addressed hash table (linear probing) of key ids which we
+   searched for but did not find in the database.  The table grows
+   as needed.  If a key id passes the filter and is not in the table,
    then we don't know whether it is in the DB or not.
 
-   To simplify the cache consistency protocol, we simply flush the
-   whole cache whenever a key is inserted or updated.  */
-
-#define KID_NOT_FOUND_CACHE_BUCKETS 256
-static struct kid_not_found_cache_bucket
-    *kid_not_found_cache[KID_NOT_FOUND_CACHE_BUCKETS];
-
-struct kid_not_found_cache_bucket {
-  struct kid_not_found_cache_bucket *next;
-  u32 kid[2];
+   When a keyblock is inserted or updated, its key ids are added to
+   the Bloom filter and removed from the table.  Deleting a keyblock
+   can't turn an unknown key id into a known one and thus needs no
+   invalidation.  */
+
+/* The initial number of slots of the not found table.  This must be
+   a power of 2.  */
+#define KID_NOT_FOUND_CACHE_MIN_SLOTS 256
+
+static struct {
+  uint64_t *slots; /* The key ids; 0 marks an unused slot.  */
+  size_t size;     /* The number of slots (a power of 2).  */
+  int have_zero;   /* Whether the (improbable) key id 0 is cached.  */
+} kid_not_found_cache;
+
+/* Parameters of the Bloom filter.  With 16 bits per key id and 6
+   probes the false positive rate is below 0.1%.  */
+#define KID_BLOOM_BITS_PER_KEY 16
+#define KID_BLOOM_PROBES 6
+#define KID_BLOOM_MIN_KEYS 256
+
+enum kid_bloom_states {
+  KID_BLOOM_EMPTY, /* Not yet built (or to be rebuilt).  */
+  KID_BLOOM_READY,
+  KID_BLOOM_FAILED /* Building failed; don't use it.  */
 };
 
+static struct {
+  enum kid_bloom_states state;
+  unsigned char *bits;
+  size_t nbits;    /* The number of bits (a power of 2).  */
+  size_t nkeys;    /* The number of key ids added to the filter.  */
+  size_t capacity; /* The number of key ids the filter was sized for.  */
+} kid_bloom;
+
 struct {
-  unsigned int count;   /* The current number of entries in the hash table.  */
-  unsigned int peak;    /* The peak of COUNT.  */
-  unsigned int flushes; /* The number of flushes.  */
+  unsigned int count;        /* The current number of entries in the table. */
+  unsigned int peak;         /* The peak of COUNT.  */
+  unsigned int grows;        /* The number of times the table was grown.  */
+  unsigned int invalidated;  /* The number of entries removed again.  */
+  unsigned int bloom_builds; /* The number of times the filter was built.  */
+  unsigned int bloom_hits;   /* Lookups answered by the filter.  */
 } kid_not_found_stats;
 
 struct {
@@ -170,6 +204,143 @@ struct {
 static int lock_all(KEYDB_HANDLE hd);
 static void unlock_all(KEYDB_HANDLE hd);
 
+/* Return the 64 bit key for the key id KID.  */
+static inline uint64_t kid_not_found_key(const u32 *kid) {
+  return ((uint64_t)kid[0] << 32) | kid[1];
+}
+
+/* Mix the bits of the key id KEY.  Key ids are already pretty random
+   but the low bits of v3 key ids and crafted key ids are not.  */
+static inline uint64_t kid_not_found_hash(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+/* Return the slot of KEY in the not found table or the free slot
+   where it would be inserted.  The table must not be full.  */
+static size_t kid_not_found_slot(uint64_t key) {
+  size_t mask = kid_not_found_cache.size - 1;
+  size_t i = kid_not_found_hash(key) & mask;
+
+  while (kid_not_found_cache.slots[i] && kid_not_found_cache.slots[i] != key)
+    i = (i + 1) & mask;
+  return i;
+}
+
+/* Double the size of the not found table (or create it).  */
+static void kid_not_found_grow(void) {
+  uint64_t *old = kid_not_found_cache.slots;
+  size_t oldsize = kid_not_found_cache.size;
+  size_t i;
+
+  kid_not_found_cache.size =
+      oldsize ? 2 * oldsize : KID_NOT_FOUND_CACHE_MIN_SLOTS;
+  kid_not_found_cache.slots =
+      (uint64_t *)xcalloc(kid_not_found_cache.size, sizeof *old);
+  for (i = 0; i < oldsize; i++)
+    if (old[i]) kid_not_found_cache.slots[kid_not_found_slot(old[i])] = old[i];
+  xfree(old);
+  if (oldsize) kid_not_found_stats.grows++;
+}
+
+/* Return the bit numbers of KID in the Bloom filter at PROBES.  */
+static void kid_bloom_probes(const u32 *kid, size_t *probes) {
+  uint64_t h = kid_not_found_hash(kid_not_found_key(kid));
+  uint64_t h1 = h & 0xffffffff;
+  uint64_t h2 = (h >> 32) | 1;
+  int i;
+
+  for (i = 0; i < KID_BLOOM_PROBES; i++)
+    probes[i] = (h1 + i * h2) & (kid_bloom.nbits - 1);
+}
+
+/* Add KID to the Bloom filter.  */
+static void kid_bloom_set(const u32 *kid) {
+  size_t probes[KID_BLOOM_PROBES];
+  int i;
+
+  kid_bloom_probes(kid, probes);
+  for (i = 0; i < KID_BLOOM_PROBES; i++)
+    kid_bloom.bits[probes[i] / 8] |= 1 << (probes[i] % 8);
+  kid_bloom.nkeys++;
+}
+
+static void kid_bloom_collect_cb(void *opaque, const u32 *kid) {
+  std::vector<uint64_t> *kids = (std::vector<uint64_t> *)opaque;
+
+  kids->push_back(kid_not_found_key(kid));
+}
+
+/* Build the Bloom filter from the key ids of all registered
+   keyboxes.  */
+static void kid_bloom_build(void) {
+  std::vector<uint64_t> kids;
+  gpg_error_t err = 0;
+  KEYBOX_HANDLE kbx;
+  size_t n;
+  int i;
+  u32 kid[2];
+
+  xfree(kid_bloom.bits);
+  kid_bloom.bits = NULL;
+  kid_bloom.nkeys = 0;
+
+  for (i = 0; !err && i < used_resources; i++) {
+    if (all_resources[i].type != KEYDB_RESOURCE_TYPE_KEYBOX) continue;
+    kbx = keybox_new_openpgp(all_resources[i].token, 0);
+    if (!kbx)
+      err = gpg_error_from_syserror();
+    else {
+      err = keybox_enum_keyids(kbx, kid_bloom_collect_cb, &kids);
+      keybox_release(kbx);
+    }
+  }
+  if (err) {
+    if (DBG_CACHE)
+      log_debug("keydb: building key id filter failed: %s\n",
+                gpg_strerror(err));
+    kid_bloom.state = KID_BLOOM_FAILED;
+    return;
+  }
+
+  /* Leave room for twice as many keys so that a few imports don't
+     force a rebuild.  */
+  kid_bloom.capacity = KID_BLOOM_MIN_KEYS;
+  while (kid_bloom.capacity < 2 * kids.size()) kid_bloom.capacity *= 2;
+  kid_bloom.nbits = kid_bloom.capacity * KID_BLOOM_BITS_PER_KEY;
+  kid_bloom.bits = (unsigned char *)xcalloc(kid_bloom.nbits / 8, 1);
+  for (n = 0; n < kids.size(); n++) {
+    kid[0] = kids[n] >> 32;
+    kid[1] = kids[n];
+    kid_bloom_set(kid);
+  }
+  kid_bloom.state = KID_BLOOM_READY;
+  kid_not_found_stats.bloom_builds++;
+
+  if (DBG_CACHE)
+    log_debug("keydb: key id filter built (%zu keys, %zu bits)\n",
+              kid_bloom.nkeys, kid_bloom.nbits);
+}
+
+/* Return true if KID is definitely not in any registered keybox
+   according to the Bloom filter.  */
+static int kid_bloom_absent_p(const u32 *kid) {
+  size_t probes[KID_BLOOM_PROBES];
+  int i;
+
+  if (kid_bloom.state == KID_BLOOM_EMPTY) kid_bloom_build();
+  if (kid_bloom.state != KID_BLOOM_READY) return 0;
+
+  kid_bloom_probes(kid, probes);
+  for (i = 0; i < KID_BLOOM_PROBES; i++)
+    if (!(kid_bloom.bits[probes[i] / 8] & (1 << (probes[i] % 8)))) return 1;
+  return 0;
+}
+
 /* Check whether the keyid KID is in key id is definitely not in the
    database.
 
@@ -180,24 +351,32 @@ static void unlock_all(KEYDB_HANDLE hd);
          definitive answer, you'll need to perform a lookup.
 
      1 - There is definitely no key with this key id in the database.
-         We searched for a key with this key id previously, but we
-         didn't find it in the database.  */
+         Either the Bloom filter rules it out or we searched for a key
+         with this key id previously, but we didn't find it in the
+         database.  */
 static int kid_not_found_p(u32 *kid) {
-  struct kid_not_found_cache_bucket *k;
-
-  for (k = kid_not_found_cache[kid[0] % KID_NOT_FOUND_CACHE_BUCKETS]; k;
-       k = k->next)
-    if (k->kid[0] == kid[0] && k->kid[1] == kid[1]) {
-      if (DBG_CACHE)
-        log_debug("keydb: kid_not_found_p (%08lx%08lx) => not in DB\n",
-                  (unsigned long)kid[0], (unsigned long)kid[1]);
-      return 1;
-    }
+  uint64_t key = kid_not_found_key(kid);
+  int found;
+
+  if (kid_bloom_absent_p(kid)) {
+    if (DBG_CACHE)
+      log_debug("keydb: kid_not_found_p (%08lx%08lx) => not in filter\n",
+                (unsigned long)kid[0], (unsigned long)kid[1]);
+    kid_not_found_stats.bloom_hits++;
+    return 1;
+  }
+
+  if (!key)
+    found = kid_not_found_cache.have_zero;
+  else
+    found = (kid_not_found_cache.size &&
+             kid_not_found_cache.slots[kid_not_found_slot(key)] == key);
 
   if (DBG_CACHE)
-    log_debug("keydb: kid_not_found_p (%08lx%08lx) => indeterminate\n",
-              (unsigned long)kid[0], (unsigned long)kid[1]);
-  return 0;
+    log_debug("keydb: kid_not_found_p (%08lx%08lx) => %s\n",
+              (unsigned long)kid[0], (unsigned long)kid[1],
+              found ? "not in DB" : "indeterminate");
+  return found;
 }
 
 /* Insert the keyid KID into the kid_not_found_cache.  FOUND is whether
@@ -206,39 +385,84 @@ static int kid_not_found_p(u32 *kid) {
    Note this function does not check whether the key id is already in
    the cache.  As such, kid_not_found_p() should be called first.  */
 static void kid_not_found_insert(u32 *kid) {
-  struct kid_not_found_cache_bucket *k;
+  uint64_t key = kid_not_found_key(kid);
 
   if (DBG_CACHE)
     log_debug("keydb: kid_not_found_insert (%08lx%08lx)\n",
               (unsigned long)kid[0], (unsigned long)kid[1]);
-  k = (kid_not_found_cache_bucket *)xmalloc(sizeof *k);
-  k->kid[0] = kid[0];
-  k->kid[1] = kid[1];
-  k->next = kid_not_found_cache[kid[0] % KID_NOT_FOUND_CACHE_BUCKETS];
-  kid_not_found_cache[kid[0] % KID_NOT_FOUND_CACHE_BUCKETS] = k;
+
+  if (!key)
+    kid_not_found_cache.have_zero = 1;
+  else {
+    /* Keep the load factor below 3/4.  */
+    if (4 * (kid_not_found_stats.count + 1) > 3 * kid_not_found_cache.size)
+      kid_not_found_grow();
+    kid_not_found_cache.slots[kid_not_found_slot(key)] = key;
+  }
   kid_not_found_stats.count++;
+  if (kid_not_found_stats.count > kid_not_found_stats.peak)
+    kid_not_found_stats.peak = kid_not_found_stats.count;
 }
 
-/* Flush the kid not found cache.  */
-static void kid_not_found_flush(void) {
-  struct kid_not_found_cache_bucket *k, *knext;
-  int i;
+/* Remove the keyid KID from the kid_not_found_cache.  */
+static void kid_not_found_remove(const u32 *kid) {
+  uint64_t key = kid_not_found_key(kid);
+  uint64_t *slots = kid_not_found_cache.slots;
+  size_t mask, i, j, home;
+
+  if (!key) {
+    if (kid_not_found_cache.have_zero) {
+      kid_not_found_cache.have_zero = 0;
+      kid_not_found_stats.count--;
+      kid_not_found_stats.invalidated++;
+    }
+    return;
+  }
+  if (!kid_not_found_cache.size) return;
+
+  i = kid_not_found_slot(key);
+  if (slots[i] != key) return;
+
+  /* Shift the following entries of the cluster back so that no
+     tombstones are needed.  */
+  mask = kid_not_found_cache.size - 1;
+  for (j = (i + 1) & mask; slots[j]; j = (j + 1) & mask) {
+    home = kid_not_found_hash(slots[j]) & mask;
+    if ((j > i && (home <= i || home > j)) ||
+        (j < i && home <= i && home > j)) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i] = 0;
+  kid_not_found_stats.count--;
+  kid_not_found_stats.invalidated++;
 
-  if (DBG_CACHE) log_debug("keydb: kid_not_found_flush\n");
+  if (DBG_CACHE)
+    log_debug("keydb: kid_not_found_remove (%08lx%08lx)\n",
+              (unsigned long)kid[0], (unsigned long)kid[1]);
+}
 
-  if (!kid_not_found_stats.count) return;
+/* Update the caches for the keys of the keyblock KB which is about
+   to be inserted or updated.  */
+static void kid_not_found_invalidate(kbnode_t kb) {
+  kbnode_t node;
+  u32 kid[2];
 
-  for (i = 0; i < DIM(kid_not_found_cache); i++) {
-    for (k = kid_not_found_cache[i]; k; k = knext) {
-      knext = k->next;
-      xfree(k);
-    }
-    kid_not_found_cache[i] = NULL;
+  if (kid_bloom.state == KID_BLOOM_READY &&
+      kid_bloom.nkeys >= kid_bloom.capacity)
+    kid_bloom.state = KID_BLOOM_EMPTY; /* Too full; rebuild on demand.  */
+  else if (kid_bloom.state == KID_BLOOM_FAILED)
+    kid_bloom.state = KID_BLOOM_EMPTY; /* The keybox may exist now.  */
+
+  for (node = kb; node; node = node->next) {
+    if (node->pkt->pkttype != PKT_PUBLIC_KEY &&
+        node->pkt->pkttype != PKT_PUBLIC_SUBKEY)
+      continue;
+    keyid_from_pk(node->pkt->pkt.public_key, kid);
+    kid_not_found_remove(kid);
+    if (kid_bloom.state == KID_BLOOM_READY) kid_bloom_set(kid);
   }
-  if (kid_not_found_stats.count > kid_not_found_stats.peak)
-    kid_not_found_stats.peak = kid_not_found_stats.count;
-  kid_not_found_stats.count = 0;
-  kid_not_found_stats.flushes++;
 }
 
 static void keyblock_cache_clear(struct keydb_handle *hd) {
@@ -650,6 +874,8 @@ gpg_error_t keydb_add_resource(const char *url, unsigned int flags) {
              user is currently using the keybox. */
 
           used_resources++;
+          /* Rebuild the key id filter to cover the new resource.  */
+          kid_bloom.state = KID_BLOOM_EMPTY;
         }
       } else if (err == GPG_ERR_EEXIST) {
         /* Already registered.  We will mark it as the primary key
@@ -686,9 +912,14 @@ void keydb_dump_stats(void) {
   log_info("       reset=%u found=%u not=%u cache=%u not=%u\n",
            keydb_stats.search_resets, keydb_stats.found, keydb_stats.notfound,
            keydb_stats.found_cached, keydb_stats.notfound_cached);
-  log_info("kid_not_found_cache: count=%u peak=%u flushes=%u\n",
-           kid_not_found_stats.count, kid_not_found_stats.peak,
-           kid_not_found_stats.flushes);
+  log_info(
+      "kid_not_found_cache: count=%u peak=%u slots=%zu grows=%u inv=%u\n",
+      kid_not_found_stats.count, kid_not_found_stats.peak,
+      kid_not_found_cache.size, kid_not_found_stats.grows,
+      kid_not_found_stats.invalidated);
+  log_info("kid_not_found_bloom: keys=%zu bits=%zu builds=%u hits=%u\n",
+           kid_bloom.nkeys, kid_bloom.nbits, kid_not_found_stats.bloom_builds,
+           kid_not_found_stats.bloom_hits);
 }
 
 /* Create a new database handle.  A database handle is similar to a
@@ -1172,7 +1403,7 @@ gpg_error_t keydb_update_keyblock(ctrl_t ctrl, KEYDB_HANDLE hd, kbnode_t kb) {
 
   if (!hd) return GPG_ERR_INV_ARG;
 
-  kid_not_found_flush();
+  kid_not_found_invalidate(kb);
   keyblock_cache_clear(hd);
 
   if (opt.dry_run) return 0;
@@ -1230,7 +1461,7 @@ gpg_error_t keydb_insert_keyblock(KEYDB_HANDLE hd, kbnode_t kb) {
 
   if (!hd) return GPG_ERR_INV_ARG;
 
-  kid_not_found_flush();
+  kid_not_found_invalidate(kb);
   keyblock_cache_clear(hd);
 
   if (opt.dry_run) return 0;
@@ -1284,7 +1515,6 @@ gpg_error_t keydb_delete_keyblock(KEYDB_HANDLE hd) {
 
   if (!hd) return GPG_ERR_INV_ARG;
 
-  kid_not_found_flush();
   keyblock_cache_clear(hd);
 
   if (hd->found < 0 || hd->found >= hd->used) return GPG_ERR_VALUE_NOT_FOUND;
@@ -257,6 +257,9 @@ void cache_public_key(PKT_public_key *pk);
 /* Disable and drop the public key cache.  */
 void getkey_disable_caches(void);
 
+/* Dump the statistics of the public key and user ID caches.  */
+void getkey_dump_stats(void);
+
 /* Return the public key with the key id KEYID and store it at PK.  */
 int get_pubkey(ctrl_t ctrl, PKT_public_key *pk, u32 *keyid);
 
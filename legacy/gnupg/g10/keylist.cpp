@@ -717,6 +717,11 @@ static void list_keyblock_print(ctrl_t ctrl, kbnode_t keyblock, int secret,
 
   if (!listctx->no_validity) check_trustdb_stale(ctrl);
 
+  /* Verify all signatures up front so that the public key operations
+     can run in parallel.  */
+  if (opt.list_sigs && listctx->check_sigs && node == keyblock)
+    check_key_signatures_batch(ctrl, keyblock, 0);
+
   /* Print the "pub" line and in KF_NONE mode the fingerprint.  */
   print_key_line(ctrl, es_stdout, pk, secret);
 
@@ -974,6 +979,8 @@ static void list_keyblock_colon(ctrl_t ctrl, kbnode_t keyblock, int secret,
      * may help to prevent sync problems.  */
     hexgrip = hexgrip_buffer ? hexgrip_buffer : "";
   }
+  if (opt.list_sigs && opt.check_sigs && node == keyblock)
+    check_key_signatures_batch(ctrl, keyblock, 0);
   stubkey = 0;
   if ((secret || has_secret) &&
       agent_get_keyinfo(NULL, hexgrip, &serialno, NULL))
@@ -262,6 +262,11 @@ int check_key_signature(ctrl_t ctrl, kbnode_t root, kbnode_t sig,
 int check_key_signature2(ctrl_t ctrl, kbnode_t root, kbnode_t node,
                          PKT_public_key *check_pk, PKT_public_key *ret_pk,
                          int *is_selfsig, u32 *r_expiredate, int *r_expired);
+/* Check the not yet cached signatures of KEYBLOCK in parallel and
+   cache the results in the signature packets.  See the implementation
+   for details.  */
+void check_key_signatures_batch(ctrl_t ctrl, kbnode_t keyblock,
+                                int selfsigs_only);
 
 /* Returns whether SIGNER generated the signature SIG over the packet
    PACKET, which is a key, subkey or uid, and comes from the key block
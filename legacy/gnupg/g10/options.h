@@ -283,6 +283,9 @@ struct options {
 
   bool try_all_secrets{false};
   bool no_sig_cache{false};
+  unsigned int key_cache_size{PK_UID_CACHE_SIZE};
+  bool no_trustdb_graph{false};
+  unsigned int tdb_cache_size{TRUSTDB_CACHE_SIZE};
   bool no_auto_check_trustdb{false};
   bool preserve_permissions{false};
   std::vector<groupitem> grouplist;
@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <vector>
+
 #include "../common/util.h"
 #include "gpg.h"
 #include "main.h"
@@ -44,16 +46,20 @@ gcry_mpi_t get_mpi_from_sexp(gcry_sexp_t sexp, const char *item, int mpifmt) {
   return data;
 }
 
-/****************
- * Emulate our old PK interface here - sometime in the future we might
- * change the internal design to directly fit to libgcrypt.
- */
-int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
-              gcry_mpi_t *pkey) {
+/* Build the S-expressions for verifying the signature DATA over HASH
+ * with the public key PKEY of algorithm PKALGO.  On success the
+ * caller must release R_SIG, R_HASH and R_PKEY; on error they are
+ * all set to NULL.  */
+static int pk_verify_build(pubkey_algo_t pkalgo, gcry_mpi_t hash,
+                           gcry_mpi_t *data, gcry_mpi_t *pkey,
+                           gcry_sexp_t *r_sig, gcry_sexp_t *r_hash,
+                           gcry_sexp_t *r_pkey) {
   gcry_sexp_t s_sig, s_hash, s_pkey;
   int rc;
   unsigned int neededfixedlen = 0;
 
+  *r_sig = *r_hash = *r_pkey = NULL;
+
   /* Make a sexp from pkey.  */
   if (pkalgo == PUBKEY_ALGO_DSA) {
     rc = gcry_sexp_build(&s_pkey, NULL, "(public-key(dsa(p%m)(q%m)(g%m)(y%m)))",
@@ -176,6 +182,29 @@ int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
   } else
     BUG();
 
+  if (rc) {
+    gcry_sexp_release(s_sig);
+    gcry_sexp_release(s_hash);
+    gcry_sexp_release(s_pkey);
+    return rc;
+  }
+
+  *r_sig = s_sig;
+  *r_hash = s_hash;
+  *r_pkey = s_pkey;
+  return 0;
+}
+
+/****************
+ * Emulate our old PK interface here - sometime in the future we might
+ * change the internal design to directly fit to libgcrypt.
+ */
+int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
+              gcry_mpi_t *pkey) {
+  gcry_sexp_t s_sig, s_hash, s_pkey;
+  int rc;
+
+  rc = pk_verify_build(pkalgo, hash, data, pkey, &s_sig, &s_hash, &s_pkey);
   if (!rc) rc = gcry_pk_verify(s_sig, s_hash, s_pkey);
 
   gcry_sexp_release(s_sig);
@@ -184,6 +213,39 @@ int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
   return rc;
 }
 
+/* Verify the N signatures in ITEMS at once and store the result of
+ * each in its RC field.  The results are the same as those of
+ * pk_verify; libgcrypt is just given the chance to check many EdDSA
+ * signatures faster than one by one.  */
+void pk_verify_batch(struct pk_verify_item *items, size_t n) {
+  std::vector<gcry_sexp_t> s_sigs, s_hashes, s_pkeys;
+  std::vector<size_t> idx;
+  std::vector<gpg_error_t> rcs;
+  gcry_sexp_t s_sig, s_hash, s_pkey;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    items[i].rc = pk_verify_build(items[i].algo, items[i].hash, items[i].data,
+                                  items[i].pkey, &s_sig, &s_hash, &s_pkey);
+    if (items[i].rc) continue;
+    s_sigs.push_back(s_sig);
+    s_hashes.push_back(s_hash);
+    s_pkeys.push_back(s_pkey);
+    idx.push_back(i);
+  }
+  if (idx.empty()) return;
+
+  rcs.resize(idx.size());
+  gcry_pk_verify_batch(s_sigs.data(), s_hashes.data(), s_pkeys.data(),
+                       rcs.data(), idx.size());
+  for (i = 0; i < idx.size(); i++) {
+    items[idx[i]].rc = rcs[i];
+    gcry_sexp_release(s_sigs[i]);
+    gcry_sexp_release(s_hashes[i]);
+    gcry_sexp_release(s_pkeys[i]);
+  }
+}
+
 /****************
  * Emulate our old PK interface here - sometime in the future we might
  * change the internal design to directly fit to libgcrypt.
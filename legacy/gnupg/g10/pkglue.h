@@ -27,6 +27,17 @@ gcry_mpi_t get_mpi_from_sexp(gcry_sexp_t sexp, const char *item, int mpifmt);
 
 int pk_verify(pubkey_algo_t algo, gcry_mpi_t hash, gcry_mpi_t *data,
               gcry_mpi_t *pkey);
+
+/* The arguments of one pk_verify for pk_verify_batch.  */
+struct pk_verify_item {
+  pubkey_algo_t algo;
+  gcry_mpi_t hash;
+  gcry_mpi_t *data;
+  gcry_mpi_t *pkey;
+  int rc; /* Receives the result.  */
+};
+
+void pk_verify_batch(struct pk_verify_item *items, size_t n);
 int pk_encrypt(pubkey_algo_t algo, gcry_mpi_t *resarr, gcry_mpi_t data,
                PKT_public_key *pk, gcry_mpi_t *pkey);
 int pk_check_secret_key(pubkey_algo_t algo, gcry_mpi_t *skey);
@@ -24,6 +24,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include "../common/compliance.h"
 #include "../common/status.h"
 #include "../common/util.h"
@@ -47,12 +56,194 @@ struct {
   unsigned int cached;  /* Number of seen cache entries.  */
   unsigned int goodsig; /* Number of good verifications from the cache.  */
   unsigned int badsig;  /* Number of bad verifications from the cache.  */
+  unsigned int diskhit; /* Number of hits in the persistent cache.  */
+  unsigned int diskput; /* Number of results added to that cache.  */
 } cache_stats;
 
 /* Dump verification stats.  */
 void sig_check_dump_stats(void) {
   log_info("sig_cache: total=%u cached=%u good=%u bad=%u\n", cache_stats.total,
            cache_stats.cached, cache_stats.goodsig, cache_stats.badsig);
+  log_info("sig_cache: persistent hits=%u added=%u\n", cache_stats.diskhit,
+           cache_stats.diskput);
+}
+
+/* The persistent signature cache.
+ *
+ * The in-memory flags (SIG->FLAGS.CHECKED and SIG->FLAGS.VALID) only
+ * survive as long as the keyblock, so every run of --check-sigs or
+ * --update-trustdb would redo all public key operations.  To avoid
+ * that, the results of verifying key signatures are also stored in
+ * the file "sigcache" EXTSEP_S GPGEXT_GPG in the home directory, next
+ * to the trustdb which is named the same way.
+ *
+ * Each record is keyed by a SHA-256 hash over the issuer's public key
+ * (as hashed for the fingerprint), the algorithms and class of the
+ * signature, the final digest over the signed data and the signature
+ * values.  Thus an entry can only be found again for exactly the same
+ * key, signed packets and signature; if the key or the user ID
+ * changes, the key changes as well and the old entry is simply not
+ * used anymore.  Expiration and revocation are not cached; they are
+ * checked by the callers as before.
+ *
+ * The file is a header followed by fixed size records, which are
+ * appended as new results come in.  A truncated record at the end
+ * (e.g. from a concurrent writer) is ignored.  The file is restarted
+ * from scratch if it grows beyond SIG_CACHE_MAX_ENTRIES.  */
+#define SIG_CACHE_MAGIC "NPGSIGC\x01"
+#define SIG_CACHE_MAGIC_LEN 8
+#define SIG_CACHE_KEYLEN 32
+#define SIG_CACHE_RECLEN (SIG_CACHE_KEYLEN + 1)
+#define SIG_CACHE_MAX_ENTRIES 1000000
+
+/* The cached status uses the same bits as the sigcache of the ring
+   trust packet: Bit 0 is set if the signature was checked and bit 1
+   is set if it is valid.  */
+#define SIG_CACHE_CHECKED 1
+#define SIG_CACHE_VALID 2
+
+static struct {
+  int initialized;
+  FILE *fp; /* Opened for appending or NULL if disabled.  */
+  std::unordered_map<std::string, byte> map;
+} sig_cache;
+
+/* Open and load the persistent signature cache.  On error the cache
+   is disabled for this process.  */
+static void sig_cache_init(void) {
+  char *fname;
+  FILE *fp;
+  byte buf[SIG_CACHE_RECLEN];
+  int truncate = 0;
+
+  sig_cache.initialized = 1;
+
+  fname = make_filename(gnupg_homedir(), "sigcache" EXTSEP_S GPGEXT_GPG, NULL);
+  fp = fopen(fname, "rb");
+  if (fp) {
+    if (fread(buf, SIG_CACHE_MAGIC_LEN, 1, fp) != 1 ||
+        memcmp(buf, SIG_CACHE_MAGIC, SIG_CACHE_MAGIC_LEN))
+      truncate = 1;
+    else
+      while (fread(buf, SIG_CACHE_RECLEN, 1, fp) == 1) {
+        if (sig_cache.map.size() >= SIG_CACHE_MAX_ENTRIES) {
+          truncate = 1;
+          break;
+        }
+        sig_cache.map[std::string((char *)buf, SIG_CACHE_KEYLEN)] =
+            buf[SIG_CACHE_KEYLEN];
+      }
+    fclose(fp);
+  } else
+    truncate = 1;
+
+  if (truncate) sig_cache.map.clear();
+
+  sig_cache.fp = fopen(fname, truncate ? "wb" : "ab");
+  if (!sig_cache.fp) {
+    if (DBG_CACHE)
+      log_debug("sig_cache: can't open '%s': %s\n", fname, strerror(errno));
+  } else if (truncate && fwrite(SIG_CACHE_MAGIC, SIG_CACHE_MAGIC_LEN, 1,
+                                sig_cache.fp) != 1) {
+    fclose(sig_cache.fp);
+    sig_cache.fp = NULL;
+  }
+  if (DBG_CACHE)
+    log_debug("sig_cache: loaded %u entries from '%s'\n",
+              (unsigned int)sig_cache.map.size(), fname);
+  xfree(fname);
+}
+
+/* Hash an MPI, which may be opaque, into MD.  */
+static void sig_cache_hash_mpi(gcry_md_hd_t md, gcry_mpi_t a) {
+  unsigned int nbits;
+  const void *p;
+  byte *buf;
+  size_t nbytes;
+
+  if (!a) {
+    gcry_md_putc(md, 0);
+    gcry_md_putc(md, 0);
+  } else if (gcry_mpi_get_flag(a, GCRYMPI_FLAG_OPAQUE)) {
+    p = gcry_mpi_get_opaque(a, &nbits);
+    gcry_md_putc(md, nbits >> 8);
+    gcry_md_putc(md, nbits);
+    if (p) gcry_md_write(md, p, (nbits + 7) / 8);
+  } else {
+    if (gcry_mpi_aprint(GCRYMPI_FMT_PGP, &buf, &nbytes, a)) BUG();
+    gcry_md_write(md, buf, nbytes);
+    gcry_free(buf);
+  }
+}
+
+/* Compute the cache key for the signature SIG made by PK and store it
+   at KEY.  DIGEST must already be finalized.  */
+static void sig_cache_make_key(PKT_public_key *pk, PKT_signature *sig,
+                               gcry_md_hd_t digest, std::string &key) {
+  gcry_md_hd_t md;
+  int nsig = pubkey_get_nsig((pubkey_algo_t)(sig->pubkey_algo));
+  int i;
+
+  if (gcry_md_open(&md, GCRY_MD_SHA256, 0)) BUG();
+  hash_public_key(md, pk);
+  gcry_md_putc(md, sig->version);
+  gcry_md_putc(md, sig->sig_class);
+  gcry_md_putc(md, sig->pubkey_algo);
+  gcry_md_putc(md, sig->digest_algo);
+  gcry_md_write(md, gcry_md_read(digest, sig->digest_algo),
+                gcry_md_get_algo_dlen(sig->digest_algo));
+  for (i = 0; i < nsig; i++) sig_cache_hash_mpi(md, sig->data[i]);
+  key.assign((const char *)gcry_md_read(md, GCRY_MD_SHA256), SIG_CACHE_KEYLEN);
+  gcry_md_close(md);
+}
+
+/* Return true if SIG is a signature over a key or user ID and thus
+   worth to be kept in the persistent cache.  Data signatures are
+   usually verified only once.  */
+static int sig_cache_wanted(PKT_signature *sig) {
+  return !opt.no_sig_cache && (IS_CERT(sig) || sig->sig_class == 0x19);
+}
+
+/* Look up KEY in the persistent cache.  Returns true and stores the
+   verification result at R_RC if found.  */
+static int sig_cache_lookup(const std::string &key, int *r_rc) {
+  if (!sig_cache.initialized) sig_cache_init();
+
+  auto it = sig_cache.map.find(key);
+  if (it == sig_cache.map.end()) return 0;
+
+  cache_stats.diskhit++;
+  *r_rc = (it->second & SIG_CACHE_VALID) ? 0 : GPG_ERR_BAD_SIGNATURE;
+  return 1;
+}
+
+/* Store the verification result RC for KEY in the persistent cache.
+   Only definite results are stored.  */
+static void sig_cache_store(const std::string &key, int rc) {
+  byte status;
+
+  if (!rc)
+    status = SIG_CACHE_CHECKED | SIG_CACHE_VALID;
+  else if (rc == GPG_ERR_BAD_SIGNATURE)
+    status = SIG_CACHE_CHECKED;
+  else
+    return;
+
+  sig_cache.map[key] = status;
+  if (!sig_cache.fp) return;
+
+  /* Write the record with a single call so that concurrent writers
+     using append mode don't interleave partial records.  */
+  std::string rec = key;
+  rec.push_back(status);
+  if (fwrite(rec.data(), rec.size(), 1, sig_cache.fp) != 1 ||
+      fflush(sig_cache.fp)) {
+    log_info("sig_cache: error writing cache: %s\n", strerror(errno));
+    fclose(sig_cache.fp);
+    sig_cache.fp = NULL;
+    return;
+  }
+  cache_stats.diskput++;
 }
 
 /* Check a signature.  This is shorthand for check_signature2 with
@@ -386,15 +577,35 @@ static int check_signature_end(PKT_public_key *pk, PKT_signature *sig,
   return rc;
 }
 
-/* This function is similar to check_signature_end, but it only checks
-   whether the signature was generated by PK.  It does not check
-   expiration, revocation, etc.  */
-static int check_signature_end_simple(PKT_public_key *pk, PKT_signature *sig,
-                                      gcry_md_hd_t digest) {
-  gcry_mpi_t result = NULL;
-  int rc = 0;
+/* The public key part of a signature verification.  Verifying a
+   signature is split into three steps so that the expensive public
+   key operation can be run on a worker thread (see
+   check_key_signatures_batch): sig_check_job_prepare completes the
+   digest and consults the persistent cache, sig_check_job_run does
+   the public key operation and sig_check_job_finish stores the result
+   and applies the final policy checks.  Only sig_check_job_run may be
+   called concurrently.  */
+struct sig_check_job {
+  PKT_public_key *pk;
+  PKT_signature *sig;
+  gcry_mpi_t hash;       /* The encoded digest or NULL if no public key
+                            operation is required.  */
+  std::string cache_key; /* The key for the persistent cache or empty.  */
+  int rc;                /* The result.  */
+};
+
+/* Prepare JOB for checking whether the signature SIG was generated by
+   PK over DIGEST.  Returns an error code if the signature can't be
+   checked at all.  */
+static int sig_check_job_prepare(PKT_public_key *pk, PKT_signature *sig,
+                                 gcry_md_hd_t digest, sig_check_job *job) {
   gcry_md_algos algo = (gcry_md_algos)sig->digest_algo;
 
+  job->pk = pk;
+  job->sig = sig;
+  job->hash = NULL;
+  job->rc = 0;
+
   if (opt.weak_digests.count(algo)) {
     print_digest_rejected_note(algo);
     return GPG_ERR_DIGEST_ALGO;
@@ -442,24 +653,64 @@ static int check_signature_end_simple(PKT_public_key *pk, PKT_signature *sig,
   }
   gcry_md_final(digest);
 
+  /* Check whether the result of the public key operation is already
+     known from a previous run.  */
+  if (sig_cache_wanted(sig)) {
+    sig_cache_make_key(pk, sig, digest, job->cache_key);
+    if (sig_cache_lookup(job->cache_key, &job->rc)) return 0;
+  }
+
   /* Convert the digest to an MPI.  */
-  result = encode_md_value(pk, digest, sig->digest_algo);
-  if (!result) return GPG_ERR_GENERAL;
+  job->hash = encode_md_value(pk, digest, sig->digest_algo);
+  if (!job->hash) return GPG_ERR_GENERAL;
 
-  /* Verify the signature.  */
-  rc = pk_verify((pubkey_algo_t)(pk->pubkey_algo), result, sig->data, pk->pkey);
-  gcry_mpi_release(result);
+  return 0;
+}
 
-  if (!rc && sig->flags.unknown_critical) {
+/* Run the public key operation of JOB, if any.  This function does
+   not touch any global state and may thus be called from several
+   threads at once.  */
+static void sig_check_job_run(sig_check_job *job) {
+  if (job->hash)
+    job->rc = pk_verify((pubkey_algo_t)(job->pk->pubkey_algo), job->hash,
+                        job->sig->data, job->pk->pkey);
+}
+
+/* Release the resources of JOB and return the verification result.  */
+static int sig_check_job_finish(sig_check_job *job) {
+  int rc = job->rc;
+
+  if (job->hash) {
+    gcry_mpi_release(job->hash);
+    job->hash = NULL;
+    if (!job->cache_key.empty()) sig_cache_store(job->cache_key, rc);
+  }
+
+  if (!rc && job->sig->flags.unknown_critical) {
     log_info(_("assuming bad signature from key %s"
                " due to an unknown critical bit\n"),
-             keystr_from_pk(pk));
+             keystr_from_pk(job->pk));
     rc = GPG_ERR_BAD_SIGNATURE;
   }
 
   return rc;
 }
 
+/* This function is similar to check_signature_end, but it only checks
+   whether the signature was generated by PK.  It does not check
+   expiration, revocation, etc.  */
+static int check_signature_end_simple(PKT_public_key *pk, PKT_signature *sig,
+                                      gcry_md_hd_t digest) {
+  sig_check_job job;
+  int rc;
+
+  rc = sig_check_job_prepare(pk, sig, digest, &job);
+  if (rc) return rc;
+
+  sig_check_job_run(&job);
+  return sig_check_job_finish(&job);
+}
+
 /* Add a uid node to a hash context.  See section 5.2.4, paragraph 4
    of RFC 4880.  */
 static void hash_uid_packet(PKT_user_id *uid, gcry_md_hd_t md,
@@ -523,8 +774,9 @@ static void cache_sig_result(PKT_signature *sig, int result) {
  * revocation key designated in a revkey subpacket, but the revocation
  * key itself isn't present.
  *
- * XXX: This code will need to be modified if gpg ever becomes
- * multi-threaded.  Note that this guarantees that a designated
+ * XXX: This code is not thread-safe (see BUSY below), which is why
+ * check_key_signatures_batch leaves designated revocations to the
+ * calling thread.  Note that this guarantees that a designated
  * revocation sig will never be considered valid unless it is actually
  * valid, as well as being issued by a revocation key in a valid
  * direct signature.  Note also that this is written so that a revoked
@@ -618,8 +870,8 @@ int check_revocation_keys(ctrl_t ctrl, PKT_public_key *pk, PKT_signature *sig) {
    this function is simpler than check_key_signature in a few ways.
    For example, there is no support for expiring backsigs since it is
    questionable what such a thing actually means.  Note also that the
-   sig cache check here, unlike other sig caches in GnuPG, is not
-   persistent. */
+   flags checked here only live as long as BACKSIG; the result of the
+   public key operation is kept in the persistent sig cache. */
 int check_backsig(PKT_public_key *main_pk, PKT_public_key *sub_pk,
                   PKT_signature *backsig) {
   gcry_md_hd_t md;
@@ -1010,3 +1262,264 @@ int check_key_signature2(ctrl_t ctrl, kbnode_t root, kbnode_t node,
 
   return rc;
 }
+
+/* Keyblocks with fewer pending public key operations than this are
+   checked on the calling thread; handing them to the pool would cost
+   more than it saves.  */
+#define SIG_CHECK_MIN_PARALLEL 4
+
+/* The largest number of EdDSA signatures verified at once.  Larger
+   batches are split so that all threads get their share.  */
+#define SIG_CHECK_MAX_BATCH 64
+
+/* The jobs run together by a worker: either a single job or a batch
+   of EdDSA jobs, which pk_verify_batch checks at once.  */
+struct sig_check_task {
+  std::vector<sig_check_job *> jobs;
+};
+
+static void sig_check_task_run(sig_check_task *task) {
+  std::vector<pk_verify_item> items;
+  sig_check_job *job;
+  size_t i;
+
+  if (task->jobs.size() == 1) {
+    sig_check_job_run(task->jobs[0]);
+    return;
+  }
+
+  items.resize(task->jobs.size());
+  for (i = 0; i < items.size(); i++) {
+    job = task->jobs[i];
+    items[i].algo = (pubkey_algo_t)(job->pk->pubkey_algo);
+    items[i].hash = job->hash;
+    items[i].data = job->sig->data;
+    items[i].pkey = job->pk->pkey;
+  }
+  pk_verify_batch(items.data(), items.size());
+  for (i = 0; i < items.size(); i++) task->jobs[i]->rc = items[i].rc;
+}
+
+/* The worker threads used by sig_check_run_jobs.  They are started
+   on first use and then wait for the next batch of tasks for the rest
+   of the process.  The pool is never freed so that the detached
+   workers never see it go away at exit.  */
+struct sig_check_pool_s {
+  std::mutex dispatch_lock; /* Serializes sig_check_run_jobs.  */
+  std::mutex lock;          /* Protects the fields below.  */
+  std::condition_variable wakeup;
+  std::condition_variable done;
+  std::vector<sig_check_task> *tasks;
+  std::atomic<size_t> next;
+  unsigned long batch;   /* Incremented for each batch.  */
+  unsigned int active;   /* Workers still busy with this batch.  */
+  unsigned int nthreads; /* Number of workers.  */
+};
+
+static sig_check_pool_s *sig_check_pool;
+
+/* Run the tasks of POOL's current batch until none is left.  */
+static void sig_check_pool_drain(sig_check_pool_s *pool,
+                                 std::vector<sig_check_task> *tasks) {
+  size_t idx;
+
+  while ((idx = pool->next++) < tasks->size())
+    sig_check_task_run(&(*tasks)[idx]);
+}
+
+static void sig_check_pool_worker(sig_check_pool_s *pool) {
+  std::unique_lock<std::mutex> lock(pool->lock);
+  std::vector<sig_check_task> *tasks;
+  unsigned long seen = 0;
+
+  for (;;) {
+    pool->wakeup.wait(lock, [&] { return pool->batch != seen; });
+    seen = pool->batch;
+    tasks = pool->tasks;
+
+    lock.unlock();
+    sig_check_pool_drain(pool, tasks);
+    lock.lock();
+
+    if (!--pool->active) pool->done.notify_one();
+  }
+}
+
+/* Return the pool, starting it if needed, or NULL if there is only
+   one processor.  Must be called with no pool lock held.  */
+static sig_check_pool_s *sig_check_get_pool(void) {
+  static std::once_flag once;
+
+  std::call_once(once, [] {
+    unsigned int n = std::thread::hardware_concurrency();
+
+    if (n < 2) return;
+    sig_check_pool = new sig_check_pool_s();
+    sig_check_pool->tasks = NULL;
+    sig_check_pool->next = 0;
+    sig_check_pool->batch = 0;
+    sig_check_pool->active = 0;
+    /* The calling thread does its share of the work.  */
+    sig_check_pool->nthreads = n - 1;
+    for (unsigned int i = 0; i < n - 1; i++)
+      std::thread(sig_check_pool_worker, sig_check_pool).detach();
+  });
+  return sig_check_pool;
+}
+
+/* Run the public key operations of JOBS.  EdDSA signatures are
+   verified in batches.  Larger numbers of jobs are spread over a pool
+   of threads with one thread per processor.  */
+static void sig_check_run_jobs(std::vector<sig_check_job> &jobs) {
+  sig_check_pool_s *pool = NULL;
+  std::vector<sig_check_task> tasks;
+  std::vector<sig_check_job *> eddsa;
+  size_t pending = 0, nthreads = 1, chunk, i;
+
+  for (auto &job : jobs) {
+    if (!job.hash) continue;
+    pending++;
+    if (job.pk->pubkey_algo == PUBKEY_ALGO_EDDSA)
+      eddsa.push_back(&job);
+    else
+      tasks.push_back(sig_check_task{{&job}});
+  }
+
+  if (pending >= SIG_CHECK_MIN_PARALLEL && (pool = sig_check_get_pool()))
+    nthreads = pool->nthreads + 1;
+
+  /* Give each thread about the same number of EdDSA signatures.  */
+  chunk = (eddsa.size() + nthreads - 1) / nthreads;
+  if (chunk > SIG_CHECK_MAX_BATCH) chunk = SIG_CHECK_MAX_BATCH;
+  if (chunk < 2) chunk = 2;
+  for (i = 0; i < eddsa.size(); i += chunk)
+    tasks.push_back(sig_check_task{std::vector<sig_check_job *>(
+        eddsa.begin() + i, eddsa.begin() + std::min(i + chunk, eddsa.size()))});
+
+  if (!pool || tasks.size() < 2) {
+    for (auto &task : tasks) sig_check_task_run(&task);
+    return;
+  }
+
+  std::lock_guard<std::mutex> dispatch(pool->dispatch_lock);
+  {
+    std::lock_guard<std::mutex> lock(pool->lock);
+
+    pool->tasks = &tasks;
+    pool->next = 0;
+    pool->active = pool->nthreads;
+    pool->batch++;
+  }
+  pool->wakeup.notify_all();
+
+  sig_check_pool_drain(pool, &tasks);
+
+  /* Wait until every worker has seen this batch, so that none of them
+     is still looking at TASKS when we return.  */
+  std::unique_lock<std::mutex> lock(pool->lock);
+  pool->done.wait(lock, [pool] { return !pool->active; });
+  pool->tasks = NULL;
+}
+
+/* Check all signatures in the keyblock KEYBLOCK whose result is not
+ * yet cached in the signature packet, running the public key
+ * operations in parallel.  If SELFSIGS_ONLY is set, only
+ * self-signatures are considered; otherwise also certifications by
+ * other keys, which are looked up using get_pubkey.
+ *
+ * This only determines whether the signatures were made by their
+ * issuers and stores the result in SIG->FLAGS.CHECKED and
+ * SIG->FLAGS.VALID, exactly as check_key_signature2 would do.  The
+ * callers are expected to use check_key_signature as usual
+ * afterwards, which then takes the cached result and does the
+ * remaining checks (e.g. of the signature's metadata).  Signatures
+ * which are not handled here, for example revocations by designated
+ * revokers or signatures which can't be checked, are left to
+ * check_key_signature.
+ *
+ * This function does nothing if the signature cache is disabled.  */
+void check_key_signatures_batch(ctrl_t ctrl, kbnode_t keyblock,
+                                int selfsigs_only) {
+  kbnode_t node;
+  kbnode_t uidnode = NULL;
+  kbnode_t subnode = NULL;
+  PKT_public_key *pripk;
+  std::vector<sig_check_job> jobs;
+  std::vector<PKT_public_key *> issuers;
+  gcry_md_hd_t md;
+
+  if (opt.no_sig_cache) return;
+
+  log_assert(keyblock->pkt->pkttype == PKT_PUBLIC_KEY);
+  pripk = keyblock->pkt->pkt.public_key;
+
+  for (node = keyblock->next; node; node = node->next) {
+    PKT_signature *sig;
+    PKT_public_key *signer;
+    PACKET *packet = NULL;
+    int selfsig;
+
+    /* Track the components the same way as find_prev_kbnode does for
+       check_key_signature2.  */
+    if (node->pkt->pkttype == PKT_USER_ID) {
+      uidnode = node;
+      continue;
+    } else if (node->pkt->pkttype == PKT_PUBLIC_SUBKEY) {
+      subnode = node;
+      continue;
+    } else if (node->pkt->pkttype != PKT_SIGNATURE)
+      continue;
+
+    sig = node->pkt->pkt.signature;
+    if (sig->flags.checked) continue;
+    if (openpgp_pk_test_algo((pubkey_algo_t)(sig->pubkey_algo)) ||
+        openpgp_md_test_algo((digest_algo_t)(sig->digest_algo)) ||
+        opt.weak_digests.count((gcry_md_algos)sig->digest_algo))
+      continue;
+
+    selfsig = keyid_cmp(pk_keyid(pripk), sig->keyid) == 0;
+    if (selfsigs_only && !selfsig) continue;
+
+    if (selfsig && (sig->sig_class == 0x1f || sig->sig_class == 0x20))
+      packet = keyblock->pkt;
+    else if (selfsig && (sig->sig_class == 0x18 || sig->sig_class == 0x28)) {
+      if (subnode) packet = subnode->pkt;
+    } else if (IS_UID_SIG(sig) || IS_UID_REV(sig)) {
+      if (uidnode) packet = uidnode->pkt;
+    }
+    if (!packet) continue;
+
+    if (selfsig)
+      signer = pripk;
+    else {
+      signer = (PKT_public_key *)xmalloc_clear(sizeof(*signer));
+      if (get_pubkey(ctrl, signer, sig->keyid)) {
+        free_public_key(signer);
+        continue;
+      }
+      issuers.push_back(signer);
+    }
+
+    /* Hash the signed data as check_signature_over_key_or_uid does.  */
+    if (gcry_md_open(&md, sig->digest_algo, 0)) BUG();
+    if (packet->pkttype == PKT_PUBLIC_KEY)
+      hash_public_key(md, packet->pkt.public_key);
+    else if (packet->pkttype == PKT_PUBLIC_SUBKEY) {
+      hash_public_key(md, pripk);
+      hash_public_key(md, packet->pkt.public_key);
+    } else {
+      hash_public_key(md, pripk);
+      hash_uid_packet(packet->pkt.user_id, md, sig);
+    }
+
+    jobs.emplace_back();
+    if (sig_check_job_prepare(signer, sig, md, &jobs.back())) jobs.pop_back();
+    gcry_md_close(md);
+  }
+
+  sig_check_run_jobs(jobs);
+
+  for (auto &job : jobs) cache_sig_result(job.sig, sig_check_job_finish(&job));
+
+  for (auto issuer : issuers) free_public_key(issuer);
+}
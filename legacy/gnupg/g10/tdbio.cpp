@@ -27,6 +27,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <unordered_map>
 
 #include "../common/iobuf.h"
 #include "../common/status.h"
@@ -48,32 +49,50 @@
 #endif
 
 /*
- * Yes, this is a very simple implementation. We should really
- * use a page aligned buffer and read complete pages.
- * To implement a simple trannsaction system, this is sufficient.
+ * The record cache.  Records are grouped into pages of
+ * TDB_PAGE_RECORDS consecutive records; a page is read from the file
+ * with a single read and found through a hash table keyed by the page
+ * number.  Two bitmaps per page tell which records hold valid data
+ * and which have been modified and still need to be written back.
+ * Pages are kept in LRU order: clean pages are evicted first and
+ * dirty pages are only written back if no clean page is left.  To
+ * implement a simple transaction system, this is sufficient.
  */
-typedef struct cache_ctrl_struct *CACHE_CTRL;
-struct cache_ctrl_struct {
-  CACHE_CTRL next;
-  struct {
-    unsigned used : 1;
-    unsigned dirty : 1;
-  } flags;
-  unsigned long recno;
-  char data[TRUST_RECORD_LEN];
+#define TDB_PAGE_RECORDS 64
+#define TDB_PAGE_SIZE (TDB_PAGE_RECORDS * TRUST_RECORD_LEN)
+
+typedef struct cache_page_struct *CACHE_PAGE;
+struct cache_page_struct {
+  CACHE_PAGE prev; /* LRU list, most recently used first.  */
+  CACHE_PAGE next;
+  unsigned long pageno;
+  uint64_t valid; /* Records holding data.  */
+  uint64_t dirty; /* Records to be written back.  */
+  char data[TDB_PAGE_SIZE];
 };
 
-/* Size of the cache.  The SOFT value is the general one.  While in a
-   transaction this may not be sufficient and thus we may increase it
-   then up to the HARD limit.  */
-#define MAX_CACHE_ENTRIES_SOFT 200
+/* The size of the cache is given in records by opt.tdb_cache_size.
+   While in a transaction dirty pages can't be written back and thus
+   the cache may grow up to this HARD limit.  */
 #define MAX_CACHE_ENTRIES_HARD 10000
 
 /* The cache is controlled by these variables.  */
-static CACHE_CTRL cache_list;
-static int cache_entries;
+static std::unordered_map<unsigned long, CACHE_PAGE> cache_pages;
+static CACHE_PAGE cache_lru_head;
+static CACHE_PAGE cache_lru_tail;
 static int cache_is_dirty;
 
+/* Statistics for the cache.  */
+static struct {
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long page_reads;
+  unsigned long evicted;
+  unsigned long flushed;
+  unsigned long invalidated;
+  size_t peak;
+} cache_stats;
+
 /* An object to pass information to cmp_krec_fpr. */
 struct cmp_krec_fpr_struct {
   int pubkey_algo;
@@ -103,6 +122,7 @@ static int in_transaction;
 
 static void open_db(void);
 static void create_hashtable(ctrl_t ctrl, TRUSTREC *vr, int type);
+static void cache_invalidate_clean(void);
 
 /*
  * Take a lock on the trustdb file name.  I a lock file can't be
@@ -122,6 +142,9 @@ static int take_write_lock(void) {
       log_fatal(_("can't lock '%s'\n"), db_name);
     else
       is_locked = 1;
+    /* Other processes may have changed the file while we did not
+       hold the lock.  */
+    cache_invalidate_clean();
     return 0;
   } else
     return 1;
@@ -139,153 +162,153 @@ static void release_write_lock(void) {
  ************* record cache **********
  *************************************/
 
+/* Return the bit for record RECNO in the bitmaps of its page.  */
+static inline uint64_t cache_record_bit(unsigned long recno) {
+  return (uint64_t)1 << (recno % TDB_PAGE_RECORDS);
+}
+
+/* Return the maximum number of pages in the cache.  */
+static size_t cache_max_pages(void) {
+  size_t n = opt.tdb_cache_size;
+
+  n = (n + TDB_PAGE_RECORDS - 1) / TDB_PAGE_RECORDS;
+  return n ? n : 1;
+}
+
+/* Move page P to the front of the LRU list.  P must not be linked. */
+static void cache_lru_push(CACHE_PAGE p) {
+  p->prev = NULL;
+  p->next = cache_lru_head;
+  if (cache_lru_head)
+    cache_lru_head->prev = p;
+  else
+    cache_lru_tail = p;
+  cache_lru_head = p;
+}
+
+/* Remove page P from the LRU list.  */
+static void cache_lru_unlink(CACHE_PAGE p) {
+  if (p->prev)
+    p->prev->next = p->next;
+  else
+    cache_lru_head = p->next;
+  if (p->next)
+    p->next->prev = p->prev;
+  else
+    cache_lru_tail = p->prev;
+}
+
+/* Remove page P from the cache and release it.  */
+static void cache_drop_page(CACHE_PAGE p) {
+  cache_lru_unlink(p);
+  cache_pages.erase(p->pageno);
+  xfree(p);
+}
+
+/*
+ * Forget all records which are not dirty.  This is used when taking
+ * the write lock because another process may have changed the trustdb
+ * in the meantime.
+ */
+static void cache_invalidate_clean(void) {
+  CACHE_PAGE p, next;
+
+  for (p = cache_lru_head; p; p = next) {
+    next = p->next;
+    p->valid &= p->dirty;
+    if (!p->valid) cache_drop_page(p);
+  }
+  cache_stats.invalidated++;
+}
+
 /*
  * Get the data from the record cache and return a pointer into that
  * cache.  Caller should copy the returned data.  NULL is returned on
  * a cache miss.
  */
 static const char *get_record_from_cache(unsigned long recno) {
-  CACHE_CTRL r;
+  auto it = cache_pages.find(recno / TDB_PAGE_RECORDS);
+  CACHE_PAGE p;
 
-  for (r = cache_list; r; r = r->next) {
-    if (r->flags.used && r->recno == recno) return r->data;
+  if (it == cache_pages.end() ||
+      !(it->second->valid & cache_record_bit(recno))) {
+    cache_stats.misses++;
+    return NULL;
+  }
+  p = it->second;
+  cache_stats.hits++;
+  if (p != cache_lru_head) {
+    cache_lru_unlink(p);
+    cache_lru_push(p);
   }
-  return NULL;
+  return p->data + (recno % TDB_PAGE_RECORDS) * TRUST_RECORD_LEN;
 }
 
 /*
- * Write a cached item back to the trustdb file.
+ * Write the dirty records of page P back to the trustdb file.
+ * Adjacent dirty records are written with one call.
  *
  * Returns: 0 on success or an error code.
  */
-static int write_cache_item(CACHE_CTRL r) {
+static int write_cache_page(CACHE_PAGE p) {
   gpg_error_t err;
-  int n;
+  unsigned long recno;
+  int i, j, n;
 
-  if (lseek(db_fd, r->recno * TRUST_RECORD_LEN, SEEK_SET) == -1) {
-    err = gpg_error_from_syserror();
-    log_error(_("trustdb rec %lu: lseek failed: %s\n"), r->recno,
-              strerror(errno));
-    return err;
-  }
-  n = write(db_fd, r->data, TRUST_RECORD_LEN);
-  if (n != TRUST_RECORD_LEN) {
-    err = gpg_error_from_syserror();
-    log_error(_("trustdb rec %lu: write failed (n=%d): %s\n"), r->recno, n,
-              strerror(errno));
-    return err;
+  for (i = 0; i < TDB_PAGE_RECORDS; i = j) {
+    j = i + 1;
+    if (!(p->dirty & ((uint64_t)1 << i))) continue;
+    while (j < TDB_PAGE_RECORDS && (p->dirty & ((uint64_t)1 << j))) j++;
+
+    recno = p->pageno * TDB_PAGE_RECORDS + i;
+    if (lseek(db_fd, recno * TRUST_RECORD_LEN, SEEK_SET) == -1) {
+      err = gpg_error_from_syserror();
+      log_error(_("trustdb rec %lu: lseek failed: %s\n"), recno,
+                strerror(errno));
+      return err;
+    }
+    n = write(db_fd, p->data + i * TRUST_RECORD_LEN,
+              (j - i) * TRUST_RECORD_LEN);
+    if (n != (j - i) * TRUST_RECORD_LEN) {
+      err = gpg_error_from_syserror();
+      log_error(_("trustdb rec %lu: write failed (n=%d): %s\n"), recno, n,
+                strerror(errno));
+      return err;
+    }
   }
-  r->flags.dirty = 0;
+  p->dirty = 0;
   return 0;
 }
 
 /*
- * Put data into the cache.  This function may flush
- * some cache entries if the cache is filled up.
+ * Make room for a new page in the cache.  This function may flush
+ * some dirty pages if the cache is filled up.
  *
  * Returns: 0 on success or an error code.
  */
-static int put_record_into_cache(unsigned long recno, const char *data) {
-  CACHE_CTRL r, unused;
-  int dirty_count = 0;
-  int clean_count = 0;
-
-  /* See whether we already cached this one.  */
-  for (unused = NULL, r = cache_list; r; r = r->next) {
-    if (!r->flags.used) {
-      if (!unused) unused = r;
-    } else if (r->recno == recno) {
-      if (!r->flags.dirty) {
-        /* Hmmm: should we use a copy and compare? */
-        if (memcmp(r->data, data, TRUST_RECORD_LEN)) {
-          r->flags.dirty = 1;
-          cache_is_dirty = 1;
-        }
-      }
-      memcpy(r->data, data, TRUST_RECORD_LEN);
-      return 0;
-    }
-    if (r->flags.used) {
-      if (r->flags.dirty)
-        dirty_count++;
-      else
-        clean_count++;
-    }
-  }
-
-  /* Not in the cache: add a new entry. */
-  if (unused) {
-    /* Reuse this entry. */
-    r = unused;
-    r->flags.used = 1;
-    r->recno = recno;
-    memcpy(r->data, data, TRUST_RECORD_LEN);
-    r->flags.dirty = 1;
-    cache_is_dirty = 1;
-    cache_entries++;
-    return 0;
-  }
-
-  /* See whether we reached the limit. */
-  if (cache_entries < MAX_CACHE_ENTRIES_SOFT) {
-    /* No: Put into cache.  */
-    r = (CACHE_CTRL)xmalloc(sizeof *r);
-    r->flags.used = 1;
-    r->recno = recno;
-    memcpy(r->data, data, TRUST_RECORD_LEN);
-    r->flags.dirty = 1;
-    r->next = cache_list;
-    cache_list = r;
-    cache_is_dirty = 1;
-    cache_entries++;
-    return 0;
-  }
-
-  /* Cache is full: discard some clean entries.  */
-  if (clean_count) {
-    int n;
+static int cache_make_room(void) {
+  CACHE_PAGE p, prev;
+  size_t n;
+  int rc;
 
-    /* We discard a third of the clean entries.  */
-    n = clean_count / 3;
-    if (!n) n = 1;
+  if (cache_pages.size() < cache_max_pages()) return 0;
 
-    for (unused = NULL, r = cache_list; r; r = r->next) {
-      if (r->flags.used && !r->flags.dirty) {
-        if (!unused) unused = r;
-        r->flags.used = 0;
-        cache_entries--;
-        if (!--n) break;
-      }
+  /* Cache is full: discard the least recently used clean page.  */
+  for (p = cache_lru_tail; p; p = p->prev) {
+    if (!p->dirty) {
+      cache_drop_page(p);
+      cache_stats.evicted++;
+      return 0;
     }
-
-    /* Now put into the cache.  */
-    log_assert(unused);
-    r = unused;
-    r->flags.used = 1;
-    r->recno = recno;
-    memcpy(r->data, data, TRUST_RECORD_LEN);
-    r->flags.dirty = 1;
-    cache_is_dirty = 1;
-    cache_entries++;
-    return 0;
   }
 
-  /* No clean entries: We have to flush some dirty entries.  */
+  /* No clean pages: We have to flush some dirty pages.  */
   if (in_transaction) {
     /* But we can't do this while in a transaction.  Thus we
      * increase the cache size instead.  */
-    if (cache_entries < MAX_CACHE_ENTRIES_HARD) {
-      if (opt.debug && !(cache_entries % 100))
-        log_debug("increasing tdbio cache size\n");
-      r = (CACHE_CTRL)xmalloc(sizeof *r);
-      r->flags.used = 1;
-      r->recno = recno;
-      memcpy(r->data, data, TRUST_RECORD_LEN);
-      r->flags.dirty = 1;
-      r->next = cache_list;
-      cache_list = r;
-      cache_is_dirty = 1;
-      cache_entries++;
+    n = cache_pages.size();
+    if (n * TDB_PAGE_RECORDS < MAX_CACHE_ENTRIES_HARD) {
+      if (opt.debug && !(n % 10)) log_debug("increasing tdbio cache size\n");
       return 0;
     }
     /* Hard limit for the cache size reached.  */
@@ -293,42 +316,152 @@ static int put_record_into_cache(unsigned long recno, const char *data) {
     return GPG_ERR_RESOURCE_LIMIT;
   }
 
-  if (dirty_count) {
-    int n;
+  /* Write back and discard a fifth of the pages, least recently used
+   * first.  */
+  n = cache_pages.size() / 5;
+  if (!n) n = 1;
 
-    /* Discard some dirty entries. */
-    n = dirty_count / 5;
-    if (!n) n = 1;
+  take_write_lock();
+  for (p = cache_lru_tail; p && n; p = prev, n--) {
+    prev = p->prev;
+    rc = write_cache_page(p);
+    if (rc) {
+      release_write_lock();
+      return rc;
+    }
+    cache_drop_page(p);
+    cache_stats.flushed++;
+  }
+  release_write_lock();
+  return 0;
+}
 
-    take_write_lock();
-    for (unused = NULL, r = cache_list; r; r = r->next) {
-      if (r->flags.used && r->flags.dirty) {
-        int rc;
+/*
+ * Return the cache page for record RECNO in R_PAGE, creating an empty
+ * page if it is not yet cached.
+ *
+ * Returns: 0 on success or an error code.
+ */
+static int cache_get_page(unsigned long recno, CACHE_PAGE *r_page) {
+  unsigned long pageno = recno / TDB_PAGE_RECORDS;
+  CACHE_PAGE p;
+  int rc;
 
-        rc = write_cache_item(r);
-        if (rc) return rc;
-        if (!unused) unused = r;
-        r->flags.used = 0;
-        cache_entries--;
-        if (!--n) break;
-      }
+  auto it = cache_pages.find(pageno);
+  if (it != cache_pages.end()) {
+    p = it->second;
+    if (p != cache_lru_head) {
+      cache_lru_unlink(p);
+      cache_lru_push(p);
     }
-    release_write_lock();
-
-    /* Now put into the cache.  */
-    log_assert(unused);
-    r = unused;
-    r->flags.used = 1;
-    r->recno = recno;
-    memcpy(r->data, data, TRUST_RECORD_LEN);
-    r->flags.dirty = 1;
-    cache_is_dirty = 1;
-    cache_entries++;
+    *r_page = p;
     return 0;
   }
 
-  /* We should never reach this.  */
-  BUG();
+  rc = cache_make_room();
+  if (rc) return rc;
+
+  p = (CACHE_PAGE)xmalloc(sizeof *p);
+  p->pageno = pageno;
+  p->valid = 0;
+  p->dirty = 0;
+  cache_pages[pageno] = p;
+  cache_lru_push(p);
+  if (cache_pages.size() > cache_stats.peak)
+    cache_stats.peak = cache_pages.size();
+  *r_page = p;
+  return 0;
+}
+
+/*
+ * Read the record RECNO into the cache together with the other
+ * records of its page which are not dirty.  On success a pointer to
+ * the cached record is stored at R_DATA.
+ *
+ * Returns: 0 on success, -1 on EOF, or an error code.
+ */
+static int read_record_into_cache(unsigned long recno, const char **r_data) {
+  char buf[TDB_PAGE_SIZE];
+  size_t off = (recno % TDB_PAGE_RECORDS) * TRUST_RECORD_LEN;
+  CACHE_PAGE p;
+  gpg_error_t err;
+  uint64_t bit;
+  int i, n, rc;
+
+  rc = cache_get_page(recno, &p);
+  if (rc) return rc;
+
+  if (lseek(db_fd, (off_t)p->pageno * TDB_PAGE_SIZE, SEEK_SET) == -1) {
+    err = gpg_error_from_syserror();
+    log_error(_("trustdb: lseek failed: %s\n"), strerror(errno));
+    return err;
+  }
+  n = read(db_fd, buf, TDB_PAGE_SIZE);
+  if (n < 0) {
+    err = gpg_error_from_syserror();
+    log_error(_("trustdb: read failed (n=%d): %s\n"), n, strerror(errno));
+    return err;
+  }
+  cache_stats.page_reads++;
+
+  for (i = 0; (i + 1) * TRUST_RECORD_LEN <= n; i++) {
+    bit = (uint64_t)1 << i;
+    if (p->dirty & bit) continue;
+    memcpy(p->data + i * TRUST_RECORD_LEN, buf + i * TRUST_RECORD_LEN,
+           TRUST_RECORD_LEN);
+    p->valid |= bit;
+  }
+
+  if (!(p->valid & cache_record_bit(recno))) {
+    if ((size_t)n <= off) return -1; /* eof */
+    err = gpg_error_from_syserror();
+    log_error(_("trustdb: read failed (n=%d): %s\n"), (int)(n - off),
+              strerror(errno));
+    return err;
+  }
+  *r_data = p->data + off;
+  return 0;
+}
+
+/*
+ * Put data into the cache.  This function may flush
+ * some cache entries if the cache is filled up.
+ *
+ * Returns: 0 on success or an error code.
+ */
+static int put_record_into_cache(unsigned long recno, const char *data) {
+  char *rec;
+  CACHE_PAGE p;
+  uint64_t bit = cache_record_bit(recno);
+  int rc;
+
+  rc = cache_get_page(recno, &p);
+  if (rc) return rc;
+
+  rec = p->data + (recno % TDB_PAGE_RECORDS) * TRUST_RECORD_LEN;
+  if (!(p->dirty & bit)) {
+    /* Hmmm: should we use a copy and compare? */
+    if (!(p->valid & bit) || memcmp(rec, data, TRUST_RECORD_LEN)) {
+      p->dirty |= bit;
+      cache_is_dirty = 1;
+    }
+  }
+  memcpy(rec, data, TRUST_RECORD_LEN);
+  p->valid |= bit;
+  return 0;
+}
+
+/* Print statistics for the record cache.  */
+void tdbio_dump_stats(void) {
+  unsigned long lookups = cache_stats.hits + cache_stats.misses;
+
+  log_info("tdbio cache: pages=%zu peak=%zu max=%zu reads=%lu inv=%lu\n",
+           cache_pages.size(), cache_stats.peak, cache_max_pages(),
+           cache_stats.page_reads, cache_stats.invalidated);
+  log_info("             hits=%lu misses=%lu (%lu%%) evicted=%lu flushed=%lu\n",
+           cache_stats.hits, cache_stats.misses,
+           lookups ? cache_stats.hits * 100 / lookups : 0, cache_stats.evicted,
+           cache_stats.flushed);
 }
 
 /* Return true if the cache is dirty.  */
@@ -338,7 +471,7 @@ int tdbio_is_dirty() { return cache_is_dirty; }
  * Flush the cache.  This cannot be used while in a transaction.
  */
 int tdbio_sync() {
-  CACHE_CTRL r;
+  CACHE_PAGE p;
   int did_lock = 0;
 
   if (db_fd == -1) open_db();
@@ -348,9 +481,9 @@ int tdbio_sync() {
 
   if (!take_write_lock()) did_lock = 1;
 
-  for (r = cache_list; r; r = r->next) {
-    if (r->flags.used && r->flags.dirty) {
-      int rc = write_cache_item(r);
+  for (p = cache_lru_head; p; p = p->next) {
+    if (p->dirty) {
+      int rc = write_cache_page(p);
       if (rc) return rc;
     }
   }
@@ -1119,29 +1252,19 @@ void tdbio_dump_record(TRUSTREC *rec, estream_t fp) {
  * Return: 0 on success, -1 on EOF, or an error code.
  */
 int tdbio_read_record(unsigned long recnum, TRUSTREC *rec, int expected) {
-  byte readbuf[TRUST_RECORD_LEN];
   const byte *buf, *p;
   gpg_error_t err = 0;
-  int n, i;
+  int rc, i;
 
   if (db_fd == -1) open_db();
 
   buf = (const byte *)get_record_from_cache(recnum);
   if (!buf) {
-    if (lseek(db_fd, recnum * TRUST_RECORD_LEN, SEEK_SET) == -1) {
-      err = gpg_error_from_syserror();
-      log_error(_("trustdb: lseek failed: %s\n"), strerror(errno));
-      return err;
-    }
-    n = read(db_fd, readbuf, TRUST_RECORD_LEN);
-    if (!n) {
-      return -1; /* eof */
-    } else if (n != TRUST_RECORD_LEN) {
-      err = gpg_error_from_syserror();
-      log_error(_("trustdb: read failed (n=%d): %s\n"), n, strerror(errno));
-      return err;
-    }
-    buf = readbuf;
+    const char *data;
+
+    rc = read_record_into_cache(recnum, &data);
+    if (rc) return rc;
+    buf = (const byte *)data;
   }
   rec->recnum = recnum;
   rec->dirty = 0;
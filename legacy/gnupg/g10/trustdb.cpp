@@ -28,6 +28,11 @@
 #include <sys/types.h>
 #endif /* !DISABLE_REGEX */
 
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <vector>
+
 #include "../common/iobuf.h"
 #include "../common/mbox-util.h"
 #include "../common/status.h"
@@ -1361,6 +1366,61 @@ static int search_skipfnc(void *opaque, u32 *kid, int dummy_uid_no) {
   return test_key_hash_table((KeyHashTable)opaque, kid);
 }
 
+/* Check the keyblock KEYBLOCK against KLIST and append it to the
+ * key_array at R_KEYS with R_NKEYS used and R_MAXKEYS allocated
+ * items if any of its user IDs is signed by a key in KLIST.  Takes
+ * ownership of KEYBLOCK.  */
+static void validate_key_list_add(ctrl_t ctrl, kbnode_t keyblock,
+                                  KeyHashTable full_trust,
+                                  struct key_item *klist, u32 curtime,
+                                  u32 *next_expire, struct key_array **r_keys,
+                                  size_t *r_nkeys, size_t *r_maxkeys) {
+  PKT_public_key *pk;
+
+  if (keyblock->pkt->pkttype != PKT_PUBLIC_KEY) {
+    log_debug("ooops: invalid pkttype %d encountered\n",
+              keyblock->pkt->pkttype);
+    dump_kbnode(keyblock);
+    release_kbnode(keyblock);
+    return;
+  }
+
+  /* prepare the keyblock for further processing */
+  merge_keys_and_selfsig(ctrl, keyblock);
+  clear_kbnode_flags(keyblock);
+  pk = keyblock->pkt->pkt.public_key;
+  if (pk->has_expired || pk->flags.revoked) {
+    /* it does not make sense to look further at those keys */
+    mark_keyblock_seen(full_trust, keyblock);
+  } else if (validate_one_keyblock(ctrl, keyblock, klist, curtime,
+                                   next_expire)) {
+    KBNODE node;
+
+    if (pk->expiredate && pk->expiredate >= curtime &&
+        pk->expiredate < *next_expire)
+      *next_expire = pk->expiredate;
+
+    if (*r_nkeys == *r_maxkeys) {
+      *r_maxkeys += 1000;
+      *r_keys =
+          (key_array *)xrealloc(*r_keys, (*r_maxkeys + 1) * sizeof **r_keys);
+    }
+    (*r_keys)[(*r_nkeys)++].keyblock = keyblock;
+
+    /* Optimization - if all uids are fully trusted, then we
+       never need to consider this key as a candidate again. */
+
+    for (node = keyblock; node; node = node->next)
+      if (node->pkt->pkttype == PKT_USER_ID && !(node->flag & 4)) break;
+
+    if (node == NULL) mark_keyblock_seen(full_trust, keyblock);
+
+    keyblock = NULL;
+  }
+
+  release_kbnode(keyblock);
+}
+
 /*
  * Scan all keys and return a key_array of all suitable keys from
  * kllist.  The caller has to pass keydb handle so that we don't use
@@ -1405,70 +1465,178 @@ static struct key_array *validate_key_list(ctrl_t ctrl, KEYDB_HANDLE hd,
 
   desc.mode = KEYDB_SEARCH_MODE_NEXT; /* change mode */
   do {
-    PKT_public_key *pk;
-
     rc = keydb_get_keyblock(hd, &keyblock);
     if (rc) {
       log_error("keydb_get_keyblock failed: %s\n", gpg_strerror(rc));
       goto die;
     }
 
+    validate_key_list_add(ctrl, keyblock, full_trust, klist, curtime,
+                          next_expire, &keys, &nkeys, &maxkeys);
+    keyblock = NULL;
+  } while (!(rc = keydb_search(hd, &desc, 1, NULL)));
+
+  if (rc && rc != GPG_ERR_NOT_FOUND) {
+    log_error("keydb_search_next failed: %s\n", gpg_strerror(rc));
+    goto die;
+  }
+
+  keys[nkeys].keyblock = NULL;
+  return keys;
+
+die:
+  keys[nkeys].keyblock = NULL;
+  release_key_array(keys);
+  return NULL;
+}
+
+/*
+ * The certification graph.  validate_key_list walks the entire key
+ * database for each depth of the web of trust, parsing every keyblock
+ * again.  With a large keyring this dominates --update-trustdb.
+ * Instead we walk the database once and record for each primary key
+ * the key IDs of the issuers of the signatures on its user IDs.  A
+ * depth then only needs to look at the keys certified by a key in
+ * KLIST; all other keys can't get a signed user ID from
+ * validate_one_keyblock anyway.  The expiration, revocation, trust
+ * signature and regexp checks are still done by
+ * validate_one_keyblock on the candidate keyblocks.
+ */
+struct cert_graph {
+  /* The primary keys in key database order.  */
+  std::vector<std::array<byte, MAX_FINGERPRINT_LEN>> fprs;
+  std::vector<std::array<u32, 2>> kids;
+
+  /* Map from the key ID of an issuer to the (ascending) indices of
+     the keys it certified.  */
+  std::unordered_map<uint64_t, std::vector<unsigned int>> certified;
+};
+
+static inline uint64_t cert_graph_key(const u32 *kid) {
+  return ((uint64_t)kid[0] << 32) | kid[1];
+}
+
+/* Build the certification graph from all keys in HD.  Returns 0 on
+   success.  */
+static gpg_error_t build_cert_graph(KEYDB_HANDLE hd, struct cert_graph *graph) {
+  KEYDB_SEARCH_DESC desc;
+  KBNODE keyblock = NULL;
+  KBNODE node;
+  gpg_error_t rc;
+
+  rc = keydb_search_reset(hd);
+  if (rc) return rc;
+
+  memset(&desc, 0, sizeof desc);
+  desc.mode = KEYDB_SEARCH_MODE_FIRST;
+  while (!(rc = keydb_search(hd, &desc, 1, NULL))) {
+    std::array<byte, MAX_FINGERPRINT_LEN> fpr;
+    std::array<u32, 2> kid;
+    size_t fprlen;
+    unsigned int idx;
+    int in_uid = 0;
+
+    desc.mode = KEYDB_SEARCH_MODE_NEXT;
+    rc = keydb_get_keyblock(hd, &keyblock);
+    if (rc) return rc;
+
     if (keyblock->pkt->pkttype != PKT_PUBLIC_KEY) {
-      log_debug("ooops: invalid pkttype %d encountered\n",
-                keyblock->pkt->pkttype);
-      dump_kbnode(keyblock);
       release_kbnode(keyblock);
       continue;
     }
 
-    /* prepare the keyblock for further processing */
-    merge_keys_and_selfsig(ctrl, keyblock);
-    clear_kbnode_flags(keyblock);
-    pk = keyblock->pkt->pkt.public_key;
-    if (pk->has_expired || pk->flags.revoked) {
-      /* it does not make sense to look further at those keys */
-      mark_keyblock_seen(full_trust, keyblock);
-    } else if (validate_one_keyblock(ctrl, keyblock, klist, curtime,
-                                     next_expire)) {
-      KBNODE node;
-
-      if (pk->expiredate && pk->expiredate >= curtime &&
-          pk->expiredate < *next_expire)
-        *next_expire = pk->expiredate;
-
-      if (nkeys == maxkeys) {
-        maxkeys += 1000;
-        keys = (key_array *)xrealloc(keys, (maxkeys + 1) * sizeof *keys);
+    fingerprint_from_pk(keyblock->pkt->pkt.public_key, fpr.data(), &fprlen);
+    if (fprlen != 20) {
+      /* Can't look this key up by fingerprint; don't use the
+         graph.  */
+      release_kbnode(keyblock);
+      return GPG_ERR_NOT_SUPPORTED;
+    }
+    keyid_from_pk(keyblock->pkt->pkt.public_key, kid.data());
+    idx = graph->fprs.size();
+    graph->fprs.push_back(fpr);
+    graph->kids.push_back(kid);
+
+    for (node = keyblock->next; node; node = node->next) {
+      if (node->pkt->pkttype == PKT_USER_ID)
+        in_uid = 1;
+      else if (node->pkt->pkttype == PKT_PUBLIC_SUBKEY)
+        in_uid = 0;
+      else if (in_uid && node->pkt->pkttype == PKT_SIGNATURE) {
+        PKT_signature *sig = node->pkt->pkt.signature;
+        std::vector<unsigned int> &edges =
+            graph->certified[cert_graph_key(sig->keyid)];
+
+        if (edges.empty() || edges.back() != idx) edges.push_back(idx);
       }
-      keys[nkeys++].keyblock = keyblock;
+    }
+    release_kbnode(keyblock);
+    keyblock = NULL;
+  }
+  if (rc != GPG_ERR_NOT_FOUND) return rc;
+
+  if (DBG_TRUST)
+    log_debug("cert_graph: %zu keys, %zu issuers\n", graph->fprs.size(),
+              graph->certified.size());
+  return 0;
+}
+
+/*
+ * Same as validate_key_list but only look at the keys which GRAPH
+ * says are certified by a key in KLIST.
+ */
+static struct key_array *validate_key_graph(ctrl_t ctrl, KEYDB_HANDLE hd,
+                                            struct cert_graph *graph,
+                                            KeyHashTable full_trust,
+                                            struct key_item *klist,
+                                            u32 curtime, u32 *next_expire) {
+  std::vector<unsigned int> candidates;
+  KBNODE keyblock = NULL;
+  struct key_array *keys = NULL;
+  size_t nkeys, maxkeys;
+  struct key_item *k;
+  int rc;
+  KEYDB_SEARCH_DESC desc;
 
-      /* Optimization - if all uids are fully trusted, then we
-         never need to consider this key as a candidate again. */
+  for (k = klist; k; k = k->next) {
+    auto it = graph->certified.find(cert_graph_key(k->kid));
 
-      for (node = keyblock; node; node = node->next)
-        if (node->pkt->pkttype == PKT_USER_ID && !(node->flag & 4)) break;
+    if (it != graph->certified.end())
+      candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+  }
+  /* Keep the key database order of validate_key_list.  */
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                   candidates.end());
 
-      if (node == NULL) mark_keyblock_seen(full_trust, keyblock);
+  maxkeys = 1000;
+  keys = (key_array *)xmalloc((maxkeys + 1) * sizeof *keys);
+  nkeys = 0;
 
-      keyblock = NULL;
+  memset(&desc, 0, sizeof desc);
+  desc.mode = KEYDB_SEARCH_MODE_FPR20;
+  for (unsigned int idx : candidates) {
+    if (test_key_hash_table(full_trust, graph->kids[idx].data())) continue;
+
+    memcpy(desc.u.fpr, graph->fprs[idx].data(), 20);
+    rc = keydb_search_reset(hd);
+    if (!rc) rc = keydb_search(hd, &desc, 1, NULL);
+    if (rc == GPG_ERR_NOT_FOUND) continue; /* Deleted meanwhile.  */
+    if (!rc) rc = keydb_get_keyblock(hd, &keyblock);
+    if (rc) {
+      log_error("keydb_get_keyblock failed: %s\n", gpg_strerror(rc));
+      keys[nkeys].keyblock = NULL;
+      release_key_array(keys);
+      return NULL;
     }
 
-    release_kbnode(keyblock);
+    validate_key_list_add(ctrl, keyblock, full_trust, klist, curtime,
+                          next_expire, &keys, &nkeys, &maxkeys);
     keyblock = NULL;
-  } while (!(rc = keydb_search(hd, &desc, 1, NULL)));
-
-  if (rc && rc != GPG_ERR_NOT_FOUND) {
-    log_error("keydb_search_next failed: %s\n", gpg_strerror(rc));
-    goto die;
   }
 
   keys[nkeys].keyblock = NULL;
   return keys;
-
-die:
-  keys[nkeys].keyblock = NULL;
-  release_key_array(keys);
-  return NULL;
 }
 
 /* Caller must sync */
@@ -1540,6 +1708,8 @@ static int validate_keys(ctrl_t ctrl, int interactive) {
   int ot_unknown, ot_undefined, ot_never, ot_marginal, ot_full, ot_ultimate;
   KeyHashTable stored, used, full_trust;
   u32 start_time, next_expire;
+  struct cert_graph graph;
+  int use_graph = 0;
 
   kdb = keydb_new();
   if (!kdb) return gpg_error_from_syserror();
@@ -1595,6 +1765,16 @@ static int validate_keys(ctrl_t ctrl, int interactive) {
              opt.marginals_needed, opt.completes_needed,
              trust_model_string(opt.trust_model));
 
+  if (!opt.no_trustdb_graph) {
+    rc = build_cert_graph(kdb, &graph);
+    if (!rc)
+      use_graph = 1;
+    else if (rc != GPG_ERR_NOT_SUPPORTED)
+      log_info("building the certification graph failed: %s\n",
+               gpg_strerror(rc));
+    rc = 0;
+  }
+
   for (depth = 0; depth < opt.max_cert_depth; depth++) {
     int valids = 0, key_count;
     /* See whether we should assign ownertrust values to the keys in
@@ -1653,8 +1833,12 @@ static int validate_keys(ctrl_t ctrl, int interactive) {
     }
 
     /* Find all keys which are signed by a key in kdlist */
-    keys = validate_key_list(ctrl, kdb, full_trust, klist, start_time,
-                             &next_expire);
+    if (use_graph)
+      keys = validate_key_graph(ctrl, kdb, &graph, full_trust, klist,
+                                start_time, &next_expire);
+    else
+      keys = validate_key_list(ctrl, kdb, full_trust, klist, start_time,
+                               &next_expire);
     if (!keys) {
       log_error("validate_key_list failed\n");
       rc = GPG_ERR_GENERAL;
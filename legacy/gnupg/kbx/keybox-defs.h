@@ -62,6 +62,10 @@ struct keybox_name {
   /* Not yet used.  */
   int did_full_scan;
 
+  /* The secondary index or NULL if not yet loaded.  See
+     keybox-index.cpp.  */
+  struct keybox_index *index;
+
   /* The name of the resource file. */
   char fname[1];
 };
@@ -158,6 +162,31 @@ int _keybox_write_blob(KEYBOXBLOB blob, FILE *fp);
 gpg_error_t _keybox_get_flag_location(const unsigned char *buffer,
                                       size_t length, int what, size_t *flag_off,
                                       size_t *flag_size);
+int _keybox_x509_get_keygrip(KEYBOXBLOB blob, unsigned char *grip);
+void _keybox_blob_index_items(KEYBOXBLOB blob,
+                              void (*cb)(void *opaque, int type,
+                                         const unsigned char *data,
+                                         size_t datalen),
+                              void *opaque);
+
+/*-- keybox-index.c --*/
+/* The item types of the secondary index.  */
+enum keybox_index_types {
+  KEYBOX_INDEX_FPR = 1,
+  KEYBOX_INDEX_LONG_KID = 2,
+  KEYBOX_INDEX_SHORT_KID = 3,
+  KEYBOX_INDEX_KEYGRIP = 4,
+  KEYBOX_INDEX_MAIL = 5
+};
+
+int _keybox_index_check(KB_NAME kb, FILE *fp, int rebuild);
+void _keybox_index_flush(KB_NAME kb);
+void _keybox_index_invalidate(KB_NAME kb);
+void _keybox_index_update(KB_NAME kb, off_t off, off_t oldlen, off_t newlen,
+                          KEYBOXBLOB blob);
+gpg_error_t _keybox_index_candidates(KEYBOX_HANDLE hd, KEYBOX_SEARCH_DESC *desc,
+                                     size_t ndesc, off_t **r_offs,
+                                     size_t *r_noffs);
 
 static inline int blob_get_type(KEYBOXBLOB blob) {
   const unsigned char *buffer;
@@ -0,0 +1,526 @@
+/* keybox-index.c - Secondary index for keybox files
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of GnuPG.
+ *
+ * GnuPG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GnuPG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* The secondary index maps the fingerprints, key ids, keygrips and
+   mail addresses of all blobs in a keybox to the file offsets of the
+   blobs.  It is kept in a sidecar file next to the keybox (FNAME.idx)
+   and loaded on the first exact-match search.
+
+   The index is only advisory: keybox_search reads the blobs at the
+   candidate offsets and runs the usual comparison functions on them.
+   Thus a hash collision of two mail addresses or an entry for a
+   deleted blob merely costs a blob read.  The index must however be
+   complete, so it is only used if it has been built for exactly the
+   file we are reading.  To check this the index carries a stamp made
+   from the device, inode, size and modification time (in
+   nanoseconds, so that two changes within one second are told apart)
+   of the keybox.  The update functions in keybox-update.cpp keep the
+   in-memory index in sync with their own changes; it is written back
+   when the keybox is unlocked or a handle is released.  Changes by a
+   program which does not know about the index, or an index which has
+   not been written back, let the stamp mismatch and the index is
+   rebuilt with the next search.
+
+   Sidecar file format (all integers big endian):
+
+     byte 0-7   magic "KBXIDX\x00\x02"
+     byte 8-39  stamp: device, inode, size, mtime (8 bytes each)
+     byte 40-   entries of 32 bytes, sorted by type, key and offset:
+                type (1 byte), key (20 bytes), reserved (3 bytes),
+                offset (8 bytes).
+
+   Keys shorter than 20 bytes (key ids) are padded with zeroes; mail
+   addresses are stored as the SHA-1 hash of the lowercased
+   address.  */
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gcrypt.h>
+#include "../common/sysutils.h"
+#include "keybox-defs.h"
+
+#define INDEX_MAGIC "KBXIDX\x00\x02"
+#define INDEX_MAGIC_LEN 8
+#define INDEX_HEADER_LEN (INDEX_MAGIC_LEN + 4 * 8)
+#define INDEX_ENTRY_LEN 32
+
+struct keybox_index_entry {
+  unsigned char type;
+  unsigned char key[20];
+  off_t off;
+
+  bool operator<(const keybox_index_entry &b) const {
+    int cmp;
+
+    if (type != b.type) return type < b.type;
+    cmp = memcmp(key, b.key, 20);
+    if (cmp) return cmp < 0;
+    return off < b.off;
+  }
+};
+
+struct keybox_index_stamp {
+  unsigned long long dev;
+  unsigned long long ino;
+  unsigned long long size;
+  unsigned long long mtime;
+
+  bool operator==(const keybox_index_stamp &b) const {
+    return dev == b.dev && ino == b.ino && size == b.size && mtime == b.mtime;
+  }
+};
+
+struct keybox_index {
+  keybox_index_stamp stamp;
+  std::vector<keybox_index_entry> entries; /* Sorted.  */
+  int dirty; /* Not yet written to the sidecar file.  */
+};
+
+static void stamp_from_stat(keybox_index_stamp *stamp, const struct stat *st) {
+  stamp->dev = st->st_dev;
+  stamp->ino = st->st_ino;
+  stamp->size = st->st_size;
+#if defined(__APPLE__)
+  stamp->mtime = st->st_mtimespec.tv_sec * 1000000000ULL +
+                 st->st_mtimespec.tv_nsec;
+#elif defined(HAVE_W32_SYSTEM)
+  stamp->mtime = st->st_mtime * 1000000000ULL;
+#else
+  stamp->mtime = st->st_mtim.tv_sec * 1000000000ULL + st->st_mtim.tv_nsec;
+#endif
+}
+
+static std::string index_filename(KB_NAME kb) {
+  return std::string(kb->fname) + EXTSEP_S "idx";
+}
+
+static void put64(unsigned char *p, unsigned long long val) {
+  int i;
+
+  for (i = 7; i >= 0; i--, val >>= 8) p[i] = val;
+}
+
+static unsigned long long get64(const unsigned char *p) {
+  unsigned long long val = 0;
+  int i;
+
+  for (i = 0; i < 8; i++) val = (val << 8) | p[i];
+  return val;
+}
+
+/* Build the key of an entry of TYPE from DATA,DATALEN.  */
+static void make_entry(keybox_index_entry *e, int type,
+                       const unsigned char *data, size_t datalen, off_t off) {
+  memset(e->key, 0, sizeof e->key);
+  e->type = type;
+  e->off = off;
+  if (type == KEYBOX_INDEX_MAIL) {
+    std::string mbox((const char *)data, datalen);
+
+    ascii_strlwr(&mbox[0]);
+    gcry_md_hash_buffer(GCRY_MD_SHA1, e->key, mbox.data(), mbox.size());
+  } else
+    memcpy(e->key, data, std::min(datalen, sizeof e->key));
+}
+
+/* Number of mail addresses hashed in one batch.  */
+#define MBOX_BATCH 256
+
+struct add_items_parm {
+  std::vector<keybox_index_entry> *entries;
+  off_t off;
+  /* The lowercased mail addresses whose hash is still missing and
+     the indices of their entries.  */
+  std::vector<std::string> mboxes;
+  std::vector<size_t> pending;
+};
+
+/* Compute the keys of the pending mail address entries of PARM.  The
+   addresses are short, so hashing them together with
+   gcry_md_hash_buffers_multi is much faster than one by one.  */
+static void flush_mboxes(struct add_items_parm *parm) {
+  std::vector<gcry_buffer_t> iov(parm->mboxes.size());
+  std::vector<unsigned char> digests(20 * parm->mboxes.size());
+  size_t i;
+
+  if (parm->mboxes.empty()) return;
+
+  for (i = 0; i < iov.size(); i++) {
+    memset(&iov[i], 0, sizeof iov[i]);
+    iov[i].data = &parm->mboxes[i][0];
+    iov[i].len = parm->mboxes[i].size();
+  }
+  if (gcry_md_hash_buffers_multi(GCRY_MD_SHA1, 0, digests.data(), iov.data(),
+                                 iov.size()))
+    BUG();
+  for (i = 0; i < iov.size(); i++)
+    memcpy((*parm->entries)[parm->pending[i]].key, &digests[20 * i], 20);
+
+  parm->mboxes.clear();
+  parm->pending.clear();
+}
+
+static void add_items_cb(void *opaque, int type, const unsigned char *data,
+                         size_t datalen) {
+  struct add_items_parm *parm = (struct add_items_parm *)opaque;
+  keybox_index_entry e;
+
+  if (type != KEYBOX_INDEX_MAIL) {
+    make_entry(&e, type, data, datalen, parm->off);
+    parm->entries->push_back(e);
+    return;
+  }
+
+  /* The key is filled in by flush_mboxes.  */
+  memset(e.key, 0, sizeof e.key);
+  e.type = type;
+  e.off = parm->off;
+  parm->mboxes.emplace_back((const char *)data, datalen);
+  ascii_strlwr(&parm->mboxes.back()[0]);
+  parm->pending.push_back(parm->entries->size());
+  parm->entries->push_back(e);
+  if (parm->mboxes.size() >= MBOX_BATCH) flush_mboxes(parm);
+}
+
+/* Write the index of KB to the sidecar file.  Errors are ignored
+   because the index can always be rebuilt.  */
+static void save_index(KB_NAME kb) {
+  struct keybox_index *idx = kb->index;
+  std::string fname = index_filename(kb);
+  std::string tmpfname = fname + EXTSEP_S + std::to_string(getpid());
+  unsigned char buf[INDEX_HEADER_LEN];
+  FILE *fp;
+  int err = 0;
+
+  fp = fopen(tmpfname.c_str(), "wb");
+  if (!fp) return;
+
+  memcpy(buf, INDEX_MAGIC, INDEX_MAGIC_LEN);
+  put64(buf + 8, idx->stamp.dev);
+  put64(buf + 16, idx->stamp.ino);
+  put64(buf + 24, idx->stamp.size);
+  put64(buf + 32, idx->stamp.mtime);
+  if (fwrite(buf, INDEX_HEADER_LEN, 1, fp) != 1) err = 1;
+
+  for (const auto &e : idx->entries) {
+    if (err) break;
+    memset(buf, 0, INDEX_ENTRY_LEN);
+    buf[0] = e.type;
+    memcpy(buf + 1, e.key, 20);
+    put64(buf + 24, e.off);
+    if (fwrite(buf, INDEX_ENTRY_LEN, 1, fp) != 1) err = 1;
+  }
+
+  if (fclose(fp)) err = 1;
+  if (err || gnupg_rename_file(tmpfname.c_str(), fname.c_str()))
+    gnupg_remove(tmpfname.c_str());
+  idx->dirty = 0;
+}
+
+/* Load the sidecar file of KB if it has been built for the file with
+   STAMP.  Returns true on success.  */
+static int load_index(KB_NAME kb, const keybox_index_stamp *stamp) {
+  std::string fname = index_filename(kb);
+  struct keybox_index *idx;
+  keybox_index_stamp filestamp;
+  unsigned char buf[INDEX_HEADER_LEN];
+  keybox_index_entry e;
+  struct stat st;
+  size_t n;
+  FILE *fp;
+
+  fp = fopen(fname.c_str(), "rb");
+  if (!fp) return 0;
+
+  if (fstat(fileno(fp), &st) || st.st_size < INDEX_HEADER_LEN ||
+      (st.st_size - INDEX_HEADER_LEN) % INDEX_ENTRY_LEN ||
+      fread(buf, INDEX_HEADER_LEN, 1, fp) != 1 ||
+      memcmp(buf, INDEX_MAGIC, INDEX_MAGIC_LEN)) {
+    fclose(fp);
+    return 0;
+  }
+  filestamp.dev = get64(buf + 8);
+  filestamp.ino = get64(buf + 16);
+  filestamp.size = get64(buf + 24);
+  filestamp.mtime = get64(buf + 32);
+  if (!(filestamp == *stamp)) {
+    fclose(fp);
+    return 0;
+  }
+
+  idx = new keybox_index;
+  idx->stamp = filestamp;
+  idx->dirty = 0;
+  n = (st.st_size - INDEX_HEADER_LEN) / INDEX_ENTRY_LEN;
+  idx->entries.reserve(n);
+  for (; n; n--) {
+    if (fread(buf, INDEX_ENTRY_LEN, 1, fp) != 1) break;
+    e.type = buf[0];
+    memcpy(e.key, buf + 1, 20);
+    e.off = get64(buf + 24);
+    if (!idx->entries.empty() && e < idx->entries.back())
+      break; /* Not sorted - corrupt.  */
+    idx->entries.push_back(e);
+  }
+  fclose(fp);
+  if (n) {
+    delete idx;
+    return 0;
+  }
+
+  _keybox_index_invalidate(kb);
+  kb->index = idx;
+  return 1;
+}
+
+/* Build the index of KB by reading all blobs from FP, which must be
+   an open stream of the keybox with STAMP.  The file position of FP
+   is preserved.  */
+static gpg_error_t build_index(KB_NAME kb, FILE *fp,
+                               const keybox_index_stamp *stamp) {
+  struct keybox_index *idx;
+  struct add_items_parm parm;
+  KEYBOXBLOB blob = NULL;
+  gpg_error_t err;
+  off_t saved;
+
+  saved = ftello(fp);
+  if (saved == (off_t)-1 || fseeko(fp, 0, SEEK_SET))
+    return gpg_error_from_syserror();
+
+  idx = new keybox_index;
+  idx->stamp = *stamp;
+  idx->dirty = 0;
+  parm.entries = &idx->entries;
+  for (;;) {
+    err = _keybox_read_blob(&blob, fp, NULL);
+    if (err == GPG_ERR_TOO_LARGE) continue;
+    if (err) break;
+    parm.off = _keybox_get_blob_fileoffset(blob);
+    _keybox_blob_index_items(blob, add_items_cb, &parm);
+    _keybox_release_blob(blob);
+    blob = NULL;
+  }
+  flush_mboxes(&parm);
+  if (err == -1 || err == GPG_ERR_EOF) err = 0;
+
+  clearerr(fp);
+  if (fseeko(fp, saved, SEEK_SET) && !err) err = gpg_error_from_syserror();
+  if (err) {
+    delete idx;
+    return err;
+  }
+
+  std::sort(idx->entries.begin(), idx->entries.end());
+  _keybox_index_invalidate(kb);
+  kb->index = idx;
+  save_index(kb);
+  return 0;
+}
+
+/* Make sure the index of KB matches the keybox opened as FP.  If
+   REBUILD is set, a missing or outdated index is rebuilt.  Returns
+   true if the index can be used.  */
+int _keybox_index_check(KB_NAME kb, FILE *fp, int rebuild) {
+  keybox_index_stamp stamp;
+  struct stat st;
+
+  if (!kb || !fp || fstat(fileno(fp), &st)) return 0;
+  stamp_from_stat(&stamp, &st);
+
+  if (kb->index && kb->index->stamp == stamp) return 1;
+  if (load_index(kb, &stamp)) return 1;
+  if (rebuild && !build_index(kb, fp, &stamp)) return 1;
+  return 0;
+}
+
+/* Write the index of KB to the sidecar file if it has been changed
+   by _keybox_index_update.  */
+void _keybox_index_flush(KB_NAME kb) {
+  if (kb && kb->index && kb->index->dirty) save_index(kb);
+}
+
+/* Release the in-memory index of KB.  */
+void _keybox_index_invalidate(KB_NAME kb) {
+  delete kb->index;
+  kb->index = NULL;
+}
+
+/* Apply a change to the keybox of KB to its index.  The blob at
+   offset OFF with OLDLEN bytes has been replaced by NEWLEN bytes and
+   the subsequent blobs have moved accordingly.  If OLDLEN is not 0
+   the items of the old blob are removed; if BLOB is not NULL, its
+   items are added at OFF.  This covers insertions (OLDLEN is 0),
+   updates, deletions (BLOB is NULL) and in-place changes (OLDLEN and
+   NEWLEN are equal).  The index is then stamped with the current
+   state of the keybox file and marked for _keybox_index_flush, so
+   that a bulk import writes the sidecar file only once.  The caller
+   must have checked with _keybox_index_check that the index was
+   valid before the change.  */
+void _keybox_index_update(KB_NAME kb, off_t off, off_t oldlen, off_t newlen,
+                          KEYBOXBLOB blob) {
+  struct keybox_index *idx = kb->index;
+  struct add_items_parm parm;
+  std::vector<keybox_index_entry> added;
+  struct stat st;
+  size_t i, j;
+
+  if (!idx) return;
+  if (stat(kb->fname, &st)) {
+    _keybox_index_invalidate(kb);
+    return;
+  }
+
+  /* Blobs do not overlap, thus shifting the offsets behind the
+     change keeps the entries sorted.  */
+  for (i = j = 0; i < idx->entries.size(); i++) {
+    keybox_index_entry &e = idx->entries[i];
+
+    if (oldlen && e.off == off) continue;
+    if (e.off > off) e.off += newlen - oldlen;
+    idx->entries[j++] = e;
+  }
+  idx->entries.resize(j);
+
+  if (blob) {
+    parm.entries = &added;
+    parm.off = off;
+    _keybox_blob_index_items(blob, add_items_cb, &parm);
+    flush_mboxes(&parm);
+    std::sort(added.begin(), added.end());
+    idx->entries.insert(idx->entries.end(), added.begin(), added.end());
+    std::inplace_merge(idx->entries.begin(), idx->entries.end() - added.size(),
+                       idx->entries.end());
+  }
+
+  stamp_from_stat(&idx->stamp, &st);
+  idx->dirty = 1;
+}
+
+/* Add the offsets of the entries of TYPE matching DATA,DATALEN to
+   OFFS.  */
+static void lookup(struct keybox_index *idx, int type,
+                   const unsigned char *data, size_t datalen,
+                   std::vector<off_t> &offs) {
+  keybox_index_entry e;
+
+  make_entry(&e, type, data, datalen, 0);
+  auto it = std::lower_bound(idx->entries.begin(), idx->entries.end(), e);
+  for (; it != idx->entries.end(); ++it) {
+    if (it->type != e.type || memcmp(it->key, e.key, 20)) break;
+    offs.push_back(it->off);
+  }
+}
+
+/* Return the sorted file offsets of all blobs which may match one of
+   the NDESC search descriptions DESC in the keybox HD at R_OFFS and
+   R_NOFFS.  The caller must xfree R_OFFS.  Returns
+   GPG_ERR_NOT_SUPPORTED if the index can't be used for this search,
+   in which case the caller needs to scan the keybox.  */
+gpg_error_t _keybox_index_candidates(KEYBOX_HANDLE hd, KEYBOX_SEARCH_DESC *desc,
+                                     size_t ndesc, off_t **r_offs,
+                                     size_t *r_noffs) {
+  std::vector<off_t> offs;
+  unsigned char buf[8];
+  const char *name;
+  size_t n, namelen;
+
+  *r_offs = NULL;
+  *r_noffs = 0;
+
+  if (!ndesc) return GPG_ERR_NOT_SUPPORTED;
+  for (n = 0; n < ndesc; n++) switch (desc[n].mode) {
+      case KEYDB_SEARCH_MODE_MAIL:
+        if (!desc[n].u.name) return GPG_ERR_NOT_SUPPORTED;
+        break;
+      case KEYDB_SEARCH_MODE_SHORT_KID:
+      case KEYDB_SEARCH_MODE_LONG_KID:
+      case KEYDB_SEARCH_MODE_FPR:
+      case KEYDB_SEARCH_MODE_FPR20:
+      case KEYDB_SEARCH_MODE_KEYGRIP:
+        break;
+      default:
+        return GPG_ERR_NOT_SUPPORTED;
+    }
+
+  if (!_keybox_index_check(hd->kb, hd->fp, 1)) return GPG_ERR_NOT_SUPPORTED;
+
+  for (n = 0; n < ndesc; n++) switch (desc[n].mode) {
+      case KEYDB_SEARCH_MODE_MAIL:
+        /* has_mail strips a leading '<' only for OpenPGP blobs, thus
+           we look up both variants.  */
+        name = desc[n].u.name;
+        namelen = strlen(name);
+        if (namelen && name[namelen - 1] == '>') namelen--;
+        if (!namelen) break;
+        lookup(hd->kb->index, KEYBOX_INDEX_MAIL, (const unsigned char *)name,
+               namelen, offs);
+        if (*name == '<' && namelen > 1)
+          lookup(hd->kb->index, KEYBOX_INDEX_MAIL,
+                 (const unsigned char *)name + 1, namelen - 1, offs);
+        break;
+      case KEYDB_SEARCH_MODE_SHORT_KID:
+        buf[0] = desc[n].u.kid[1] >> 24;
+        buf[1] = desc[n].u.kid[1] >> 16;
+        buf[2] = desc[n].u.kid[1] >> 8;
+        buf[3] = desc[n].u.kid[1];
+        lookup(hd->kb->index, KEYBOX_INDEX_SHORT_KID, buf, 4, offs);
+        break;
+      case KEYDB_SEARCH_MODE_LONG_KID:
+        buf[0] = desc[n].u.kid[0] >> 24;
+        buf[1] = desc[n].u.kid[0] >> 16;
+        buf[2] = desc[n].u.kid[0] >> 8;
+        buf[3] = desc[n].u.kid[0];
+        buf[4] = desc[n].u.kid[1] >> 24;
+        buf[5] = desc[n].u.kid[1] >> 16;
+        buf[6] = desc[n].u.kid[1] >> 8;
+        buf[7] = desc[n].u.kid[1];
+        lookup(hd->kb->index, KEYBOX_INDEX_LONG_KID, buf, 8, offs);
+        break;
+      case KEYDB_SEARCH_MODE_FPR:
+      case KEYDB_SEARCH_MODE_FPR20:
+        lookup(hd->kb->index, KEYBOX_INDEX_FPR, desc[n].u.fpr, 20, offs);
+        break;
+      case KEYDB_SEARCH_MODE_KEYGRIP:
+        lookup(hd->kb->index, KEYBOX_INDEX_KEYGRIP, desc[n].u.grip, 20, offs);
+        break;
+      default:
+        break;
+    }
+
+  std::sort(offs.begin(), offs.end());
+  offs.erase(std::unique(offs.begin(), offs.end()), offs.end());
+  if (!offs.empty()) {
+    *r_offs = (off_t *)xtrymalloc(offs.size() * sizeof **r_offs);
+    if (!*r_offs) return gpg_error_from_syserror();
+    memcpy(*r_offs, offs.data(), offs.size() * sizeof **r_offs);
+    *r_noffs = offs.size();
+  }
+  return 0;
+}
@@ -51,6 +51,7 @@ gpg_error_t keybox_register_file(const char *fname, int secret,
   kr->lockhd = NULL;
   kr->is_locked = 0;
   kr->did_full_scan = 0;
+  kr->index = NULL;
   /* keep a list of all issued pointers */
   kr->next = kb_names;
   kb_names = kr;
@@ -138,6 +139,7 @@ keybox_new_x509(void *token, int secret) {
 
 void keybox_release(KEYBOX_HANDLE hd) {
   if (!hd) return;
+  _keybox_index_flush(hd->kb);
   if (hd->kb->handle_table) {
     int idx;
     for (idx = 0; idx < hd->kb->handle_table_size; idx++)
@@ -249,6 +251,9 @@ gpg_error_t keybox_lock(KEYBOX_HANDLE hd, int yes) {
   } else /* Release the lock.  */
   {
     if (kb->is_locked) {
+      /* Write back the changes of the secondary index while we still
+         hold the lock.  */
+      _keybox_index_flush(kb);
       if (dotlock_release(kb->lockhd)) {
         err = gpg_error_from_syserror();
         log_info("can't unlock '%s'\n", kb->fname);
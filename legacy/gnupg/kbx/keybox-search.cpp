@@ -326,6 +326,58 @@ static int blob_cmp_name(KEYBOXBLOB blob, int idx, const char *name,
   return 0; /* not found */
 }
 
+/* Locate the mail address in the user id of LEN bytes at BUFFER+OFF.
+   For X.509 this is the entire user id if it is enclosed in angle
+   brackets.  For OpenPGP it is the part in angle brackets or, if
+   there are none, the entire user id if it looks like a mailbox.
+   Returns true and stores the location at R_OFF and R_LEN if a mail
+   address was found.  */
+static int uid_get_mailbox(const unsigned char *buffer, size_t off,
+                           size_t len, int x509, size_t *r_off,
+                           size_t *r_len) {
+  size_t mypos, mylen;
+
+  if (x509) {
+    if (len < 2 || buffer[off] != '<')
+      return 0; /* empty name or trailing 0 not stored */
+    len--;      /* one back */
+    if (len < 3 || buffer[off + len] != '>')
+      return 0; /* not a proper email address */
+    off++;
+    len--;
+  } else /* OpenPGP.  */
+  {
+    /* We need to forward to the mailbox part.  */
+    mypos = off;
+    mylen = len;
+    for (; len && buffer[off] != '<'; len--, off++)
+      ;
+    if (len < 2 || buffer[off] != '<') {
+      /* Mailbox not explicitly given or too short.  Restore
+         OFF and LEN and check whether the entire string
+         resembles a mailbox without the angle brackets.  */
+      off = mypos;
+      len = mylen;
+      if (!is_valid_mailbox_mem(buffer + off, len))
+        return 0; /* Not a mail address. */
+    } else        /* Seems to be standard user id with mail address.  */
+    {
+      off++; /* Point to first char of the mail address.  */
+      len--;
+      /* Search closing '>'.  */
+      for (mypos = off; len && buffer[mypos] != '>'; len--, mypos++)
+        ;
+      if (!len || buffer[mypos] != '>' || off == mypos)
+        return 0; /* Not a proper mail address.  */
+      len = mypos - off;
+    }
+  }
+
+  *r_off = off;
+  *r_len = len;
+  return 1;
+}
+
 /* Compare all email addresses of the subject.  With SUBSTR given as
    True a substring search is done in the mail address.  The X509 flag
    indicated whether the search is done on an X.509 blob.  */
@@ -370,48 +422,13 @@ static int blob_cmp_mail(KEYBOXBLOB blob, const char *name, size_t namelen,
      for the issuer name.  */
   for (idx = !!x509; idx < nuids; idx++) {
     size_t mypos = pos;
-    size_t mylen;
 
     mypos += idx * uidinfolen;
     off = get32(buffer + mypos);
     len = get32(buffer + mypos + 4);
     if (off + len > length)
       return 0; /* error: better stop here - out of bounds */
-    if (x509) {
-      if (len < 2 || buffer[off] != '<')
-        continue; /* empty name or trailing 0 not stored */
-      len--;      /* one back */
-      if (len < 3 || buffer[off + len] != '>')
-        continue; /* not a proper email address */
-      off++;
-      len--;
-    } else /* OpenPGP.  */
-    {
-      /* We need to forward to the mailbox part.  */
-      mypos = off;
-      mylen = len;
-      for (; len && buffer[off] != '<'; len--, off++)
-        ;
-      if (len < 2 || buffer[off] != '<') {
-        /* Mailbox not explicitly given or too short.  Restore
-           OFF and LEN and check whether the entire string
-           resembles a mailbox without the angle brackets.  */
-        off = mypos;
-        len = mylen;
-        if (!is_valid_mailbox_mem(buffer + off, len))
-          continue; /* Not a mail address. */
-      } else        /* Seems to be standard user id with mail address.  */
-      {
-        off++; /* Point to first char of the mail address.  */
-        len--;
-        /* Search closing '>'.  */
-        for (mypos = off; len && buffer[mypos] != '>'; len--, mypos++)
-          ;
-        if (!len || buffer[mypos] != '>' || off == mypos)
-          continue; /* Not a proper mail address.  */
-        len = mypos - off;
-      }
-    }
+    if (!uid_get_mailbox(buffer, off, len, x509, &off, &len)) continue;
 
     if (substr) {
       if (ascii_memcasemem(buffer + off, len, name, namelen))
@@ -424,11 +441,10 @@ static int blob_cmp_mail(KEYBOXBLOB blob, const char *name, size_t namelen,
   return 0; /* not found */
 }
 
-/* Return true if the key in BLOB matches the 20 bytes keygrip GRIP.
-   We don't have the keygrips as meta data, thus we need to parse the
-   certificate. Fixme: We might want to return proper error codes
-   instead of failing a search for invalid certificates etc.  */
-static int blob_x509_has_grip(KEYBOXBLOB blob, const unsigned char *grip) {
+/* Compute the 20 bytes keygrip of the key in the X.509 BLOB and
+   store it at GRIP.  Returns true on success.  We don't have the
+   keygrips as meta data, thus we need to parse the certificate.  */
+int _keybox_x509_get_keygrip(KEYBOXBLOB blob, unsigned char *grip) {
   int rc;
   const unsigned char *buffer;
   size_t length;
@@ -437,7 +453,6 @@ static int blob_x509_has_grip(KEYBOXBLOB blob, const unsigned char *grip) {
   ksba_cert_t cert = NULL;
   ksba_sexp_t p = NULL;
   gcry_sexp_t s_pkey;
-  unsigned char array[20];
   unsigned char *rcp;
   size_t n;
 
@@ -464,14 +479,14 @@ static int blob_x509_has_grip(KEYBOXBLOB blob, const unsigned char *grip) {
     gcry_sexp_release(s_pkey);
     goto failed;
   }
-  rcp = gcry_pk_get_keygrip(s_pkey, array);
+  rcp = gcry_pk_get_keygrip(s_pkey, grip);
   gcry_sexp_release(s_pkey);
   if (!rcp) goto failed; /* Can't calculate keygrip. */
 
   xfree(p);
   ksba_cert_release(cert);
   ksba_reader_release(reader);
-  return !memcmp(array, grip, 20);
+  return 1;
 failed:
   xfree(p);
   ksba_cert_release(cert);
@@ -479,6 +494,15 @@ failed:
   return 0;
 }
 
+/* Return true if the key in BLOB matches the 20 bytes keygrip GRIP.
+   Fixme: We might want to return proper error codes instead of
+   failing a search for invalid certificates etc.  */
+static int blob_x509_has_grip(KEYBOXBLOB blob, const unsigned char *grip) {
+  unsigned char array[20];
+
+  return _keybox_x509_get_keygrip(blob, array) && !memcmp(array, grip, 20);
+}
+
 /*
   The has_foo functions are used as helpers for search
 */
@@ -608,6 +632,77 @@ static gpg_error_t open_file(KEYBOX_HANDLE hd) {
   return 0;
 }
 
+/* Call CB with OPAQUE for every item of BLOB which is kept in the
+   secondary index: the fingerprints and key ids of all keys, all mail
+   addresses and, for X.509, the keygrip.  The items are extracted the
+   same way the has_foo functions above look at them.  */
+void _keybox_blob_index_items(KEYBOXBLOB blob,
+                              void (*cb)(void *opaque, int type,
+                                         const unsigned char *data,
+                                         size_t datalen),
+                              void *opaque) {
+  const unsigned char *buffer;
+  size_t length;
+  size_t pos, off, len;
+  size_t nkeys, keyinfolen;
+  size_t nuids, uidinfolen;
+  size_t nserial;
+  int idx, x509;
+  unsigned char grip[20];
+
+  switch (blob_get_type(blob)) {
+    case KEYBOX_BLOBTYPE_PGP:
+      x509 = 0;
+      break;
+    case KEYBOX_BLOBTYPE_X509:
+      x509 = 1;
+      break;
+    default:
+      return;
+  }
+
+  buffer = _keybox_get_blob_image(blob, &length);
+  if (length < 40) return; /* blob too short */
+
+  /*keys*/
+  nkeys = get16(buffer + 16);
+  keyinfolen = get16(buffer + 18);
+  if (keyinfolen < 28) return; /* invalid blob */
+  pos = 20;
+  if (pos + keyinfolen * nkeys > length) return; /* out of bounds */
+  for (idx = 0; idx < nkeys; idx++) {
+    off = pos + idx * keyinfolen;
+    cb(opaque, KEYBOX_INDEX_FPR, buffer + off, 20);
+    cb(opaque, KEYBOX_INDEX_LONG_KID, buffer + off + 12, 8);
+    cb(opaque, KEYBOX_INDEX_SHORT_KID, buffer + off + 16, 4);
+  }
+  pos += keyinfolen * nkeys;
+
+  if (x509 && _keybox_x509_get_keygrip(blob, grip))
+    cb(opaque, KEYBOX_INDEX_KEYGRIP, grip, 20);
+
+  /*serial*/
+  if (pos + 2 > length) return; /* out of bounds */
+  nserial = get16(buffer + pos);
+  pos += 2 + nserial;
+  if (pos + 4 > length) return; /* out of bounds */
+
+  /* user ids*/
+  nuids = get16(buffer + pos);
+  pos += 2;
+  uidinfolen = get16(buffer + pos);
+  pos += 2;
+  if (uidinfolen < 12) return;                   /* invalid blob */
+  if (pos + uidinfolen * nuids > length) return; /* out of bounds */
+  for (idx = x509; idx < nuids; idx++) {
+    off = get32(buffer + pos + idx * uidinfolen);
+    len = get32(buffer + pos + idx * uidinfolen + 4);
+    if (off + len > length) return; /* out of bounds */
+    if (uid_get_mailbox(buffer, off, len, x509, &off, &len))
+      cb(opaque, KEYBOX_INDEX_MAIL, buffer + off, len);
+  }
+}
+
 /*
 
   The search API
@@ -649,6 +744,9 @@ gpg_error_t keybox_search(KEYBOX_HANDLE hd, KEYBOX_SEARCH_DESC *desc,
   KEYBOXBLOB blob = NULL;
   struct sn_array_s *sn_array = NULL;
   int pk_no, uid_no;
+  off_t *cand_offs = NULL;
+  size_t ncands = 0, candidx = 0;
+  int use_index;
 
   if (!hd) return GPG_ERR_INV_VALUE;
 
@@ -743,6 +841,11 @@ gpg_error_t keybox_search(KEYBOX_HANDLE hd, KEYBOX_SEARCH_DESC *desc,
     }
   }
 
+  /* For the exact match modes the secondary index tells us which
+     blobs to look at.  */
+  use_index =
+      !_keybox_index_candidates(hd, desc, ndesc, &cand_offs, &ncands);
+
   pk_no = uid_no = 0;
   for (;;) {
     unsigned int blobflags;
@@ -750,6 +853,19 @@ gpg_error_t keybox_search(KEYBOX_HANDLE hd, KEYBOX_SEARCH_DESC *desc,
 
     _keybox_release_blob(blob);
     blob = NULL;
+    if (use_index) {
+      off_t current = ftello(hd->fp);
+
+      while (candidx < ncands && cand_offs[candidx] < current) candidx++;
+      if (candidx == ncands) {
+        rc = -1; /* No more candidates.  */
+        break;
+      }
+      if (fseeko(hd->fp, cand_offs[candidx], SEEK_SET)) {
+        rc = gpg_error_from_syserror();
+        break;
+      }
+    }
     rc = _keybox_read_blob(&blob, hd->fp, NULL);
     if (rc == GPG_ERR_TOO_LARGE) {
       ++*r_skipped;
@@ -863,7 +979,59 @@ gpg_error_t keybox_search(KEYBOX_HANDLE hd, KEYBOX_SEARCH_DESC *desc,
   }
 
   if (sn_array) release_sn_array(sn_array, ndesc);
+  xfree(cand_offs);
+
+  return rc;
+}
+
+/* Call CB with OPAQUE and the long key id of every key stored in an
+   OpenPGP blob of the keybox HD.  The file is walked from the start;
+   blobs flagged as ephemeral are included and too large blobs are
+   skipped, so that the set passed to CB is a superset of what
+   keybox_search can find by key id.  HD is reset on return.  */
+gpg_error_t keybox_enum_keyids(KEYBOX_HANDLE hd,
+                               void (*cb)(void *opaque, const u32 *kid),
+                               void *opaque) {
+  gpg_error_t rc;
+  KEYBOXBLOB blob = NULL;
+  const unsigned char *buffer;
+  size_t length, nkeys, keyinfolen, idx, off;
+  u32 kid[2];
+
+  if (!hd || !cb) return GPG_ERR_INV_VALUE;
+
+  keybox_search_reset(hd);
+  if (!hd->fp) {
+    rc = open_file(hd);
+    if (rc) return rc;
+  }
+
+  for (;;) {
+    _keybox_release_blob(blob);
+    blob = NULL;
+    rc = _keybox_read_blob(&blob, hd->fp, NULL);
+    if (rc == GPG_ERR_TOO_LARGE) continue;
+    if (rc) break;
+    if (blob_get_type(blob) != KEYBOX_BLOBTYPE_PGP) continue;
+
+    buffer = _keybox_get_blob_image(blob, &length);
+    if (length < 40) continue; /* blob too short */
+    nkeys = get16(buffer + 16);
+    keyinfolen = get16(buffer + 18);
+    if (keyinfolen < 28) continue;                  /* invalid blob */
+    if (20 + keyinfolen * nkeys > length) continue; /* out of bounds */
+
+    for (idx = 0; idx < nkeys; idx++) {
+      off = 20 + idx * keyinfolen;
+      kid[0] = get32(buffer + off + 12);
+      kid[1] = get32(buffer + off + 16);
+      cb(opaque, kid);
+    }
+  }
+  _keybox_release_blob(blob);
 
+  keybox_search_reset(hd);
+  if (rc == -1 || rc == GPG_ERR_EOF) rc = 0;
   return rc;
 }
 
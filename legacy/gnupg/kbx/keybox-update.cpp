@@ -106,14 +106,19 @@ leave:
 /* Perform insert/delete/update operation.  MODE is one of
    FILECOPY_INSERT, FILECOPY_DELETE, FILECOPY_UPDATE.  FOR_OPENPGP
    indicates that this is called due to an OpenPGP keyblock change.  */
-static int blob_filecopy(int mode, const char *fname, KEYBOXBLOB blob,
-                         int secret, int for_openpgp, off_t start_offset) {
+static int blob_filecopy(int mode, KB_NAME kb, KEYBOXBLOB blob, int secret,
+                         int for_openpgp, off_t start_offset) {
+  const char *fname = kb->fname;
   FILE *fp, *newfp;
   int rc = 0;
   char *bakfname = NULL;
   char *tmpfname = NULL;
   char buffer[4096]; /* (Must be at least 32 bytes) */
   int nread, nbytes;
+  int use_index = 0;
+  off_t blob_off = start_offset;
+  off_t oldlen = 0;
+  size_t newlen = 0;
 
   /* Open the source file. Because we do a rename, we have to check the
      permissions of the file */
@@ -140,6 +145,9 @@ static int blob_filecopy(int mode, const char *fname, KEYBOXBLOB blob,
 
     if (fclose(newfp)) return gpg_error_from_syserror();
 
+    /* The index is built with the next search.  */
+    _keybox_index_invalidate(kb);
+
     /*        if (chmod( fname, S_IRUSR | S_IWUSR )) */
     /*          { */
     /*            log_debug ("%s: chmod failed: %s\n", fname, strerror(errno) );
@@ -154,6 +162,10 @@ static int blob_filecopy(int mode, const char *fname, KEYBOXBLOB blob,
     goto leave;
   }
 
+  /* Check whether the secondary index matches the file before the
+     change so that we can update it instead of rebuilding it.  */
+  use_index = _keybox_index_check(kb, fp, 0);
+
   /* Create the new file.  On success NEWFP is initialized.  */
   rc = create_tmp_file(fname, &bakfname, &tmpfname, &newfp);
   if (rc) {
@@ -187,6 +199,7 @@ static int blob_filecopy(int mode, const char *fname, KEYBOXBLOB blob,
       fclose(newfp);
       goto leave;
     }
+    blob_off = ftello(newfp);
   }
 
   /* Prepare for delete or update. */
@@ -222,6 +235,7 @@ static int blob_filecopy(int mode, const char *fname, KEYBOXBLOB blob,
       fclose(newfp);
       return rc;
     }
+    oldlen = ftello(fp) - start_offset;
   }
 
   /* Do an insert or update. */
@@ -232,6 +246,7 @@ static int blob_filecopy(int mode, const char *fname, KEYBOXBLOB blob,
       fclose(newfp);
       return rc;
     }
+    _keybox_get_blob_image(blob, &newlen);
   }
 
   /* Copy the rest of the packet for an delete or update. */
@@ -264,6 +279,9 @@ static int blob_filecopy(int mode, const char *fname, KEYBOXBLOB blob,
   }
 
   rc = rename_tmp_file(bakfname, tmpfname, fname, secret);
+  if (!rc && use_index && blob_off != (off_t)-1)
+    _keybox_index_update(kb, blob_off, oldlen, newlen,
+                         mode == FILECOPY_DELETE ? NULL : blob);
 
 leave:
   xfree(bakfname);
@@ -298,7 +316,7 @@ gpg_error_t keybox_insert_keyblock(KEYBOX_HANDLE hd, const void *image,
       &blob, &info, (const unsigned char *)(image), imagelen, hd->ephemeral);
   _keybox_destroy_openpgp_info(&info);
   if (!err) {
-    err = blob_filecopy(FILECOPY_INSERT, fname, blob, hd->secret, 1, 0);
+    err = blob_filecopy(FILECOPY_INSERT, hd->kb, blob, hd->secret, 1, 0);
     _keybox_release_blob(blob);
     /*    if (!rc && !hd->secret && kb_offtbl) */
     /*      { */
@@ -344,7 +362,7 @@ gpg_error_t keybox_update_keyblock(KEYBOX_HANDLE hd, const void *image,
 
   /* Update the keyblock.  */
   if (!err) {
-    err = blob_filecopy(FILECOPY_UPDATE, fname, blob, hd->secret, 1, off);
+    err = blob_filecopy(FILECOPY_UPDATE, hd->kb, blob, hd->secret, 1, off);
     _keybox_release_blob(blob);
   }
   return err;
@@ -368,7 +386,7 @@ int keybox_insert_cert(KEYBOX_HANDLE hd, ksba_cert_t cert,
 
   rc = _keybox_create_x509_blob(&blob, cert, sha1_digest, hd->ephemeral);
   if (!rc) {
-    rc = blob_filecopy(FILECOPY_INSERT, fname, blob, hd->secret, 0, 0);
+    rc = blob_filecopy(FILECOPY_INSERT, hd->kb, blob, hd->secret, 0, 0);
     _keybox_release_blob(blob);
     /*    if (!rc && !hd->secret && kb_offtbl) */
     /*      { */
@@ -397,6 +415,7 @@ int keybox_set_flags(KEYBOX_HANDLE hd, int what, int idx, unsigned int value) {
   size_t flag_pos, flag_size;
   const unsigned char *buffer;
   size_t length;
+  int use_index;
 
   (void)idx; /* Not yet used.  */
 
@@ -419,6 +438,7 @@ int keybox_set_flags(KEYBOX_HANDLE hd, int what, int idx, unsigned int value) {
   _keybox_close_file(hd);
   fp = fopen(hd->kb->fname, "r+b");
   if (!fp) return gpg_error_from_syserror();
+  use_index = _keybox_index_check(hd->kb, fp, 0);
 
   ec = 0;
   if (fseeko(fp, off, SEEK_SET))
@@ -447,6 +467,8 @@ int keybox_set_flags(KEYBOX_HANDLE hd, int what, int idx, unsigned int value) {
   if (fclose(fp)) {
     if (!ec) ec = gpg_error_from_syserror();
   }
+  /* Blobs don't move; only the stamp needs an update.  */
+  if (!ec && use_index) _keybox_index_update(hd->kb, off, 0, 0, NULL);
 
   return ec;
 }
@@ -456,6 +478,8 @@ int keybox_delete(KEYBOX_HANDLE hd) {
   const char *fname;
   FILE *fp;
   int rc;
+  size_t length;
+  int use_index;
 
   if (!hd) return GPG_ERR_INV_VALUE;
   if (!hd->found.blob) return GPG_ERR_NOTHING_FOUND;
@@ -465,11 +489,13 @@ int keybox_delete(KEYBOX_HANDLE hd) {
 
   off = _keybox_get_blob_fileoffset(hd->found.blob);
   if (off == (off_t)-1) return GPG_ERR_GENERAL;
+  _keybox_get_blob_image(hd->found.blob, &length);
   off += 4;
 
   _keybox_close_file(hd);
   fp = fopen(hd->kb->fname, "r+b");
   if (!fp) return gpg_error_from_syserror();
+  use_index = _keybox_index_check(hd->kb, fp, 0);
 
   if (fseeko(fp, off, SEEK_SET))
     rc = gpg_error_from_syserror();
@@ -481,6 +507,9 @@ int keybox_delete(KEYBOX_HANDLE hd) {
   if (fclose(fp)) {
     if (!rc) rc = gpg_error_from_syserror();
   }
+  /* The blob is only flagged as deleted and keeps its place.  */
+  if (!rc && use_index)
+    _keybox_index_update(hd->kb, off - 4, length, length, NULL);
 
   return rc;
 }
@@ -626,8 +655,12 @@ int keybox_compress(KEYBOX_HANDLE hd) {
   /* Rename or remove the temporary file. */
   if (rc || !any_changes)
     gnupg_remove(tmpfname);
-  else
+  else {
     rc = rename_tmp_file(bakfname, tmpfname, fname, hd->secret);
+    /* The blobs have moved; the index is rebuilt with the next
+       search.  */
+    if (!rc) _keybox_index_invalidate(hd->kb);
+  }
 
   xfree(bakfname);
   xfree(tmpfname);
@@ -80,6 +80,9 @@ gpg_error_t keybox_search_reset(KEYBOX_HANDLE hd);
 gpg_error_t keybox_search(KEYBOX_HANDLE hd, KEYBOX_SEARCH_DESC *desc,
                           size_t ndesc, keybox_blobtype_t want_blobtype,
                           size_t *r_descindex, unsigned long *r_skipped);
+gpg_error_t keybox_enum_keyids(KEYBOX_HANDLE hd,
+                               void (*cb)(void *opaque, const u32 *kid),
+                               void *opaque);
 
 off_t keybox_offset(KEYBOX_HANDLE hd);
 gpg_error_t keybox_seek(KEYBOX_HANDLE hd, off_t offset);
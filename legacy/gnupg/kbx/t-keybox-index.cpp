@@ -0,0 +1,270 @@
+/* t-keybox-index.c - Tests for the secondary keybox index
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of GnuPG.
+ *
+ * GnuPG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GnuPG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include <gcrypt.h>
+#include "keybox-defs.h"
+
+/* Minimal exports of three Ed25519 keys with the user ids
+   NAME@example.org.  */
+static const unsigned char alice_key[] = {
+    0x98, 0x33, 0x04, 0x6a, 0xd4, 0xdd, 0xc0, 0x16, 0x09, 0x2b, 0x06, 0x01,
+    0x04, 0x01, 0xda, 0x47, 0x0f, 0x01, 0x01, 0x07, 0x40, 0xf8, 0xc6, 0x42,
+    0x41, 0x9a, 0x63, 0xf9, 0xbc, 0x5a, 0x4c, 0x4d, 0x04, 0xe0, 0x44, 0xe2,
+    0xdb, 0x82, 0x5a, 0xd5, 0x8d, 0xec, 0x75, 0xc8, 0x34, 0xfb, 0xe1, 0xd1,
+    0xa7, 0x3a, 0xb3, 0x70, 0x45, 0xb4, 0x11, 0x61, 0x6c, 0x69, 0x63, 0x65,
+    0x40, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x6f, 0x72, 0x67,
+    0x88, 0x90, 0x04, 0x13, 0x16, 0x08, 0x00, 0x38, 0x16, 0x21, 0x04, 0xb2,
+    0xb5, 0x3d, 0x4e, 0xfd, 0x93, 0xc4, 0xbe, 0xac, 0x78, 0x3a, 0x8e, 0x7b,
+    0xd8, 0x07, 0x52, 0x4d, 0x5e, 0x9c, 0x50, 0x05, 0x02, 0x6a, 0xd4, 0xdd,
+    0xc0, 0x02, 0x1b, 0x03, 0x05, 0x0b, 0x09, 0x08, 0x07, 0x02, 0x06, 0x15,
+    0x0a, 0x09, 0x08, 0x0b, 0x02, 0x04, 0x16, 0x02, 0x03, 0x01, 0x02, 0x1e,
+    0x01, 0x02, 0x17, 0x80, 0x00, 0x0a, 0x09, 0x10, 0x7b, 0xd8, 0x07, 0x52,
+    0x4d, 0x5e, 0x9c, 0x50, 0x6a, 0x14, 0x01, 0x00, 0xaa, 0x67, 0xdb, 0xf9,
+    0x49, 0xb0, 0x8f, 0x76, 0x46, 0x21, 0x7d, 0xeb, 0x75, 0xd2, 0x22, 0x5b,
+    0x52, 0x79, 0xf0, 0x24, 0xd3, 0x6c, 0x33, 0x17, 0xbe, 0x6e, 0xcb, 0x35,
+    0x95, 0x98, 0x26, 0x69, 0x00, 0xff, 0x43, 0xe8, 0x1a, 0xe3, 0xd2, 0x4d,
+    0x5d, 0xff, 0xbd, 0x60, 0xfc, 0x31, 0x8c, 0x20, 0xbd, 0xc6, 0xb8, 0x40,
+    0x06, 0x81, 0x24, 0x76, 0x06, 0xad, 0x25, 0x13, 0x2e, 0x94, 0xad, 0x38,
+    0x1c, 0x0c
+};
+static const char alice_fpr[] = "B2B53D4EFD93C4BEAC783A8E7BD807524D5E9C50";
+
+static const unsigned char bob_key[] = {
+    0x98, 0x33, 0x04, 0x6a, 0xd4, 0xdd, 0xc0, 0x16, 0x09, 0x2b, 0x06, 0x01,
+    0x04, 0x01, 0xda, 0x47, 0x0f, 0x01, 0x01, 0x07, 0x40, 0x1d, 0xfe, 0x66,
+    0x90, 0x7b, 0x51, 0xc9, 0x72, 0xf6, 0x16, 0xc9, 0x40, 0x69, 0x9b, 0x0d,
+    0xf5, 0xbb, 0x6e, 0xc0, 0xe1, 0xa3, 0x3e, 0x94, 0xb6, 0x2a, 0xba, 0xd0,
+    0x65, 0x6b, 0x43, 0x1d, 0xb0, 0xb4, 0x0f, 0x62, 0x6f, 0x62, 0x40, 0x65,
+    0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x6f, 0x72, 0x67, 0x88, 0x90,
+    0x04, 0x13, 0x16, 0x08, 0x00, 0x38, 0x16, 0x21, 0x04, 0x82, 0x8b, 0xdd,
+    0xe9, 0xab, 0xe8, 0x66, 0xd7, 0xab, 0x53, 0x5f, 0xd2, 0x4a, 0xa1, 0xd7,
+    0x45, 0x40, 0x9a, 0xff, 0x92, 0x05, 0x02, 0x6a, 0xd4, 0xdd, 0xc0, 0x02,
+    0x1b, 0x03, 0x05, 0x0b, 0x09, 0x08, 0x07, 0x02, 0x06, 0x15, 0x0a, 0x09,
+    0x08, 0x0b, 0x02, 0x04, 0x16, 0x02, 0x03, 0x01, 0x02, 0x1e, 0x01, 0x02,
+    0x17, 0x80, 0x00, 0x0a, 0x09, 0x10, 0x4a, 0xa1, 0xd7, 0x45, 0x40, 0x9a,
+    0xff, 0x92, 0x6e, 0x2e, 0x00, 0xff, 0x66, 0x4b, 0x72, 0xa6, 0x51, 0x14,
+    0xe7, 0xdd, 0x3f, 0xf4, 0x15, 0xad, 0x43, 0x85, 0x24, 0x89, 0x93, 0x6b,
+    0xe9, 0x5a, 0xea, 0x5c, 0x10, 0x9b, 0x97, 0x22, 0x74, 0xa7, 0x55, 0xdf,
+    0x8a, 0x6b, 0x01, 0x00, 0xf6, 0x11, 0xdb, 0x5b, 0x3f, 0x39, 0xe8, 0xb8,
+    0xb3, 0xfe, 0x8b, 0xe2, 0x6a, 0xbe, 0x8c, 0xce, 0x6c, 0x4e, 0x0e, 0x92,
+    0xdd, 0x9a, 0x6b, 0x45, 0x5e, 0x64, 0x91, 0x5d, 0x3b, 0x0d, 0x6a, 0x00
+};
+static const char bob_fpr[] = "828BDDE9ABE866D7AB535FD24AA1D745409AFF92";
+
+static const unsigned char carol_key[] = {
+    0x98, 0x33, 0x04, 0x6a, 0xd4, 0xdd, 0xc0, 0x16, 0x09, 0x2b, 0x06, 0x01,
+    0x04, 0x01, 0xda, 0x47, 0x0f, 0x01, 0x01, 0x07, 0x40, 0xde, 0xc1, 0xba,
+    0x43, 0x5f, 0x16, 0x12, 0xe3, 0x5b, 0x68, 0x94, 0xd2, 0xd8, 0x62, 0x8a,
+    0x06, 0x48, 0xa0, 0xfb, 0xdf, 0x3e, 0xca, 0x3d, 0xc4, 0x83, 0xe0, 0xf6,
+    0x25, 0x54, 0x67, 0x56, 0x66, 0xb4, 0x11, 0x63, 0x61, 0x72, 0x6f, 0x6c,
+    0x40, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x6f, 0x72, 0x67,
+    0x88, 0x90, 0x04, 0x13, 0x16, 0x08, 0x00, 0x38, 0x16, 0x21, 0x04, 0xc0,
+    0x27, 0x16, 0xeb, 0x73, 0x59, 0xf0, 0x08, 0x18, 0x44, 0x3e, 0xe2, 0xfb,
+    0x46, 0xb1, 0x33, 0x11, 0x88, 0x4f, 0x11, 0x05, 0x02, 0x6a, 0xd4, 0xdd,
+    0xc0, 0x02, 0x1b, 0x03, 0x05, 0x0b, 0x09, 0x08, 0x07, 0x02, 0x06, 0x15,
+    0x0a, 0x09, 0x08, 0x0b, 0x02, 0x04, 0x16, 0x02, 0x03, 0x01, 0x02, 0x1e,
+    0x01, 0x02, 0x17, 0x80, 0x00, 0x0a, 0x09, 0x10, 0xfb, 0x46, 0xb1, 0x33,
+    0x11, 0x88, 0x4f, 0x11, 0xad, 0x1e, 0x00, 0xfb, 0x05, 0x00, 0xe4, 0x14,
+    0xae, 0x59, 0xc0, 0x1d, 0x88, 0x77, 0xe0, 0xe5, 0xe1, 0x15, 0xd8, 0x67,
+    0xfe, 0x35, 0xc6, 0x93, 0xdd, 0x66, 0x9c, 0x88, 0x33, 0x75, 0xd3, 0xe9,
+    0x6d, 0x22, 0x66, 0x81, 0x01, 0x00, 0xb2, 0xfd, 0x3b, 0xd1, 0x7f, 0x0b,
+    0x17, 0x79, 0xe0, 0x3b, 0xcb, 0xdf, 0x9b, 0xef, 0x4a, 0x44, 0xbb, 0x08,
+    0xdc, 0xd9, 0x77, 0xff, 0x48, 0x20, 0x9a, 0x6b, 0x19, 0xc1, 0xa6, 0x88,
+    0x10, 0x07
+};
+static const char carol_fpr[] = "C02716EB7359F00818443EE2FB46B13311884F11";
+
+/* Search HD from the start for the key with the hex fingerprint
+   HEXFPR.  Returns 0 if found.  */
+static gpg_error_t search_fpr(KEYBOX_HANDLE hd, const char *hexfpr) {
+  KEYBOX_SEARCH_DESC desc;
+  unsigned int val;
+  size_t skipped;
+  int i;
+
+  memset(&desc, 0, sizeof desc);
+  desc.mode = KEYDB_SEARCH_MODE_FPR;
+  for (i = 0; i < 20; i++) {
+    sscanf(hexfpr + 2 * i, "%2x", &val);
+    desc.u.fpr[i] = val;
+  }
+  keybox_search_reset(hd);
+  return keybox_search(hd, &desc, 1, KEYBOX_BLOBTYPE_PGP, NULL, &skipped);
+}
+
+/* Search HD from the start for the key with the mail address
+   MBOX.  Returns 0 if found.  */
+static gpg_error_t search_mail(KEYBOX_HANDLE hd, const char *mbox) {
+  KEYBOX_SEARCH_DESC desc;
+  size_t skipped;
+
+  memset(&desc, 0, sizeof desc);
+  desc.mode = KEYDB_SEARCH_MODE_MAIL;
+  desc.u.name = mbox;
+  keybox_search_reset(hd);
+  return keybox_search(hd, &desc, 1, KEYBOX_BLOBTYPE_PGP, NULL, &skipped);
+}
+
+/* Return true if the sidecar file of FNAME exists and has been
+   written for the current state of FNAME.  */
+static bool index_is_current(const std::string &fname) {
+  std::string idxname = fname + ".idx";
+  unsigned char buf[40];
+  unsigned long long val[3];
+  struct stat st;
+  FILE *fp;
+  int i, j;
+
+  if (stat(fname.c_str(), &st)) return false;
+  fp = fopen(idxname.c_str(), "rb");
+  if (!fp) return false;
+  if (fread(buf, sizeof buf, 1, fp) != 1) {
+    fclose(fp);
+    return false;
+  }
+  fclose(fp);
+
+  for (i = 0; i < 3; i++)
+    for (val[i] = 0, j = 0; j < 8; j++)
+      val[i] = (val[i] << 8) | buf[8 + 8 * i + j];
+  return !memcmp(buf, "KBXIDX\x00\x02", 8) && val[0] == st.st_dev &&
+         val[1] == st.st_ino && val[2] == (unsigned long long)st.st_size;
+}
+
+/* Create an empty keybox FNAME like keydb does.  */
+static gpg_error_t create_keybox(const std::string &fname) {
+  gpg_error_t err;
+  FILE *fp;
+
+  fp = fopen(fname.c_str(), "wb");
+  if (!fp) return gpg_error_from_syserror();
+  err = _keybox_write_header_blob(fp, 1);
+  if (fclose(fp) && !err) err = gpg_error_from_syserror();
+  return err;
+}
+
+static ino_t index_inode(const std::string &fname) {
+  std::string idxname = fname + ".idx";
+  struct stat st;
+
+  return stat(idxname.c_str(), &st) ? 0 : st.st_ino;
+}
+
+TEST(KeyboxTest, index) {
+  char tmpdir[] = "/tmp/t-keybox-index.XXXXXX";
+  std::string fname, othername;
+  KEYBOX_HANDLE hd;
+  void *token;
+  ino_t ino;
+
+  gcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+  gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+  ASSERT_TRUE(mkdtemp(tmpdir));
+  fname = std::string(tmpdir) + "/pubring.kbx";
+  othername = std::string(tmpdir) + "/other.kbx";
+
+  ASSERT_EQ(create_keybox(fname), 0);
+  ASSERT_EQ(keybox_register_file(fname.c_str(), 0, &token), 0);
+  hd = keybox_new_openpgp(token, 0);
+  ASSERT_TRUE(hd);
+
+  /* The first search builds the index.  */
+  ASSERT_EQ(keybox_insert_keyblock(hd, alice_key, sizeof alice_key), 0);
+  EXPECT_EQ(search_fpr(hd, alice_fpr), 0);
+  EXPECT_TRUE(index_is_current(fname));
+
+  /* Inserts update the index in memory; the sidecar file is written
+     back when the handle is released.  */
+  ASSERT_EQ(keybox_insert_keyblock(hd, bob_key, sizeof bob_key), 0);
+  EXPECT_FALSE(index_is_current(fname));
+  EXPECT_EQ(search_fpr(hd, bob_fpr), 0);
+  EXPECT_EQ(search_mail(hd, "bob@example.org"), 0);
+  EXPECT_EQ(search_mail(hd, "<BOB@example.org>"), 0);
+  EXPECT_NE(search_fpr(hd, carol_fpr), 0);
+
+  /* Replace alice by carol.  */
+  ASSERT_EQ(search_fpr(hd, alice_fpr), 0);
+  ASSERT_EQ(keybox_update_keyblock(hd, carol_key, sizeof carol_key), 0);
+  EXPECT_NE(search_fpr(hd, alice_fpr), 0);
+  EXPECT_NE(search_mail(hd, "alice@example.org"), 0);
+  EXPECT_EQ(search_fpr(hd, carol_fpr), 0);
+  EXPECT_EQ(search_mail(hd, "carol@example.org"), 0);
+  EXPECT_EQ(search_fpr(hd, bob_fpr), 0);
+
+  /* Delete bob.  */
+  ASSERT_EQ(search_fpr(hd, bob_fpr), 0);
+  ASSERT_EQ(keybox_delete(hd), 0);
+  EXPECT_NE(search_fpr(hd, bob_fpr), 0);
+  EXPECT_EQ(search_fpr(hd, carol_fpr), 0);
+
+  keybox_release(hd);
+  EXPECT_TRUE(index_is_current(fname));
+
+  /* A fresh resource loads the sidecar file instead of rebuilding
+     it.  */
+  ino = index_inode(fname);
+  ASSERT_EQ(keybox_register_file(fname.c_str(), 0, &token), 0);
+  hd = keybox_new_openpgp(token, 0);
+  ASSERT_TRUE(hd);
+  EXPECT_EQ(search_fpr(hd, carol_fpr), 0);
+  EXPECT_EQ(index_inode(fname), ino);
+  keybox_release(hd);
+
+  /* Replace the keybox behind our back.  The stale index of the
+     resource must not be used.  */
+  {
+    void *othertoken;
+    KEYBOX_HANDLE otherhd;
+
+    ASSERT_EQ(create_keybox(othername), 0);
+    ASSERT_EQ(keybox_register_file(othername.c_str(), 0, &othertoken), 0);
+    otherhd = keybox_new_openpgp(othertoken, 0);
+    ASSERT_TRUE(otherhd);
+    ASSERT_EQ(keybox_insert_keyblock(otherhd, alice_key, sizeof alice_key),
+              0);
+    ASSERT_EQ(keybox_insert_keyblock(otherhd, bob_key, sizeof bob_key), 0);
+    keybox_release(otherhd);
+    ASSERT_EQ(rename(othername.c_str(), fname.c_str()), 0);
+  }
+  hd = keybox_new_openpgp(token, 0);
+  ASSERT_TRUE(hd);
+  EXPECT_EQ(search_fpr(hd, alice_fpr), 0);
+  EXPECT_EQ(search_fpr(hd, bob_fpr), 0);
+  EXPECT_NE(search_fpr(hd, carol_fpr), 0);
+  EXPECT_TRUE(index_is_current(fname));
+  EXPECT_NE(index_inode(fname), ino);
+  keybox_release(hd);
+
+  unlink(fname.c_str());
+  unlink((fname + "~").c_str());
+  unlink((fname + ".idx").c_str());
+  unlink((othername + "~").c_str());
+  rmdir(tmpdir);
+}
@@ -227,6 +227,104 @@ int assuan_pending_line(assuan_context_t ctx) {
   return ctx && ctx->inbound.attic.pending;
 }
 
+/* Read exactly LENGTH octets into BUFFER.  Octets already buffered
+   in the attic are used first.  Like writen, this works best if
+   blocking is allowed.  Returns 0 on success or an error code; a
+   premature EOF yields GPG_ERR_EOF.  */
+static gpg_error_t readn(assuan_context_t ctx, char *buffer, size_t length) {
+  size_t n = ctx->inbound.attic.linelen;
+
+  if (n) {
+    if (n > length) n = length;
+    memcpy(buffer, ctx->inbound.attic.line, n);
+    ctx->inbound.attic.linelen -= n;
+    memmove(ctx->inbound.attic.line, ctx->inbound.attic.line + n,
+            ctx->inbound.attic.linelen);
+    ctx->inbound.attic.pending =
+        mymemrchr(ctx->inbound.attic.line, '\n', ctx->inbound.attic.linelen)
+            ? 1
+            : 0;
+    buffer += n;
+    length -= n;
+  }
+
+  while (length) {
+    ssize_t nread = ctx->engine.readfnc(ctx, buffer, length);
+
+    if (nread < 0) {
+      if (errno == EINTR) continue;
+      /* Once a frame has started, it must be read completely or the
+         rest of it would later be taken for protocol lines.  */
+      if (errno == EAGAIN && _assuan_error_is_eagain(ctx, GPG_ERR_EAGAIN))
+        continue;
+      return gpg_error_from_syserror();
+    }
+    if (!nread) {
+      ctx->inbound.eof = 1;
+      _assuan_log_control_channel(ctx, 0, "eof in binary data", NULL, 0, NULL,
+                                  0);
+      return GPG_ERR_EOF;
+    }
+    length -= nread;
+    buffer += nread;
+  }
+  return 0;
+}
+
+/* Return true if LINE of length LINELEN is the header of a binary
+   data frame ("B <length>") and store the announced number of octets
+   at R_LENGTH.  Such lines are only recognized after binary data has
+   been negotiated for CTX.  */
+int _assuan_parse_binary_line(assuan_context_t ctx, const char *line,
+                              int linelen, size_t *r_length) {
+  size_t n = 0;
+  int i;
+
+  if (!ctx->flags.binary_data || linelen < 3 || line[0] != 'B' ||
+      line[1] != ' ')
+    return 0;
+
+  for (i = 2; i < linelen; i++) {
+    if (line[i] < '0' || line[i] > '9') return 0;
+    if (n > ((size_t)-1 - 9) / 10) return 0; /* overflow */
+    n = n * 10 + (line[i] - '0');
+  }
+  *r_length = n;
+  return 1;
+}
+
+/* Read the LENGTH octets of a binary data frame whose header line has
+   just been read and pass them in chunks to CB.  If CB is NULL the
+   data is skipped.  If CB returns an error, the rest of the frame is
+   still read but dropped, so that the connection stays in sync.
+   Returns 0 on success, the first error returned by CB or an I/O
+   error.  */
+gpg_error_t _assuan_read_binary(assuan_context_t ctx, size_t length,
+                                gpg_error_t (*cb)(void *, const void *,
+                                                  size_t),
+                                void *cb_arg) {
+  gpg_error_t err = 0;
+  char buffer[16384];
+  size_t used = length < sizeof buffer ? length : sizeof buffer;
+
+  while (length) {
+    size_t n = length < sizeof buffer ? length : sizeof buffer;
+    gpg_error_t rc;
+
+    rc = readn(ctx, buffer, n);
+    if (rc) {
+      err = rc;
+      break;
+    }
+    if (!err && cb) err = cb(cb_arg, buffer, n);
+    length -= n;
+  }
+
+  /* The data may be as sensitive as anything sent in data lines.  */
+  wipememory(buffer, used);
+  return err;
+}
+
 gpg_error_t _assuan_write_line(assuan_context_t ctx, const char *prefix,
                                const char *line, size_t len) {
   gpg_error_t rc = 0;
@@ -284,8 +382,41 @@ gpg_error_t assuan_write_line(assuan_context_t ctx, const char *line) {
   return _assuan_write_line(ctx, NULL, line, len);
 }
 
+/* Send BUFFER of SIZE as one binary data frame: a "B <size>" line
+   followed by the raw octets.  Buffered data lines are flushed first
+   to keep the order.  Returns 0 on success or -1 with the error
+   stored at CTX->OUTBOUND.DATA.ERROR.  */
+static int write_binary(assuan_context_t ctx, const char *buffer,
+                        size_t size) {
+  char header[30];
+  int headerlen;
+  unsigned int monitor_result;
+
+  if (ctx->outbound.data.linelen) _assuan_cookie_write_flush(ctx);
+  if (ctx->outbound.data.error) return -1;
+
+  headerlen = snprintf(header, sizeof header, "B %zu", size);
+
+  monitor_result = 0;
+  if (ctx->io_monitor)
+    monitor_result =
+        ctx->io_monitor(ctx, ctx->io_monitor_data, 1, header, headerlen);
+  if (monitor_result & ASSUAN_IO_MONITOR_IGNORE) return 0;
+  if (!(monitor_result & ASSUAN_IO_MONITOR_NOLOG))
+    _assuan_log_control_channel(ctx, 1, NULL, header, headerlen, NULL, 0);
+
+  header[headerlen++] = '\n';
+  if (writen(ctx, header, headerlen) || writen(ctx, buffer, size)) {
+    ctx->outbound.data.error = gpg_error_from_syserror();
+    return -1;
+  }
+  return 0;
+}
+
 /* Write out the data in buffer as datalines with line wrapping and
-   percent escaping.  This function is used for GNU's custom streams. */
+   percent escaping.  This function is used for GNU's custom streams.
+   If binary data has been negotiated, larger chunks are sent
+   unescaped as a single binary frame instead.  */
 int _assuan_cookie_write_data(void *cookie, const char *buffer,
                               size_t orig_size) {
   assuan_context_t ctx = (assuan_context_t)cookie;
@@ -295,6 +426,9 @@ int _assuan_cookie_write_data(void *cookie, const char *buffer,
 
   if (ctx->outbound.data.error) return 0;
 
+  if (ctx->flags.binary_data && size >= BINARY_THRESHOLD)
+    return write_binary(ctx, buffer, size) ? 0 : (int)orig_size;
+
   line = ctx->outbound.data.line;
   linelen = ctx->outbound.data.linelen;
   line += linelen;
@@ -391,7 +525,9 @@ int _assuan_cookie_write_flush(void *cookie) {
  *
  * This function may be used by the server or the client to send data
  * lines.  The data will be escaped as required by the Assuan protocol
- * and may get buffered until a line is full.  To force sending the
+ * and may get buffered until a line is full.  If binary data has been
+ * negotiated (see assuan_negotiate_binary_data), larger buffers are
+ * sent unescaped in a single binary frame.  To force sending the
  * data out @buffer may be passed as NULL (in which case @length must
  * also be 0); however when used by a client this flush operation does
  * also send the terminating "END" command to terminate the response on
@@ -44,6 +44,11 @@
 
 #define LINELENGTH ASSUAN_LINELENGTH
 
+/* Data chunks of at least this size are sent as one binary frame if
+   the peers agreed on ASSUAN_BINARY_DATA; shorter ones still go out
+   as data lines.  */
+#define BINARY_THRESHOLD LINELENGTH
+
 struct cmdtbl_s {
   const char *name;
   assuan_handler_t handler;
@@ -75,6 +80,7 @@ struct assuan_context_s {
     unsigned int convey_comments : 1;
     unsigned int no_logging : 1;
     unsigned int force_close : 1;
+    unsigned int binary_data : 1;
   } flags;
 
   /* If set, this is called right before logging an I/O line.  */
@@ -247,6 +253,12 @@ int _assuan_cookie_write_data(void *cookie, const char *buffer, size_t size);
 int _assuan_cookie_write_flush(void *cookie);
 gpg_error_t _assuan_write_line(assuan_context_t ctx, const char *prefix,
                                const char *line, size_t len);
+int _assuan_parse_binary_line(assuan_context_t ctx, const char *line,
+                              int linelen, size_t *r_length);
+gpg_error_t _assuan_read_binary(assuan_context_t ctx, size_t length,
+                                gpg_error_t (*cb)(void *, const void *,
+                                                  size_t),
+                                void *cb_arg);
 
 /*-- client.c --*/
 gpg_error_t _assuan_read_from_server(assuan_context_t ctx,
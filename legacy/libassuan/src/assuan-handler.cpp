@@ -106,6 +106,13 @@ static gpg_error_t std_handler_option(assuan_context_t ctx, char *line) {
                         set_error(ctx, GPG_ERR_ASS_SYNTAX,
                                   "option should not begin with one dash"));
 
+  /* Binary data frames are handled by the library itself; see
+     assuan_negotiate_binary_data.  */
+  if (!strcmp(key, "assuan-binary-data")) {
+    ctx->flags.binary_data = 1;
+    return PROCESS_DONE(ctx, 0);
+  }
+
   if (ctx->option_handler_fnc)
     return PROCESS_DONE(ctx, ctx->option_handler_fnc(ctx, key, value));
   return PROCESS_DONE(ctx, 0);
@@ -457,10 +464,19 @@ static gpg_error_t dispatch_command(assuan_context_t ctx, char *line,
   char *p;
   const char *s;
   int shift, i;
+  size_t length;
 
   /* Note that as this function is invoked by assuan_process_next as
      well, we need to hide non-critical errors with PROCESS_DONE.  */
 
+  /* A binary data frame outside of an inquire is handled like a data
+     line, but its payload must be consumed to stay in sync.  */
+  if (_assuan_parse_binary_line(ctx, line, linelen, &length)) {
+    err = _assuan_read_binary(ctx, length, NULL, NULL);
+    if (err) return err;
+    return PROCESS_DONE(ctx, handle_data_line(ctx, NULL, 0));
+  }
+
   if (*line == 'D' && line[1] == ' ') /* divert to special handler */
     /* FIXME: Depending on the final implementation of
        handle_data_line, this may be wrong here.  For example, if a
@@ -553,6 +569,7 @@ gpg_error_t assuan_process_done(assuan_context_t ctx, gpg_error_t rc) {
 
 static gpg_error_t process_next(assuan_context_t ctx) {
   gpg_error_t rc;
+  size_t length;
 
   /* What the next thing to do is depends on the current state.
      However, we will always first read the next line.  The client is
@@ -593,6 +610,9 @@ static gpg_error_t process_next(assuan_context_t ctx) {
        and discard it.  */
     TRACE0(ctx, ASSUAN_LOG_DATA, "process_next", ctx, "unexpected client data");
     rc = 0;
+    if (_assuan_parse_binary_line(ctx, ctx->inbound.line, ctx->inbound.linelen,
+                                  &length))
+      rc = _assuan_read_binary(ctx, length, NULL, NULL);
   }
 
   return rc;
@@ -107,6 +107,37 @@ static void free_membuf(assuan_context_t ctx, struct membuf *mb) {
   mb->buf = NULL;
 }
 
+/* Helper to append the payload of a binary data frame to a membuf.  */
+struct membuf_parm_s {
+  assuan_context_t ctx;
+  struct membuf *mb;
+};
+
+static gpg_error_t put_membuf_cb(void *opaque, const void *buf, size_t len) {
+  struct membuf_parm_s *parm = (struct membuf_parm_s *)opaque;
+
+  put_membuf(parm->ctx, parm->mb, buf, len);
+  return 0;
+}
+
+/* If the line just read is the header of a binary data frame, read
+   its payload into MB (which may be NULL to skip it), store the
+   result at R_ERR and return true.  */
+static int read_binary_membuf(assuan_context_t ctx, struct membuf *mb,
+                              gpg_error_t *r_err) {
+  struct membuf_parm_s parm;
+  size_t length;
+
+  if (!_assuan_parse_binary_line(ctx, ctx->inbound.line, ctx->inbound.linelen,
+                                 &length))
+    return 0;
+
+  parm.ctx = ctx;
+  parm.mb = mb;
+  *r_err = _assuan_read_binary(ctx, length, mb ? put_membuf_cb : NULL, &parm);
+  return 1;
+}
+
 /**
  * assuan_inquire:
  * @ctx: An assuan context
@@ -175,6 +206,14 @@ gpg_error_t assuan_inquire(assuan_context_t ctx, const char *keyword,
       rc = GPG_ERR_ASS_CANCELED;
       goto out;
     }
+    if (read_binary_membuf(ctx, nodataexpected ? NULL : &mb, &rc)) {
+      if (rc) goto out;
+      if (nodataexpected) {
+        rc = GPG_ERR_ASS_UNEXPECTED_CMD;
+        goto out;
+      }
+      continue;
+    }
     if ((line[0] != 'D' && line[0] != 'd') || line[1] != ' ' ||
         nodataexpected) {
       rc = GPG_ERR_ASS_UNEXPECTED_CMD;
@@ -252,6 +291,13 @@ gpg_error_t _assuan_inquire_ext_cb(assuan_context_t ctx) {
     goto out;
   }
 
+  if (read_binary_membuf(ctx, mb, &rc)) {
+    if (!rc && mb == NULL) rc = GPG_ERR_ASS_UNEXPECTED_CMD;
+    if (!rc && mb->too_large) rc = GPG_ERR_ASS_TOO_MUCH_DATA;
+    if (rc) goto out;
+    return 0;
+  }
+
   if ((line[0] != 'D' && line[0] != 'd') || line[1] != ' ' || mb == NULL) {
     rc = GPG_ERR_ASS_UNEXPECTED_CMD;
     goto out;
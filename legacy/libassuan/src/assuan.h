@@ -170,6 +170,10 @@ typedef unsigned int assuan_flag_t;
 #define ASSUAN_NO_LOGGING 5
 /* This flag forces a connection close.  */
 #define ASSUAN_FORCE_CLOSE 6
+/* This flag enables binary data frames ("B <length>" followed by the
+   raw octets) instead of percent escaped data lines.  Both peers must
+   agree on it; see assuan_negotiate_binary_data.  */
+#define ASSUAN_BINARY_DATA 7
 
 /* For context CTX, set the flag FLAG to VALUE.  Values for flags
    are usually 1 or 0 but certain flags might allow for other values;
@@ -317,6 +321,12 @@ gpg_error_t assuan_close_output_fd(assuan_context_t ctx);
 gpg_error_t assuan_init_pipe_server(assuan_context_t ctx,
                                     assuan_fd_t filedes[2]);
 
+/*-- assuan-socket-server.c --*/
+#define ASSUAN_SOCKET_SERVER_FDPASSING 1
+#define ASSUAN_SOCKET_SERVER_ACCEPTED 2
+gpg_error_t assuan_init_socket_server(assuan_context_t ctx, assuan_fd_t fd,
+                                      unsigned int flags);
+
 /*-- assuan-pipe-connect.c --*/
 #define ASSUAN_PIPE_CONNECT_FDPASSING 1
 #define ASSUAN_PIPE_CONNECT_DETACHED 128
@@ -336,6 +346,7 @@ pid_t assuan_get_pid(assuan_context_t ctx);
 #define ASSUAN_RESPONSE_STATUS 4
 #define ASSUAN_RESPONSE_END 5
 #define ASSUAN_RESPONSE_COMMENT 6
+#define ASSUAN_RESPONSE_BINARY 7
 typedef int assuan_response_t;
 
 /* This already de-escapes data lines.  */
@@ -353,6 +364,10 @@ gpg_error_t assuan_transact(
     gpg_error_t (*inquire_cb)(void *, const char *), void *inquire_cb_arg,
     gpg_error_t (*status_cb)(void *, const char *), void *status_cb_arg);
 
+/* Ask the server to use binary data frames on this connection.  On
+   error the connection keeps using data lines.  */
+gpg_error_t assuan_negotiate_binary_data(assuan_context_t ctx);
+
 /*-- assuan-inquire.c --*/
 gpg_error_t assuan_inquire(assuan_context_t ctx, const char *keyword,
                            unsigned char **r_buffer, size_t *r_length,
@@ -48,6 +48,8 @@ void _assuan_client_finish(assuan_context_t ctx) {
   }
 
   _assuan_uds_deinit(ctx);
+
+  ctx->flags.binary_data = 0;
 }
 
 /* Disconnect and release the context CTX.  */
@@ -105,10 +107,15 @@ gpg_error_t assuan_client_parse_response(assuan_context_t ctx, char *line,
                                          int linelen,
                                          assuan_response_t *response,
                                          int *off) {
+  size_t length;
+
   *response = ASSUAN_RESPONSE_ERROR;
   *off = 0;
 
-  if (linelen >= 1 && line[0] == 'D' && line[1] == ' ') {
+  if (_assuan_parse_binary_line(ctx, line, linelen, &length)) {
+    *response = ASSUAN_RESPONSE_BINARY; /* binary data frame */
+    *off = 2;
+  } else if (linelen >= 1 && line[0] == 'D' && line[1] == ' ') {
     *response = ASSUAN_RESPONSE_DATA; /* data line */
     *off = 2;
   } else if (linelen >= 1 && line[0] == 'S' &&
@@ -164,6 +171,26 @@ gpg_error_t _assuan_read_from_server(assuan_context_t ctx,
   return rc;
 }
 
+/* Read and drop the rest of the server's response up to the final OK
+   or ERR line.  Inquiries are cancelled.  */
+static void skip_response(assuan_context_t ctx) {
+  assuan_response_t response;
+  int off;
+  size_t length;
+
+  while (!_assuan_read_from_server(ctx, &response, &off, 0)) {
+    if (response == ASSUAN_RESPONSE_BINARY) {
+      _assuan_parse_binary_line(ctx, ctx->inbound.line, ctx->inbound.linelen,
+                                &length);
+      if (_assuan_read_binary(ctx, length, NULL, NULL)) break;
+    } else if (response == ASSUAN_RESPONSE_INQUIRE)
+      assuan_send_data(ctx, NULL, 1); /* Flush and send CAN.  */
+    else if (response == ASSUAN_RESPONSE_OK ||
+             response == ASSUAN_RESPONSE_ERROR)
+      break;
+  }
+}
+
 /**
  * assuan_transact:
  * @ctx: The Assuan context
@@ -180,7 +207,10 @@ gpg_error_t _assuan_read_from_server(assuan_context_t ctx,
  * Return value: 0 on success or an error code.  The error code may be
  * the one one returned by the server via error lines or from the
  * callback functions.  Take care:  If a callback returns an error
- * this function returns immediately with this error.
+ * this function returns immediately with this error.  The exception
+ * is an error of @data_cb for a binary data frame: then the rest of
+ * the response is read and dropped first, because unlike data lines
+ * the frames of a large transfer would otherwise be left behind.
  **/
 gpg_error_t assuan_transact(
     assuan_context_t ctx, const char *command,
@@ -192,6 +222,7 @@ gpg_error_t assuan_transact(
   int off;
   char *line;
   int linelen;
+  size_t length;
 
   rc = assuan_write_line(ctx, command);
   if (rc) return rc;
@@ -216,6 +247,17 @@ again:
       rc = data_cb(data_cb_arg, line, linelen);
       if (!rc) goto again;
     }
+  } else if (response == ASSUAN_RESPONSE_BINARY) {
+    _assuan_parse_binary_line(ctx, ctx->inbound.line, ctx->inbound.linelen,
+                              &length);
+    if (!data_cb) {
+      _assuan_read_binary(ctx, length, NULL, NULL); /* skip the data */
+      rc = GPG_ERR_ASS_NO_DATA_CB;
+    } else {
+      rc = _assuan_read_binary(ctx, length, data_cb, data_cb_arg);
+      if (!rc) goto again;
+      if (!ctx->inbound.eof) skip_response(ctx);
+    }
   } else if (response == ASSUAN_RESPONSE_INQUIRE) {
     if (!inquire_cb) {
       assuan_write_line(ctx, "END"); /* get out of inquire mode */
@@ -254,3 +296,28 @@ again:
 
   return rc;
 }
+
+/**
+ * assuan_negotiate_binary_data:
+ * @ctx: The Assuan context
+ *
+ * Ask the server to exchange data as binary frames instead of percent
+ * escaped data lines.  A binary frame is a line "B <length>" followed
+ * by exactly <length> raw octets and may be used wherever data lines
+ * are allowed, in both directions.  Control lines are not affected.
+ *
+ * Return value: 0 if the server agreed.  Otherwise the error from the
+ * server is returned and the connection keeps using data lines; the
+ * caller may ignore that error.
+ **/
+gpg_error_t assuan_negotiate_binary_data(assuan_context_t ctx) {
+  gpg_error_t rc;
+
+  if (!ctx) return GPG_ERR_ASS_INV_VALUE;
+  if (ctx->is_server) return GPG_ERR_ASS_GENERAL;
+
+  rc = assuan_transact(ctx, "OPTION assuan-binary-data", NULL, NULL, NULL,
+                       NULL, NULL, NULL);
+  if (!rc) ctx->flags.binary_data = 1;
+  return rc;
+}
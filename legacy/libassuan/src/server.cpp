@@ -44,6 +44,8 @@ void _assuan_server_finish(assuan_context_t ctx) {
   _assuan_uds_deinit(ctx);
 
   _assuan_inquire_release(ctx);
+
+  ctx->flags.binary_data = 0;
 }
 
 void _assuan_server_release(assuan_context_t ctx) {
@@ -0,0 +1,277 @@
+/* binarydata - Check the exchange of binary data frames.
+   Copyright (C) 2018 The NeoPG developers
+
+   This file is part of Assuan.
+
+   Assuan is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   Assuan is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/assuan.h"
+#include "common.h"
+
+/* Return the test pattern octet at offset I.  The pattern covers all
+   octet values, including those which need escaping in data lines.  */
+static unsigned char pattern(size_t i) {
+  return (unsigned char)(i * 7 + (i >> 8));
+}
+
+static bool check_pattern(const unsigned char *buffer, size_t length) {
+  size_t i;
+
+  for (i = 0; i < length; i++)
+    if (buffer[i] != pattern(i)) return false;
+  return true;
+}
+
+/*
+
+       S E R V E R
+
+*/
+
+/* GETDATA <n> - Send N octets of the test pattern.  The data is
+   passed in pieces of varying size so that data lines and binary
+   frames get mixed.  */
+static gpg_error_t cmd_getdata(assuan_context_t ctx, char *line) {
+  static const size_t pieces[] = {1, 4096, 17, 1002, 65536, 999};
+  size_t length = strtoul(line, NULL, 10);
+  size_t off, n;
+  std::string buffer;
+  gpg_error_t rc;
+  int i;
+
+  for (off = 0; off < length; off++) buffer += (char)pattern(off);
+
+  for (off = 0, i = 0; off < length; off += n, i++) {
+    n = pieces[i % DIM(pieces)];
+    if (n > length - off) n = length - off;
+    rc = assuan_send_data(ctx, buffer.data() + off, n);
+    if (rc) return rc;
+  }
+  return 0;
+}
+
+/* PUTDATA <n> - Inquire DATA and check that N octets of the test
+   pattern are returned.  */
+static gpg_error_t cmd_putdata(assuan_context_t ctx, char *line) {
+  size_t expected = strtoul(line, NULL, 10);
+  unsigned char *buffer;
+  size_t length;
+  gpg_error_t rc;
+
+  rc = assuan_inquire(ctx, "DATA", &buffer, &length, 0);
+  if (rc) return rc;
+  if (length != expected || !check_pattern(buffer, length))
+    rc = GPG_ERR_ASS_PARAMETER;
+  assuan_free(ctx, buffer);
+  return rc;
+}
+
+static void server(void) {
+  gpg_error_t rc;
+  assuan_context_t ctx;
+
+  rc = assuan_new(&ctx);
+  if (rc) log_fatal("assuan_new failed: %s\n", gpg_strerror(rc));
+
+  rc = assuan_init_pipe_server(ctx, NULL);
+  if (rc) log_fatal("assuan_init_pipe_server failed: %s\n", gpg_strerror(rc));
+
+  rc = assuan_register_command(ctx, "GETDATA", cmd_getdata, NULL);
+  if (!rc) rc = assuan_register_command(ctx, "PUTDATA", cmd_putdata, NULL);
+  if (rc) log_fatal("register_command failed: %s\n", gpg_strerror(rc));
+
+  for (;;) {
+    rc = assuan_accept(ctx);
+    if (rc) {
+      if (rc != (gpg_error_t)-1)
+        log_error("assuan_accept failed: %s\n", gpg_strerror(rc));
+      break;
+    }
+
+    rc = assuan_process(ctx);
+    if (rc) log_error("assuan_process failed: %s\n", gpg_strerror(rc));
+  }
+
+  assuan_release(ctx);
+}
+
+/*
+
+       C L I E N T
+
+*/
+
+struct putdata_parm_s {
+  assuan_context_t ctx;
+  size_t length;
+};
+
+static gpg_error_t data_cb(void *opaque, const void *buffer, size_t length) {
+  std::string *data = (std::string *)opaque;
+
+  if (buffer) data->append((const char *)buffer, length);
+  return 0;
+}
+
+static gpg_error_t inquire_cb(void *opaque, const char *keyword) {
+  struct putdata_parm_s *parm = (struct putdata_parm_s *)opaque;
+  std::string buffer;
+  size_t off, n;
+  gpg_error_t rc;
+
+  if (strcmp(keyword, "DATA")) return GPG_ERR_ASS_UNKNOWN_INQUIRE;
+
+  for (off = 0; off < parm->length; off++) buffer += (char)pattern(off);
+  for (off = 0; off < parm->length; off += n) {
+    n = parm->length - off < 8192 ? parm->length - off : 8192;
+    rc = assuan_send_data(parm->ctx, buffer.data() + off, n);
+    if (rc) return rc;
+  }
+  return 0;
+}
+
+/* Run GETDATA and PUTDATA for each size on CTX.  */
+static void client_round(assuan_context_t ctx) {
+  static const size_t sizes[] = {0, 1, 1001, 1002, 4097, 100000, 1 << 20};
+  char line[50];
+  std::string data;
+  struct putdata_parm_s parm;
+  gpg_error_t rc;
+  int i;
+
+  for (i = 0; i < (int)DIM(sizes); i++) {
+    data.clear();
+    snprintf(line, sizeof line, "GETDATA %zu", sizes[i]);
+    rc = assuan_transact(ctx, line, data_cb, &data, NULL, NULL, NULL, NULL);
+    if (rc)
+      log_error("%s failed: %s\n", line, gpg_strerror(rc));
+    else if (data.size() != sizes[i] ||
+             !check_pattern((const unsigned char *)data.data(), data.size()))
+      log_error("%s returned wrong data\n", line);
+
+    parm.ctx = ctx;
+    parm.length = sizes[i];
+    snprintf(line, sizeof line, "PUTDATA %zu", sizes[i]);
+    rc = assuan_transact(ctx, line, NULL, NULL, inquire_cb, &parm, NULL, NULL);
+    if (rc) log_error("%s failed: %s\n", line, gpg_strerror(rc));
+  }
+}
+
+/* A data callback which fails after LIMIT octets.  */
+struct failing_parm_s {
+  size_t seen;
+  size_t limit;
+};
+
+static gpg_error_t failing_data_cb(void *opaque, const void *buffer,
+                                   size_t length) {
+  struct failing_parm_s *parm = (struct failing_parm_s *)opaque;
+
+  if (!buffer) return 0;
+  parm->seen += length;
+  return parm->seen > parm->limit ? GPG_ERR_CANCELED : 0;
+}
+
+/* Let the data callback fail in the middle of a large transfer in
+   binary frames and check that the next command still gets its own
+   response.  */
+static void client_abort(assuan_context_t ctx) {
+  struct failing_parm_s parm;
+  std::string data;
+  gpg_error_t rc;
+
+  parm.seen = 0;
+  parm.limit = 100000;
+  rc = assuan_transact(ctx, "GETDATA 1048576", failing_data_cb, &parm, NULL,
+                       NULL, NULL, NULL);
+  if (rc != GPG_ERR_CANCELED)
+    log_error("GETDATA with failing callback returned: %s\n",
+              gpg_strerror(rc));
+
+  rc = assuan_transact(ctx, "GETDATA 5003", data_cb, &data, NULL, NULL, NULL,
+                       NULL);
+  if (rc)
+    log_error("GETDATA after failing callback failed: %s\n",
+              gpg_strerror(rc));
+  else if (data.size() != 5003 ||
+           !check_pattern((const unsigned char *)data.data(), data.size()))
+    log_error("GETDATA after failing callback returned wrong data\n");
+}
+
+static void client(assuan_context_t ctx) {
+  gpg_error_t rc;
+
+  client_round(ctx);
+
+  rc = assuan_negotiate_binary_data(ctx);
+  if (rc)
+    log_error("assuan_negotiate_binary_data failed: %s\n", gpg_strerror(rc));
+  else if (!assuan_get_flag(ctx, ASSUAN_BINARY_DATA))
+    log_error("binary data not enabled after negotiation\n");
+
+  client_round(ctx);
+  client_abort(ctx);
+}
+
+/*
+
+     M A I N
+
+*/
+int binarydata_main(int argc, char **argv) {
+  assuan_context_t ctx;
+  gpg_error_t err;
+  int no_close_fds[2];
+  const char *loc;
+
+  if (argc) {
+    log_set_prefix(*argv);
+    argc--;
+    argv++;
+  }
+  if (argc && !strcmp(*argv, "--verbose")) verbose = 1;
+
+  assuan_set_assuan_log_prefix(log_prefix);
+
+  no_close_fds[0] = 2;
+  no_close_fds[1] = -1;
+
+  err = assuan_new(&ctx);
+  if (err) log_fatal("assuan_new failed: %s\n", gpg_strerror(err));
+
+  /* Use a socketpair so that the Unix domain socket I/O is used.  */
+  err = assuan_pipe_connect(ctx, NULL, &loc, no_close_fds, NULL, NULL,
+                            ASSUAN_PIPE_CONNECT_FDPASSING);
+  if (err) {
+    log_error("assuan_pipe_connect failed: %s\n", gpg_strerror(err));
+    assuan_release(ctx);
+  } else if (loc[0] == 's') {
+    server();
+    assuan_release(ctx);
+    _exit(0);
+  } else {
+    client(ctx);
+    assuan_release(ctx);
+  }
+
+  return errorcount ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+/* sockserver - Check concurrent socket servers.
+   Copyright (C) 2018 The NeoPG developers
+
+   This file is part of Assuan.
+
+   Assuan is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   Assuan is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/assuan.h"
+#include "common.h"
+
+/* Number of concurrent connections and commands sent on each.  */
+#define N_CONNECTIONS 8
+#define N_COMMANDS 200
+
+static std::atomic<int> failures{0};
+
+/*
+
+       S E R V E R
+
+*/
+
+static gpg_error_t cmd_ping(assuan_context_t ctx, char *line) {
+  return assuan_send_data(ctx, line, strlen(line));
+}
+
+/* Serve the already accepted connection FD until the client says
+   BYE.  */
+static void server(int fd) {
+  gpg_error_t rc;
+  assuan_context_t ctx;
+
+  rc = assuan_new(&ctx);
+  if (rc) log_fatal("assuan_new failed: %s\n", gpg_strerror(rc));
+
+  rc = assuan_init_socket_server(ctx, fd, ASSUAN_SOCKET_SERVER_ACCEPTED);
+  if (rc) log_fatal("assuan_init_socket_server failed: %s\n", gpg_strerror(rc));
+
+  rc = assuan_register_command(ctx, "PING", cmd_ping, NULL);
+  if (rc) log_fatal("register_command failed: %s\n", gpg_strerror(rc));
+
+  for (;;) {
+    rc = assuan_accept(ctx);
+    if (rc) {
+      if (rc != (gpg_error_t)-1)
+        log_error("assuan_accept failed: %s\n", gpg_strerror(rc));
+      break;
+    }
+
+    rc = assuan_process(ctx);
+    if (rc) {
+      log_error("assuan_process failed: %s\n", gpg_strerror(rc));
+      failures++;
+    }
+  }
+
+  assuan_release(ctx);
+}
+
+/*
+
+       C L I E N T
+
+*/
+
+/* Read one line from FD into BUFFER of SIZE.  Returns false on
+   error.  */
+static bool read_line(int fd, char *buffer, size_t size) {
+  size_t n = 0;
+  ssize_t nread;
+
+  while (n + 1 < size) {
+    nread = read(fd, buffer + n, 1);
+    if (nread < 0 && errno == EINTR) continue;
+    if (nread <= 0) return false;
+    if (buffer[n] == '\n') {
+      buffer[n] = 0;
+      return true;
+    }
+    n++;
+  }
+  return false;
+}
+
+static bool write_line(int fd, const char *line) {
+  size_t len = strlen(line);
+
+  return write(fd, line, len) == (ssize_t)len && write(fd, "\n", 1) == 1;
+}
+
+/* Run a client on connection FD and check that each PING is answered
+   with its own argument.  */
+static void client(int fd, int id) {
+  char line[100];
+  char expected[100];
+  int i;
+
+  if (!read_line(fd, line, sizeof line) || strncmp(line, "OK", 2)) {
+    log_error("client %d: no greeting\n", id);
+    failures++;
+    return;
+  }
+
+  for (i = 0; i < N_COMMANDS; i++) {
+    snprintf(line, sizeof line, "PING %d-%d", id, i);
+    snprintf(expected, sizeof expected, "D %d-%d", id, i);
+    if (!write_line(fd, line)) {
+      log_error("client %d: write failed: %s\n", id, strerror(errno));
+      failures++;
+      return;
+    }
+    if (!read_line(fd, line, sizeof line) || strcmp(line, expected)) {
+      log_error("client %d: unexpected data line\n", id);
+      failures++;
+      return;
+    }
+    if (!read_line(fd, line, sizeof line) || strncmp(line, "OK", 2)) {
+      log_error("client %d: command %d failed\n", id, i);
+      failures++;
+      return;
+    }
+  }
+
+  if (!write_line(fd, "BYE") || !read_line(fd, line, sizeof line) ||
+      strncmp(line, "OK", 2)) {
+    log_error("client %d: BYE failed\n", id);
+    failures++;
+  }
+  close(fd);
+}
+
+/*
+
+     M A I N
+
+*/
+int sockserver_main(int argc, char **argv) {
+  std::vector<std::thread> threads;
+  int fds[2];
+  int i;
+
+  if (argc) {
+    log_set_prefix(*argv);
+    argc--;
+    argv++;
+  }
+  if (argc && !strcmp(*argv, "--verbose")) verbose = 1;
+
+  assuan_set_assuan_log_prefix(log_prefix);
+
+  /* Each connection gets its own server context, as a daemon running
+     its own accept loop would do.  */
+  for (i = 0; i < N_CONNECTIONS; i++) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+      log_fatal("socketpair failed: %s\n", strerror(errno));
+    threads.emplace_back(server, fds[0]);
+    threads.emplace_back(client, fds[1], i);
+  }
+
+  for (auto &thread : threads) thread.join();
+
+  if (failures) errorcount++;
+  return errorcount ? 1 : 0;
+}
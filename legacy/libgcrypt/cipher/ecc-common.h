@@ -112,6 +112,19 @@ gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pk,
                                    gcry_mpi_t r, gcry_mpi_t s, int hashalgo,
                                    gcry_mpi_t pkmpi);
 
+/* A signature to be verified by _gcry_ecc_eddsa_verify_batch.  */
+typedef struct {
+  gcry_mpi_t input; /* The message as opaque MPI.  */
+  gcry_mpi_t r;     /* The signature values as opaque MPIs.  */
+  gcry_mpi_t s;
+  gcry_mpi_t pk;  /* The EdDSA style encoded public key.  */
+  gpg_error_t rc; /* Receives the result of the verification.  */
+} eddsa_batch_item_t;
+
+gpg_error_t _gcry_ecc_eddsa_verify_batch(eddsa_batch_item_t *items,
+                                         unsigned int nitems,
+                                         ECC_public_key *pk, int hashalgo);
+
 /*-- ecc-gost.c --*/
 gpg_error_t _gcry_ecc_gost_sign(gcry_mpi_t input, ECC_secret_key *skey,
                                 gcry_mpi_t r, gcry_mpi_t s);
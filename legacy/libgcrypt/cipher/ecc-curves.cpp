@@ -1057,6 +1057,7 @@ gpg_error_t _gcry_ecc_set_mpi(const char *name, gcry_mpi_t newvalue,
   } else if (!strcmp(name, "b")) {
     mpi_free(ec->b);
     ec->b = mpi_copy(newvalue);
+    _gcry_mpi_ec_get_reset(ec);
   } else if (!strcmp(name, "n")) {
     mpi_free(ec->n);
     ec->n = mpi_copy(newvalue);
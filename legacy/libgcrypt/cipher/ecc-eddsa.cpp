@@ -454,7 +454,7 @@ gpg_error_t _gcry_ecc_eddsa_genkey(ECC_secret_key *sk, elliptic_curve_t *E,
   /* log_printmpi ("ecgen         a", a); */
 
   /* Compute Q.  */
-  _gcry_mpi_ec_mul_point(&Q, a, &E->G, ctx);
+  _gcry_mpi_ec_mul_base_point(&Q, a, &E->G, ctx);
   if (DBG_CIPHER) log_printpnt("ecgen      pk", &Q, ctx);
 
   /* Copy the stuff to the key structures. */
@@ -547,7 +547,7 @@ gpg_error_t _gcry_ecc_eddsa_sign(gcry_mpi_t input, ECC_secret_key *skey,
       goto leave;
     }
   } else {
-    _gcry_mpi_ec_mul_point(&Q, a, &skey->E.G, ctx);
+    _gcry_mpi_ec_mul_base_point(&Q, a, &skey->E.G, ctx);
     rc = _gcry_ecc_eddsa_encodepoint(&Q, ctx, x, y, 0, &encpk, &encpklen);
     if (rc) goto leave;
     if (DBG_CIPHER) log_printhex("  e_pk", encpk, encpklen);
@@ -568,7 +568,10 @@ gpg_error_t _gcry_ecc_eddsa_sign(gcry_mpi_t input, ECC_secret_key *skey,
   reverse_buffer(digest, 64);
   if (DBG_CIPHER) log_printhex("     r", digest, 64);
   _gcry_mpi_set_buffer(r, digest, 64, 0);
-  _gcry_mpi_ec_mul_point(&I, r, &skey->E.G, ctx);
+  /* R only depends on r modulo the order of G; reducing it allows the
+     use of the comb for G.  */
+  mpi_mod(r, r, skey->E.n);
+  _gcry_mpi_ec_mul_base_point(&I, r, &skey->E.G, ctx);
   if (DBG_CIPHER) log_printpnt("   r", &I, ctx);
 
   /* Convert R into affine coordinates and apply encoding.  */
@@ -718,7 +721,7 @@ gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pkey,
     }
   }
 
-  _gcry_mpi_ec_mul_point(&Ia, s, &pkey->E.G, ctx);
+  _gcry_mpi_ec_mul_base_point(&Ia, s, &pkey->E.G, ctx);
   _gcry_mpi_ec_mul_point(&Ib, h, &Q, ctx);
   _gcry_mpi_sub(Ib.x, ctx->p, Ib.x);
   _gcry_mpi_ec_add_points(&Ia, &Ia, &Ib, ctx);
@@ -742,3 +745,263 @@ leave:
   point_free(&Q);
   return rc;
 }
+
+/* Return true if POINT has order N or is the neutral element, that
+   is if it has no component of small order.  X and Y are scratch
+   MPIs.  */
+static int eddsa_point_in_subgroup(mpi_point_t point, gcry_mpi_t n,
+                                   mpi_ec_t ctx, gcry_mpi_t x, gcry_mpi_t y) {
+  mpi_point_struct T;
+  int res;
+
+  point_init(&T);
+  _gcry_mpi_ec_mul_point(&T, n, point, ctx);
+  res = !_gcry_mpi_ec_get_affine(x, y, &T, ctx) && !mpi_cmp_ui(x, 0) &&
+        !mpi_cmp_ui(y, 1);
+  point_free(&T);
+  return res;
+}
+
+/* A public key of a batch.  Signatures by the same key share the
+   multiplication of the key.  */
+typedef struct {
+  const void *pkbuf; /* The key as given.  */
+  unsigned int pkbits;
+  unsigned char *encpk; /* The encoded key or NULL if the key is not
+                           suitable for the batch.  */
+  mpi_point_struct A;
+  gcry_mpi_t scalar; /* Sum of z_i·h_i over the signatures.  */
+} eddsa_batch_key_t;
+
+/* Prepare the signature ITEM for batch verification with CTX, where B
+   is the size of an encoded point and N the order of the base point.
+   Returns false if ITEM needs to be verified on its own.  Otherwise
+   R is set to the point of the signature, H to the hash value reduced
+   modulo N and S to the value S.  */
+static int eddsa_batch_prepare(eddsa_batch_item_t *item,
+                               eddsa_batch_key_t *key, mpi_ec_t ctx, int b,
+                               int hashalgo, gcry_mpi_t n, mpi_point_t R,
+                               gcry_mpi_t h, gcry_mpi_t s) {
+  const void *mbuf, *rbuf;
+  void *sbuf;
+  unsigned char *tbuf = NULL;
+  unsigned int tmp, tlen;
+  size_t mlen;
+  unsigned char digest[64];
+  gcry_buffer_t hvec[3];
+  int res = 0;
+
+  if (!key->encpk) return 0;
+
+  mbuf = mpi_get_opaque(item->input, &tmp);
+  mlen = (tmp + 7) / 8;
+  rbuf = mpi_get_opaque(item->r, &tmp);
+  if ((tmp + 7) / 8 != b) return 0;
+  mpi_get_opaque(item->s, &tmp);
+  if ((tmp + 7) / 8 != b) return 0;
+
+  /* The single verification compares the encoding of R, thus R must
+     decode to a point which encodes back to R.  */
+  if (_gcry_ecc_eddsa_decodepoint(item->r, ctx, R, NULL, NULL)) return 0;
+  if (_gcry_ecc_eddsa_encodepoint(R, ctx, h, s, 0, &tbuf, &tlen)) return 0;
+  if (tlen != b || memcmp(tbuf, rbuf, tlen)) goto leave;
+  if (!_gcry_mpi_ec_curve_point(R, ctx)) goto leave;
+  if (!eddsa_point_in_subgroup(R, n, ctx, h, s)) goto leave;
+
+  /* h = H(encodepoint(R) + encodepoint(pk) + m) mod n  */
+  hvec[0].data = (char *)rbuf;
+  hvec[0].off = 0;
+  hvec[0].len = b;
+  hvec[1].data = key->encpk;
+  hvec[1].off = 0;
+  hvec[1].len = b;
+  hvec[2].data = (char *)mbuf;
+  hvec[2].off = 0;
+  hvec[2].len = mlen;
+  if (_gcry_md_hash_buffers(hashalgo, 0, digest, hvec, 3)) goto leave;
+  reverse_buffer(digest, 64);
+  _gcry_mpi_set_buffer(h, digest, 64, 0);
+  mpi_mod(h, h, n);
+
+  sbuf = _gcry_mpi_get_opaque_copy(item->s, &tmp);
+  reverse_buffer((unsigned char *)(sbuf), b);
+  _gcry_mpi_set_buffer(s, sbuf, b, 0);
+  xfree(sbuf);
+  res = 1;
+
+leave:
+  xfree(tbuf);
+  return res;
+}
+
+/* Verify the NITEMS EdDSA signatures in ITEMS at once.  PKEY has the
+ * curve parameters; the public keys are given with the items.  The
+ * result for each signature is stored in its RC field and is the
+ * same as _gcry_ecc_eddsa_verify would return.  0 is returned if
+ * all of them verify, else the first error.
+ *
+ * With random 128 bit values z_i this checks
+ *
+ *   (sum z_i·s_i)·G - sum z_i·R_i - sum (z_i·h_i)·A_i = 0
+ *
+ * using a single multi-scalar multiplication.  This is the
+ * verification equation without the cofactor, as used by
+ * _gcry_ecc_eddsa_verify.  A signature or key with a component of
+ * small order could make the equation hold with probability up to
+ * 1/2 although a single verification fails.  Therefore only
+ * signatures whose R and A are in the subgroup of order n are
+ * verified this way; all others and all signatures of a failed batch
+ * are verified one by one.
+ */
+gpg_error_t _gcry_ecc_eddsa_verify_batch(eddsa_batch_item_t *items,
+                                         unsigned int nitems,
+                                         ECC_public_key *pkey, int hashalgo) {
+  gpg_error_t rc = 0;
+  mpi_ec_t ctx = NULL;
+  int b;
+  unsigned int i, j, nkeys, npoints;
+  unsigned char *single;
+  eddsa_batch_key_t *keys = NULL;
+  unsigned int *keyidx = NULL;
+  mpi_point_struct *points = NULL;
+  mpi_point_t *ppoints = NULL;
+  gcry_mpi_t *scalars = NULL;
+  gcry_mpi_t z, h, s, sum, x, y;
+  unsigned char zbuf[16];
+  mpi_point_struct Ia, Ib;
+
+  single = (unsigned char *)xmalloc(nitems ? nitems : 1);
+  memset(single, 1, nitems);
+  if (nitems < 2 || hashalgo != GCRY_MD_SHA512) goto leave;
+
+  ctx = _gcry_mpi_ec_p_internal_new(pkey->E.model, pkey->E.dialect, 0,
+                                    pkey->E.p, pkey->E.a, pkey->E.b);
+  b = ctx->nbits / 8;
+  if (b != 256 / 8) goto leave;
+
+  point_init(&Ia);
+  point_init(&Ib);
+  z = mpi_new(0);
+  h = mpi_new(0);
+  s = mpi_new(0);
+  sum = mpi_new(0);
+  x = mpi_new(0);
+  y = mpi_new(0);
+  keys = (eddsa_batch_key_t *)xcalloc(nitems, sizeof *keys);
+  keyidx = (unsigned int *)xcalloc(nitems, sizeof *keyidx);
+  points = (mpi_point_struct *)xcalloc(nitems, sizeof *points);
+  ppoints = (mpi_point_t *)xcalloc(2 * nitems, sizeof *ppoints);
+  scalars = (gcry_mpi_t *)xcalloc(2 * nitems, sizeof *scalars);
+
+  /* Find the keys and check them once.  */
+  nkeys = 0;
+  for (i = 0; i < nitems; i++) {
+    const void *pkbuf;
+    unsigned int pkbits, enclen;
+
+    if (!mpi_is_opaque(items[i].input) || !mpi_is_opaque(items[i].r) ||
+        !mpi_is_opaque(items[i].s) || !mpi_is_opaque(items[i].pk)) {
+      keyidx[i] = nitems;
+      continue;
+    }
+    pkbuf = mpi_get_opaque(items[i].pk, &pkbits);
+    for (j = 0; j < nkeys; j++)
+      if (keys[j].pkbits == pkbits &&
+          !memcmp(keys[j].pkbuf, pkbuf, (pkbits + 7) / 8))
+        break;
+    keyidx[i] = j;
+    if (j < nkeys) continue;
+
+    nkeys++;
+    keys[j].pkbuf = pkbuf;
+    keys[j].pkbits = pkbits;
+    point_init(&keys[j].A);
+    keys[j].scalar = mpi_new(0);
+    if (_gcry_ecc_eddsa_decodepoint(items[i].pk, ctx, &keys[j].A,
+                                    &keys[j].encpk, &enclen))
+      keys[j].encpk = NULL;
+    else if (enclen != b || !_gcry_mpi_ec_curve_point(&keys[j].A, ctx) ||
+             !eddsa_point_in_subgroup(&keys[j].A, pkey->E.n, ctx, x, y)) {
+      xfree(keys[j].encpk);
+      keys[j].encpk = NULL;
+    }
+  }
+
+  /* Collect the negated points R_i with their factors z_i and the sum
+     of z_i·s_i; the factors of the keys are summed up.  */
+  npoints = 0;
+  for (i = 0; i < nitems; i++) {
+    if (keyidx[i] == nitems) continue;
+    point_init(&points[i]);
+    if (!eddsa_batch_prepare(&items[i], &keys[keyidx[i]], ctx, b, hashalgo,
+                             pkey->E.n, &points[i], h, s))
+      continue;
+    single[i] = 0;
+
+    _gcry_create_nonce(zbuf, sizeof zbuf);
+    _gcry_mpi_set_buffer(z, zbuf, sizeof zbuf, 0);
+    mpi_mulm(s, s, z, pkey->E.n);
+    mpi_addm(sum, sum, s, pkey->E.n);
+    mpi_mulm(h, h, z, pkey->E.n);
+    mpi_addm(keys[keyidx[i]].scalar, keys[keyidx[i]].scalar, h, pkey->E.n);
+
+    _gcry_mpi_sub(points[i].x, ctx->p, points[i].x);
+    ppoints[npoints] = &points[i];
+    scalars[npoints] = mpi_copy(z);
+    npoints++;
+  }
+  for (j = 0; j < nkeys; j++)
+    if (keys[j].encpk && mpi_cmp_ui(keys[j].scalar, 0)) {
+      _gcry_mpi_sub(keys[j].A.x, ctx->p, keys[j].A.x);
+      ppoints[npoints] = &keys[j].A;
+      scalars[npoints] = mpi_copy(keys[j].scalar);
+      npoints++;
+    }
+
+  if (npoints) {
+    _gcry_mpi_ec_mul_base_point(&Ia, sum, &pkey->E.G, ctx);
+    _gcry_mpi_ec_mul_points(&Ib, scalars, ppoints, npoints, ctx);
+    _gcry_mpi_ec_add_points(&Ia, &Ia, &Ib, ctx);
+    if (_gcry_mpi_ec_get_affine(x, y, &Ia, ctx) || mpi_cmp_ui(x, 0) ||
+        mpi_cmp_ui(y, 1)) {
+      if (DBG_CIPHER) log_debug("eddsa batch verification failed\n");
+      memset(single, 1, nitems);
+    }
+  }
+
+  for (i = 0; i < nitems; i++)
+    if (keyidx[i] != nitems) point_free(&points[i]);
+  for (i = 0; i < npoints; i++) _gcry_mpi_release(scalars[i]);
+  for (j = 0; j < nkeys; j++) {
+    point_free(&keys[j].A);
+    _gcry_mpi_release(keys[j].scalar);
+    xfree(keys[j].encpk);
+  }
+  xfree(keys);
+  xfree(keyidx);
+  xfree(points);
+  xfree(ppoints);
+  xfree(scalars);
+  _gcry_mpi_release(z);
+  _gcry_mpi_release(h);
+  _gcry_mpi_release(s);
+  _gcry_mpi_release(sum);
+  _gcry_mpi_release(x);
+  _gcry_mpi_release(y);
+  point_free(&Ia);
+  point_free(&Ib);
+
+leave:
+  _gcry_mpi_ec_free(ctx);
+  for (i = 0; i < nitems; i++) {
+    if (single[i])
+      items[i].rc =
+          _gcry_ecc_eddsa_verify(items[i].input, pkey, items[i].r, items[i].s,
+                                 hashalgo, items[i].pk);
+    else
+      items[i].rc = 0;
+    if (!rc) rc = items[i].rc;
+  }
+  xfree(single);
+  return rc;
+}
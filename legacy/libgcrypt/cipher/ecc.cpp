@@ -866,43 +866,53 @@ leave:
   return rc;
 }
 
-static gpg_error_t ecc_verify(gcry_sexp_t s_sig, gcry_sexp_t s_data,
-                              gcry_sexp_t s_keyparms) {
-  gpg_error_t rc;
+/* The arguments of a signature verification, as parsed by
+   ecc_verify_parse.  */
+struct ecc_verify_args {
   struct pk_encoding_ctx ctx;
-  gcry_sexp_t l1 = NULL;
-  char *curvename = NULL;
-  gcry_mpi_t mpi_g = NULL;
-  gcry_mpi_t mpi_q = NULL;
-  gcry_mpi_t sig_r = NULL;
-  gcry_mpi_t sig_s = NULL;
-  gcry_mpi_t data = NULL;
+  char *curvename;
+  gcry_mpi_t mpi_g;
+  gcry_mpi_t mpi_q;
+  gcry_mpi_t sig_r;
+  gcry_mpi_t sig_s;
+  gcry_mpi_t data;
   ECC_public_key pk;
   int sigflags;
+};
 
-  memset(&pk, 0, sizeof pk);
-  _gcry_pk_util_init_encoding_ctx(&ctx, PUBKEY_OP_VERIFY,
+/* Parse the arguments of ecc_verify into ARGS, which needs to be
+   released with ecc_verify_release also on error.  */
+static gpg_error_t ecc_verify_parse(gcry_sexp_t s_sig, gcry_sexp_t s_data,
+                                    gcry_sexp_t s_keyparms,
+                                    struct ecc_verify_args *args) {
+  gpg_error_t rc;
+  gcry_sexp_t l1 = NULL;
+  ECC_public_key &pk = args->pk;
+
+  memset(args, 0, sizeof *args);
+  _gcry_pk_util_init_encoding_ctx(&args->ctx, PUBKEY_OP_VERIFY,
                                   ecc_get_nbits(s_keyparms));
 
   /* Extract the data.  */
-  rc = _gcry_pk_util_data_to_mpi(s_data, &data, &ctx);
+  rc = _gcry_pk_util_data_to_mpi(s_data, &args->data, &args->ctx);
   if (rc) goto leave;
-  if (DBG_CIPHER) log_mpidump("ecc_verify data", data);
+  if (DBG_CIPHER) log_mpidump("ecc_verify data", args->data);
 
   /*
    * Extract the signature value.
    */
-  rc = _gcry_pk_util_preparse_sigval(s_sig, ecc_names, &l1, &sigflags);
+  rc = _gcry_pk_util_preparse_sigval(s_sig, ecc_names, &l1, &args->sigflags);
   if (rc) goto leave;
   rc = sexp_extract_param(l1, NULL,
-                          (sigflags & PUBKEY_FLAG_EDDSA) ? "/rs" : "rs", &sig_r,
-                          &sig_s, NULL);
+                          (args->sigflags & PUBKEY_FLAG_EDDSA) ? "/rs" : "rs",
+                          &args->sig_r, &args->sig_s, NULL);
   if (rc) goto leave;
   if (DBG_CIPHER) {
-    log_mpidump("ecc_verify  s_r", sig_r);
-    log_mpidump("ecc_verify  s_s", sig_s);
+    log_mpidump("ecc_verify  s_r", args->sig_r);
+    log_mpidump("ecc_verify  s_s", args->sig_s);
   }
-  if ((ctx.flags & PUBKEY_FLAG_EDDSA) ^ (sigflags & PUBKEY_FLAG_EDDSA)) {
+  if ((args->ctx.flags & PUBKEY_FLAG_EDDSA) ^
+      (args->sigflags & PUBKEY_FLAG_EDDSA)) {
     rc = GPG_ERR_CONFLICT; /* Inconsistent use of flag/algoname.  */
     goto leave;
   }
@@ -910,42 +920,43 @@ static gpg_error_t ecc_verify(gcry_sexp_t s_sig, gcry_sexp_t s_data,
   /*
    * Extract the key.
    */
-  if ((ctx.flags & PUBKEY_FLAG_PARAM))
+  if ((args->ctx.flags & PUBKEY_FLAG_PARAM))
     rc = sexp_extract_param(s_keyparms, NULL, "-p?a?b?g?n?h?/q", &pk.E.p,
-                            &pk.E.a, &pk.E.b, &mpi_g, &pk.E.n, &pk.E.h, &mpi_q,
-                            NULL);
+                            &pk.E.a, &pk.E.b, &args->mpi_g, &pk.E.n, &pk.E.h,
+                            &args->mpi_q, NULL);
   else
-    rc = sexp_extract_param(s_keyparms, NULL, "/q", &mpi_q, NULL);
+    rc = sexp_extract_param(s_keyparms, NULL, "/q", &args->mpi_q, NULL);
   if (rc) goto leave;
-  if (mpi_g) {
+  if (args->mpi_g) {
     point_init(&pk.E.G);
-    rc = _gcry_ecc_os2ec(&pk.E.G, mpi_g);
+    rc = _gcry_ecc_os2ec(&pk.E.G, args->mpi_g);
     if (rc) goto leave;
   }
   /* Add missing parameters using the optional curve parameter.  */
   sexp_release(l1);
   l1 = sexp_find_token(s_keyparms, "curve", 5);
   if (l1) {
-    curvename = sexp_nth_string(l1, 1);
-    if (curvename) {
-      rc = _gcry_ecc_fill_in_curve(0, curvename, &pk.E, NULL);
+    args->curvename = sexp_nth_string(l1, 1);
+    if (args->curvename) {
+      rc = _gcry_ecc_fill_in_curve(0, args->curvename, &pk.E, NULL);
       if (rc) goto leave;
     }
   }
   /* Guess required fields if a curve parameter has not been given.
      FIXME: This is a crude hacks.  We need to fix that.  */
-  if (!curvename) {
-    pk.E.model =
-        ((sigflags & PUBKEY_FLAG_EDDSA) ? MPI_EC_EDWARDS : MPI_EC_WEIERSTRASS);
-    pk.E.dialect = ((sigflags & PUBKEY_FLAG_EDDSA) ? ECC_DIALECT_ED25519
-                                                   : ECC_DIALECT_STANDARD);
+  if (!args->curvename) {
+    pk.E.model = ((args->sigflags & PUBKEY_FLAG_EDDSA) ? MPI_EC_EDWARDS
+                                                       : MPI_EC_WEIERSTRASS);
+    pk.E.dialect = ((args->sigflags & PUBKEY_FLAG_EDDSA)
+                        ? ECC_DIALECT_ED25519
+                        : ECC_DIALECT_STANDARD);
     if (!pk.E.h) pk.E.h = mpi_const(MPI_C_ONE);
   }
 
   if (DBG_CIPHER) {
     log_debug("ecc_verify info: %s/%s%s\n", _gcry_ecc_model2str(pk.E.model),
               _gcry_ecc_dialect2str(pk.E.dialect),
-              (sigflags & PUBKEY_FLAG_EDDSA) ? "+EdDSA" : "");
+              (args->sigflags & PUBKEY_FLAG_EDDSA) ? "+EdDSA" : "");
     if (pk.E.name) log_debug("ecc_verify name: %s\n", pk.E.name);
     log_printmpi("ecc_verify    p", pk.E.p);
     log_printmpi("ecc_verify    a", pk.E.a);
@@ -953,82 +964,157 @@ static gpg_error_t ecc_verify(gcry_sexp_t s_sig, gcry_sexp_t s_data,
     log_printpnt("ecc_verify  g", &pk.E.G, NULL);
     log_printmpi("ecc_verify    n", pk.E.n);
     log_printmpi("ecc_verify    h", pk.E.h);
-    log_printmpi("ecc_verify    q", mpi_q);
+    log_printmpi("ecc_verify    q", args->mpi_q);
   }
   if (!pk.E.p || !pk.E.a || !pk.E.b || !pk.E.G.x || !pk.E.n || !pk.E.h ||
-      !mpi_q) {
+      !args->mpi_q)
     rc = GPG_ERR_NO_OBJ;
-    goto leave;
+
+leave:
+  sexp_release(l1);
+  return rc;
+}
+
+/* Verify the signature described by ARGS.  */
+static gpg_error_t ecc_verify_parsed(struct ecc_verify_args *args) {
+  gpg_error_t rc;
+  ECC_public_key &pk = args->pk;
+  gcry_mpi_t data = args->data;
+
+  if ((args->sigflags & PUBKEY_FLAG_EDDSA))
+    return _gcry_ecc_eddsa_verify(data, &pk, args->sig_r, args->sig_s,
+                                  args->ctx.hash_algo, args->mpi_q);
+
+  point_init(&pk.Q);
+  if ((args->sigflags & PUBKEY_FLAG_GOST)) {
+    rc = _gcry_ecc_os2ec(&pk.Q, args->mpi_q);
+    if (rc) return rc;
+
+    return _gcry_ecc_gost_verify(data, &pk, args->sig_r, args->sig_s);
   }
 
-  /*
-   * Verify the signature.
-   */
-  if ((sigflags & PUBKEY_FLAG_EDDSA)) {
-    rc = _gcry_ecc_eddsa_verify(data, &pk, sig_r, sig_s, ctx.hash_algo, mpi_q);
-  } else if ((sigflags & PUBKEY_FLAG_GOST)) {
-    point_init(&pk.Q);
-    rc = _gcry_ecc_os2ec(&pk.Q, mpi_q);
-    if (rc) goto leave;
+  if (pk.E.dialect == ECC_DIALECT_ED25519) {
+    mpi_ec_t ec;
+
+    /* Fixme: Factor the curve context setup out of eddsa_verify
+       and ecdsa_verify. So that we don't do it twice.  */
+    ec = _gcry_mpi_ec_p_internal_new(pk.E.model, pk.E.dialect, 0, pk.E.p,
+                                     pk.E.a, pk.E.b);
 
-    rc = _gcry_ecc_gost_verify(data, &pk, sig_r, sig_s);
+    rc = _gcry_ecc_eddsa_decodepoint(args->mpi_q, ec, &pk.Q, NULL, NULL);
+    _gcry_mpi_ec_free(ec);
   } else {
-    point_init(&pk.Q);
-    if (pk.E.dialect == ECC_DIALECT_ED25519) {
-      mpi_ec_t ec;
+    rc = _gcry_ecc_os2ec(&pk.Q, args->mpi_q);
+  }
+  if (rc) return rc;
 
-      /* Fixme: Factor the curve context setup out of eddsa_verify
-         and ecdsa_verify. So that we don't do it twice.  */
-      ec = _gcry_mpi_ec_p_internal_new(pk.E.model, pk.E.dialect, 0, pk.E.p,
-                                       pk.E.a, pk.E.b);
+  if (mpi_is_opaque(data)) {
+    const void *abuf;
+    unsigned int abits, qbits;
+    gcry_mpi_t a;
 
-      rc = _gcry_ecc_eddsa_decodepoint(mpi_q, ec, &pk.Q, NULL, NULL);
-      _gcry_mpi_ec_free(ec);
-    } else {
-      rc = _gcry_ecc_os2ec(&pk.Q, mpi_q);
-    }
-    if (rc) goto leave;
+    qbits = mpi_get_nbits(pk.E.n);
 
-    if (mpi_is_opaque(data)) {
-      const void *abuf;
-      unsigned int abits, qbits;
-      gcry_mpi_t a;
+    abuf = mpi_get_opaque(data, &abits);
+    rc = _gcry_mpi_scan(&a, GCRYMPI_FMT_USG, abuf, (abits + 7) / 8, NULL);
+    if (!rc) {
+      if (abits > qbits) mpi_rshift(a, a, abits - qbits);
 
-      qbits = mpi_get_nbits(pk.E.n);
+      rc = _gcry_ecc_ecdsa_verify(a, &pk, args->sig_r, args->sig_s);
+      _gcry_mpi_release(a);
+    }
+  } else
+    rc = _gcry_ecc_ecdsa_verify(data, &pk, args->sig_r, args->sig_s);
+  return rc;
+}
 
-      abuf = mpi_get_opaque(data, &abits);
-      rc = _gcry_mpi_scan(&a, GCRYMPI_FMT_USG, abuf, (abits + 7) / 8, NULL);
-      if (!rc) {
-        if (abits > qbits) mpi_rshift(a, a, abits - qbits);
+static void ecc_verify_release(struct ecc_verify_args *args) {
+  _gcry_mpi_release(args->pk.E.p);
+  _gcry_mpi_release(args->pk.E.a);
+  _gcry_mpi_release(args->pk.E.b);
+  _gcry_mpi_release(args->mpi_g);
+  point_free(&args->pk.E.G);
+  _gcry_mpi_release(args->pk.E.n);
+  _gcry_mpi_release(args->pk.E.h);
+  _gcry_mpi_release(args->mpi_q);
+  point_free(&args->pk.Q);
+  _gcry_mpi_release(args->data);
+  _gcry_mpi_release(args->sig_r);
+  _gcry_mpi_release(args->sig_s);
+  xfree(args->curvename);
+  _gcry_pk_util_free_encoding_ctx(&args->ctx);
+}
 
-        rc = _gcry_ecc_ecdsa_verify(a, &pk, sig_r, sig_s);
-        _gcry_mpi_release(a);
-      }
-    } else
-      rc = _gcry_ecc_ecdsa_verify(data, &pk, sig_r, sig_s);
-  }
+static gpg_error_t ecc_verify(gcry_sexp_t s_sig, gcry_sexp_t s_data,
+                              gcry_sexp_t s_keyparms) {
+  gpg_error_t rc;
+  struct ecc_verify_args args;
 
-leave:
-  _gcry_mpi_release(pk.E.p);
-  _gcry_mpi_release(pk.E.a);
-  _gcry_mpi_release(pk.E.b);
-  _gcry_mpi_release(mpi_g);
-  point_free(&pk.E.G);
-  _gcry_mpi_release(pk.E.n);
-  _gcry_mpi_release(pk.E.h);
-  _gcry_mpi_release(mpi_q);
-  point_free(&pk.Q);
-  _gcry_mpi_release(data);
-  _gcry_mpi_release(sig_r);
-  _gcry_mpi_release(sig_s);
-  xfree(curvename);
-  sexp_release(l1);
-  _gcry_pk_util_free_encoding_ctx(&ctx);
+  rc = ecc_verify_parse(s_sig, s_data, s_keyparms, &args);
+  if (!rc) rc = ecc_verify_parsed(&args);
+  ecc_verify_release(&args);
   if (DBG_CIPHER)
     log_debug("ecc_verify    => %s\n", rc ? gpg_strerror(rc) : "Good");
   return rc;
 }
 
+/* Return true if the curves of the public keys A and B are the
+   same.  */
+static int ecc_same_curve(ECC_public_key *a, ECC_public_key *b) {
+  return a->E.model == b->E.model && a->E.dialect == b->E.dialect &&
+         !mpi_cmp(a->E.p, b->E.p) && !mpi_cmp(a->E.a, b->E.a) &&
+         !mpi_cmp(a->E.b, b->E.b) && !mpi_cmp(a->E.n, b->E.n) &&
+         !mpi_cmp(a->E.h, b->E.h) && !mpi_cmp(a->E.G.x, b->E.G.x) &&
+         !mpi_cmp(a->E.G.y, b->E.G.y) && !mpi_cmp(a->E.G.z, b->E.G.z);
+}
+
+/* Verify the N signatures S_SIGS[i] on S_DATA[i] with the keys
+   KEYPARMS[i] and store the results at RCS.  Ed25519 signatures are
+   verified together; see _gcry_ecc_eddsa_verify_batch.  */
+static void ecc_verify_batch(gcry_sexp_t *s_sigs, gcry_sexp_t *s_data,
+                             gcry_sexp_t *keyparms, gpg_error_t *rcs,
+                             unsigned int n) {
+  struct ecc_verify_args *args;
+  eddsa_batch_item_t *items;
+  unsigned int *idx;
+  unsigned int i, nitems;
+  ECC_public_key *first = NULL;
+
+  args = (struct ecc_verify_args *)xcalloc(n, sizeof *args);
+  items = (eddsa_batch_item_t *)xcalloc(n, sizeof *items);
+  idx = (unsigned int *)xcalloc(n, sizeof *idx);
+
+  nitems = 0;
+  for (i = 0; i < n; i++) {
+    rcs[i] = ecc_verify_parse(s_sigs[i], s_data[i], keyparms[i], &args[i]);
+    if (rcs[i]) continue;
+
+    if ((args[i].sigflags & PUBKEY_FLAG_EDDSA) &&
+        args[i].pk.E.model == MPI_EC_EDWARDS &&
+        args[i].pk.E.dialect == ECC_DIALECT_ED25519 &&
+        args[i].ctx.hash_algo == GCRY_MD_SHA512 &&
+        (!first || ecc_same_curve(first, &args[i].pk))) {
+      if (!first) first = &args[i].pk;
+      items[nitems].input = args[i].data;
+      items[nitems].r = args[i].sig_r;
+      items[nitems].s = args[i].sig_s;
+      items[nitems].pk = args[i].mpi_q;
+      idx[nitems++] = i;
+    } else
+      rcs[i] = ecc_verify_parsed(&args[i]);
+  }
+
+  if (nitems) {
+    _gcry_ecc_eddsa_verify_batch(items, nitems, first, GCRY_MD_SHA512);
+    for (i = 0; i < nitems; i++) rcs[idx[i]] = items[i].rc;
+  }
+
+  for (i = 0; i < n; i++) ecc_verify_release(&args[i]);
+  xfree(args);
+  xfree(items);
+  xfree(idx);
+}
+
 /* ecdh raw is classic 2-round DH protocol published in 1976.
  *
  * Overview of ecc_encrypt_raw and ecc_decrypt_raw.
@@ -1891,4 +1977,5 @@ gcry_pk_spec_t _gcry_pubkey_spec_ecc = {
     run_selftests,
     compute_keygrip,
     _gcry_ecc_get_curve,
-    _gcry_ecc_get_param_sexp};
+    _gcry_ecc_get_param_sexp,
+    ecc_verify_batch};
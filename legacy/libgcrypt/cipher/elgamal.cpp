@@ -416,6 +416,7 @@ static int check_secret_key(ELG_secret_key *sk) {
 static void do_encrypt(gcry_mpi_t a, gcry_mpi_t b, gcry_mpi_t input,
                        ELG_public_key *pkey) {
   gcry_mpi_t k;
+  mpi_mont_t mont;
 
   /* Note: maybe we should change the interface, so that it
    * is possible to check that input is < p and return an
@@ -423,14 +424,25 @@ static void do_encrypt(gcry_mpi_t a, gcry_mpi_t b, gcry_mpi_t input,
    */
 
   k = gen_k(pkey->p, 1);
-  mpi_powm(a, pkey->g, k, pkey->p);
+
+  /* Both exponentiations are modulo P; compute its Montgomery
+     constants only once.  */
+  mont = mpi_mont_new(pkey->p);
+  if (mont)
+    mpi_powm_mont(a, pkey->g, k, mont);
+  else
+    mpi_powm(a, pkey->g, k, pkey->p);
 
   /* b = (y^k * input) mod p
    *	 = ((y^k mod p) * (input mod p)) mod p
    * and because input is < p
    *	 = ((y^k mod p) * input) mod p
    */
-  mpi_powm(b, pkey->y, k, pkey->p);
+  if (mont)
+    mpi_powm_mont(b, pkey->y, k, mont);
+  else
+    mpi_powm(b, pkey->y, k, pkey->p);
+  mpi_mont_free(mont);
   mpi_mulm(b, b, input, pkey->p);
 #if 0
   if( DBG_CIPHER )
@@ -450,6 +462,9 @@ static void decrypt(gcry_mpi_t output, gcry_mpi_t a, gcry_mpi_t b,
                     ELG_secret_key *skey) {
   gcry_mpi_t t1, t2, r;
   unsigned int nbits = mpi_get_nbits(skey->p);
+#ifdef USE_BLINDING
+  mpi_mont_t mont;
+#endif
 
   mpi_normalize(a);
   mpi_normalize(b);
@@ -466,10 +481,18 @@ static void decrypt(gcry_mpi_t output, gcry_mpi_t a, gcry_mpi_t b,
   _gcry_mpi_randomize(r, nbits);
 
   /* t1 = r^x mod p */
-  mpi_powm(t1, r, skey->x, skey->p);
+  mont = mpi_mont_new(skey->p);
+  if (mont)
+    mpi_powm_mont(t1, r, skey->x, mont);
+  else
+    mpi_powm(t1, r, skey->x, skey->p);
   /* t2 = (a * r)^-x mod p */
   mpi_mulm(t2, a, r, skey->p);
-  mpi_powm(t2, t2, skey->x, skey->p);
+  if (mont)
+    mpi_powm_mont(t2, t2, skey->x, mont);
+  else
+    mpi_powm(t2, t2, skey->x, skey->p);
+  mpi_mont_free(mont);
   mpi_invm(t2, t2, skey->p);
   /* t1 = (t1 * t2) mod p*/
   mpi_mulm(t1, t1, t2, skey->p);
@@ -25,6 +25,7 @@
 #include <stdint.h>
 #endif
 
+#include "bufhelp.h"
 #include "g10lib.h"
 #include "hash-common.h"
 
@@ -144,3 +145,93 @@ void _gcry_md_block_write(void *context, const void *inbuf_arg, size_t inlen) {
   for (; inlen && hd->count < blocksize; inlen--)
     hd->buf[hd->count++] = *inbuf++;
 }
+
+#ifdef USE_MD_MULTI
+/* Return block BLK of the message P of LEN bytes padded to NBLKS
+   blocks.  Full data blocks are read in place; the others are
+   assembled in the 64 bytes at TMP.  */
+static const unsigned char *multi_block(unsigned char *tmp,
+                                        const unsigned char *p, size_t len,
+                                        size_t blk, size_t nblks) {
+  size_t off = blk * 64;
+  size_t n;
+
+  if (off + 64 <= len) return p + off;
+
+  n = off < len ? len - off : 0;
+  if (n) memcpy(tmp, p + off, n);
+  memset(tmp + n, 0, 64 - n);
+  if (off <= len) tmp[n] = 0x80;
+  if (blk == nblks - 1) buf_put_be64(tmp + 56, (u64)len << 3);
+  return tmp;
+}
+
+/* Hash each of the IOVCNT buffers at IOV as a separate message and
+   store the digests of NWORDS big-endian words one after the other
+   at OUTBUF.  IV has the initial chaining variables and TRANSFORM
+   compresses one block of all lanes.  A lane is refilled with the
+   next message as soon as its message is done, so that messages of
+   different length keep all lanes busy.  */
+void _gcry_md_multi_hash_buffers(void *outbuf, const gcry_buffer_t *iov,
+                                 int iovcnt, const u32 *iv, int nwords,
+                                 _gcry_md_multi_transform_t transform) {
+  struct {
+    const unsigned char *p;
+    size_t len;
+    size_t blk;
+    size_t nblks;
+    int msg; /* Index of the message or -1 for an idle lane.  */
+  } lane[MD_MULTI_LANES];
+  md_multi_vec_t state[8];
+  md_multi_vec_t w[16];
+  unsigned char tmp[64];
+  const unsigned char *src;
+  unsigned char *out;
+  int next = 0;
+  int active = 0;
+  int i, j;
+
+  gcry_assert(nwords <= 8);
+
+  for (i = 0; i < MD_MULTI_LANES; i++) lane[i].msg = -1;
+  memset(state, 0, sizeof state);
+
+  for (;;) {
+    for (i = 0; i < MD_MULTI_LANES; i++) {
+      if (lane[i].msg < 0 && next < iovcnt) {
+        lane[i].p = (const unsigned char *)iov[next].data + iov[next].off;
+        lane[i].len = iov[next].len;
+        lane[i].blk = 0;
+        lane[i].nblks = (lane[i].len + 8) / 64 + 1;
+        lane[i].msg = next++;
+        for (j = 0; j < nwords; j++) state[j][i] = iv[j];
+        active++;
+      }
+
+      if (lane[i].msg < 0) {
+        memset(tmp, 0, 64);
+        src = tmp;
+      } else
+        src = multi_block(tmp, lane[i].p, lane[i].len, lane[i].blk,
+                          lane[i].nblks);
+      for (j = 0; j < 16; j++) w[j][i] = buf_get_be32(src + 4 * j);
+    }
+    if (!active) break;
+
+    transform(state, w);
+
+    for (i = 0; i < MD_MULTI_LANES; i++) {
+      if (lane[i].msg < 0 || ++lane[i].blk < lane[i].nblks) continue;
+
+      out = (unsigned char *)outbuf + (size_t)lane[i].msg * 4 * nwords;
+      for (j = 0; j < nwords; j++) buf_put_be32(out + 4 * j, state[j][i]);
+      lane[i].msg = -1;
+      active--;
+    }
+  }
+
+  wipememory(state, sizeof state);
+  wipememory(w, sizeof w);
+  wipememory(tmp, sizeof tmp);
+}
+#endif /*USE_MD_MULTI*/
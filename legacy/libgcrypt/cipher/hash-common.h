@@ -51,4 +51,23 @@ typedef struct gcry_md_block_ctx {
 
 void _gcry_md_block_write(void *context, const void *inbuf_arg, size_t inlen);
 
+/* Multi-buffer hashing of many independent messages with a 64 byte
+   block, big-endian hash function like SHA-1 and SHA-256.  Each lane
+   of a vector holds the value for one message; with GCC vector
+   extensions the compiler generates the SIMD code for the target.  */
+#if defined(__GNUC__)
+#define USE_MD_MULTI 1
+#define MD_MULTI_LANES 8
+typedef u32 md_multi_vec_t __attribute__((vector_size(4 * MD_MULTI_LANES)));
+
+/* Type of the function to compress one block of all lanes.  STATE
+   has the chaining variables and W the 16 message words.  */
+typedef void (*_gcry_md_multi_transform_t)(md_multi_vec_t *state,
+                                           const md_multi_vec_t *w);
+
+void _gcry_md_multi_hash_buffers(void *outbuf, const gcry_buffer_t *iov,
+                                 int iovcnt, const u32 *iv, int nwords,
+                                 _gcry_md_multi_transform_t transform);
+#endif /*__GNUC__*/
+
 #endif /*GCRY_HASH_COMMON_H*/
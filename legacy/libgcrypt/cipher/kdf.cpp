@@ -28,6 +28,13 @@
 #include "g10lib.h"
 #include "kdf-internal.h"
 
+/* The iterated and salted S2K hashes up to 65 MiB of the repeated
+   salt and passphrase.  Writing them separately costs a call into the
+   hash function for every few bytes.  Instead we expand the pattern
+   into a buffer of about this size so that the block function of the
+   hash processes runs of full blocks directly.  */
+#define S2K_CHUNK_SIZE 2048
+
 /* Transform a passphrase into a suitable key of length KEYSIZE and
    store this key in the caller provided buffer KEYBUFFER.  The caller
    must provide an HASHALGO, a valid ALGO and depending on that algo a
@@ -37,11 +44,14 @@ static gpg_error_t openpgp_s2k(const void *passphrase, size_t passphraselen,
                                int algo, int hashalgo, const void *salt,
                                size_t saltlen, unsigned long iterations,
                                size_t keysize, void *keybuffer) {
-  gpg_error_t ec;
-  gcry_md_hd_t md;
+  gpg_error_t ec = 0;
+  gcry_md_hd_t *md;
   char *key = (char *)keybuffer;
-  int pass, i;
-  int used = 0;
+  unsigned char *chunk = NULL;
+  size_t chunklen = 0;
+  size_t dlen, n;
+  int npasses, pass, i;
+  size_t used = 0;
   int secmode;
 
   if ((algo == GCRY_KDF_SALTED_S2K || algo == GCRY_KDF_ITERSALTED_S2K) &&
@@ -50,48 +60,78 @@ static gpg_error_t openpgp_s2k(const void *passphrase, size_t passphraselen,
 
   secmode = _gcry_is_secure(passphrase) || _gcry_is_secure(keybuffer);
 
-  ec = _gcry_md_open(&md, hashalgo, secmode ? GCRY_MD_FLAG_SECURE : 0);
-  if (ec) return ec;
+  dlen = _gcry_md_get_algo_dlen(hashalgo);
+  if (!dlen) return GPG_ERR_DIGEST_ALGO;
+
+  /* If the key is longer than the digest, more passes are required.
+     They hash the same data preceded by an increasing number of
+     zeros, thus we run them side by side over the same buffer.  */
+  npasses = (keysize + dlen - 1) / dlen;
+  md = (gcry_md_hd_t *)xtrycalloc(npasses, sizeof *md);
+  if (!md) return gpg_error_from_syserror();
+
+  for (pass = 0; pass < npasses; pass++) {
+    ec = _gcry_md_open(md + pass, hashalgo,
+                       secmode ? GCRY_MD_FLAG_SECURE : 0);
+    if (ec) goto leave;
+    for (i = 0; i < pass; i++) /* Preset the hash context.  */
+      _gcry_md_putc(md[pass], 0);
+  }
+
+  if (algo == GCRY_KDF_SALTED_S2K || algo == GCRY_KDF_ITERSALTED_S2K) {
+    size_t len2 = passphraselen + 8;
+    unsigned long count = len2;
+    unsigned char *p;
 
-  for (pass = 0; used < keysize; pass++) {
-    if (pass) {
-      _gcry_md_reset(md);
-      for (i = 0; i < pass; i++) /* Preset the hash context.  */
-        _gcry_md_putc(md, 0);
+    if (algo == GCRY_KDF_ITERSALTED_S2K) {
+      count = iterations;
+      if (count < len2) count = len2;
     }
 
-    if (algo == GCRY_KDF_SALTED_S2K || algo == GCRY_KDF_ITERSALTED_S2K) {
-      int len2 = passphraselen + 8;
-      unsigned long count = len2;
+    /* Expand the salt and passphrase into a buffer holding a whole
+       number of copies, but not more than we need.  */
+    n = S2K_CHUNK_SIZE / len2;
+    if (n > count / len2) n = count / len2;
+    if (!n) n = 1;
+    chunklen = n * len2;
+    chunk = (unsigned char *)(secmode ? xtrymalloc_secure(chunklen)
+                                      : xtrymalloc(chunklen));
+    if (!chunk) {
+      ec = gpg_error_from_syserror();
+      goto leave;
+    }
+    for (p = chunk; n; n--, p += len2) {
+      memcpy(p, salt, saltlen);
+      memcpy(p + saltlen, passphrase, passphraselen);
+    }
 
-      if (algo == GCRY_KDF_ITERSALTED_S2K) {
-        count = iterations;
-        if (count < len2) count = len2;
-      }
+    for (; count >= chunklen; count -= chunklen)
+      for (pass = 0; pass < npasses; pass++)
+        _gcry_md_write(md[pass], chunk, chunklen);
+    /* The remaining bytes are a prefix of the repeated pattern.  */
+    if (count)
+      for (pass = 0; pass < npasses; pass++)
+        _gcry_md_write(md[pass], chunk, count);
+  } else
+    for (pass = 0; pass < npasses; pass++)
+      _gcry_md_write(md[pass], passphrase, passphraselen);
+
+  for (pass = 0; pass < npasses; pass++) {
+    _gcry_md_final(md[pass]);
+    n = dlen;
+    if (n > keysize - used) n = keysize - used;
+    memcpy(key + used, _gcry_md_read(md[pass], hashalgo), n);
+    used += n;
+  }
 
-      while (count > len2) {
-        _gcry_md_write(md, salt, saltlen);
-        _gcry_md_write(md, passphrase, passphraselen);
-        count -= len2;
-      }
-      if (count < saltlen)
-        _gcry_md_write(md, salt, count);
-      else {
-        _gcry_md_write(md, salt, saltlen);
-        count -= saltlen;
-        _gcry_md_write(md, passphrase, count);
-      }
-    } else
-      _gcry_md_write(md, passphrase, passphraselen);
-
-    _gcry_md_final(md);
-    i = _gcry_md_get_algo_dlen(hashalgo);
-    if (i > keysize - used) i = keysize - used;
-    memcpy(key + used, _gcry_md_read(md, hashalgo), i);
-    used += i;
+leave:
+  if (chunk) {
+    wipememory(chunk, chunklen);
+    xfree(chunk);
   }
-  _gcry_md_close(md);
-  return 0;
+  for (pass = 0; pass < npasses; pass++) _gcry_md_close(md[pass]);
+  xfree(md);
+  return ec;
 }
 
 /* Transform a passphrase into a suitable key of length KEYSIZE and
@@ -28,6 +28,7 @@
 
 #include "cipher.h"
 #include "g10lib.h"
+#include "hash-common.h"
 
 /* This is the list of the digest implementations included in
    libgcrypt.  */
@@ -775,6 +776,36 @@ gpg_error_t _gcry_md_get(gcry_md_hd_t hd, int algo, byte *buffer, int buflen) {
   return GPG_ERR_INTERNAL;
 }
 
+/* Size of the context buffer for one-shot hashing on the stack.  This
+   is large enough for all digests we have; a larger context makes
+   md_hash_oneshot fail and the caller uses a handle instead.  */
+#define MD_ONESHOT_CONTEXT_SIZE 512
+
+/* Hash the IOVCNT buffers at IOV with algorithm ALGO into DIGEST
+   using a context on the stack.  This avoids the allocation of a
+   handle and its context list, which for short data costs more than
+   the hashing itself.  Returns false if ALGO can't be used this way,
+   in which case nothing has been done.  */
+static int md_hash_oneshot(int algo, void *digest, const gcry_buffer_t *iov,
+                           int iovcnt) {
+  union {
+    PROPERLY_ALIGNED_TYPE align;
+    byte c[MD_ONESHOT_CONTEXT_SIZE];
+  } context;
+  gcry_md_spec_t *spec;
+
+  spec = spec_from_algo(algo);
+  if (!spec || !spec->read || spec->contextsize > sizeof context) return 0;
+
+  spec->init(&context, 0);
+  for (; iovcnt > 0; iov++, iovcnt--)
+    spec->write(&context, (const char *)iov[0].data + iov[0].off, iov[0].len);
+  spec->final(&context);
+  memcpy(digest, spec->read(&context), spec->mdlen);
+  wipememory(&context, spec->contextsize);
+  return 1;
+}
+
 /*
  * Shortcut function to hash a buffer with a given algo. The only
  * guaranteed supported algorithms are RIPE-MD160 and SHA-1. The
@@ -806,6 +837,12 @@ void _gcry_md_hash_buffer(int algo, void *digest, const void *buffer,
        normal functions. */
     gcry_md_hd_t h;
     gpg_error_t err;
+    gcry_buffer_t iov;
+
+    memset(&iov, 0, sizeof iov);
+    iov.data = (void *)buffer;
+    iov.len = length;
+    if (md_hash_oneshot(algo, digest, &iov, 1)) return;
 
     err = md_open(&h, algo, 0);
     if (err)
@@ -867,6 +904,8 @@ gpg_error_t _gcry_md_hash_buffers(int algo, unsigned int flags, void *digest,
     dlen = md_digest_length(algo);
     if (!dlen) return GPG_ERR_DIGEST_ALGO;
 
+    if (!hmac && md_hash_oneshot(algo, digest, iov, iovcnt)) return 0;
+
     rc = md_open(&h, algo, (hmac ? GCRY_MD_FLAG_HMAC : 0));
     if (rc) return rc;
 
@@ -890,6 +929,51 @@ gpg_error_t _gcry_md_hash_buffers(int algo, unsigned int flags, void *digest,
   return 0;
 }
 
+/* Shortcut function to hash many independent messages with a given
+   algo.  Each of the IOVCNT items in IOV is a separate message and
+   its digest is stored at DIGESTS, one after the other, which must
+   have been provided by the caller with IOVCNT times the digest
+   length of ALGO.  FLAGS must be 0.
+
+   For SHA-1 and SHA-256 the messages are hashed in parallel using
+   the lanes of vector registers; this is much faster than hashing
+   them one by one if the messages are short, as for fingerprints and
+   keygrips.  Returns 0 on success or an error code.  */
+gpg_error_t _gcry_md_hash_buffers_multi(int algo, unsigned int flags,
+                                        void *digests,
+                                        const gcry_buffer_t *iov,
+                                        int iovcnt) {
+  gpg_error_t rc;
+  int dlen;
+  int i;
+
+  if (!iov || iovcnt < 0) return GPG_ERR_INV_ARG;
+  if (flags) return GPG_ERR_INV_ARG;
+
+  if (0)
+    ;
+#if USE_SHA256 && defined(USE_MD_MULTI)
+  else if (algo == GCRY_MD_SHA256)
+    _gcry_sha256_hash_buffers_multi(digests, iov, iovcnt);
+#endif
+#if USE_SHA1 && defined(USE_MD_MULTI)
+  else if (algo == GCRY_MD_SHA1)
+    _gcry_sha1_hash_buffers_multi(digests, iov, iovcnt);
+#endif
+  else {
+    dlen = md_digest_length(algo);
+    if (!dlen) return GPG_ERR_DIGEST_ALGO;
+
+    for (i = 0; i < iovcnt; i++) {
+      rc = _gcry_md_hash_buffers(algo, 0, (char *)digests + (size_t)i * dlen,
+                                 iov + i, 1);
+      if (rc) return rc;
+    }
+  }
+
+  return 0;
+}
+
 static int md_get_algo(gcry_md_hd_t a) {
   GcryDigestEntry *r = a->ctx->list;
 
@@ -43,12 +43,17 @@ static int pss_verify_cmp(void *opaque, gcry_mpi_t tmp) {
                               ctx->saltlen);
 }
 
-/* Parser for a flag list.  On return the encoding is stored at
-   R_ENCODING and the flags are stored at R_FLAGS.  If any of them is
-   not needed, NULL may be passed.  The function returns 0 on success
-   or an error code. */
-gpg_error_t _gcry_pk_util_parse_flaglist(gcry_sexp_t list, int *r_flags,
-                                         enum pk_encoding *r_encoding) {
+/* Return true if the N bytes at S are the string NAME.  */
+static int name_eq(const char *s, size_t n, const char *name) {
+  return s && n == strlen(name) && !memcmp(s, name, n);
+}
+
+/* Parser for a flag list given as view.  On return the encoding is
+   stored at R_ENCODING and the flags are stored at R_FLAGS.  If any
+   of them is not needed, NULL may be passed.  The function returns 0
+   on success or an error code. */
+static gpg_error_t parse_flaglist(gcry_sexp_view_t list, int *r_flags,
+                                  enum pk_encoding *r_encoding) {
   gpg_error_t rc = 0;
   const char *s;
   size_t n;
@@ -57,8 +62,8 @@ gpg_error_t _gcry_pk_util_parse_flaglist(gcry_sexp_t list, int *r_flags,
   int flags = 0;
   int igninvflag = 0;
 
-  for (i = list ? sexp_length(list) - 1 : 0; i > 0; i--) {
-    s = sexp_nth_data(list, i, &n);
+  for (i = sexp_view_length(list) - 1; i > 0; i--) {
+    s = sexp_view_nth_data(list, i, &n);
     if (!s) continue; /* Not a data element. */
 
     switch (n) {
@@ -173,6 +178,12 @@ gpg_error_t _gcry_pk_util_parse_flaglist(gcry_sexp_t list, int *r_flags,
   return rc;
 }
 
+/* Parser for a flag list.  See parse_flaglist.  */
+gpg_error_t _gcry_pk_util_parse_flaglist(gcry_sexp_t list, int *r_flags,
+                                         enum pk_encoding *r_encoding) {
+  return parse_flaglist(sexp_view(list), r_flags, r_encoding);
+}
+
 static int get_hash_algo(const char *s, size_t n) {
   static const struct {
     const char *name;
@@ -233,25 +244,24 @@ static int get_hash_algo(const char *s, size_t n) {
  * stores 0 at R_NBITS.
  */
 gpg_error_t _gcry_pk_util_get_nbits(gcry_sexp_t list, unsigned int *r_nbits) {
+  gcry_sexp_view_t l1;
   char buf[50];
   const char *s;
   size_t n;
 
   *r_nbits = 0;
 
-  list = sexp_find_token(list, "nbits", 0);
-  if (!list) return 0; /* No NBITS found.  */
+  l1 = sexp_view_find_token(sexp_view(list), "nbits", 0);
+  if (!l1.d) return 0; /* No NBITS found.  */
 
-  s = sexp_nth_data(list, 1, &n);
+  s = sexp_view_nth_data(l1, 1, &n);
   if (!s || n >= DIM(buf) - 1) {
     /* NBITS given without a cdr.  */
-    sexp_release(list);
     return GPG_ERR_INV_OBJ;
   }
   memcpy(buf, s, n);
   buf[n] = 0;
   *r_nbits = (unsigned int)strtoul(buf, NULL, 0);
-  sexp_release(list);
   return 0;
 }
 
@@ -275,28 +285,27 @@ gpg_error_t _gcry_pk_util_get_nbits(gcry_sexp_t list, unsigned int *r_nbits) {
  * stores 0 at R_E.
  */
 gpg_error_t _gcry_pk_util_get_rsa_use_e(gcry_sexp_t list, unsigned long *r_e) {
+  gcry_sexp_view_t l1;
   char buf[50];
   const char *s;
   size_t n;
 
   *r_e = 0;
 
-  list = sexp_find_token(list, "rsa-use-e", 0);
-  if (!list) {
+  l1 = sexp_view_find_token(sexp_view(list), "rsa-use-e", 0);
+  if (!l1.d) {
     *r_e = 65537; /* Not given, use the value generated by old versions. */
     return 0;
   }
 
-  s = sexp_nth_data(list, 1, &n);
+  s = sexp_view_nth_data(l1, 1, &n);
   if (!s || n >= DIM(buf) - 1) {
     /* No value or value too large.  */
-    sexp_release(list);
     return GPG_ERR_INV_OBJ;
   }
   memcpy(buf, s, n);
   buf[n] = 0;
   *r_e = strtoul(buf, NULL, 0);
-  sexp_release(list);
   return 0;
 }
 
@@ -311,69 +320,49 @@ gpg_error_t _gcry_pk_util_preparse_sigval(gcry_sexp_t s_sig,
                                           const char **algo_names,
                                           gcry_sexp_t *r_parms,
                                           int *r_eccflags) {
-  gpg_error_t rc;
-  gcry_sexp_t l1 = NULL;
-  gcry_sexp_t l2 = NULL;
-  char *name = NULL;
+  gcry_sexp_view_t l1, l2;
+  const char *name;
+  size_t n;
   int i;
 
   *r_parms = NULL;
   if (r_eccflags) *r_eccflags = 0;
 
   /* Extract the signature value.  */
-  l1 = sexp_find_token(s_sig, "sig-val", 0);
-  if (!l1) {
-    rc = GPG_ERR_INV_OBJ; /* Does not contain a signature value object.  */
-    goto leave;
-  }
-
-  l2 = sexp_nth(l1, 1);
-  if (!l2) {
-    rc = GPG_ERR_NO_OBJ; /* No cadr for the sig object.  */
-    goto leave;
-  }
-  name = sexp_nth_string(l2, 0);
-  if (!name) {
-    rc = GPG_ERR_INV_OBJ; /* Invalid structure of object.  */
-    goto leave;
-  } else if (!strcmp(name, "flags")) {
+  l1 = sexp_view_find_token(sexp_view(s_sig), "sig-val", 0);
+  if (!l1.d)
+    return GPG_ERR_INV_OBJ; /* Does not contain a signature value object. */
+
+  l2 = sexp_view_nth(l1, 1);
+  if (!l2.d) return GPG_ERR_NO_OBJ; /* No cadr for the sig object.  */
+  name = sexp_view_nth_data(l2, 0, &n);
+  if (!name || !n)
+    return GPG_ERR_INV_OBJ; /* Invalid structure of object.  */
+  else if (name_eq(name, n, "flags")) {
     /* Skip a "flags" parameter and look again for the algorithm
        name.  This is not used but here just for the sake of
        consistent S-expressions we need to handle it. */
-    sexp_release(l2);
-    l2 = sexp_nth(l1, 2);
-    if (!l2) {
-      rc = GPG_ERR_INV_OBJ;
-      goto leave;
-    }
-    xfree(name);
-    name = sexp_nth_string(l2, 0);
-    if (!name) {
-      rc = GPG_ERR_INV_OBJ; /* Invalid structure of object.  */
-      goto leave;
-    }
+    l2 = sexp_view_nth(l1, 2);
+    if (!l2.d) return GPG_ERR_INV_OBJ;
+    name = sexp_view_nth_data(l2, 0, &n);
+    if (!name || !n)
+      return GPG_ERR_INV_OBJ; /* Invalid structure of object.  */
   }
 
   for (i = 0; algo_names[i]; i++)
-    if (!strcasecmp(name, algo_names[i])) break;
-  if (!algo_names[i]) {
-    rc = GPG_ERR_CONFLICT; /* "sig-val" uses an unexpected algo. */
-    goto leave;
-  }
+    if (n == strlen(algo_names[i]) && !strncasecmp(name, algo_names[i], n))
+      break;
+  if (!algo_names[i])
+    return GPG_ERR_CONFLICT; /* "sig-val" uses an unexpected algo. */
   if (r_eccflags) {
-    if (!strcmp(name, "eddsa")) *r_eccflags = PUBKEY_FLAG_EDDSA;
-    if (!strcmp(name, "gost")) *r_eccflags = PUBKEY_FLAG_GOST;
+    if (name_eq(name, n, "eddsa")) *r_eccflags = PUBKEY_FLAG_EDDSA;
+    if (name_eq(name, n, "gost")) *r_eccflags = PUBKEY_FLAG_GOST;
   }
 
-  *r_parms = l2;
-  l2 = NULL;
-  rc = 0;
-
-leave:
-  xfree(name);
-  sexp_release(l2);
-  sexp_release(l1);
-  return rc;
+  /* Only the parameter list is copied out of S_SIG.  */
+  *r_parms = sexp_view_copy(l2);
+  if (!*r_parms) return gpg_error_from_syserror();
+  return 0;
 }
 
 /* Parse a "enc-val" s-expression and store the inner parameter list
@@ -400,9 +389,9 @@ gpg_error_t _gcry_pk_util_preparse_encval(gcry_sexp_t sexp,
                                           gcry_sexp_t *r_parms,
                                           struct pk_encoding_ctx *ctx) {
   gpg_error_t rc = 0;
-  gcry_sexp_t l1 = NULL;
-  gcry_sexp_t l2 = NULL;
-  char *name = NULL;
+  gcry_sexp_view_t l1, l2;
+  const char *name;
+  size_t namelen;
   size_t n;
   int parsed_flags = 0;
   int i;
@@ -410,30 +399,31 @@ gpg_error_t _gcry_pk_util_preparse_encval(gcry_sexp_t sexp,
   *r_parms = NULL;
 
   /* Check that the first element is valid.  */
-  l1 = sexp_find_token(sexp, "enc-val", 0);
-  if (!l1) {
+  l1 = sexp_view_find_token(sexp_view(sexp), "enc-val", 0);
+  if (!l1.d) {
     rc = GPG_ERR_INV_OBJ; /* Does not contain an encrypted value object.  */
     goto leave;
   }
 
-  l2 = sexp_nth(l1, 1);
-  if (!l2) {
+  l2 = sexp_view_nth(l1, 1);
+  if (!l2.d) {
     rc = GPG_ERR_NO_OBJ; /* No cadr for the data object.  */
     goto leave;
   }
 
   /* Extract identifier of sublist.  */
-  name = sexp_nth_string(l2, 0);
-  if (!name) {
+  name = sexp_view_nth_data(l2, 0, &namelen);
+  if (!name || !namelen) {
     rc = GPG_ERR_INV_OBJ; /* Invalid structure of object.  */
     goto leave;
   }
 
-  if (!strcmp(name, "flags")) {
+  if (name_eq(name, namelen, "flags")) {
+    gcry_sexp_view_t list;
     const char *s;
 
     /* There is a flags element - process it.  */
-    rc = _gcry_pk_util_parse_flaglist(l2, &parsed_flags, &ctx->encoding);
+    rc = parse_flaglist(l2, &parsed_flags, &ctx->encoding);
     if (rc) goto leave;
     if (ctx->encoding == PUBKEY_ENC_PSS) {
       rc = GPG_ERR_CONFLICT;
@@ -443,10 +433,9 @@ gpg_error_t _gcry_pk_util_preparse_encval(gcry_sexp_t sexp,
     /* Get the OAEP parameters HASH-ALGO and LABEL, if any. */
     if (ctx->encoding == PUBKEY_ENC_OAEP) {
       /* Get HASH-ALGO. */
-      sexp_release(l2);
-      l2 = sexp_find_token(l1, "hash-algo", 0);
-      if (l2) {
-        s = sexp_nth_data(l2, 1, &n);
+      list = sexp_view_find_token(l1, "hash-algo", 0);
+      if (list.d) {
+        s = sexp_view_nth_data(list, 1, &n);
         if (!s)
           rc = GPG_ERR_NO_OBJ;
         else {
@@ -457,10 +446,9 @@ gpg_error_t _gcry_pk_util_preparse_encval(gcry_sexp_t sexp,
       }
 
       /* Get LABEL. */
-      sexp_release(l2);
-      l2 = sexp_find_token(l1, "label", 0);
-      if (l2) {
-        s = sexp_nth_data(l2, 1, &n);
+      list = sexp_view_find_token(l1, "label", 0);
+      if (list.d) {
+        s = sexp_view_nth_data(list, 1, &n);
         if (!s)
           rc = GPG_ERR_NO_OBJ;
         else if (n > 0) {
@@ -477,22 +465,20 @@ gpg_error_t _gcry_pk_util_preparse_encval(gcry_sexp_t sexp,
     }
 
     /* Get the next which has the actual data - skip HASH-ALGO and LABEL. */
-    for (i = 2; (sexp_release(l2), l2 = sexp_nth(l1, i)); i++) {
-      s = sexp_nth_data(l2, 0, &n);
-      if (!(n == 9 && !memcmp(s, "hash-algo", 9)) &&
-          !(n == 5 && !memcmp(s, "label", 5)) &&
-          !(n == 15 && !memcmp(s, "random-override", 15)))
+    for (i = 2; (l2 = sexp_view_nth(l1, i)).d; i++) {
+      s = sexp_view_nth_data(l2, 0, &n);
+      if (!name_eq(s, n, "hash-algo") && !name_eq(s, n, "label") &&
+          !name_eq(s, n, "random-override"))
         break;
     }
-    if (!l2) {
+    if (!l2.d) {
       rc = GPG_ERR_NO_OBJ; /* No cadr for the data object. */
       goto leave;
     }
 
     /* Extract sublist identifier.  */
-    xfree(name);
-    name = sexp_nth_string(l2, 0);
-    if (!name) {
+    name = sexp_view_nth_data(l2, 0, &namelen);
+    if (!name || !namelen) {
       rc = GPG_ERR_INV_OBJ; /* Invalid structure of object. */
       goto leave;
     }
@@ -500,21 +486,24 @@ gpg_error_t _gcry_pk_util_preparse_encval(gcry_sexp_t sexp,
     parsed_flags |= PUBKEY_FLAG_LEGACYRESULT;
 
   for (i = 0; algo_names[i]; i++)
-    if (!strcasecmp(name, algo_names[i])) break;
+    if (namelen == strlen(algo_names[i]) &&
+        !strncasecmp(name, algo_names[i], namelen))
+      break;
   if (!algo_names[i]) {
     rc = GPG_ERR_CONFLICT; /* "enc-val" uses an unexpected algo. */
     goto leave;
   }
 
-  *r_parms = l2;
-  l2 = NULL;
+  /* Only the parameter list is copied out of SEXP.  */
+  *r_parms = sexp_view_copy(l2);
+  if (!*r_parms) {
+    rc = gpg_error_from_syserror();
+    goto leave;
+  }
   ctx->flags |= parsed_flags;
   rc = 0;
 
 leave:
-  xfree(name);
-  sexp_release(l2);
-  sexp_release(l1);
   return rc;
 }
 
@@ -570,26 +559,25 @@ void _gcry_pk_util_free_encoding_ctx(struct pk_encoding_ctx *ctx) {
 gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
                                       struct pk_encoding_ctx *ctx) {
   gpg_error_t rc = 0;
-  gcry_sexp_t ldata, lhash, lvalue;
+  gcry_sexp_view_t ldata, lhash, lvalue;
   size_t n;
   const char *s;
   int unknown_flag = 0;
   int parsed_flags = 0;
 
   *ret_mpi = NULL;
-  ldata = sexp_find_token(input, "data", 0);
-  if (!ldata) { /* assume old style */
+  ldata = sexp_view_find_token(sexp_view(input), "data", 0);
+  if (!ldata.d) { /* assume old style */
     *ret_mpi = sexp_nth_mpi(input, 0, 0);
     return *ret_mpi ? GPG_ERR_NO_ERROR : GPG_ERR_INV_OBJ;
   }
 
   /* See whether there is a flags list.  */
   {
-    gcry_sexp_t lflags = sexp_find_token(ldata, "flags", 0);
-    if (lflags) {
-      if (_gcry_pk_util_parse_flaglist(lflags, &parsed_flags, &ctx->encoding))
+    gcry_sexp_view_t lflags = sexp_view_find_token(ldata, "flags", 0);
+    if (lflags.d) {
+      if (parse_flaglist(lflags, &parsed_flags, &ctx->encoding))
         unknown_flag = 1;
-      sexp_release(lflags);
     }
   }
 
@@ -597,41 +585,41 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
     ctx->encoding = PUBKEY_ENC_RAW; /* default to raw */
 
   /* Get HASH or MPI */
-  lhash = sexp_find_token(ldata, "hash", 0);
-  lvalue = lhash ? NULL : sexp_find_token(ldata, "value", 0);
+  lhash = sexp_view_find_token(ldata, "hash", 0);
+  lvalue.d = NULL;
+  if (!lhash.d) lvalue = sexp_view_find_token(ldata, "value", 0);
 
-  if (!(!lhash ^ !lvalue))
+  if (!(!lhash.d ^ !lvalue.d))
     rc = GPG_ERR_INV_OBJ; /* none or both given */
   else if (unknown_flag)
     rc = GPG_ERR_INV_FLAG;
   else if (ctx->encoding == PUBKEY_ENC_RAW &&
            (parsed_flags & PUBKEY_FLAG_EDDSA)) {
     /* Prepare for EdDSA.  */
-    gcry_sexp_t list;
+    gcry_sexp_view_t list;
     void *value;
     size_t valuelen;
 
-    if (!lvalue) {
+    if (!lvalue.d) {
       rc = GPG_ERR_INV_OBJ;
       goto leave;
     }
     /* Get HASH-ALGO. */
-    list = sexp_find_token(ldata, "hash-algo", 0);
-    if (list) {
-      s = sexp_nth_data(list, 1, &n);
+    list = sexp_view_find_token(ldata, "hash-algo", 0);
+    if (list.d) {
+      s = sexp_view_nth_data(list, 1, &n);
       if (!s)
         rc = GPG_ERR_NO_OBJ;
       else {
         ctx->hash_algo = get_hash_algo(s, n);
         if (!ctx->hash_algo) rc = GPG_ERR_DIGEST_ALGO;
       }
-      sexp_release(list);
     } else
       rc = GPG_ERR_INV_OBJ;
     if (rc) goto leave;
 
     /* Get VALUE.  */
-    value = sexp_nth_buffer(lvalue, 1, &valuelen);
+    value = sexp_view_nth_buffer(lvalue, 1, &valuelen);
     if (!value) {
       /* We assume that a zero length message is meant by
          "(value)".  This is commonly used by test vectors.  Note
@@ -647,16 +635,16 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
 
     /* Note that mpi_set_opaque takes ownership of VALUE.  */
     *ret_mpi = mpi_set_opaque(NULL, value, valuelen * 8);
-  } else if (ctx->encoding == PUBKEY_ENC_RAW && lhash &&
+  } else if (ctx->encoding == PUBKEY_ENC_RAW && lhash.d &&
              ((parsed_flags & PUBKEY_FLAG_RAW_FLAG) ||
               (parsed_flags & PUBKEY_FLAG_RFC6979))) {
     /* Raw encoding along with a hash element.  This is commonly
        used for DSA.  For better backward error compatibility we
        allow this only if either the rfc6979 flag has been given or
        the raw flags was explicitly given.  */
-    if (sexp_length(lhash) != 3)
+    if (sexp_view_length(lhash) != 3)
       rc = GPG_ERR_INV_OBJ;
-    else if (!(s = sexp_nth_data(lhash, 1, &n)) || !n)
+    else if (!(s = sexp_view_nth_data(lhash, 1, &n)) || !n)
       rc = GPG_ERR_INV_OBJ;
     else {
       void *value;
@@ -665,7 +653,7 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
       ctx->hash_algo = get_hash_algo(s, n);
       if (!ctx->hash_algo)
         rc = GPG_ERR_DIGEST_ALGO;
-      else if (!(value = sexp_nth_buffer(lhash, 2, &valuelen)))
+      else if (!(value = sexp_view_nth_buffer(lhash, 2, &valuelen)))
         rc = GPG_ERR_INV_OBJ;
       else if ((valuelen * 8) < valuelen) {
         xfree(value);
@@ -673,7 +661,7 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
       } else
         *ret_mpi = mpi_set_opaque(NULL, value, valuelen * 8);
     }
-  } else if (ctx->encoding == PUBKEY_ENC_RAW && lvalue) {
+  } else if (ctx->encoding == PUBKEY_ENC_RAW && lvalue.d) {
     /* RFC6969 may only be used with the a hash value and not the
        MPI based value.  */
     if (parsed_flags & PUBKEY_FLAG_RFC6979) {
@@ -682,23 +670,23 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
     }
 
     /* Get the value */
-    *ret_mpi = sexp_nth_mpi(lvalue, 1, GCRYMPI_FMT_USG);
+    *ret_mpi = sexp_view_nth_mpi(lvalue, 1, GCRYMPI_FMT_USG);
     if (!*ret_mpi) rc = GPG_ERR_INV_OBJ;
-  } else if (ctx->encoding == PUBKEY_ENC_PKCS1 && lvalue &&
+  } else if (ctx->encoding == PUBKEY_ENC_PKCS1 && lvalue.d &&
              ctx->op == PUBKEY_OP_ENCRYPT) {
     const void *value;
     size_t valuelen;
-    gcry_sexp_t list;
+    gcry_sexp_view_t list;
     void *random_override = NULL;
     size_t random_override_len = 0;
 
-    if (!(value = sexp_nth_data(lvalue, 1, &valuelen)) || !valuelen)
+    if (!(value = sexp_view_nth_data(lvalue, 1, &valuelen)) || !valuelen)
       rc = GPG_ERR_INV_OBJ;
     else {
       /* Get optional RANDOM-OVERRIDE.  */
-      list = sexp_find_token(ldata, "random-override", 0);
-      if (list) {
-        s = sexp_nth_data(list, 1, &n);
+      list = sexp_view_find_token(ldata, "random-override", 0);
+      if (list.d) {
+        s = sexp_view_nth_data(list, 1, &n);
         if (!s)
           rc = GPG_ERR_NO_OBJ;
         else if (n > 0) {
@@ -710,7 +698,6 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
             random_override_len = n;
           }
         }
-        sexp_release(list);
         if (rc) goto leave;
       }
 
@@ -719,11 +706,11 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
           (const unsigned char *)(random_override), random_override_len);
       xfree(random_override);
     }
-  } else if (ctx->encoding == PUBKEY_ENC_PKCS1 && lhash &&
+  } else if (ctx->encoding == PUBKEY_ENC_PKCS1 && lhash.d &&
              (ctx->op == PUBKEY_OP_SIGN || ctx->op == PUBKEY_OP_VERIFY)) {
-    if (sexp_length(lhash) != 3)
+    if (sexp_view_length(lhash) != 3)
       rc = GPG_ERR_INV_OBJ;
-    else if (!(s = sexp_nth_data(lhash, 1, &n)) || !n)
+    else if (!(s = sexp_view_nth_data(lhash, 1, &n)) || !n)
       rc = GPG_ERR_INV_OBJ;
     else {
       const void *value;
@@ -733,55 +720,54 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
 
       if (!ctx->hash_algo)
         rc = GPG_ERR_DIGEST_ALGO;
-      else if (!(value = sexp_nth_data(lhash, 2, &valuelen)) || !valuelen)
+      else if (!(value = sexp_view_nth_data(lhash, 2, &valuelen)) || !valuelen)
         rc = GPG_ERR_INV_OBJ;
       else
         rc = _gcry_rsa_pkcs1_encode_for_sig(ret_mpi, ctx->nbits,
                                             (const unsigned char *)(value),
                                             valuelen, ctx->hash_algo);
     }
-  } else if (ctx->encoding == PUBKEY_ENC_PKCS1_RAW && lvalue &&
+  } else if (ctx->encoding == PUBKEY_ENC_PKCS1_RAW && lvalue.d &&
              (ctx->op == PUBKEY_OP_SIGN || ctx->op == PUBKEY_OP_VERIFY)) {
     const void *value;
     size_t valuelen;
 
-    if (sexp_length(lvalue) != 2)
+    if (sexp_view_length(lvalue) != 2)
       rc = GPG_ERR_INV_OBJ;
-    else if (!(value = sexp_nth_data(lvalue, 1, &valuelen)) || !valuelen)
+    else if (!(value = sexp_view_nth_data(lvalue, 1, &valuelen)) || !valuelen)
       rc = GPG_ERR_INV_OBJ;
     else
       rc = _gcry_rsa_pkcs1_encode_raw_for_sig(
           ret_mpi, ctx->nbits, (const unsigned char *)(value), valuelen);
-  } else if (ctx->encoding == PUBKEY_ENC_OAEP && lvalue &&
+  } else if (ctx->encoding == PUBKEY_ENC_OAEP && lvalue.d &&
              ctx->op == PUBKEY_OP_ENCRYPT) {
     const void *value;
     size_t valuelen;
 
-    if (!(value = sexp_nth_data(lvalue, 1, &valuelen)) || !valuelen)
+    if (!(value = sexp_view_nth_data(lvalue, 1, &valuelen)) || !valuelen)
       rc = GPG_ERR_INV_OBJ;
     else {
-      gcry_sexp_t list;
+      gcry_sexp_view_t list;
       void *random_override = NULL;
       size_t random_override_len = 0;
 
       /* Get HASH-ALGO. */
-      list = sexp_find_token(ldata, "hash-algo", 0);
-      if (list) {
-        s = sexp_nth_data(list, 1, &n);
+      list = sexp_view_find_token(ldata, "hash-algo", 0);
+      if (list.d) {
+        s = sexp_view_nth_data(list, 1, &n);
         if (!s)
           rc = GPG_ERR_NO_OBJ;
         else {
           ctx->hash_algo = get_hash_algo(s, n);
           if (!ctx->hash_algo) rc = GPG_ERR_DIGEST_ALGO;
         }
-        sexp_release(list);
         if (rc) goto leave;
       }
 
       /* Get LABEL. */
-      list = sexp_find_token(ldata, "label", 0);
-      if (list) {
-        s = sexp_nth_data(list, 1, &n);
+      list = sexp_view_find_token(ldata, "label", 0);
+      if (list.d) {
+        s = sexp_view_nth_data(list, 1, &n);
         if (!s)
           rc = GPG_ERR_NO_OBJ;
         else if (n > 0) {
@@ -793,13 +779,12 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
             ctx->labellen = n;
           }
         }
-        sexp_release(list);
         if (rc) goto leave;
       }
       /* Get optional RANDOM-OVERRIDE.  */
-      list = sexp_find_token(ldata, "random-override", 0);
-      if (list) {
-        s = sexp_nth_data(list, 1, &n);
+      list = sexp_view_find_token(ldata, "random-override", 0);
+      if (list.d) {
+        s = sexp_view_nth_data(list, 1, &n);
         if (!s)
           rc = GPG_ERR_NO_OBJ;
         else if (n > 0) {
@@ -811,7 +796,6 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
             random_override_len = n;
           }
         }
-        sexp_release(list);
         if (rc) goto leave;
       }
 
@@ -822,11 +806,11 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
 
       xfree(random_override);
     }
-  } else if (ctx->encoding == PUBKEY_ENC_PSS && lhash &&
+  } else if (ctx->encoding == PUBKEY_ENC_PSS && lhash.d &&
              ctx->op == PUBKEY_OP_SIGN) {
-    if (sexp_length(lhash) != 3)
+    if (sexp_view_length(lhash) != 3)
       rc = GPG_ERR_INV_OBJ;
-    else if (!(s = sexp_nth_data(lhash, 1, &n)) || !n)
+    else if (!(s = sexp_view_nth_data(lhash, 1, &n)) || !n)
       rc = GPG_ERR_INV_OBJ;
     else {
       const void *value;
@@ -838,27 +822,26 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
 
       if (!ctx->hash_algo)
         rc = GPG_ERR_DIGEST_ALGO;
-      else if (!(value = sexp_nth_data(lhash, 2, &valuelen)) || !valuelen)
+      else if (!(value = sexp_view_nth_data(lhash, 2, &valuelen)) || !valuelen)
         rc = GPG_ERR_INV_OBJ;
       else {
-        gcry_sexp_t list;
+        gcry_sexp_view_t list;
 
         /* Get SALT-LENGTH. */
-        list = sexp_find_token(ldata, "salt-length", 0);
-        if (list) {
-          s = sexp_nth_data(list, 1, &n);
+        list = sexp_view_find_token(ldata, "salt-length", 0);
+        if (list.d) {
+          s = sexp_view_nth_data(list, 1, &n);
           if (!s) {
             rc = GPG_ERR_NO_OBJ;
             goto leave;
           }
           ctx->saltlen = (unsigned int)strtoul(s, NULL, 10);
-          sexp_release(list);
         }
 
         /* Get optional RANDOM-OVERRIDE.  */
-        list = sexp_find_token(ldata, "random-override", 0);
-        if (list) {
-          s = sexp_nth_data(list, 1, &n);
+        list = sexp_view_find_token(ldata, "random-override", 0);
+        if (list.d) {
+          s = sexp_view_nth_data(list, 1, &n);
           if (!s)
             rc = GPG_ERR_NO_OBJ;
           else if (n > 0) {
@@ -870,7 +853,6 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
               random_override_len = n;
             }
           }
-          sexp_release(list);
           if (rc) goto leave;
         }
 
@@ -883,11 +865,11 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
         xfree(random_override);
       }
     }
-  } else if (ctx->encoding == PUBKEY_ENC_PSS && lhash &&
+  } else if (ctx->encoding == PUBKEY_ENC_PSS && lhash.d &&
              ctx->op == PUBKEY_OP_VERIFY) {
-    if (sexp_length(lhash) != 3)
+    if (sexp_view_length(lhash) != 3)
       rc = GPG_ERR_INV_OBJ;
-    else if (!(s = sexp_nth_data(lhash, 1, &n)) || !n)
+    else if (!(s = sexp_view_nth_data(lhash, 1, &n)) || !n)
       rc = GPG_ERR_INV_OBJ;
     else {
       ctx->hash_algo = get_hash_algo(s, n);
@@ -895,29 +877,26 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
       if (!ctx->hash_algo)
         rc = GPG_ERR_DIGEST_ALGO;
       else {
-        gcry_sexp_t list;
+        gcry_sexp_view_t list;
         /* Get SALT-LENGTH. */
-        list = sexp_find_token(ldata, "salt-length", 0);
-        if (list) {
+        list = sexp_view_find_token(ldata, "salt-length", 0);
+        if (list.d) {
           unsigned long ul;
 
-          s = sexp_nth_data(list, 1, &n);
+          s = sexp_view_nth_data(list, 1, &n);
           if (!s) {
             rc = GPG_ERR_NO_OBJ;
-            sexp_release(list);
             goto leave;
           }
           ul = strtoul(s, NULL, 10);
           if (ul > 16384) {
             rc = GPG_ERR_TOO_LARGE;
-            sexp_release(list);
             goto leave;
           }
           ctx->saltlen = ul;
-          sexp_release(list);
         }
 
-        *ret_mpi = sexp_nth_mpi(lhash, 2, GCRYMPI_FMT_USG);
+        *ret_mpi = sexp_view_nth_mpi(lhash, 2, GCRYMPI_FMT_USG);
         if (!*ret_mpi) rc = GPG_ERR_INV_OBJ;
         ctx->verify_cmp = pss_verify_cmp;
         ctx->verify_arg = *ret_mpi;
@@ -927,10 +906,6 @@ gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
     rc = GPG_ERR_CONFLICT;
 
 leave:
-  sexp_release(ldata);
-  sexp_release(lhash);
-  sexp_release(lvalue);
-
   if (!rc)
     ctx->flags = parsed_flags;
   else {
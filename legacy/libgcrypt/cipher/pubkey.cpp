@@ -399,6 +399,77 @@ leave:
   return rc;
 }
 
+/*
+   Verify several signatures at once.
+
+   Each S_SIGS[i], S_HASHES[i] and S_PKEYS[i] is checked as by
+   _gcry_pk_verify and the result is stored at RCS[i].  Algorithms
+   which support it verify their signatures together, which is faster
+   than one at a time.  Returns 0 if all signatures verify, else the
+   first error.  */
+gpg_error_t _gcry_pk_verify_batch(gcry_sexp_t *s_sigs, gcry_sexp_t *s_hashes,
+                                  gcry_sexp_t *s_pkeys, gpg_error_t *rcs,
+                                  unsigned int n) {
+  gpg_error_t rc = 0;
+  gcry_pk_spec_t **specs;
+  gcry_sexp_t *keyparms;
+  gcry_sexp_t *sigs, *hashes, *parms;
+  unsigned int *idx;
+  unsigned int i, j, m;
+
+  specs = (gcry_pk_spec_t **)xcalloc(n ? n : 1, sizeof *specs);
+  keyparms = (gcry_sexp_t *)xcalloc(n ? n : 1, sizeof *keyparms);
+  for (i = 0; i < n; i++) {
+    rcs[i] = spec_from_sexp(s_pkeys[i], 0, &specs[i], &keyparms[i]);
+    if (rcs[i])
+      specs[i] = NULL;
+    else if (!specs[i]->verify) {
+      rcs[i] = GPG_ERR_NOT_IMPLEMENTED;
+      specs[i] = NULL;
+    } else if (!specs[i]->verify_batch) {
+      rcs[i] = specs[i]->verify(s_sigs[i], s_hashes[i], keyparms[i]);
+      specs[i] = NULL;
+    }
+  }
+
+  /* Hand the remaining signatures to their algorithms, all
+     signatures of one algorithm at once.  */
+  sigs = (gcry_sexp_t *)xcalloc(n ? n : 1, sizeof *sigs);
+  hashes = (gcry_sexp_t *)xcalloc(n ? n : 1, sizeof *hashes);
+  parms = (gcry_sexp_t *)xcalloc(n ? n : 1, sizeof *parms);
+  idx = (unsigned int *)xcalloc(n ? n : 1, sizeof *idx);
+  for (i = 0; i < n; i++) {
+    gcry_pk_spec_t *spec = specs[i];
+    gpg_error_t *results;
+
+    if (!spec) continue;
+    for (m = 0, j = i; j < n; j++)
+      if (specs[j] == spec) {
+        sigs[m] = s_sigs[j];
+        hashes[m] = s_hashes[j];
+        parms[m] = keyparms[j];
+        idx[m++] = j;
+        specs[j] = NULL;
+      }
+    results = (gpg_error_t *)xcalloc(m, sizeof *results);
+    spec->verify_batch(sigs, hashes, parms, results, m);
+    for (j = 0; j < m; j++) rcs[idx[j]] = results[j];
+    xfree(results);
+  }
+
+  for (i = 0; i < n; i++) {
+    sexp_release(keyparms[i]);
+    if (!rc) rc = rcs[i];
+  }
+  xfree(specs);
+  xfree(keyparms);
+  xfree(sigs);
+  xfree(hashes);
+  xfree(parms);
+  xfree(idx);
+  return rc;
+}
+
 /*
    Test a key.
 
@@ -46,6 +46,10 @@ typedef struct {
   gcry_mpi_t p; /* prime  p. */
   gcry_mpi_t q; /* prime  q. */
   gcry_mpi_t u; /* inverse of p mod q. */
+  /* Montgomery contexts for N, P and Q, created on first use.  */
+  mpi_mont_t mont_n;
+  mpi_mont_t mont_p;
+  mpi_mont_t mont_q;
 } RSA_secret_key;
 
 static const char *rsa_names[] = {
@@ -108,6 +112,7 @@ static int test_keys(RSA_secret_key *sk, unsigned nbits);
 static int check_secret_key(RSA_secret_key *sk);
 static void public_x(gcry_mpi_t output, gcry_mpi_t input, RSA_public_key *skey);
 static void secret(gcry_mpi_t output, gcry_mpi_t input, RSA_secret_key *skey);
+static void release_mont(RSA_secret_key *sk);
 static unsigned int rsa_get_nbits(gcry_sexp_t parms);
 
 /* Check that a freshly generated key actually works.  Returns 0 on success. */
@@ -160,6 +165,7 @@ static int test_keys(RSA_secret_key *sk, unsigned int nbits) {
   result = 0; /* All tests succeeded.  */
 
 leave:
+  release_mont(sk);
   _gcry_mpi_release(signature);
   _gcry_mpi_release(decr_plaintext);
   _gcry_mpi_release(ciphertext);
@@ -882,13 +888,33 @@ stronger_key_check ( RSA_secret_key *skey )
 }
 #endif
 
+/* Compute W = B^E mod M using the Montgomery context at R_MONT,
+ * which is created on first use so that further operations with the
+ * same modulus need not compute its constants again.  */
+static void powm_cached(gcry_mpi_t w, gcry_mpi_t b, gcry_mpi_t e,
+                        gcry_mpi_t m, mpi_mont_t *r_mont) {
+  if (!*r_mont) *r_mont = mpi_mont_new(m);
+  if (*r_mont)
+    mpi_powm_mont(w, b, e, *r_mont);
+  else
+    mpi_powm(w, b, e, m);
+}
+
+/* Release the Montgomery contexts cached in SK.  */
+static void release_mont(RSA_secret_key *sk) {
+  mpi_mont_free(sk->mont_n);
+  mpi_mont_free(sk->mont_p);
+  mpi_mont_free(sk->mont_q);
+  sk->mont_n = sk->mont_p = sk->mont_q = NULL;
+}
+
 /* Secret key operation - standard version.
  *
  *	m = c^d mod n
  */
 static void secret_core_std(gcry_mpi_t M, gcry_mpi_t C, gcry_mpi_t D,
-                            gcry_mpi_t N) {
-  mpi_powm(M, C, D, N);
+                            gcry_mpi_t N, mpi_mont_t *r_mont_n) {
+  powm_cached(M, C, D, N, r_mont_n);
 }
 
 /* Secret key operation - using the CRT.
@@ -900,7 +926,8 @@ static void secret_core_std(gcry_mpi_t M, gcry_mpi_t C, gcry_mpi_t D,
  */
 static void secret_core_crt(gcry_mpi_t M, gcry_mpi_t C, gcry_mpi_t D,
                             unsigned int Nlimbs, gcry_mpi_t P, gcry_mpi_t Q,
-                            gcry_mpi_t U) {
+                            gcry_mpi_t U, mpi_mont_t *r_mont_p,
+                            mpi_mont_t *r_mont_q) {
   gcry_mpi_t m1 = mpi_alloc_secure(Nlimbs + 1);
   gcry_mpi_t m2 = mpi_alloc_secure(Nlimbs + 1);
   gcry_mpi_t h = mpi_alloc_secure(Nlimbs + 1);
@@ -920,7 +947,7 @@ static void secret_core_crt(gcry_mpi_t M, gcry_mpi_t C, gcry_mpi_t D,
   mpi_mul(D_blind, h, r);
   mpi_fdiv_r(h, D, h);
   mpi_add(D_blind, D_blind, h);
-  mpi_powm(m1, C, D_blind, P);
+  powm_cached(m1, C, D_blind, P, r_mont_p);
 
   /* d_blind = (d mod (q-1)) + (q-1) * r            */
   /* m2 = c ^ d_blind mod q */
@@ -930,7 +957,7 @@ static void secret_core_crt(gcry_mpi_t M, gcry_mpi_t C, gcry_mpi_t D,
   mpi_mul(D_blind, h, r);
   mpi_fdiv_r(h, D, h);
   mpi_add(D_blind, D_blind, h);
-  mpi_powm(m2, C, D_blind, Q);
+  powm_cached(m2, C, D_blind, Q, r_mont_q);
 
   mpi_free(r);
   mpi_free(D_blind);
@@ -958,10 +985,10 @@ static void secret(gcry_mpi_t output, gcry_mpi_t input, RSA_secret_key *skey) {
   mpi_normalize(input);
 
   if (!skey->p || !skey->q || !skey->u) {
-    secret_core_std(output, input, skey->d, skey->n);
+    secret_core_std(output, input, skey->d, skey->n, &skey->mont_n);
   } else {
     secret_core_crt(output, input, skey->d, mpi_get_nlimbs(skey->n), skey->p,
-                    skey->q, skey->u);
+                    skey->q, skey->u, &skey->mont_p, &skey->mont_q);
   }
 }
 
@@ -988,7 +1015,7 @@ static void secret_blinded(gcry_mpi_t output, gcry_mpi_t input,
   /* Do blinding.  We calculate: y = (x * r^e) mod n, where r is the
    * random number, e is the public exponent, x is the non-blinded
    * input data and n is the RSA modulus.  */
-  mpi_powm(bldata, r, sk->e, sk->n);
+  powm_cached(bldata, r, sk->e, sk->n, &sk->mont_n);
   mpi_mulm(bldata, bldata, input, sk->n);
 
   /* Perform decryption.  */
@@ -1272,6 +1299,7 @@ leave:
   _gcry_mpi_release(sk.p);
   _gcry_mpi_release(sk.q);
   _gcry_mpi_release(sk.u);
+  release_mont(&sk);
   _gcry_mpi_release(data);
   sexp_release(l1);
   _gcry_pk_util_free_encoding_ctx(&ctx);
@@ -1285,7 +1313,6 @@ static gpg_error_t rsa_sign(gcry_sexp_t *r_sig, gcry_sexp_t s_data,
   struct pk_encoding_ctx ctx;
   gcry_mpi_t data = NULL;
   RSA_secret_key sk = {NULL, NULL, NULL, NULL, NULL, NULL};
-  RSA_public_key pk;
   gcry_mpi_t sig = NULL;
   gcry_mpi_t result = NULL;
 
@@ -1325,9 +1352,7 @@ static gpg_error_t rsa_sign(gcry_sexp_t *r_sig, gcry_sexp_t s_data,
   /* Check that the created signature is good.  This detects a failure
      of the CRT algorithm  (Lenstra's attack on RSA's use of the CRT).  */
   result = mpi_new(0);
-  pk.n = sk.n;
-  pk.e = sk.e;
-  public_x(result, sig, &pk);
+  powm_cached(result, sig, sk.e, sk.n, &sk.mont_n);
   if (mpi_cmp(result, data)) {
     rc = GPG_ERR_BAD_SIGNATURE;
     goto leave;
@@ -1357,6 +1382,7 @@ leave:
   _gcry_mpi_release(sk.p);
   _gcry_mpi_release(sk.q);
   _gcry_mpi_release(sk.u);
+  release_mont(&sk);
   _gcry_mpi_release(data);
   _gcry_pk_util_free_encoding_ctx(&ctx);
   if (DBG_CIPHER) log_debug("rsa_sign      => %s\n", gpg_strerror(rc));
@@ -268,6 +268,77 @@ static unsigned int transform_blk(void *ctx, const unsigned char *data) {
   return /* burn_stack */ 88 + 4 * sizeof(void *);
 }
 
+#ifdef USE_MD_MULTI
+/* The same rounds on vectors with one message in each lane.  The
+   round macros above are reused with a vector rotate in place of the
+   scalar one.  */
+#define rol(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define XM(i) ((i) < 16 ? x[i] : M(i))
+
+static inline __attribute__((always_inline)) void transform_multi_core(
+    md_multi_vec_t *state, const md_multi_vec_t *w) {
+  md_multi_vec_t a, b, c, d, e, tm;
+  md_multi_vec_t x[16];
+  int i;
+
+  memcpy(x, w, sizeof x);
+  a = state[0];
+  b = state[1];
+  c = state[2];
+  d = state[3];
+  e = state[4];
+
+  for (i = 0; i < 20; i += 5) {
+    R(a, b, c, d, e, F1, (u32)K1, XM(i + 0));
+    R(e, a, b, c, d, F1, (u32)K1, XM(i + 1));
+    R(d, e, a, b, c, F1, (u32)K1, XM(i + 2));
+    R(c, d, e, a, b, F1, (u32)K1, XM(i + 3));
+    R(b, c, d, e, a, F1, (u32)K1, XM(i + 4));
+  }
+  for (; i < 40; i += 5) {
+    R(a, b, c, d, e, F2, (u32)K2, M(i + 0));
+    R(e, a, b, c, d, F2, (u32)K2, M(i + 1));
+    R(d, e, a, b, c, F2, (u32)K2, M(i + 2));
+    R(c, d, e, a, b, F2, (u32)K2, M(i + 3));
+    R(b, c, d, e, a, F2, (u32)K2, M(i + 4));
+  }
+  for (; i < 60; i += 5) {
+    R(a, b, c, d, e, F3, (u32)K3, M(i + 0));
+    R(e, a, b, c, d, F3, (u32)K3, M(i + 1));
+    R(d, e, a, b, c, F3, (u32)K3, M(i + 2));
+    R(c, d, e, a, b, F3, (u32)K3, M(i + 3));
+    R(b, c, d, e, a, F3, (u32)K3, M(i + 4));
+  }
+  for (; i < 80; i += 5) {
+    R(a, b, c, d, e, F4, (u32)K4, M(i + 0));
+    R(e, a, b, c, d, F4, (u32)K4, M(i + 1));
+    R(d, e, a, b, c, F4, (u32)K4, M(i + 2));
+    R(c, d, e, a, b, F4, (u32)K4, M(i + 3));
+    R(b, c, d, e, a, F4, (u32)K4, M(i + 4));
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+#undef XM
+#undef rol
+
+static void transform_multi(md_multi_vec_t *state, const md_multi_vec_t *w) {
+  transform_multi_core(state, w);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_MD_MULTI_AVX2 1
+static __attribute__((target("avx2"))) void transform_multi_avx2(
+    md_multi_vec_t *state, const md_multi_vec_t *w) {
+  transform_multi_core(state, w);
+}
+#endif
+#endif /*USE_MD_MULTI*/
+
 /* Assembly implementations use SystemV ABI, ABI conversion and additional
  * stack to store XMM6-XMM15 needed on Win64. */
 #undef ASM_FUNC_ABI
@@ -468,6 +539,26 @@ void _gcry_sha1_hash_buffers(void *outbuf, const gcry_buffer_t *iov,
   memcpy(outbuf, hd.bctx.buf, 20);
 }
 
+#ifdef USE_MD_MULTI
+/* Hash each of the IOVCNT buffers at IOV as a separate message and
+   store the 20 byte digests one after the other at OUTBUF.  */
+void _gcry_sha1_hash_buffers_multi(void *outbuf, const gcry_buffer_t *iov,
+                                   int iovcnt) {
+  static const u32 iv[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476,
+                            0xc3d2e1f0};
+  _gcry_md_multi_transform_t fnc = transform_multi;
+
+#ifdef USE_MD_MULTI_AVX2
+  /* The initialization of a local static is thread-safe.  */
+  static const int use_avx2 =
+      __builtin_cpu_supports("avx2") && !getenv("GCRYPT_NO_MD_MULTI_AVX2");
+
+  if (use_avx2) fnc = transform_multi_avx2;
+#endif
+  _gcry_md_multi_hash_buffers(outbuf, iov, iovcnt, iv, 5, fnc);
+}
+#endif /*USE_MD_MULTI*/
+
 /*
      Self-test section.
  */
@@ -182,21 +182,21 @@ static void sha224_init(void *context, unsigned int flags) {
   (w[i & 0x0f] = S1(w[(i - 2) & 0x0f]) + w[(i - 7) & 0x0f] + \
                  S0(w[(i - 15) & 0x0f]) + w[(i - 16) & 0x0f])
 
+static const u32 K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
 static unsigned int transform_blk(void *ctx, const unsigned char *data) {
   SHA256_CONTEXT *hd = (SHA256_CONTEXT *)ctx;
-  static const u32 K[64] = {
-      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
-      0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
-      0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
-      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
-      0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
-      0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
-
   u32 a, b, c, d, e, f, g, h, t1, t2;
   u32 w[16];
 
@@ -288,6 +288,65 @@ static unsigned int transform_blk(void *ctx, const unsigned char *data) {
 
   return /*burn_stack*/ 26 * 4 + 32;
 }
+
+#ifdef USE_MD_MULTI
+/* The same rounds on vectors with one message in each lane.  The
+   round macros above are reused with a vector rotate in place of the
+   scalar one.  */
+#define ror(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define WM(i) ((i) < 16 ? w[i] : W(i))
+
+static inline __attribute__((always_inline)) void transform_multi_core(
+    md_multi_vec_t *state, const md_multi_vec_t *x) {
+  md_multi_vec_t a, b, c, d, e, f, g, h, t1, t2;
+  md_multi_vec_t w[16];
+  int i;
+
+  memcpy(w, x, sizeof w);
+  a = state[0];
+  b = state[1];
+  c = state[2];
+  d = state[3];
+  e = state[4];
+  f = state[5];
+  g = state[6];
+  h = state[7];
+
+  for (i = 0; i < 64; i += 8) {
+    R(a, b, c, d, e, f, g, h, K[i + 0], WM(i + 0));
+    R(h, a, b, c, d, e, f, g, K[i + 1], WM(i + 1));
+    R(g, h, a, b, c, d, e, f, K[i + 2], WM(i + 2));
+    R(f, g, h, a, b, c, d, e, K[i + 3], WM(i + 3));
+    R(e, f, g, h, a, b, c, d, K[i + 4], WM(i + 4));
+    R(d, e, f, g, h, a, b, c, K[i + 5], WM(i + 5));
+    R(c, d, e, f, g, h, a, b, K[i + 6], WM(i + 6));
+    R(b, c, d, e, f, g, h, a, K[i + 7], WM(i + 7));
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+#undef WM
+#undef ror
+
+static void transform_multi(md_multi_vec_t *state, const md_multi_vec_t *w) {
+  transform_multi_core(state, w);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_MD_MULTI_AVX2 1
+static __attribute__((target("avx2"))) void transform_multi_avx2(
+    md_multi_vec_t *state, const md_multi_vec_t *w) {
+  transform_multi_core(state, w);
+}
+#endif
+#endif /*USE_MD_MULTI*/
 #undef S0
 #undef S1
 #undef R
@@ -469,6 +528,26 @@ void _gcry_sha256_hash_buffers(void *outbuf, const gcry_buffer_t *iov,
   memcpy(outbuf, hd.bctx.buf, 32);
 }
 
+#ifdef USE_MD_MULTI
+/* Hash each of the IOVCNT buffers at IOV as a separate message and
+   store the 32 byte digests one after the other at OUTBUF.  */
+void _gcry_sha256_hash_buffers_multi(void *outbuf, const gcry_buffer_t *iov,
+                                     int iovcnt) {
+  static const u32 iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  _gcry_md_multi_transform_t fnc = transform_multi;
+
+#ifdef USE_MD_MULTI_AVX2
+  /* The initialization of a local static is thread-safe.  */
+  static const int use_avx2 =
+      __builtin_cpu_supports("avx2") && !getenv("GCRYPT_NO_MD_MULTI_AVX2");
+
+  if (use_avx2) fnc = transform_multi_avx2;
+#endif
+  _gcry_md_multi_hash_buffers(outbuf, iov, iovcnt, iv, 8, fnc);
+}
+#endif /*USE_MD_MULTI*/
+
 /*
      Self-test section.
  */
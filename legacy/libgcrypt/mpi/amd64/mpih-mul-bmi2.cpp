@@ -0,0 +1,184 @@
+/* mpih-mul-bmi2.c  -  x86-64 MPI helper functions using MULX and ADX
+ * Copyright (C) 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * These are drop-in replacements for the generic mul_1, addmul_1 and
+ * submul_1 loops.  MULX does not touch the flags, so the carry of the
+ * product chain and the carry of the accumulation can be kept in CF
+ * and OF (ADCX/ADOX) at the same time.  The loop counter lives in RCX
+ * and is tested with JRCXZ, which does not touch the flags either.
+ * The functions are selected at runtime by _gcry_mpi_init if the CPU
+ * supports BMI2 and ADX.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mpi-internal.h"
+
+#ifdef USE_MPIH_BMI2
+
+/* One limb of RES = S1 * S2_LIMB.  The product chain runs through
+   CF; H0 holds the high part of the previous limb and H1 receives
+   the high part of this one.  */
+#define MUL_1_STEP(off, h0, h1)                       \
+  "mulx " off "(%[up]), %[lo], %[" h1 "]\n\t"         \
+  "adcx %[" h0 "], %[lo]\n\t"                         \
+  "movq %[lo], " off "(%[rp])\n\t"
+
+mpi_limb_t _gcry_mpih_mul_1_bmi2(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                 mpi_size_t s1_size, mpi_limb_t s2_limb) {
+  mpi_limb_t h0 = 0, h1, lo;
+  mpi_limb_t n4 = s1_size >> 2;
+  mpi_limb_t n1 = s1_size & 3;
+
+  __asm__ volatile(
+      "xorl %k[lo], %k[lo]\n" /* Clear CF.  */
+      "1:\n\t"
+      "jrcxz 2f\n\t"
+      MUL_1_STEP("0", "h0", "h1")
+      MUL_1_STEP("8", "h1", "h0")
+      MUL_1_STEP("16", "h0", "h1")
+      MUL_1_STEP("24", "h1", "h0")
+      "leaq 32(%[up]), %[up]\n\t"
+      "leaq 32(%[rp]), %[rp]\n\t"
+      "leaq -1(%%rcx), %%rcx\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "movq %[n1], %%rcx\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      MUL_1_STEP("0", "h0", "h1")
+      "movq %[h1], %[h0]\n\t"
+      "leaq 8(%[up]), %[up]\n\t"
+      "leaq 8(%[rp]), %[rp]\n\t"
+      "leaq -1(%%rcx), %%rcx\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "movl $0, %k[lo]\n\t"
+      "adcx %[lo], %[h0]\n\t"
+      : [h0] "+&r"(h0), [h1] "=&r"(h1), [lo] "=&r"(lo), [up] "+r"(s1_ptr),
+        [rp] "+r"(res_ptr), "+c"(n4)
+      : [n1] "r"(n1), "d"(s2_limb)
+      : "cc", "memory");
+
+  return h0;
+}
+
+/* One limb of RES += S1 * S2_LIMB.  The product chain runs through CF
+   and the accumulation into RES through OF.  */
+#define ADDMUL_1_STEP(off, h0, h1)                    \
+  "mulx " off "(%[up]), %[lo], %[" h1 "]\n\t"         \
+  "adcx %[" h0 "], %[lo]\n\t"                         \
+  "adox " off "(%[rp]), %[lo]\n\t"                    \
+  "movq %[lo], " off "(%[rp])\n\t"
+
+mpi_limb_t _gcry_mpih_addmul_1_adx(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                   mpi_size_t s1_size, mpi_limb_t s2_limb) {
+  mpi_limb_t h0 = 0, h1, lo;
+  mpi_limb_t n4 = s1_size >> 2;
+  mpi_limb_t n1 = s1_size & 3;
+
+  __asm__ volatile(
+      "xorl %k[lo], %k[lo]\n" /* Clear CF and OF.  */
+      "1:\n\t"
+      "jrcxz 2f\n\t"
+      ADDMUL_1_STEP("0", "h0", "h1")
+      ADDMUL_1_STEP("8", "h1", "h0")
+      ADDMUL_1_STEP("16", "h0", "h1")
+      ADDMUL_1_STEP("24", "h1", "h0")
+      "leaq 32(%[up]), %[up]\n\t"
+      "leaq 32(%[rp]), %[rp]\n\t"
+      "leaq -1(%%rcx), %%rcx\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "movq %[n1], %%rcx\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      ADDMUL_1_STEP("0", "h0", "h1")
+      "movq %[h1], %[h0]\n\t"
+      "leaq 8(%[up]), %[up]\n\t"
+      "leaq 8(%[rp]), %[rp]\n\t"
+      "leaq -1(%%rcx), %%rcx\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "movl $0, %k[lo]\n\t"
+      "adcx %[lo], %[h0]\n\t"
+      "adox %[lo], %[h0]\n\t"
+      : [h0] "+&r"(h0), [h1] "=&r"(h1), [lo] "=&r"(lo), [up] "+r"(s1_ptr),
+        [rp] "+r"(res_ptr), "+c"(n4)
+      : [n1] "r"(n1), "d"(s2_limb)
+      : "cc", "memory");
+
+  return h0;
+}
+
+/* One limb of RES -= S1 * S2_LIMB.  The product chain runs through CF.
+   The subtraction is done as an addition of the complement through
+   OF, which starts out set to supply the +1 of the two's
+   complement.  */
+#define SUBMUL_1_STEP(off, h0, h1)                    \
+  "mulx " off "(%[up]), %[lo], %[" h1 "]\n\t"         \
+  "adcx %[" h0 "], %[lo]\n\t"                         \
+  "notq %[lo]\n\t"                                    \
+  "adox " off "(%[rp]), %[lo]\n\t"                    \
+  "movq %[lo], " off "(%[rp])\n\t"
+
+mpi_limb_t _gcry_mpih_submul_1_bmi2(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                    mpi_size_t s1_size, mpi_limb_t s2_limb) {
+  mpi_limb_t h0 = 0, h1, lo;
+  mpi_limb_t n4 = s1_size >> 2;
+  mpi_limb_t n1 = s1_size & 3;
+
+  __asm__ volatile(
+      /* Set OF and clear CF.  */
+      "movq $0x7fffffffffffffff, %[lo]\n\t"
+      "addq $1, %[lo]\n"
+      "1:\n\t"
+      "jrcxz 2f\n\t"
+      SUBMUL_1_STEP("0", "h0", "h1")
+      SUBMUL_1_STEP("8", "h1", "h0")
+      SUBMUL_1_STEP("16", "h0", "h1")
+      SUBMUL_1_STEP("24", "h1", "h0")
+      "leaq 32(%[up]), %[up]\n\t"
+      "leaq 32(%[rp]), %[rp]\n\t"
+      "leaq -1(%%rcx), %%rcx\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "movq %[n1], %%rcx\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      SUBMUL_1_STEP("0", "h0", "h1")
+      "movq %[h1], %[h0]\n\t"
+      "leaq 8(%[up]), %[up]\n\t"
+      "leaq 8(%[rp]), %[rp]\n\t"
+      "leaq -1(%%rcx), %%rcx\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "movl $0, %k[lo]\n\t"
+      "adcx %[lo], %[h0]\n\t"
+      "seto %b[lo]\n\t"
+      : [h0] "+&r"(h0), [h1] "=&r"(h1), [lo] "=&r"(lo), [up] "+r"(s1_ptr),
+        [rp] "+r"(res_ptr), "+c"(n4)
+      : [n1] "r"(n1), "d"(s2_limb)
+      : "cc", "memory");
+
+  /* A clear OF is a borrow out of the complement addition.  */
+  return h0 + 1 - lo;
+}
+
+#endif /*USE_MPIH_BMI2*/
@@ -21,11 +21,180 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "context.h"
 #include "ec-context.h"
+#include "ec-internal.h"
 #include "g10lib.h"
 #include "longlong.h"
 #include "mpi-internal.h"
 
 void _gcry_mpi_ec_ed25519_mod(gcry_mpi_t a) { (void)a; }
+
+#ifdef __SIZEOF_INT128__
+
+/* Arithmetic in GF(2^255 - 19) with radix 2^51: An element is
+   represented by 5 limbs of 51 bits each.  After each operation the
+   limbs are at most a few bits larger than 51 bits so that the next
+   operation cannot overflow.  */
+
+typedef unsigned __int128 fe25519_u128;
+
+#define FE25519_MASK ((((uint64_t)1) << 51) - 1)
+
+/* Propagate the carries of R, folding the top carry back to the
+   lowest limb.  */
+static void fe25519_carry(ec_fe_t r) {
+  r[1] += r[0] >> 51;
+  r[0] &= FE25519_MASK;
+  r[2] += r[1] >> 51;
+  r[1] &= FE25519_MASK;
+  r[3] += r[2] >> 51;
+  r[2] &= FE25519_MASK;
+  r[4] += r[3] >> 51;
+  r[3] &= FE25519_MASK;
+  r[0] += 19 * (r[4] >> 51);
+  r[4] &= FE25519_MASK;
+}
+
+static void fe25519_from_words(ec_fe_t r, const uint64_t w[4]) {
+  r[0] = w[0] & FE25519_MASK;
+  r[1] = ((w[0] >> 51) | (w[1] << 13)) & FE25519_MASK;
+  r[2] = ((w[1] >> 38) | (w[2] << 26)) & FE25519_MASK;
+  r[3] = ((w[2] >> 25) | (w[3] << 39)) & FE25519_MASK;
+  r[4] = w[3] >> 12;
+  fe25519_carry(r);
+}
+
+/* This follows fcontract from curve25519-donna.  */
+static void fe25519_to_words(uint64_t w[4], const ec_fe_t a) {
+  uint64_t t[5];
+
+  memcpy(t, a, sizeof t);
+  fe25519_carry(t);
+  fe25519_carry(t);
+
+  /* T is now in [0, 2^255).  Add 19 so that values >= P carry into
+     bit 255, and drop that bit after subtracting 19 again.  */
+  t[0] += 19;
+  fe25519_carry(t);
+
+  t[0] += FE25519_MASK + 1 - 19;
+  t[1] += FE25519_MASK;
+  t[2] += FE25519_MASK;
+  t[3] += FE25519_MASK;
+  t[4] += FE25519_MASK;
+
+  t[1] += t[0] >> 51;
+  t[0] &= FE25519_MASK;
+  t[2] += t[1] >> 51;
+  t[1] &= FE25519_MASK;
+  t[3] += t[2] >> 51;
+  t[2] &= FE25519_MASK;
+  t[4] += t[3] >> 51;
+  t[3] &= FE25519_MASK;
+  t[4] &= FE25519_MASK;
+
+  w[0] = t[0] | (t[1] << 51);
+  w[1] = (t[1] >> 13) | (t[2] << 38);
+  w[2] = (t[2] >> 26) | (t[3] << 25);
+  w[3] = (t[3] >> 39) | (t[4] << 12);
+}
+
+static void fe25519_add(ec_fe_t r, const ec_fe_t a, const ec_fe_t b) {
+  int i;
+
+  for (i = 0; i < 5; i++) r[i] = a[i] + b[i];
+  fe25519_carry(r);
+}
+
+/* R = A - B computed as A + 4P - B so that no limb gets negative.  */
+static void fe25519_sub(ec_fe_t r, const ec_fe_t a, const ec_fe_t b) {
+  r[0] = a[0] + 4 * (FE25519_MASK - 18) - b[0];
+  r[1] = a[1] + 4 * FE25519_MASK - b[1];
+  r[2] = a[2] + 4 * FE25519_MASK - b[2];
+  r[3] = a[3] + 4 * FE25519_MASK - b[3];
+  r[4] = a[4] + 4 * FE25519_MASK - b[4];
+  fe25519_carry(r);
+}
+
+static void fe25519_mul(ec_fe_t r, const ec_fe_t a, const ec_fe_t b) {
+  fe25519_u128 t0, t1, t2, t3, t4;
+  uint64_t b1_19 = 19 * b[1];
+  uint64_t b2_19 = 19 * b[2];
+  uint64_t b3_19 = 19 * b[3];
+  uint64_t b4_19 = 19 * b[4];
+  uint64_t c;
+
+#define M(x, y) ((fe25519_u128)(x) * (y))
+  t0 = M(a[0], b[0]) + M(a[1], b4_19) + M(a[2], b3_19) + M(a[3], b2_19) +
+       M(a[4], b1_19);
+  t1 = M(a[0], b[1]) + M(a[1], b[0]) + M(a[2], b4_19) + M(a[3], b3_19) +
+       M(a[4], b2_19);
+  t2 = M(a[0], b[2]) + M(a[1], b[1]) + M(a[2], b[0]) + M(a[3], b4_19) +
+       M(a[4], b3_19);
+  t3 = M(a[0], b[3]) + M(a[1], b[2]) + M(a[2], b[1]) + M(a[3], b[0]) +
+       M(a[4], b4_19);
+  t4 = M(a[0], b[4]) + M(a[1], b[3]) + M(a[2], b[2]) + M(a[3], b[1]) +
+       M(a[4], b[0]);
+#undef M
+
+  t1 += (uint64_t)(t0 >> 51);
+  t2 += (uint64_t)(t1 >> 51);
+  t3 += (uint64_t)(t2 >> 51);
+  t4 += (uint64_t)(t3 >> 51);
+  c = (uint64_t)(t4 >> 51);
+
+  r[0] = ((uint64_t)t0 & FE25519_MASK) + 19 * c;
+  r[1] = (uint64_t)t1 & FE25519_MASK;
+  r[2] = (uint64_t)t2 & FE25519_MASK;
+  r[3] = (uint64_t)t3 & FE25519_MASK;
+  r[4] = (uint64_t)t4 & FE25519_MASK;
+  r[1] += r[0] >> 51;
+  r[0] &= FE25519_MASK;
+}
+
+static void fe25519_sqr(ec_fe_t r, const ec_fe_t a) {
+  fe25519_u128 t0, t1, t2, t3, t4;
+  uint64_t d0 = 2 * a[0];
+  uint64_t d1 = 2 * a[1];
+  uint64_t a3_19 = 19 * a[3];
+  uint64_t a4_19 = 19 * a[4];
+  uint64_t c;
+
+#define M(x, y) ((fe25519_u128)(x) * (y))
+  t0 = M(a[0], a[0]) + M(2 * a[1], a4_19) + M(2 * a[2], a3_19);
+  t1 = M(d0, a[1]) + M(2 * a[2], a4_19) + M(a[3], a3_19);
+  t2 = M(d0, a[2]) + M(a[1], a[1]) + M(2 * a[3], a4_19);
+  t3 = M(d0, a[3]) + M(d1, a[2]) + M(a[4], a4_19);
+  t4 = M(d0, a[4]) + M(d1, a[3]) + M(a[2], a[2]);
+#undef M
+
+  t1 += (uint64_t)(t0 >> 51);
+  t2 += (uint64_t)(t1 >> 51);
+  t3 += (uint64_t)(t2 >> 51);
+  t4 += (uint64_t)(t3 >> 51);
+  c = (uint64_t)(t4 >> 51);
+
+  r[0] = ((uint64_t)t0 & FE25519_MASK) + 19 * c;
+  r[1] = (uint64_t)t1 & FE25519_MASK;
+  r[2] = (uint64_t)t2 & FE25519_MASK;
+  r[3] = (uint64_t)t3 & FE25519_MASK;
+  r[4] = (uint64_t)t4 & FE25519_MASK;
+  r[1] += r[0] >> 51;
+  r[0] &= FE25519_MASK;
+}
+
+const struct ec_field_s _gcry_ec_field_25519 = {
+    "2^255-19",
+    {0xffffffffffffffed, 0xffffffffffffffff, 0xffffffffffffffff,
+     0x7fffffffffffffff},
+    fe25519_from_words,
+    fe25519_to_words,
+    fe25519_add,
+    fe25519_sub,
+    fe25519_mul,
+    fe25519_sqr};
+
+#endif /*__SIZEOF_INT128__*/
@@ -20,6 +20,38 @@
 #ifndef GCRY_EC_INTERNAL_H
 #define GCRY_EC_INTERNAL_H
 
+#include <stdint.h>
+
 void _gcry_mpi_ec_ed25519_mod(gcry_mpi_t a);
 
+/* Fixed-size field arithmetic for some well-known primes.  A field
+   element is stored in an ec_fe_t using a representation private to
+   the backend.  All functions run in constant time and allow the
+   result to overlap with the arguments.  */
+typedef uint64_t ec_fe_t[5];
+
+struct ec_field_s {
+  const char *name;
+  uint64_t p[4]; /* The prime as little endian 64 bit words.  */
+
+  /* Convert the value W < 2^256 into the field element R.  */
+  void (*from_words)(ec_fe_t r, const uint64_t w[4]);
+  /* Convert A into its fully reduced value W.  */
+  void (*to_words)(uint64_t w[4], const ec_fe_t a);
+
+  void (*add)(ec_fe_t r, const ec_fe_t a, const ec_fe_t b);
+  void (*sub)(ec_fe_t r, const ec_fe_t a, const ec_fe_t b);
+  void (*mul)(ec_fe_t r, const ec_fe_t a, const ec_fe_t b);
+  void (*sqr)(ec_fe_t r, const ec_fe_t a);
+};
+typedef const struct ec_field_s *ec_field_t;
+
+#ifdef __SIZEOF_INT128__
+/*-- ec-ed25519.c --*/
+extern const struct ec_field_s _gcry_ec_field_25519;
+
+/*-- ec-nist.c --*/
+extern const struct ec_field_s _gcry_ec_field_nistp256;
+#endif /*__SIZEOF_INT128__*/
+
 #endif /*GCRY_EC_INTERNAL_H*/
@@ -0,0 +1,168 @@
+/* ec-nist.c -  NIST optimized elliptic curve functions
+ * Copyright (C) 2013 g10 Code GmbH
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "context.h"
+#include "ec-context.h"
+#include "ec-internal.h"
+#include "g10lib.h"
+#include "mpi-internal.h"
+
+#ifdef __SIZEOF_INT128__
+
+/* Arithmetic in GF(p) for the NIST P-256 prime
+
+     p = 2^256 - 2^224 + 2^192 + 2^96 - 1
+
+   Elements are kept fully reduced in Montgomery form a·2^256 mod p
+   using 4 limbs.  Since p = -1 mod 2^64, the Montgomery factor
+   -p^-1 mod 2^64 is 1.  */
+
+typedef unsigned __int128 p256_u128;
+
+static const uint64_t p256_p[4] = {0xffffffffffffffff, 0x00000000ffffffff,
+                                   0x0000000000000000, 0xffffffff00000001};
+
+/* 2^512 mod p, used to convert into Montgomery form.  */
+static const uint64_t p256_rr[4] = {0x0000000000000003, 0xfffffffbffffffff,
+                                    0xfffffffffffffffe, 0x00000004fffffffd};
+
+/* Store T - P in R if T >= P, where T has the 257th bit CARRY, and T
+   otherwise.  */
+static void p256_reduce_once(uint64_t r[4], const uint64_t t[4],
+                             uint64_t carry) {
+  uint64_t s[4];
+  uint64_t borrow = 0;
+  uint64_t mask;
+  p256_u128 d;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    d = (p256_u128)t[i] - p256_p[i] - borrow;
+    s[i] = (uint64_t)d;
+    borrow = (uint64_t)(d >> 64) & 1;
+  }
+  /* Use S unless the subtraction borrowed beyond CARRY.  */
+  mask = -(uint64_t)((carry | (borrow ^ 1)) & 1);
+  for (i = 0; i < 4; i++) r[i] = (s[i] & mask) | (t[i] & ~mask);
+}
+
+/* R = A · B · 2^-256 mod p, using the CIOS method.  A must be less
+   than 2^256 and B less than p.  */
+static void p256_mont_mul(uint64_t r[4], const uint64_t a[4],
+                          const uint64_t b[4]) {
+  uint64_t t[6] = {0, 0, 0, 0, 0, 0};
+  p256_u128 c;
+  uint64_t m;
+  int i, j;
+
+  for (i = 0; i < 4; i++) {
+    c = 0;
+    for (j = 0; j < 4; j++) {
+      c += (p256_u128)a[j] * b[i] + t[j];
+      t[j] = (uint64_t)c;
+      c >>= 64;
+    }
+    c += t[4];
+    t[4] = (uint64_t)c;
+    t[5] = (uint64_t)(c >> 64);
+
+    m = t[0];
+    c = ((p256_u128)m * p256_p[0] + t[0]) >> 64;
+    for (j = 1; j < 4; j++) {
+      c += (p256_u128)m * p256_p[j] + t[j];
+      t[j - 1] = (uint64_t)c;
+      c >>= 64;
+    }
+    c += t[4];
+    t[3] = (uint64_t)c;
+    t[4] = t[5] + (uint64_t)(c >> 64);
+  }
+
+  p256_reduce_once(r, t, t[4]);
+}
+
+static void p256_from_words(ec_fe_t r, const uint64_t w[4]) {
+  p256_mont_mul(r, w, p256_rr);
+}
+
+static void p256_to_words(uint64_t w[4], const ec_fe_t a) {
+  static const uint64_t one[4] = {1, 0, 0, 0};
+
+  p256_mont_mul(w, one, a);
+}
+
+static void p256_add(ec_fe_t r, const ec_fe_t a, const ec_fe_t b) {
+  uint64_t t[4];
+  p256_u128 c = 0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    c += (p256_u128)a[i] + b[i];
+    t[i] = (uint64_t)c;
+    c >>= 64;
+  }
+  p256_reduce_once(r, t, (uint64_t)c);
+}
+
+static void p256_sub(ec_fe_t r, const ec_fe_t a, const ec_fe_t b) {
+  uint64_t t[4];
+  uint64_t borrow = 0;
+  uint64_t mask;
+  p256_u128 d;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    d = (p256_u128)a[i] - b[i] - borrow;
+    t[i] = (uint64_t)d;
+    borrow = (uint64_t)(d >> 64) & 1;
+  }
+
+  /* Add P back if the subtraction borrowed.  */
+  mask = -borrow;
+  d = 0;
+  for (i = 0; i < 4; i++) {
+    d += (p256_u128)t[i] + (p256_p[i] & mask);
+    r[i] = (uint64_t)d;
+    d >>= 64;
+  }
+}
+
+static void p256_mul(ec_fe_t r, const ec_fe_t a, const ec_fe_t b) {
+  p256_mont_mul(r, a, b);
+}
+
+static void p256_sqr(ec_fe_t r, const ec_fe_t a) { p256_mont_mul(r, a, a); }
+
+const struct ec_field_s _gcry_ec_field_nistp256 = {
+    "nistp256",
+    {0xffffffffffffffff, 0x00000000ffffffff, 0x0000000000000000,
+     0xffffffff00000001},
+    p256_from_words,
+    p256_to_words,
+    p256_add,
+    p256_sub,
+    p256_mul,
+    p256_sqr};
+
+#endif /*__SIZEOF_INT128__*/
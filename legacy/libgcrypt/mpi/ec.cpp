@@ -19,9 +19,13 @@
  */
 
 #include <config.h>
+
+#include <mutex>
+
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "context.h"
 #include "ec-context.h"
@@ -269,6 +273,7 @@ static void ec_invm(gcry_mpi_t x, gcry_mpi_t a, mpi_ec_t ctx) {
 void _gcry_mpi_ec_get_reset(mpi_ec_t ec) {
   ec->t.valid.a_is_pminus3 = 0;
   ec->t.valid.two_inv_p = 0;
+  ec->t.valid.field = 0;
 }
 
 /* Accessor for helper variable.  */
@@ -296,6 +301,112 @@ static gcry_mpi_t ec_get_two_inv_p(mpi_ec_t ec) {
   return ec->t.two_inv_p;
 }
 
+/* Store A, which must be less than 2^256, as little endian words in
+   W.  */
+static void ec_mpi_to_words(uint64_t w[4], gcry_mpi_t a) {
+  int i;
+
+  memset(w, 0, 4 * sizeof *w);
+  for (i = 0; i < a->nlimbs; i++) {
+#if BITS_PER_MPI_LIMB == 64
+    w[i] = a->d[i];
+#else
+    w[i / 2] |= (uint64_t)a->d[i] << (32 * (i % 2));
+#endif
+  }
+}
+
+/* Load the value A into the field element R using the field backend
+   of CTX.  */
+static void ec_fe_load(ec_fe_t r, gcry_mpi_t a, mpi_ec_t ctx) {
+  uint64_t w[4];
+  gcry_mpi_t tmp;
+
+  if (a->sign || a->nlimbs * BITS_PER_MPI_LIMB > 256) {
+    tmp = mpi_copy(a);
+    mpi_mod(tmp, tmp, ctx->p);
+    ec_mpi_to_words(w, tmp);
+    mpi_free(tmp);
+  } else
+    ec_mpi_to_words(w, a);
+  ctx->t.field->from_words(r, w);
+}
+
+/* Store the field element A into W.  */
+static void ec_fe_store(gcry_mpi_t w, const ec_fe_t a, mpi_ec_t ctx) {
+  uint64_t words[4];
+  int i;
+
+  ctx->t.field->to_words(words, a);
+  mpi_resize(w, 256 / BITS_PER_MPI_LIMB);
+  for (i = 0; i < 256 / BITS_PER_MPI_LIMB; i++) {
+#if BITS_PER_MPI_LIMB == 64
+    w->d[i] = words[i];
+#else
+    w->d[i] = (mpi_limb_t)(words[i / 2] >> (32 * (i % 2)));
+#endif
+  }
+  w->nlimbs = 256 / BITS_PER_MPI_LIMB;
+  MPN_NORMALIZE(w->d, w->nlimbs);
+  w->sign = 0;
+}
+
+/* Return true if the field element A is zero.  */
+static int ec_fe_is_zero(const ec_fe_t a, mpi_ec_t ctx) {
+  uint64_t w[4];
+
+  ctx->t.field->to_words(w, a);
+  return !(w[0] | w[1] | w[2] | w[3]);
+}
+
+#ifdef __SIZEOF_INT128__
+/* The available fixed-size field backends.  */
+static const struct ec_field_s *const ec_fields[] = {
+    &_gcry_ec_field_25519, &_gcry_ec_field_nistp256};
+#endif
+
+/* Return the fixed-size field backend for CTX or NULL if the generic
+   MPI functions need to be used.  */
+static ec_field_t ec_find_field(mpi_ec_t ctx) {
+#ifdef __SIZEOF_INT128__
+  /* The initialization of a local static is thread-safe.  */
+  static const int use_field = !getenv("GCRYPT_NO_EC_FIELD");
+  uint64_t w[4];
+  int i;
+
+  if (!use_field || !ctx->p || !ctx->a ||
+      ctx->p->nlimbs * BITS_PER_MPI_LIMB > 256)
+    return NULL;
+  /* The Weierstrass formulas are only implemented for A = P - 3.  */
+  if (ctx->model == MPI_EC_WEIERSTRASS && !ec_get_a_is_pminus3(ctx))
+    return NULL;
+
+  ec_mpi_to_words(w, ctx->p);
+  for (i = 0; i < DIM(ec_fields); i++) {
+    if (memcmp(w, ec_fields[i]->p, sizeof w)) continue;
+
+    ctx->t.field = ec_fields[i];
+    ec_fe_load(ctx->t.fe_a, ctx->a, ctx);
+    if (ctx->b) ec_fe_load(ctx->t.fe_b, ctx->b, ctx);
+    if (ctx->model == MPI_EC_WEIERSTRASS)
+      ec_fe_load(ctx->t.fe_two_inv, ec_get_two_inv_p(ctx), ctx);
+    return ec_fields[i];
+  }
+#else
+  (void)ctx;
+#endif
+  return NULL;
+}
+
+/* Accessor for helper variable.  */
+static ec_field_t ec_get_field(mpi_ec_t ec) {
+  if (!ec->t.valid.field) {
+    ec->t.valid.field = 1;
+    ec->t.field = ec_find_field(ec);
+  }
+  return ec->t.field;
+}
+
 /* This function initialized a context for elliptic curve based on the
    field GF(p).  P is the prime specifying this field, A is the first
    coefficient.  CTX is expected to be zeroized.  */
@@ -548,6 +659,285 @@ int _gcry_mpi_ec_get_affine(gcry_mpi_t x, gcry_mpi_t y, mpi_point_t point,
   }
 }
 
+/* The point functions below are the same formulas as the generic
+   versions further down but use the fixed-size field backend
+   returned by ec_get_field.  */
+
+/*  RESULT = 2 * POINT  (Weierstrass version for A = P - 3).  POINT
+    must not be at infinity.  */
+static void dup_point_weierstrass_fe(mpi_point_t result, mpi_point_t point,
+                                     mpi_ec_t ctx) {
+  ec_field_t f = ctx->t.field;
+  ec_fe_t x, y, z, t1, t2, l1, l2, l3;
+
+  ec_fe_load(x, point->x, ctx);
+  ec_fe_load(y, point->y, ctx);
+  ec_fe_load(z, point->z, ctx);
+
+  /* L1 = 3(X - Z^2)(X + Z^2) */
+  f->sqr(t1, z);
+  f->sub(l1, x, t1);
+  f->add(t2, l1, l1);
+  f->add(l1, t2, l1);
+  f->add(t2, x, t1);
+  f->mul(l1, l1, t2);
+
+  /* Z3 = 2YZ */
+  f->mul(z, y, z);
+  f->add(z, z, z);
+
+  /* L2 = 4XY^2 */
+  f->sqr(t2, y);
+  f->mul(l2, t2, x);
+  f->add(l2, l2, l2);
+  f->add(l2, l2, l2);
+
+  /* X3 = L1^2 - 2L2 */
+  f->sqr(x, l1);
+  f->add(t1, l2, l2);
+  f->sub(x, x, t1);
+
+  /* L3 = 8Y^4 */
+  f->sqr(t2, t2);
+  f->add(l3, t2, t2);
+  f->add(l3, l3, l3);
+  f->add(l3, l3, l3);
+
+  /* Y3 = L1(L2 - X3) - L3 */
+  f->sub(y, l2, x);
+  f->mul(y, y, l1);
+  f->sub(y, y, l3);
+
+  ec_fe_store(result->x, x, ctx);
+  ec_fe_store(result->y, y, ctx);
+  ec_fe_store(result->z, z, ctx);
+}
+
+/* RESULT = P1 + P2  (Weierstrass version).  P1 and P2 must not be
+   at infinity or the same point.  */
+static void add_points_weierstrass_fe(mpi_point_t result, mpi_point_t p1,
+                                      mpi_point_t p2, mpi_ec_t ctx) {
+  ec_field_t f = ctx->t.field;
+  ec_fe_t x1, y1, z1, x2, y2, z2;
+  ec_fe_t l1, l2, l3, l4, l5, l6, l7, l8, l9, t1, t2, t3;
+
+  ec_fe_load(x1, p1->x, ctx);
+  ec_fe_load(y1, p1->y, ctx);
+  ec_fe_load(z1, p1->z, ctx);
+  ec_fe_load(x2, p2->x, ctx);
+  ec_fe_load(y2, p2->y, ctx);
+  ec_fe_load(z2, p2->z, ctx);
+
+  /* l1 = x1 z2^2  */
+  /* l2 = x2 z1^2  */
+  f->sqr(t1, z2);
+  f->mul(l1, t1, x1);
+  f->sqr(t2, z1);
+  f->mul(l2, t2, x2);
+  /* l3 = l1 - l2 */
+  f->sub(l3, l1, l2);
+  /* l4 = y1 z2^3  */
+  f->mul(l4, t1, z2);
+  f->mul(l4, l4, y1);
+  /* l5 = y2 z1^3  */
+  f->mul(l5, t2, z1);
+  f->mul(l5, l5, y2);
+  /* l6 = l4 - l5  */
+  f->sub(l6, l4, l5);
+
+  if (ec_fe_is_zero(l3, ctx)) {
+    if (ec_fe_is_zero(l6, ctx)) {
+      /* P1 and P2 are the same - use duplicate function.  */
+      _gcry_mpi_ec_dup_point(result, p1, ctx);
+    } else {
+      /* P1 is the inverse of P2.  */
+      mpi_set_ui(result->x, 1);
+      mpi_set_ui(result->y, 1);
+      mpi_set_ui(result->z, 0);
+    }
+    return;
+  }
+
+  /* l7 = l1 + l2  */
+  f->add(l7, l1, l2);
+  /* l8 = l4 + l5  */
+  f->add(l8, l4, l5);
+  /* z3 = z1 z2 l3  */
+  f->mul(z1, z1, z2);
+  f->mul(z1, z1, l3);
+  /* x3 = l6^2 - l7 l3^2  */
+  f->sqr(t1, l6);
+  f->sqr(t3, l3);
+  f->mul(t2, t3, l7);
+  f->sub(x1, t1, t2);
+  /* l9 = l7 l3^2 - 2 x3  */
+  f->add(t1, x1, x1);
+  f->sub(l9, t2, t1);
+  /* y3 = (l9 l6 - l8 l3^3)/2  */
+  f->mul(l9, l9, l6);
+  f->mul(t1, t3, l3);
+  f->mul(t1, t1, l8);
+  f->sub(y1, l9, t1);
+  f->mul(y1, y1, ctx->t.fe_two_inv);
+
+  ec_fe_store(result->x, x1, ctx);
+  ec_fe_store(result->y, y1, ctx);
+  ec_fe_store(result->z, z1, ctx);
+}
+
+/*  RESULT = 2 * POINT  (Twisted Edwards version).  */
+static void dup_point_edwards_fe(mpi_point_t result, mpi_point_t point,
+                                 mpi_ec_t ctx) {
+  static const ec_fe_t zero = {0, 0, 0, 0, 0};
+  ec_field_t f = ctx->t.field;
+  ec_fe_t x, y, z, b, c, d, e, h;
+
+  ec_fe_load(x, point->x, ctx);
+  ec_fe_load(y, point->y, ctx);
+  ec_fe_load(z, point->z, ctx);
+
+  /* B = (X_1 + Y_1)^2  */
+  f->add(b, x, y);
+  f->sqr(b, b);
+
+  /* C = X_1^2 */
+  /* D = Y_1^2 */
+  f->sqr(c, x);
+  f->sqr(d, y);
+
+  /* E = aC */
+  if (ctx->dialect == ECC_DIALECT_ED25519)
+    f->sub(e, zero, c);
+  else
+    f->mul(e, ctx->t.fe_a, c);
+
+  /* F = E + D (kept in Y) */
+  f->add(y, e, d);
+
+  /* H = Z_1^2 */
+  f->sqr(h, z);
+
+  /* J = F - 2H (kept in Z) */
+  f->sub(z, y, h);
+  f->sub(z, z, h);
+
+  /* X_3 = (B - C - D) · J */
+  f->sub(x, b, c);
+  f->sub(x, x, d);
+  f->mul(x, x, z);
+
+  /* Y_3 = F · (E - D) */
+  f->sub(e, e, d);
+
+  /* Z_3 = F · J */
+  f->mul(z, y, z);
+  f->mul(y, y, e);
+
+  ec_fe_store(result->x, x, ctx);
+  ec_fe_store(result->y, y, ctx);
+  ec_fe_store(result->z, z, ctx);
+}
+
+/* RESULT = P1 + P2  (Twisted Edwards version).  */
+static void add_points_edwards_fe(mpi_point_t result, mpi_point_t p1,
+                                  mpi_point_t p2, mpi_ec_t ctx) {
+  ec_field_t f = ctx->t.field;
+  ec_fe_t x1, y1, z1, x2, y2, z2, a, b, c, d, e;
+
+  ec_fe_load(x1, p1->x, ctx);
+  ec_fe_load(y1, p1->y, ctx);
+  ec_fe_load(z1, p1->z, ctx);
+  ec_fe_load(x2, p2->x, ctx);
+  ec_fe_load(y2, p2->y, ctx);
+  ec_fe_load(z2, p2->z, ctx);
+
+  /* A = Z1 · Z2 */
+  f->mul(a, z1, z2);
+
+  /* B = A^2 */
+  f->sqr(b, a);
+
+  /* C = X1 · X2 */
+  f->mul(c, x1, x2);
+
+  /* D = Y1 · Y2 */
+  f->mul(d, y1, y2);
+
+  /* E = d · C · D */
+  f->mul(e, ctx->t.fe_b, c);
+  f->mul(e, e, d);
+
+  /* F = B - E (kept in Z1) */
+  f->sub(z1, b, e);
+
+  /* G = B + E (kept in Z2) */
+  f->add(z2, b, e);
+
+  /* X_3 = A · F · ((X_1 + Y_1) · (X_2 + Y_2) - C - D) */
+  f->add(x1, x1, y1);
+  f->add(x2, x2, y2);
+  f->mul(x1, x1, x2);
+  f->sub(x1, x1, c);
+  f->sub(x1, x1, d);
+  f->mul(x1, x1, z1);
+  f->mul(x1, x1, a);
+
+  /* Y_3 = A · G · (D - aC) */
+  if (ctx->dialect == ECC_DIALECT_ED25519)
+    f->add(y1, d, c);
+  else {
+    f->mul(y1, ctx->t.fe_a, c);
+    f->sub(y1, d, y1);
+  }
+  f->mul(y1, y1, z2);
+  f->mul(y1, y1, a);
+
+  /* Z_3 = F · G */
+  f->mul(z1, z1, z2);
+
+  ec_fe_store(result->x, x1, ctx);
+  ec_fe_store(result->y, y1, ctx);
+  ec_fe_store(result->z, z1, ctx);
+}
+
+/* A step of the Montgomery Ladder; see montgomery_ladder.  */
+static void montgomery_ladder_fe(mpi_point_t prd, mpi_point_t sum,
+                                 mpi_point_t p1, mpi_point_t p2,
+                                 gcry_mpi_t dif_x, mpi_ec_t ctx) {
+  ec_field_t f = ctx->t.field;
+  ec_fe_t x1, z1, x2, z2, dx, px, pz, sx, sz;
+
+  ec_fe_load(x1, p1->x, ctx);
+  ec_fe_load(z1, p1->z, ctx);
+  ec_fe_load(x2, p2->x, ctx);
+  ec_fe_load(z2, p2->z, ctx);
+  ec_fe_load(dx, dif_x, ctx);
+
+  f->add(sx, x2, z2);
+  f->sub(z2, x2, z2);
+  f->add(px, x1, z1);
+  f->sub(z1, x1, z1);
+  f->mul(x2, z1, sx);
+  f->mul(z2, px, z2);
+  f->sqr(x1, px);
+  f->sqr(z1, z1);
+  f->add(sx, x2, z2);
+  f->sub(z2, x2, z2);
+  f->mul(px, x1, z1);
+  f->sub(z1, x1, z1);
+  f->sqr(sx, sx);
+  f->sqr(sz, z2);
+  f->mul(pz, z1, ctx->t.fe_a); /* CTX->A: (a-2)/4 */
+  f->mul(sz, sz, dx);
+  f->add(pz, x1, pz);
+  f->mul(pz, pz, z1);
+
+  ec_fe_store(prd->x, px, ctx);
+  ec_fe_store(prd->z, pz, ctx);
+  ec_fe_store(sum->x, sx, ctx);
+  ec_fe_store(sum->z, sz, ctx);
+}
+
 /*  RESULT = 2 * POINT  (Weierstrass version). */
 static void dup_point_weierstrass(mpi_point_t result, mpi_point_t point,
                                   mpi_ec_t ctx) {
@@ -566,6 +956,8 @@ static void dup_point_weierstrass(mpi_point_t result, mpi_point_t point,
     mpi_set_ui(x3, 1);
     mpi_set_ui(y3, 1);
     mpi_set_ui(z3, 0);
+  } else if (ec_get_field(ctx)) {
+    dup_point_weierstrass_fe(result, point, ctx);
   } else {
     if (ec_get_a_is_pminus3(ctx)) /* Use the faster case.  */
     {
@@ -717,7 +1109,10 @@ void _gcry_mpi_ec_dup_point(mpi_point_t result, mpi_point_t point,
       dup_point_montgomery(result, point, ctx);
       break;
     case MPI_EC_EDWARDS:
-      dup_point_edwards(result, point, ctx);
+      if (ec_get_field(ctx))
+        dup_point_edwards_fe(result, point, ctx);
+      else
+        dup_point_edwards(result, point, ctx);
       break;
   }
 }
@@ -759,6 +1154,8 @@ static void add_points_weierstrass(mpi_point_t result, mpi_point_t p1,
     mpi_set(x3, p1->x);
     mpi_set(y3, p1->y);
     mpi_set(z3, p1->z);
+  } else if (ec_get_field(ctx)) {
+    add_points_weierstrass_fe(result, p1, p2, ctx);
   } else {
     int z1_is_one = !mpi_cmp_ui(z1, 1);
     int z2_is_one = !mpi_cmp_ui(z2, 1);
@@ -947,6 +1344,11 @@ static void add_points_edwards(mpi_point_t result, mpi_point_t p1,
    Outputs: PRD = 2 * P1 and  SUM = P1 + P2. */
 static void montgomery_ladder(mpi_point_t prd, mpi_point_t sum, mpi_point_t p1,
                               mpi_point_t p2, gcry_mpi_t dif_x, mpi_ec_t ctx) {
+  if (ec_get_field(ctx)) {
+    montgomery_ladder_fe(prd, sum, p1, p2, dif_x, ctx);
+    return;
+  }
+
   ec_addm(sum->x, p2->x, p2->z, ctx);
   ec_subm(p2->z, p2->x, p2->z, ctx);
   ec_addm(prd->x, p1->x, p1->z, ctx);
@@ -978,7 +1380,10 @@ void _gcry_mpi_ec_add_points(mpi_point_t result, mpi_point_t p1, mpi_point_t p2,
       add_points_montgomery(result, p1, p2, ctx);
       break;
     case MPI_EC_EDWARDS:
-      add_points_edwards(result, p1, p2, ctx);
+      if (ec_get_field(ctx))
+        add_points_edwards_fe(result, p1, p2, ctx);
+      else
+        add_points_edwards(result, p1, p2, ctx);
       break;
   }
 }
@@ -1232,6 +1637,229 @@ void _gcry_mpi_ec_mul_point(mpi_point_t result, gcry_mpi_t scalar,
   mpi_free(k);
 }
 
+/* Number of teeth of the fixed-base combs.  A comb holds 2^COMB_TEETH
+   points and a multiplication takes ceil(nbits/COMB_TEETH) doublings
+   and additions.  */
+#define COMB_TEETH 8
+#define COMB_SIZE (1 << COMB_TEETH)
+#define COMB_SPACING(nbits) (((nbits) + COMB_TEETH - 1) / COMB_TEETH)
+
+/* A fixed-base comb for the affine point (X,Y) on the curve given by
+   MODEL, P, A and B.  POINTS[i] is the sum of 2^(j*SPACING)·(X,Y) for
+   all bits j set in i.  Combs are never changed after creation and
+   are kept for the lifetime of the process.  */
+struct ec_comb_s {
+  struct ec_comb_s *next;
+  enum gcry_mpi_ec_models model;
+  gcry_mpi_t p, a, b;
+  gcry_mpi_t x, y;
+  unsigned int spacing;
+  mpi_point_struct points[COMB_SIZE];
+};
+
+/* The list of combs and the lock protecting it.  */
+static struct ec_comb_s *ec_combs;
+static std::mutex ec_combs_lock;
+
+/* Return true if COMB has been built for the point BASE on the curve
+   of CTX.  */
+static int comb_matches(struct ec_comb_s *comb, mpi_point_t base,
+                        mpi_ec_t ctx) {
+  return (comb->model == ctx->model && !mpi_cmp(comb->x, base->x) &&
+          !mpi_cmp(comb->y, base->y) && !mpi_cmp(comb->p, ctx->p) &&
+          !mpi_cmp(comb->a, ctx->a) && !mpi_cmp(comb->b, ctx->b));
+}
+
+/* Allocate the coordinates of P with exactly NLIMBS limbs so that
+   they can be used with mpi_set_cond.  */
+static void comb_point_alloc(mpi_point_t p, size_t nlimbs) {
+  p->x = mpi_alloc(nlimbs);
+  p->y = mpi_alloc(nlimbs);
+  p->z = mpi_alloc(nlimbs);
+}
+
+/* Build the comb for the affine point BASE.  */
+static struct ec_comb_s *comb_new(mpi_point_t base, mpi_ec_t ctx) {
+  struct ec_comb_s *comb;
+  mpi_point_struct teeth[COMB_TEETH];
+  mpi_point_struct tmp;
+  size_t nlimbs = ctx->p->nlimbs;
+  unsigned int i, j;
+
+  comb = (struct ec_comb_s *)xcalloc(1, sizeof *comb);
+  comb->model = ctx->model;
+  comb->p = mpi_copy(ctx->p);
+  comb->a = mpi_copy(ctx->a);
+  comb->b = mpi_copy(ctx->b);
+  comb->x = mpi_copy(base->x);
+  comb->y = mpi_copy(base->y);
+  comb->spacing = COMB_SPACING(ctx->nbits);
+
+  /* TEETH[j] = 2^(j*SPACING)·BASE.  */
+  for (j = 0; j < COMB_TEETH; j++) {
+    point_init(&teeth[j]);
+    if (!j)
+      point_set(&teeth[j], base);
+    else {
+      point_set(&teeth[j], &teeth[j - 1]);
+      for (i = 0; i < comb->spacing; i++)
+        _gcry_mpi_ec_dup_point(&teeth[j], &teeth[j], ctx);
+    }
+  }
+
+  point_init(&tmp);
+  for (i = 0; i < COMB_SIZE; i++) {
+    comb_point_alloc(&comb->points[i], nlimbs);
+    if (!i) {
+      /* The neutral element.  */
+      mpi_set_ui(comb->points[i].x, 0);
+      mpi_set_ui(comb->points[i].y, 1);
+      mpi_set_ui(comb->points[i].z, 1);
+      continue;
+    }
+    /* Add the lowest tooth to the entry without it.  */
+    for (j = 0; !(i & (1 << j)); j++)
+      ;
+    _gcry_mpi_ec_add_points(&tmp, &comb->points[i & (i - 1)], &teeth[j], ctx);
+    point_set(&comb->points[i], &tmp);
+  }
+
+  point_free(&tmp);
+  for (j = 0; j < COMB_TEETH; j++) point_free(&teeth[j]);
+  return comb;
+}
+
+/* Return the comb for BASE on the curve of CTX.  The comb is created
+   on first use.  */
+static struct ec_comb_s *ec_get_comb(mpi_point_t base, mpi_ec_t ctx) {
+  struct ec_comb_s *comb = ctx->t.comb;
+
+  if (comb && comb_matches(comb, base, ctx)) return comb;
+
+  std::lock_guard<std::mutex> lock(ec_combs_lock);
+  for (comb = ec_combs; comb; comb = comb->next)
+    if (comb_matches(comb, base, ctx)) break;
+  if (!comb) {
+    comb = comb_new(base, ctx);
+    comb->next = ec_combs;
+    ec_combs = comb;
+  }
+  ctx->t.comb = comb;
+  return comb;
+}
+
+/* Scalar multiplication with a fixed base point, like the generator
+   of a curve.  RESULT is set to SCALAR·BASE.  For Twisted Edwards
+   curves a precomputed comb for BASE is used, which is created when
+   BASE is first used; for this BASE must be given in affine
+   coordinates and SCALAR must not be larger than the field.  In all
+   other cases this is the same as _gcry_mpi_ec_mul_point.  */
+void _gcry_mpi_ec_mul_base_point(mpi_point_t result, gcry_mpi_t scalar,
+                                 mpi_point_t base, mpi_ec_t ctx) {
+  struct ec_comb_s *comb;
+  mpi_point_struct sel;
+  unsigned int idx, i, j;
+  int k;
+
+  if (ctx->model != MPI_EC_EDWARDS || mpi_cmp_ui(base->z, 1) ||
+      mpi_has_sign(scalar) ||
+      mpi_get_nbits(scalar) > COMB_TEETH * COMB_SPACING(ctx->nbits)) {
+    _gcry_mpi_ec_mul_point(result, scalar, base, ctx);
+    return;
+  }
+
+  comb = ec_get_comb(base, ctx);
+
+  mpi_set_ui(result->x, 0);
+  mpi_set_ui(result->y, 1);
+  mpi_set_ui(result->z, 1);
+  point_resize(result, ctx);
+
+  if (mpi_is_secure(scalar)) {
+    /* Assume that SCALAR is a secret: Always do the same number of
+       steps and read all entries of the comb in each step.  */
+    comb_point_alloc(&sel, ctx->p->nlimbs);
+    for (k = comb->spacing - 1; k >= 0; k--) {
+      for (idx = 0, j = 0; j < COMB_TEETH; j++)
+        idx |= mpi_test_bit(scalar, k + j * comb->spacing) << j;
+      for (i = 0; i < COMB_SIZE; i++) {
+        mpi_set_cond(sel.x, comb->points[i].x, i == idx);
+        mpi_set_cond(sel.y, comb->points[i].y, i == idx);
+        mpi_set_cond(sel.z, comb->points[i].z, i == idx);
+      }
+      _gcry_mpi_ec_dup_point(result, result, ctx);
+      _gcry_mpi_ec_add_points(result, result, &sel, ctx);
+    }
+    point_free(&sel);
+  } else {
+    for (k = comb->spacing - 1; k >= 0; k--) {
+      for (idx = 0, j = 0; j < COMB_TEETH; j++)
+        idx |= mpi_test_bit(scalar, k + j * comb->spacing) << j;
+      _gcry_mpi_ec_dup_point(result, result, ctx);
+      if (idx) _gcry_mpi_ec_add_points(result, result, &comb->points[idx], ctx);
+    }
+  }
+}
+
+/* Multi-scalar multiplication: Set RESULT to the sum of
+   SCALARS[i]·POINTS[i] for the N points.  This uses Straus' method
+   with a window of 4 bits, so that all points share the doublings.
+   The scalars must not be negative; they are not processed in
+   constant time.  Montgomery curves are not supported.  */
+void _gcry_mpi_ec_mul_points(mpi_point_t result, gcry_mpi_t *scalars,
+                             mpi_point_t *points, unsigned int n,
+                             mpi_ec_t ctx) {
+  mpi_point_struct *tab;
+  unsigned int i, j, nbits, digit;
+  int w;
+
+  if (ctx->model == MPI_EC_MONTGOMERY)
+    log_fatal("%s: %s not yet supported\n", "_gcry_mpi_ec_mul_points",
+              "Montgomery");
+
+  if (ctx->model == MPI_EC_WEIERSTRASS) {
+    mpi_set_ui(result->x, 1);
+    mpi_set_ui(result->y, 1);
+    mpi_set_ui(result->z, 0);
+  } else {
+    mpi_set_ui(result->x, 0);
+    mpi_set_ui(result->y, 1);
+    mpi_set_ui(result->z, 1);
+  }
+  if (!n) return;
+
+  /* TAB[i*16+d] = d·POINTS[i] for d = 1..15.  */
+  tab = (mpi_point_struct *)xcalloc(n * 16, sizeof *tab);
+  nbits = 0;
+  for (i = 0; i < n; i++) {
+    if (mpi_get_nbits(scalars[i]) > nbits) nbits = mpi_get_nbits(scalars[i]);
+    for (j = 1; j < 16; j++) {
+      point_init(&tab[i * 16 + j]);
+      if (j == 1)
+        point_set(&tab[i * 16 + j], points[i]);
+      else if (j == 2)
+        _gcry_mpi_ec_dup_point(&tab[i * 16 + j], points[i], ctx);
+      else
+        _gcry_mpi_ec_add_points(&tab[i * 16 + j], &tab[i * 16 + j - 1],
+                                points[i], ctx);
+    }
+  }
+
+  for (w = (nbits + 3) / 4 - 1; w >= 0; w--) {
+    for (j = 0; j < 4; j++) _gcry_mpi_ec_dup_point(result, result, ctx);
+    for (i = 0; i < n; i++) {
+      for (digit = 0, j = 0; j < 4; j++)
+        digit |= mpi_test_bit(scalars[i], w * 4 + j) << j;
+      if (digit)
+        _gcry_mpi_ec_add_points(result, result, &tab[i * 16 + digit], ctx);
+    }
+  }
+
+  for (i = 0; i < n; i++)
+    for (j = 1; j < 16; j++) point_free(&tab[i * 16 + j]);
+  xfree(tab);
+}
+
 /* Return true if POINT is on the curve described by CTX.  */
 int _gcry_mpi_ec_curve_point(gcry_mpi_point_t point, mpi_ec_t ctx) {
   int res = 0;
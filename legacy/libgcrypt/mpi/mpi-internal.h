@@ -223,10 +223,27 @@ void _gcry_mpih_mul_karatsuba_case(mpi_ptr_t prodp, mpi_ptr_t up,
                                    mpi_size_t usize, mpi_ptr_t vp,
                                    mpi_size_t vsize, struct karatsuba_ctx *ctx);
 
+mpi_limb_t _gcry_mpih_mont_inv(mpi_ptr_t mp);
+void _gcry_mpih_redc(mpi_ptr_t rp, mpi_ptr_t tp, mpi_ptr_t mp, mpi_size_t n,
+                     mpi_limb_t minv);
+
 /*-- mpih-mul_1.c (or xxx/cpu/ *.S) --*/
 mpi_limb_t _gcry_mpih_mul_1(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
                             mpi_size_t s1_size, mpi_limb_t s2_limb);
 
+/*-- amd64/mpih-mul-bmi2.c --*/
+#if defined(__GNUC__) && defined(__x86_64__) && BITS_PER_MPI_LIMB == 64
+#define USE_MPIH_BMI2 1
+/* Set by _gcry_mpi_init if the CPU supports BMI2 and ADX.  */
+extern int _gcry_mpih_use_bmi2;
+mpi_limb_t _gcry_mpih_mul_1_bmi2(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                 mpi_size_t s1_size, mpi_limb_t s2_limb);
+mpi_limb_t _gcry_mpih_addmul_1_adx(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                   mpi_size_t s1_size, mpi_limb_t s2_limb);
+mpi_limb_t _gcry_mpih_submul_1_bmi2(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                    mpi_size_t s1_size, mpi_limb_t s2_limb);
+#endif
+
 /*-- mpih-div.c --*/
 mpi_limb_t _gcry_mpih_mod_1(mpi_ptr_t dividend_ptr, mpi_size_t dividend_size,
                             mpi_limb_t divisor_limb);
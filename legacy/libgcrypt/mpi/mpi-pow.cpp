@@ -30,9 +30,257 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "g10lib.h"
 #include "longlong.h"
 #include "mpi-internal.h"
 
+/* Context with the constants for Montgomery multiplication modulo the
+   odd number M.  With R = 2^(N*BITS_PER_MPI_LIMB), a number A is kept
+   as A*R mod M; the product of two such numbers then only needs the
+   reduction done by _gcry_mpih_redc instead of a division.  */
+struct mont_ctx_s {
+  gcry_mpi_t m;    /* The absolute value of the modulus.  */
+  int msign;       /* The sign of the modulus.  */
+  int secure;      /* The constants are stored in secure memory.  */
+  mpi_size_t n;    /* The number of limbs of M.  */
+  mpi_limb_t minv; /* -M^-1 mod 2^BITS_PER_MPI_LIMB.  */
+  mpi_ptr_t r2;    /* R^2 mod M, to convert into Montgomery form.  */
+  mpi_ptr_t one;   /* R mod M, which is 1 in Montgomery form.  */
+};
+
+/* Fill in CTX for the modulus M.  Returns false if M is zero or even,
+   in which case CTX is not changed.  */
+static int mont_init(mpi_mont_t ctx, gcry_mpi_t m) {
+  gcry_mpi_t tmp;
+  mpi_ptr_t tp;
+  mpi_size_t n;
+
+  n = m->nlimbs;
+  MPN_NORMALIZE(m->d, n);
+  if (!n || !(m->d[0] & 1)) return 0;
+
+  ctx->secure = mpi_is_secure(m);
+  ctx->msign = m->sign;
+  ctx->m = mpi_copy(m);
+  ctx->m->nlimbs = n;
+  ctx->m->sign = 0;
+  ctx->n = n;
+  ctx->minv = _gcry_mpih_mont_inv(ctx->m->d);
+
+  tmp = ctx->secure ? mpi_alloc_secure(2 * n + 1) : mpi_alloc(2 * n + 1);
+  mpi_set_ui(tmp, 1);
+  mpi_lshift_limbs(tmp, 2 * n);
+  mpi_fdiv_r(tmp, tmp, ctx->m);
+  ctx->r2 = mpi_alloc_limb_space(n, ctx->secure);
+  MPN_ZERO(ctx->r2, n);
+  MPN_COPY(ctx->r2, tmp->d, tmp->nlimbs);
+  mpi_free(tmp);
+
+  /* R mod M is the Montgomery reduction of R^2 mod M.  */
+  tp = mpi_alloc_limb_space(2 * n, ctx->secure);
+  MPN_COPY(tp, ctx->r2, n);
+  MPN_ZERO(tp + n, n);
+  ctx->one = mpi_alloc_limb_space(n, ctx->secure);
+  _gcry_mpih_redc(ctx->one, tp, ctx->m->d, n, ctx->minv);
+  _gcry_mpi_free_limb_space(tp, ctx->secure ? 2 * n : 0);
+
+  return 1;
+}
+
+static void mont_deinit(mpi_mont_t ctx) {
+  mpi_size_t wipe = ctx->secure ? ctx->n : 0;
+
+  _gcry_mpi_free_limb_space(ctx->r2, wipe);
+  _gcry_mpi_free_limb_space(ctx->one, wipe);
+  mpi_free(ctx->m);
+}
+
+/* Return a new context for Montgomery based exponentiation modulo M
+   or NULL if M is zero or even.  M may be changed after this call.
+   The context needs to be released using _gcry_mpi_mont_free.  */
+mpi_mont_t _gcry_mpi_mont_new(gcry_mpi_t m) {
+  mpi_mont_t ctx;
+
+  ctx = (mpi_mont_t)xcalloc(1, sizeof *ctx);
+  if (!mont_init(ctx, m)) {
+    xfree(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+void _gcry_mpi_mont_free(mpi_mont_t ctx) {
+  if (ctx) {
+    mont_deinit(ctx);
+    xfree(ctx);
+  }
+}
+
+/* Store A * B / R mod M at RP, where TP provides 2N limbs of space.
+   RP may be equal to AP or BP.
+
+   This is always a schoolbook product.  Unlike the generic basecase
+   it does not look at the limbs of BP to skip multiplications by 0
+   or 1, and unlike the Karatsuba code it does not compare the halves
+   of the operands, so the sequence of operations only depends on N.  */
+static void mont_mul(mpi_ptr_t rp, mpi_ptr_t ap, mpi_ptr_t bp,
+                     mpi_mont_t ctx, mpi_ptr_t tp) {
+  mpi_size_t n = ctx->n;
+  mpi_size_t i;
+
+  tp[n] = _gcry_mpih_mul_1(tp, ap, n, bp[0]);
+  for (i = 1; i < n; i++)
+    tp[n + i] = _gcry_mpih_addmul_1(tp + i, ap, n, bp[i]);
+
+  _gcry_mpih_redc(rp, tp, ctx->m->d, n, ctx->minv);
+}
+
+/* Store A^2 / R mod M at RP, where TP provides 2N limbs of space.
+   RP may be equal to AP.  Like mont_mul this does not use Karatsuba
+   for large N, because _gcry_mpih_sqr_n branches on the values.  */
+static void mont_sqr(mpi_ptr_t rp, mpi_ptr_t ap, mpi_mont_t ctx,
+                     mpi_ptr_t tp) {
+  _gcry_mpih_sqr_n_basecase(tp, ap, ctx->n);
+  _gcry_mpih_redc(rp, tp, ctx->m->d, ctx->n, ctx->minv);
+}
+
+/* Return the W bits of the exponent EP starting at bit POS.  */
+static mpi_limb_t mont_window(mpi_ptr_t ep, mpi_size_t esize,
+                              unsigned int pos, unsigned int w) {
+  mpi_size_t i = pos / BITS_PER_MPI_LIMB;
+  unsigned int sh = pos % BITS_PER_MPI_LIMB;
+  mpi_limb_t e;
+
+  e = ep[i] >> sh;
+  if (sh + w > BITS_PER_MPI_LIMB && i + 1 < esize)
+    e |= ep[i + 1] << (BITS_PER_MPI_LIMB - sh);
+  return e & ((((mpi_limb_t)1) << w) - 1);
+}
+
+/* Copy entry IDX of the NENTRIES entries of N limbs in TABLE to RP.
+   All entries are read to not reveal IDX through the cache.  */
+static void mont_select(mpi_ptr_t rp, mpi_ptr_t table, mpi_size_t n,
+                        mpi_size_t nentries, mpi_limb_t idx) {
+  mpi_size_t i, k;
+  mpi_limb_t mask;
+
+  MPN_ZERO(rp, n);
+  for (k = 0; k < nentries; k++) {
+    mask = 0UL - (mpi_limb_t)(k == (mpi_size_t)idx);
+    for (i = 0; i < n; i++) rp[i] |= table[k * n + i] & mask;
+  }
+}
+
+/****************
+ * RES = BASE ^ EXPO mod M for the odd modulus described by CTX.
+ *
+ * This is a fixed-window exponentiation with the numbers kept in
+ * Montgomery form.  Every window costs the same squarings and one
+ * multiplication, even if its bits are zero, and the table entry is
+ * selected by reading the whole table.  The products are schoolbook
+ * products at all sizes.  Thus, apart from the length of EXPO and
+ * the size of M, neither the sequence of operations nor the memory
+ * access pattern of the main loop depends on the values of EXPO,
+ * BASE or M.
+ */
+void _gcry_mpi_powm_mont(gcry_mpi_t res, gcry_mpi_t base, gcry_mpi_t expo,
+                         mpi_mont_t ctx) {
+  mpi_size_t n = ctx->n;
+  mpi_ptr_t ep, bp;
+  mpi_size_t esize, bsize, rsize;
+  mpi_ptr_t space, table, xp, wp, tp;
+  mpi_size_t space_nlimbs;
+  gcry_mpi_t breduced = NULL;
+  unsigned int nbits, pos, w, k;
+  int sec, negative_result;
+
+  esize = expo->nlimbs;
+  ep = expo->d;
+  MPN_NORMALIZE(ep, esize);
+
+  if (!esize) {
+    /* Exponent is zero, result is 1 mod M, i.e., 1 or 0 depending
+       on if M equals 1.  */
+    mpi_set_ui(res, !(n == 1 && ctx->m->d[0] == 1));
+    return;
+  }
+
+  sec = ctx->secure || mpi_is_secure(expo) || mpi_is_secure(base);
+  negative_result = (ep[0] & 1) && base->sign;
+
+  /* Montgomery conversion needs a base less than R.  */
+  bsize = base->nlimbs;
+  bp = base->d;
+  if (bsize > n) {
+    breduced = mpi_copy(base);
+    breduced->sign = 0;
+    mpi_fdiv_r(breduced, breduced, ctx->m);
+    bsize = breduced->nlimbs;
+    bp = breduced->d;
+  }
+
+  nbits = esize * BITS_PER_MPI_LIMB;
+  count_leading_zeros(k, ep[esize - 1]);
+  nbits -= k;
+  if (nbits > 512)
+    w = 5;
+  else if (nbits > 128)
+    w = 4;
+  else if (nbits > 24)
+    w = 3;
+  else
+    w = 1;
+
+  /* The table with BASE^i * R mod M for 0 <= i < 2^W, the
+     accumulator XP, the selected entry WP and the workspace for the
+     products.  */
+  space_nlimbs = ((1 << w) + 4) * n;
+  space = mpi_alloc_limb_space(space_nlimbs, sec);
+  table = space;
+  xp = table + (n << w);
+  wp = xp + n;
+  tp = wp + n;
+
+  MPN_COPY(table, ctx->one, n);
+  MPN_ZERO(wp, n);
+  MPN_COPY(wp, bp, bsize);
+  mont_mul(table + n, wp, ctx->r2, ctx, tp);
+  for (k = 2; k < (1U << w); k++)
+    mont_mul(table + k * n, table + (k - 1) * n, table + n, ctx, tp);
+
+  /* Process the exponent from the most significant window.  */
+  pos = ((nbits + w - 1) / w - 1) * w;
+  mont_select(xp, table, n, 1 << w, mont_window(ep, esize, pos, w));
+  while (pos) {
+    pos -= w;
+    for (k = 0; k < w; k++) mont_sqr(xp, xp, ctx, tp);
+    mont_select(wp, table, n, 1 << w, mont_window(ep, esize, pos, w));
+    mont_mul(xp, xp, wp, ctx, tp);
+  }
+
+  /* Convert the result back; BASE and EXPO are not used anymore, so
+     RES may be identical to one of them.  */
+  MPN_COPY(tp, xp, n);
+  MPN_ZERO(tp + n, n);
+  RESIZE_IF_NEEDED(res, n);
+  _gcry_mpih_redc(res->d, tp, ctx->m->d, n, ctx->minv);
+  rsize = n;
+  MPN_NORMALIZE(res->d, rsize);
+  res->sign = 0;
+
+  /* Fixup for negative results.  */
+  if (negative_result && rsize) {
+    _gcry_mpih_sub(res->d, ctx->m->d, n, res->d, rsize);
+    rsize = n;
+    MPN_NORMALIZE(res->d, rsize);
+    res->sign = ctx->msign;
+  }
+  res->nlimbs = rsize;
+
+  _gcry_mpi_free_limb_space(space, sec ? space_nlimbs : 0);
+  mpi_free(breduced);
+}
+
 /*
  * When you need old implementation, please add compilation option
  * -DUSE_ALGORITHM_SIMPLE_EXPONENTIATION
@@ -386,6 +634,15 @@ void _gcry_mpi_powm(gcry_mpi_t res, gcry_mpi_t base, gcry_mpi_t expo,
   mpi_ptr_t base_u;
   mpi_size_t base_u_size;
   mpi_size_t max_u_size;
+  struct mont_ctx_s mont;
+
+  /* Odd moduli, which includes all moduli of the public key
+     algorithms, are handled by the Montgomery engine.  */
+  if (mont_init(&mont, mod)) {
+    _gcry_mpi_powm_mont(res, base, expo, &mont);
+    mont_deinit(&mont);
+    return;
+  }
 
   esize = expo->nlimbs;
   msize = mod->nlimbs;
@@ -206,38 +206,38 @@ static void mul_n(mpi_ptr_t prodp, mpi_ptr_t up, mpi_ptr_t vp, mpi_size_t size,
   }
 }
 
+/* Square U (pointed to by UP, SIZE limbs) and store the 2 * SIZE limbs
+ * of the result at PRODP.
+ *
+ * The products U[i] * U[j] for i < j are summed up once, doubled and
+ * the squares U[i]^2 added, which needs about half the limb
+ * multiplications of a general product.  Unlike the multiplication
+ * basecase this does not skip limbs with the value 0 or 1.  */
 void _gcry_mpih_sqr_n_basecase(mpi_ptr_t prodp, mpi_ptr_t up, mpi_size_t size) {
   mpi_size_t i;
-  mpi_limb_t cy_limb;
-  mpi_limb_t v_limb;
-
-  /* Multiply by the first limb in V separately, as the result can be
-   * stored (not added) to PROD.  We also avoid a loop for zeroing.  */
-  v_limb = up[0];
-  if (v_limb <= 1) {
-    if (v_limb == 1)
-      MPN_COPY(prodp, up, size);
-    else
-      MPN_ZERO(prodp, size);
-    cy_limb = 0;
-  } else
-    cy_limb = _gcry_mpih_mul_1(prodp, up, size, v_limb);
-
-  prodp[size] = cy_limb;
-  prodp++;
-
-  /* For each iteration in the outer loop, multiply one limb from
-   * U with one limb from V, and add it to PROD.  */
-  for (i = 1; i < size; i++) {
-    v_limb = up[i];
-    if (v_limb <= 1) {
-      cy_limb = 0;
-      if (v_limb == 1) cy_limb = _gcry_mpih_add_n(prodp, prodp, up, size);
-    } else
-      cy_limb = _gcry_mpih_addmul_1(prodp, up, size, v_limb);
+  mpi_limb_t hi, lo, x, cy, c;
+
+  prodp[0] = 0;
+  prodp[2 * size - 1] = 0;
+  if (size > 1) {
+    prodp[size] = _gcry_mpih_mul_1(prodp + 1, up + 1, size - 1, up[0]);
+    for (i = 1; i < size - 1; i++)
+      prodp[size + i] = _gcry_mpih_addmul_1(prodp + 2 * i + 1, up + i + 1,
+                                            size - 1 - i, up[i]);
+    _gcry_mpih_lshift(prodp, prodp, 2 * size, 1);
+  }
 
-    prodp[size] = cy_limb;
-    prodp++;
+  cy = 0;
+  for (i = 0; i < size; i++) {
+    umul_ppmm(hi, lo, up[i], up[i]);
+    x = prodp[2 * i] + lo;
+    c = x < lo;
+    prodp[2 * i] = x + cy;
+    c += prodp[2 * i] < cy;
+    x = prodp[2 * i + 1] + hi;
+    cy = x < hi;
+    prodp[2 * i + 1] = x + c;
+    cy += prodp[2 * i + 1] < c;
   }
 }
 
@@ -472,3 +472,37 @@ mpi_limb_t _gcry_mpih_mul(mpi_ptr_t prodp, mpi_ptr_t up, mpi_size_t usize,
   _gcry_mpih_release_karatsuba_ctx(&ctx);
   return *prod_endp;
 }
+
+/* Return -MP[0]^-1 mod 2^BITS_PER_MPI_LIMB for the odd modulus MP as
+ * needed by _gcry_mpih_redc.  */
+mpi_limb_t _gcry_mpih_mont_inv(mpi_ptr_t mp) {
+  mpi_limb_t inv = mp[0];
+  int bits;
+
+  /* For odd M, M is its own inverse modulo 8; each Newton step
+   * doubles the number of correct bits.  */
+  for (bits = 3; bits < BITS_PER_MPI_LIMB; bits *= 2) inv *= 2 - mp[0] * inv;
+  return -inv;
+}
+
+/* Montgomery reduction: Store TP * 2^(-N*BITS_PER_MPI_LIMB) mod MP
+ * at RP.  TP has 2N limbs, is clobbered and must be less than MP *
+ * 2^(N*BITS_PER_MPI_LIMB); RP may be equal to TP.  MINV is the value
+ * returned by _gcry_mpih_mont_inv.  The running time does not depend
+ * on the values.  */
+void _gcry_mpih_redc(mpi_ptr_t rp, mpi_ptr_t tp, mpi_ptr_t mp, mpi_size_t n,
+                     mpi_limb_t minv) {
+  mpi_limb_t cy, borrow, mask;
+  mpi_size_t i;
+
+  /* Each step clears the lowest limb of the remaining TP; keep the
+   * carry there and add all of them at the end.  */
+  for (i = 0; i < n; i++)
+    tp[i] = _gcry_mpih_addmul_1(tp + i, mp, n, tp[i] * minv);
+  cy = _gcry_mpih_add_n(rp, tp + n, tp, n);
+
+  /* The result is less than 2 MP; subtract MP once if needed.  */
+  borrow = _gcry_mpih_sub_n(tp + n, rp, mp, n);
+  mask = 0 - (cy | (borrow ^ 1));
+  for (i = 0; i < n; i++) rp[i] = (tp[n + i] & mask) | (rp[i] & ~mask);
+}
@@ -23,6 +23,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <cpuid.h>
+#endif
 
 #include "g10lib.h"
 #include "mpi-internal.h"
@@ -30,7 +33,26 @@
 /* Constants allocated right away at startup.  */
 static gcry_mpi_t constants[MPI_NUMBER_OF_CONSTANTS];
 
-const char *_gcry_mpi_get_hw_config(void) { return ""; }
+#ifdef USE_MPIH_BMI2
+int _gcry_mpih_use_bmi2;
+
+/* Enable the MULX/ADX kernels if the CPU has BMI2 and ADX.  */
+static void detect_mpih_bmi2(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (getenv("GCRYPT_NO_MPI_BMI2")) return;
+  if (__get_cpuid_max(0, NULL) < 7) return;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  _gcry_mpih_use_bmi2 = (ebx & (1 << 8)) && (ebx & (1 << 19));
+}
+#endif
+
+const char *_gcry_mpi_get_hw_config(void) {
+#ifdef USE_MPIH_BMI2
+  if (_gcry_mpih_use_bmi2) return "amd64/bmi2-adx";
+#endif
+  return "";
+}
 
 /* Initialize the MPI subsystem.  This is called early and allows to
    do some initialization without taking care of threading issues.  */
@@ -38,6 +60,10 @@ gpg_error_t _gcry_mpi_init(void) {
   int idx;
   unsigned long value;
 
+#ifdef USE_MPIH_BMI2
+  detect_mpih_bmi2();
+#endif
+
   for (idx = 0; idx < MPI_NUMBER_OF_CONSTANTS; idx++) {
     switch (idx) {
       case MPI_C_ZERO:
@@ -69,6 +69,12 @@ typedef gpg_error_t (*gcry_pk_sign_t)(gcry_sexp_t *r_sig, gcry_sexp_t s_data,
 typedef gpg_error_t (*gcry_pk_verify_t)(gcry_sexp_t s_sig, gcry_sexp_t s_data,
                                         gcry_sexp_t keyparms);
 
+/* Type for the pk_verify_batch function.  */
+typedef void (*gcry_pk_verify_batch_t)(gcry_sexp_t *s_sigs,
+                                       gcry_sexp_t *s_data,
+                                       gcry_sexp_t *keyparms,
+                                       gpg_error_t *rcs, unsigned int n);
+
 /* Type for the pk_get_nbits function.  */
 typedef unsigned (*gcry_pk_get_nbits_t)(gcry_sexp_t keyparms);
 
@@ -108,6 +114,7 @@ typedef struct gcry_pk_spec {
   pk_comp_keygrip_t comp_keygrip;
   pk_get_curve_t get_curve;
   pk_get_curve_param_t get_curve_param;
+  gcry_pk_verify_batch_t verify_batch; /* May be NULL.  */
 } gcry_pk_spec_t;
 
 /*
@@ -109,11 +109,15 @@ void _gcry_rmd160_hash_buffer(void *outbuf, const void *buffer, size_t length);
 void _gcry_sha1_hash_buffer(void *outbuf, const void *buffer, size_t length);
 void _gcry_sha1_hash_buffers(void *outbuf, const gcry_buffer_t *iov,
                              int iovcnt);
+void _gcry_sha1_hash_buffers_multi(void *outbuf, const gcry_buffer_t *iov,
+                                   int iovcnt);
 
 /*-- sha256.c --*/
 void _gcry_sha256_hash_buffer(void *outbuf, const void *buffer, size_t length);
 void _gcry_sha256_hash_buffers(void *outbuf, const gcry_buffer_t *iov,
                                int iovcnt);
+void _gcry_sha256_hash_buffers_multi(void *outbuf, const gcry_buffer_t *iov,
+                                     int iovcnt);
 
 /*-- sha512.c --*/
 void _gcry_sha512_hash_buffer(void *outbuf, const void *buffer, size_t length);
@@ -20,6 +20,8 @@
 #ifndef GCRY_EC_CONTEXT_H
 #define GCRY_EC_CONTEXT_H
 
+#include <stdint.h>
+
 #include "mpi.h"
 
 /* This context is used with all our EC functions. */
@@ -50,6 +52,7 @@ struct mpi_ec_ctx_s {
     struct {
       unsigned int a_is_pminus3 : 1;
       unsigned int two_inv_p : 1;
+      unsigned int field : 1;
     } valid; /* Flags to help setting the helper vars below.  */
 
     int a_is_pminus3; /* True if A = P - 3. */
@@ -58,9 +61,19 @@ struct mpi_ec_ctx_s {
 
     mpi_barrett_t p_barrett;
 
+    /* The fixed-size field backend for P or NULL.  If set, A, B and
+       1/2 in the representation of that backend.  */
+    const struct ec_field_s *field;
+    uint64_t fe_a[5];
+    uint64_t fe_b[5];
+    uint64_t fe_two_inv[5];
+
     /* Scratch variables.  */
     gcry_mpi_t scratch[11];
 
+    /* The fixed-base comb last used with this context.  */
+    struct ec_comb_s *comb;
+
     /* Helper for fast reduction.  */
     /*   int nist_nbits; /\* If this is a NIST curve, the # of bits.  *\/ */
     /*   gcry_mpi_t s[10]; */
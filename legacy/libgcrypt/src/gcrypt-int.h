@@ -85,6 +85,9 @@ gpg_error_t _gcry_pk_sign(gcry_sexp_t *result, gcry_sexp_t data,
                           gcry_sexp_t skey);
 gpg_error_t _gcry_pk_verify(gcry_sexp_t sigval, gcry_sexp_t data,
                             gcry_sexp_t pkey);
+gpg_error_t _gcry_pk_verify_batch(gcry_sexp_t *sigvals, gcry_sexp_t *data,
+                                  gcry_sexp_t *pkeys, gpg_error_t *rcs,
+                                  unsigned int n);
 gpg_error_t _gcry_pk_testkey(gcry_sexp_t key);
 gpg_error_t _gcry_pk_genkey(gcry_sexp_t *r_key, gcry_sexp_t s_parms);
 gpg_error_t _gcry_pk_ctl(int cmd, void *buffer, size_t buflen);
@@ -114,6 +117,9 @@ void _gcry_md_hash_buffer(int algo, void *digest, const void *buffer,
                           size_t length);
 gpg_error_t _gcry_md_hash_buffers(int algo, unsigned int flags, void *digest,
                                   const gcry_buffer_t *iov, int iovcnt);
+gpg_error_t _gcry_md_hash_buffers_multi(int algo, unsigned int flags,
+                                        void *digests,
+                                        const gcry_buffer_t *iov, int iovcnt);
 int _gcry_md_get_algo(gcry_md_hd_t hd);
 unsigned int _gcry_md_get_algo_dlen(int algo);
 int _gcry_md_is_enabled(gcry_md_hd_t a, int algo);
@@ -213,6 +219,25 @@ gpg_error_t _gcry_sexp_extract_param(gcry_sexp_t sexp, const char *path,
                                      const char *list, ...)
     _GCRY_GCC_ATTR_SENTINEL(0);
 
+/* A borrowed view of a list or an element inside of an S-expression;
+   see sexp.cpp.  An empty view has D set to NULL.  */
+typedef struct gcry_sexp_view {
+  const unsigned char *d;
+} gcry_sexp_view_t;
+
+gcry_sexp_view_t _gcry_sexp_view(const gcry_sexp_t list);
+gcry_sexp_view_t _gcry_sexp_view_find_token(gcry_sexp_view_t list,
+                                            const char *tok, size_t toklen);
+int _gcry_sexp_view_length(gcry_sexp_view_t list);
+gcry_sexp_view_t _gcry_sexp_view_nth(gcry_sexp_view_t list, int number);
+const char *_gcry_sexp_view_nth_data(gcry_sexp_view_t list, int number,
+                                     size_t *datalen);
+void *_gcry_sexp_view_nth_buffer(gcry_sexp_view_t list, int number,
+                                 size_t *rlength);
+gcry_mpi_t _gcry_sexp_view_nth_mpi(gcry_sexp_view_t list, int number,
+                                   int mpifmt);
+gcry_sexp_t _gcry_sexp_view_copy(gcry_sexp_view_t view);
+
 #define sexp_new(a, b, c, d) _gcry_sexp_new((a), (b), (c), (d))
 #define sexp_create(a, b, c, d, e) _gcry_sexp_create((a), (b), (c), (d), (e))
 #define sexp_sscan(a, b, c, d) _gcry_sexp_sscan((a), (b), (c), (d))
@@ -238,6 +263,14 @@ gpg_error_t _gcry_sexp_extract_param(gcry_sexp_t sexp, const char *path,
 #define sexp_nth_string(a, b) _gcry_sexp_nth_string((a), (b))
 #define sexp_nth_mpi(a, b, c) _gcry_sexp_nth_mpi((a), (b), (c))
 #define sexp_extract_param _gcry_sexp_extract_param
+#define sexp_view(a) _gcry_sexp_view((a))
+#define sexp_view_find_token(a, b, c) _gcry_sexp_view_find_token((a), (b), (c))
+#define sexp_view_length(a) _gcry_sexp_view_length((a))
+#define sexp_view_nth(a, b) _gcry_sexp_view_nth((a), (b))
+#define sexp_view_nth_data(a, b, c) _gcry_sexp_view_nth_data((a), (b), (c))
+#define sexp_view_nth_buffer(a, b, c) _gcry_sexp_view_nth_buffer((a), (b), (c))
+#define sexp_view_nth_mpi(a, b, c) _gcry_sexp_view_nth_mpi((a), (b), (c))
+#define sexp_view_copy(a) _gcry_sexp_view_copy((a))
 
 gcry_mpi_t _gcry_mpi_new(unsigned int nbits);
 gcry_mpi_t _gcry_mpi_snew(unsigned int nbits);
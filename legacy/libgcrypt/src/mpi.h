@@ -188,6 +188,20 @@ void _gcry_mpi_mod_barrett(gcry_mpi_t r, gcry_mpi_t x, mpi_barrett_t ctx);
 void _gcry_mpi_mul_barrett(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v,
                            mpi_barrett_t ctx);
 
+/*-- mpi-pow.c --*/
+#define mpi_mont_new(m) _gcry_mpi_mont_new((m))
+#define mpi_mont_free(c) _gcry_mpi_mont_free((c))
+#define mpi_powm_mont(w, b, e, c) _gcry_mpi_powm_mont((w), (b), (e), (c))
+
+/* Context used with Montgomery based exponentiation.  */
+struct mont_ctx_s;
+typedef struct mont_ctx_s *mpi_mont_t;
+
+mpi_mont_t _gcry_mpi_mont_new(gcry_mpi_t m);
+void _gcry_mpi_mont_free(mpi_mont_t ctx);
+void _gcry_mpi_powm_mont(gcry_mpi_t res, gcry_mpi_t base, gcry_mpi_t expo,
+                         mpi_mont_t ctx);
+
 /*-- mpi-mpow.c --*/
 #define mpi_mulpowm(a, b, c, d) _gcry_mpi_mulpowm((a), (b), (c), (d))
 void _gcry_mpi_mulpowm(gcry_mpi_t res, gcry_mpi_t *basearray,
@@ -261,6 +275,11 @@ void _gcry_mpi_ec_sub_points(mpi_point_t result, mpi_point_t p1, mpi_point_t p2,
                              mpi_ec_t ctx);
 void _gcry_mpi_ec_mul_point(mpi_point_t result, gcry_mpi_t scalar,
                             mpi_point_t point, mpi_ec_t ctx);
+void _gcry_mpi_ec_mul_base_point(mpi_point_t result, gcry_mpi_t scalar,
+                                 mpi_point_t base, mpi_ec_t ctx);
+void _gcry_mpi_ec_mul_points(mpi_point_t result, gcry_mpi_t *scalars,
+                             mpi_point_t *points, unsigned int n,
+                             mpi_ec_t ctx);
 int _gcry_mpi_ec_curve_point(gcry_mpi_point_t point, mpi_ec_t ctx);
 
 gcry_mpi_t _gcry_mpi_ec_ec2os(gcry_mpi_point_t point, mpi_ec_t ectx);
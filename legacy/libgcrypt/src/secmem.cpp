@@ -21,6 +21,7 @@
 
 #include <config.h>
 
+#include <atomic>
 #include <mutex>
 
 #include <errno.h>
@@ -106,6 +107,53 @@ std::mutex secmem_lock;
 #define SECMEM_LOCK secmem_lock.lock()
 #define SECMEM_UNLOCK secmem_lock.unlock()
 
+/* Released blocks of the main pool up to this size are kept in a
+ * per-thread cache, one list for each multiple of 32 bytes, so that
+ * the next allocation of the same size in this thread does not need
+ * SECMEM_LOCK.  The cached blocks stay active in the pool and are
+ * wiped when they enter the cache.  A thread caches at most
+ * CACHE_MAX_BYTES and never more than a 16th of the main pool.  All
+ * caches are registered in CACHE_LIST, so that they can be returned
+ * to the pool when it runs out of memory.  */
+#define CACHE_MAX_BLOCK 512
+#define CACHE_CLASSES (CACHE_MAX_BLOCK / 32)
+#define CACHE_DEPTH 8
+#define CACHE_MAX_BYTES 4096
+
+typedef struct secmem_cache_s {
+  /* Protects the blocks against a concurrent cache_flush_all_locked.
+   * Apart from that only the owning thread takes it.  */
+  std::mutex lock;
+
+  /* The links of CACHE_LIST, protected by SECMEM_LOCK.  */
+  struct secmem_cache_s *next, *prev;
+  int registered;
+
+  /* The value of CACHE_GENERATION when the blocks were cached.  */
+  unsigned int generation;
+  size_t bytes;
+  int count[CACHE_CLASSES];
+  memblock_t *blocks[CACHE_CLASSES][CACHE_DEPTH];
+
+  ~secmem_cache_s();
+} secmem_cache_t;
+
+static thread_local secmem_cache_t secmem_cache;
+
+/* The caches of all threads, protected by SECMEM_LOCK.  */
+static secmem_cache_t *cache_list;
+
+/* Incremented by _gcry_secmem_term; cached blocks of an older
+ * generation belong to a released pool and are dropped.  */
+static std::atomic<unsigned int> cache_generation;
+
+/* Statistics of the caches of all threads.  */
+static std::atomic<unsigned long> cache_hits;
+static std::atomic<unsigned long> cache_misses;
+static std::atomic<unsigned long> cache_flushes;
+static std::atomic<unsigned int> cache_blocks;
+static std::atomic<unsigned long> cache_bytes;
+
 /* The size of the memblock structure; this does not include the
    memory that is available to the user.  */
 #define BLOCK_HEAD_SIZE offsetof(memblock_t, aligned)
@@ -220,6 +268,157 @@ static memblock_t *mb_get_new(pooldesc_t *pool, memblock_t *block,
   return mb;
 }
 
+/* Wipe out the memory of block MB.  */
+static void mb_wipe(memblock_t *mb) {
+  int size = mb->size;
+
+/* This does not make much sense: probably this memory is held in the
+ * cache. We do it anyway: */
+#define MB_WIPE_OUT(byte) \
+  wipememory2(((char *)mb + BLOCK_HEAD_SIZE), (byte), size);
+
+  MB_WIPE_OUT(0xff);
+  MB_WIPE_OUT(0xaa);
+  MB_WIPE_OUT(0x55);
+  MB_WIPE_OUT(0x00);
+}
+
+/* Return the already wiped block MB to POOL.  */
+static void mb_release(pooldesc_t *pool, memblock_t *mb) {
+  /* Update stats.  */
+  stats_update(pool, 0, mb->size);
+
+  mb->flags &= ~MB_FLAG_ACTIVE;
+
+  mb_merge(pool, mb);
+}
+
+/* Return a block of SIZE bytes, which is a multiple of 32, from the
+ * cache of this thread or NULL.  */
+static void *cache_get(size_t size) {
+  secmem_cache_t *c = &secmem_cache;
+  memblock_t *mb;
+  int idx = size / 32 - 1;
+
+  if (idx < 0 || idx >= CACHE_CLASSES) return NULL;
+
+  std::lock_guard<std::mutex> lock(c->lock);
+  if (c->generation != cache_generation.load(std::memory_order_acquire))
+    return NULL;
+  if (!c->count[idx]) {
+    cache_misses.fetch_add(1, std::memory_order_relaxed);
+    return NULL;
+  }
+
+  mb = c->blocks[idx][--c->count[idx]];
+  c->bytes -= size;
+  cache_hits.fetch_add(1, std::memory_order_relaxed);
+  cache_blocks.fetch_sub(1, std::memory_order_relaxed);
+  cache_bytes.fetch_sub(size, std::memory_order_relaxed);
+  return &mb->aligned.c;
+}
+
+/* Add the cache C to CACHE_LIST.  */
+static void cache_register(secmem_cache_t *c) {
+  std::lock_guard<std::mutex> lock(secmem_lock);
+
+  c->prev = NULL;
+  c->next = cache_list;
+  if (cache_list) cache_list->prev = c;
+  cache_list = c;
+  c->registered = 1;
+}
+
+/* Wipe the block at A and put it into the cache of this thread.
+ * Returns false if A is not a suitable block of the main pool or the
+ * cache is full.  */
+static int cache_put(void *a) {
+  secmem_cache_t *c = &secmem_cache;
+  unsigned int gen = cache_generation.load(std::memory_order_acquire);
+  memblock_t *mb;
+  size_t limit;
+  int idx;
+
+  /* The main pool is never moved while it is okay, thus we don't
+   * need the lock; see also _gcry_private_is_secure.  */
+  if (!mainpool.okay || !ptr_into_pool_p(&mainpool, a)) return 0;
+
+  mb = ADDR_TO_BLOCK(a);
+  if (mb->size % 32) return 0;
+  idx = mb->size / 32 - 1;
+  if (idx < 0 || idx >= CACHE_CLASSES) return 0;
+
+  if (!c->registered) cache_register(c);
+
+  std::lock_guard<std::mutex> lock(c->lock);
+  if (c->generation != gen) {
+    /* The cached blocks belong to a pool released by
+     * _gcry_secmem_term.  */
+    memset(c->count, 0, sizeof c->count);
+    c->bytes = 0;
+    c->generation = gen;
+  }
+
+  limit = mainpool.size / 16;
+  if (limit > CACHE_MAX_BYTES) limit = CACHE_MAX_BYTES;
+  if (c->count[idx] == CACHE_DEPTH || c->bytes + mb->size > limit) return 0;
+
+  mb_wipe(mb);
+  c->blocks[idx][c->count[idx]++] = mb;
+  c->bytes += mb->size;
+  cache_blocks.fetch_add(1, std::memory_order_relaxed);
+  cache_bytes.fetch_add(mb->size, std::memory_order_relaxed);
+  return 1;
+}
+
+/* Return all blocks in the cache C to the main pool.  Expected to be
+ * called with the secmem lock held.  Returns true if any block was
+ * released.  */
+static int cache_flush_locked(secmem_cache_t *c) {
+  int idx, any = 0;
+  std::lock_guard<std::mutex> lock(c->lock);
+
+  if (c->generation == cache_generation.load(std::memory_order_acquire)) {
+    for (idx = 0; idx < CACHE_CLASSES; idx++)
+      while (c->count[idx]) {
+        mb_release(&mainpool, c->blocks[idx][--c->count[idx]]);
+        cache_blocks.fetch_sub(1, std::memory_order_relaxed);
+        cache_bytes.fetch_sub((idx + 1) * 32, std::memory_order_relaxed);
+        any = 1;
+      }
+  }
+  memset(c->count, 0, sizeof c->count);
+  c->bytes = 0;
+  if (any) cache_flushes.fetch_add(1, std::memory_order_relaxed);
+  return any;
+}
+
+/* Return the blocks in the caches of all threads to the main pool.
+ * Expected to be called with the secmem lock held.  Returns true if
+ * any block was released.  */
+static int cache_flush_all_locked(void) {
+  secmem_cache_t *c;
+  int any = 0;
+
+  for (c = cache_list; c; c = c->next)
+    if (cache_flush_locked(c)) any = 1;
+  return any;
+}
+
+/* Give the cached blocks back when the thread terminates.  */
+secmem_cache_s::~secmem_cache_s() {
+  std::lock_guard<std::mutex> lock(secmem_lock);
+
+  cache_flush_locked(this);
+  if (registered) {
+    if (prev)
+      prev->next = next;
+    else
+      cache_list = next;
+    if (next) next->prev = prev;
+  }
+}
+
 /* Print a warning message.  */
 static void print_warn(void) {
   if (!no_warning) log_info("Warning: using insecure memory!\n");
@@ -508,7 +707,11 @@ static void *_gcry_secmem_malloc_internal(size_t size, int xhint) {
   /* Blocks are always a multiple of 32. */
   size = ((size + 31) / 32) * 32;
 
+  /* Blocks cached by any thread are returned to the main pool before
+   * we resort to the overflow pools or fail.  */
   mb = mb_get_new(pool, (memblock_t *)pool->mem, size);
+  if (!mb && cache_flush_all_locked())
+    mb = mb_get_new(pool, (memblock_t *)pool->mem, size);
   if (mb) {
     stats_update(pool, mb->size, 0);
     return &mb->aligned.c;
@@ -565,6 +768,10 @@ static void *_gcry_secmem_malloc_internal(size_t size, int xhint) {
  * that the caller is a xmalloc style function.  */
 void *_gcry_secmem_malloc(size_t size, int xhint) {
   void *p;
+
+  p = cache_get(((size + 31) / 32) * 32);
+  if (p) return p;
+
   std::lock_guard<std::mutex> lock(secmem_lock);
   p = _gcry_secmem_malloc_internal(size, xhint);
   return p;
@@ -573,31 +780,14 @@ void *_gcry_secmem_malloc(size_t size, int xhint) {
 static int _gcry_secmem_free_internal(void *a) {
   pooldesc_t *pool;
   memblock_t *mb;
-  int size;
 
   for (pool = &mainpool; pool; pool = pool->next)
     if (pool->okay && ptr_into_pool_p(pool, a)) break;
   if (!pool) return 0; /* A does not belong to use.  */
 
   mb = ADDR_TO_BLOCK(a);
-  size = mb->size;
-
-/* This does not make much sense: probably this memory is held in the
- * cache. We do it anyway: */
-#define MB_WIPE_OUT(byte) \
-  wipememory2(((char *)mb + BLOCK_HEAD_SIZE), (byte), size);
-
-  MB_WIPE_OUT(0xff);
-  MB_WIPE_OUT(0xaa);
-  MB_WIPE_OUT(0x55);
-  MB_WIPE_OUT(0x00);
-
-  /* Update stats.  */
-  stats_update(pool, 0, size);
-
-  mb->flags &= ~MB_FLAG_ACTIVE;
-
-  mb_merge(pool, mb);
+  mb_wipe(mb);
+  mb_release(pool, mb);
 
   return 1; /* Freed.  */
 }
@@ -608,6 +798,8 @@ int _gcry_secmem_free(void *a) {
   int mine;
 
   if (!a) return 1; /* Tell caller that we handled it.  */
+  if (cache_put(a)) return 1;
+
   std::lock_guard<std::mutex> lock(secmem_lock);
   mine = _gcry_secmem_free_internal(a);
   return mine;
@@ -669,6 +861,12 @@ int _gcry_private_is_secure(const void *p) {
 void _gcry_secmem_term() {
   pooldesc_t *pool, *next;
 
+  /* The blocks in the per-thread caches are released with the
+   * pools.  */
+  cache_generation.fetch_add(1, std::memory_order_release);
+  cache_blocks = 0;
+  cache_bytes = 0;
+
   for (pool = &mainpool; pool; pool = next) {
     next = pool->next;
     if (!pool->okay) continue;
@@ -708,4 +906,8 @@ void _gcry_secmem_dump_stats() {
                pool == &mainpool ? "secmem usage:" : "", pool->cur_alloced,
                (unsigned long)pool->size, pool->cur_blocks);
   }
+  log_info("secmem cache: %u blocks with %lu bytes cached, %lu hits, "
+           "%lu misses, %lu flushes\n",
+           cache_blocks.load(), cache_bytes.load(), cache_hits.load(),
+           cache_misses.load(), cache_flushes.load());
 }
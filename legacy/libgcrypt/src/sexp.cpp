@@ -765,6 +765,218 @@ gcry_sexp_t _gcry_sexp_cadr(const gcry_sexp_t list) {
   return b;
 }
 
+/* Borrowed views.
+
+   The functions above copy each sublist they return into a new
+   object.  A view instead points into the buffer of an existing
+   S-expression, either to the ST_OPEN of a list or to the ST_DATA of
+   a single element.  A view of a single element behaves like the list
+   "(element)" which _gcry_sexp_nth would return for it.  Views need
+   not be released but are only valid as long as the S-expression
+   they were taken from.  */
+
+/* Return the address after the element starting at P, which must be
+   ST_OPEN or ST_DATA.  */
+static const byte *skip_element(const byte *p) {
+  DATALEN n;
+  int level = 0;
+
+  do {
+    if (*p == ST_DATA) {
+      memcpy(&n, ++p, sizeof n);
+      p += sizeof n + n;
+    } else {
+      if (*p == ST_OPEN)
+        level++;
+      else if (*p == ST_CLOSE)
+        level--;
+      else if (*p == ST_STOP)
+        BUG();
+      p++;
+    }
+  } while (level);
+  return p;
+}
+
+/* Return a view of the entire LIST.  */
+gcry_sexp_view_t _gcry_sexp_view(const gcry_sexp_t list) {
+  gcry_sexp_view_t view = {NULL};
+
+  if (list && (list->d[0] == ST_DATA ||
+               (list->d[0] == ST_OPEN && list->d[1] != ST_CLOSE)))
+    view.d = list->d;
+  return view;
+}
+
+/* Same as _gcry_sexp_find_token but return a view.  */
+gcry_sexp_view_t _gcry_sexp_view_find_token(gcry_sexp_view_t list,
+                                            const char *tok, size_t toklen) {
+  gcry_sexp_view_t view = {NULL};
+  const byte *p, *end;
+  DATALEN n;
+
+  if (!list.d) return view;
+
+  if (!toklen) toklen = strlen(tok);
+
+  p = list.d;
+  if (*p == ST_DATA) {
+    memcpy(&n, p + 1, sizeof n);
+    if (n == toklen && !memcmp(p + 1 + sizeof n, tok, toklen)) view = list;
+    return view;
+  }
+
+  end = skip_element(p);
+  while (p < end) {
+    if (*p == ST_OPEN && p[1] == ST_DATA) {
+      memcpy(&n, p + 2, sizeof n);
+      if (n == toklen && !memcmp(p + 2 + sizeof n, tok, toklen)) {
+        view.d = p;
+        break;
+      }
+      p += 2 + sizeof n + n;
+    } else if (*p == ST_DATA) {
+      memcpy(&n, p + 1, sizeof n);
+      p += 1 + sizeof n + n;
+    } else
+      p++;
+  }
+  return view;
+}
+
+/* Return the number of elements of LIST.  */
+int _gcry_sexp_view_length(gcry_sexp_view_t list) {
+  const byte *p;
+  int length = 0;
+
+  if (!list.d) return 0;
+  if (*list.d == ST_DATA) return 1;
+
+  for (p = list.d + 1; *p != ST_CLOSE; p = skip_element(p)) length++;
+  return length;
+}
+
+/* Return the address of element NUMBER of the list at P or NULL.  */
+static const byte *view_nth(const byte *p, int number) {
+  for (p++; *p != ST_CLOSE; p = skip_element(p), number--)
+    if (!number) return p;
+  return NULL;
+}
+
+/* Same as _gcry_sexp_nth but return a view.  */
+gcry_sexp_view_t _gcry_sexp_view_nth(gcry_sexp_view_t list, int number) {
+  gcry_sexp_view_t view = {NULL};
+  const byte *p;
+
+  if (!list.d) return view;
+  if (number < 0) number = 0; /* As with _gcry_sexp_nth.  */
+  if (*list.d == ST_DATA) {
+    if (!number) view = list;
+    return view;
+  }
+
+  p = view_nth(list.d, number);
+  if (p && !(*p == ST_OPEN && p[1] == ST_CLOSE)) view.d = p;
+  return view;
+}
+
+/* Same as _gcry_sexp_nth_data but for a view.  */
+const char *_gcry_sexp_view_nth_data(gcry_sexp_view_t list, int number,
+                                     size_t *datalen) {
+  const byte *p;
+  DATALEN n;
+
+  *datalen = 0;
+  if (!list.d) return NULL;
+  if (number < 0) number = 0; /* As with _gcry_sexp_nth_data.  */
+
+  if (*list.d == ST_DATA)
+    p = number ? NULL : list.d;
+  else
+    p = view_nth(list.d, number);
+  if (!p || *p != ST_DATA) return NULL;
+
+  memcpy(&n, p + 1, sizeof n);
+  *datalen = n;
+  return (const char *)p + 1 + sizeof n;
+}
+
+/* Same as _gcry_sexp_nth_buffer but for a view.  */
+void *_gcry_sexp_view_nth_buffer(gcry_sexp_view_t list, int number,
+                                 size_t *rlength) {
+  const char *s;
+  size_t n;
+  char *buf;
+
+  *rlength = 0;
+  s = _gcry_sexp_view_nth_data(list, number, &n);
+  if (!s || !n) return NULL;
+  buf = (char *)xtrymalloc(n);
+  if (!buf) return NULL;
+  memcpy(buf, s, n);
+  *rlength = n;
+  return buf;
+}
+
+/* Same as _gcry_sexp_nth_mpi but for a view.  */
+gcry_mpi_t _gcry_sexp_view_nth_mpi(gcry_sexp_view_t list, int number,
+                                   int mpifmt) {
+  const char *s;
+  size_t n;
+  gcry_mpi_t a;
+
+  if (mpifmt == GCRYMPI_FMT_OPAQUE) {
+    char *p;
+
+    p = (char *)_gcry_sexp_view_nth_buffer(list, number, &n);
+    if (!p) return NULL;
+
+    a = _gcry_is_secure(list.d) ? _gcry_mpi_snew(0) : _gcry_mpi_new(0);
+    if (a)
+      mpi_set_opaque(a, p, n * 8);
+    else
+      xfree(p);
+  } else {
+    if (!mpifmt) mpifmt = GCRYMPI_FMT_STD;
+
+    s = _gcry_sexp_view_nth_data(list, number, &n);
+    if (!s) return NULL;
+
+    if (_gcry_mpi_scan(&a, (gcry_mpi_format)(mpifmt), s, n, NULL)) return NULL;
+  }
+
+  return a;
+}
+
+/* Return a new S-expression with a copy of the list or element of
+   VIEW or NULL if VIEW is empty or on memory failure.  */
+gcry_sexp_t _gcry_sexp_view_copy(gcry_sexp_view_t view) {
+  gcry_sexp_t newlist;
+  byte *d;
+  size_t n;
+
+  if (!view.d) return NULL;
+
+  n = skip_element(view.d) - view.d;
+  if (*view.d == ST_DATA) {
+    newlist = (gcry_sexp_t)xtrymalloc(sizeof *newlist + n + 2);
+    if (!newlist) return NULL;
+    d = newlist->d;
+    *d++ = ST_OPEN;
+    memcpy(d, view.d, n);
+    d += n;
+    *d++ = ST_CLOSE;
+  } else {
+    newlist = (gcry_sexp_t)xtrymalloc(sizeof *newlist + n);
+    if (!newlist) return NULL;
+    d = newlist->d;
+    memcpy(d, view.d, n);
+    d += n;
+  }
+  *d = ST_STOP;
+  return newlist;
+}
+
 static GPG_ERR_INLINE int hextonibble(int s) {
   if (s >= '0' && s <= '9')
     return s - '0';
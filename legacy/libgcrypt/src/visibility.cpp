@@ -600,6 +600,12 @@ gpg_error_t gcry_pk_verify(gcry_sexp_t sigval, gcry_sexp_t data,
   return _gcry_pk_verify(sigval, data, pkey);
 }
 
+gpg_error_t gcry_pk_verify_batch(gcry_sexp_t *sigvals, gcry_sexp_t *data,
+                                 gcry_sexp_t *pkeys, gpg_error_t *rcs,
+                                 unsigned int n) {
+  return _gcry_pk_verify_batch(sigvals, data, pkeys, rcs, n);
+}
+
 gpg_error_t gcry_pk_testkey(gcry_sexp_t key) { return _gcry_pk_testkey(key); }
 
 gpg_error_t gcry_pk_genkey(gcry_sexp_t *r_key, gcry_sexp_t s_parms) {
@@ -686,6 +692,12 @@ gpg_error_t gcry_md_hash_buffers(int algo, unsigned int flags, void *digest,
   return _gcry_md_hash_buffers(algo, flags, digest, iov, iovcnt);
 }
 
+gpg_error_t gcry_md_hash_buffers_multi(int algo, unsigned int flags,
+                                       void *digests, const gcry_buffer_t *iov,
+                                       int iovcnt) {
+  return _gcry_md_hash_buffers_multi(algo, flags, digests, iov, iovcnt);
+}
+
 int gcry_md_get_algo(gcry_md_hd_t hd) { return _gcry_md_get_algo(hd); }
 
 unsigned int gcry_md_get_algo_dlen(int algo) {
@@ -3,8 +3,68 @@
 #include "gtest/gtest.h"
 
 int hmac_main(int argc, char* argv[]);
+int ed25519_main(int argc, char* argv[]);
+int cv25519_main(int argc, char* argv[]);
+int dsa_rfc6979_main(int argc, char* argv[]);
+int ecdh_main(int argc, char* argv[]);
+int mpitests_main(int argc, char* argv[]);
+int md_multi_main(int argc, char* argv[]);
+int kdf_main(int argc, char* argv[]);
+int pubkey_util_main(int argc, char* argv[]);
+int sexp_main(int argc, char* argv[]);
+int eddsa_batch_main(int argc, char* argv[]);
 
 TEST(GcryptTest, hmac) {
   int result = hmac_main(0, NULL);
   ASSERT_EQ(result, 0);
 }
+
+TEST(GcryptTest, ed25519) {
+  int result = ed25519_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, cv25519) {
+  int result = cv25519_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, dsa_rfc6979) {
+  int result = dsa_rfc6979_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, ecdh) {
+  int result = ecdh_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, mpitests) {
+  int result = mpitests_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, md_multi) {
+  int result = md_multi_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, kdf) {
+  int result = kdf_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, pubkey_util) {
+  int result = pubkey_util_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, sexp) {
+  int result = sexp_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, eddsa_batch) {
+  int result = eddsa_batch_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
@@ -156,7 +156,7 @@ static void test_opaque(void) {
 
   if (!gcry_mpi_get_flag(a, GCRYMPI_FLAG_OPAQUE)) die("opaque flag not set\n");
 
-  p = gcry_mpi_get_opaque(a, &nbits);
+  p = (char*)gcry_mpi_get_opaque(a, &nbits);
   if (!p) die("gcry_mpi_get_opaque returned NULL\n");
   if (nbits != 21 * 8 + 1)
     die("gcry_mpi_get_opaque returned a changed bit size\n");
@@ -172,7 +172,7 @@ static void test_opaque(void) {
 
   if (!gcry_mpi_get_flag(a, GCRYMPI_FLAG_OPAQUE)) die("opaque flag not set\n");
 
-  p = gcry_mpi_get_opaque(a, &nbits);
+  p = (char*)gcry_mpi_get_opaque(a, &nbits);
   if (!p) die("gcry_mpi_get_opaque returned NULL\n");
   if (nbits != 21 * 8 + 1)
     die("gcry_mpi_get_opaque returned a changed bit size\n");
@@ -197,7 +197,7 @@ static void test_maxsize(void) {
    * which may result in a segv but we ignore that to avoid actually
    * allocating such a long buffer.  */
   err = gcry_mpi_scan(&a, GCRYMPI_FMT_USG, buffer, 16 * 1024 * 1024 + 1, NULL);
-  if (gpg_err_code(err) != GPG_ERR_INV_OBJ)
+  if (err != GPG_ERR_INV_OBJ)
     die("gcry_mpi_scan does not detect its generic input limit\n");
 
   /* Now test the PGP limit.  The scan code check the two length bytes
@@ -205,7 +205,7 @@ static void test_maxsize(void) {
   buffer[0] = (16385 >> 8);
   buffer[1] = (16385 & 0xff);
   err = gcry_mpi_scan(&a, GCRYMPI_FMT_PGP, buffer, sizeof buffer, NULL);
-  if (gpg_err_code(err) != GPG_ERR_INV_OBJ)
+  if (err != GPG_ERR_INV_OBJ)
     die("gcry_mpi_scan does not detect the PGP input limit\n");
 
   buffer[0] = (16384 >> 8);
@@ -498,17 +498,92 @@ static int test_powm(void) {
   return 1;
 }
 
-int main(int argc, char* argv[]) {
+/* Compute RES = BASE ^ EXPO mod MOD with a plain square and multiply
+   using gcry_mpi_mulm.  This is slow but does not share any code with
+   gcry_mpi_powm besides the division.  */
+static void reference_powm(gcry_mpi_t res, gcry_mpi_t base, gcry_mpi_t expo,
+                           gcry_mpi_t mod) {
+  gcry_mpi_t b = gcry_mpi_new(0);
+  int i;
+
+  gcry_mpi_mod(b, base, mod);
+  gcry_mpi_set_ui(res, 1);
+  gcry_mpi_mod(res, res, mod);
+  for (i = gcry_mpi_get_nbits(expo) - 1; i >= 0; i--) {
+    gcry_mpi_mulm(res, res, res, mod);
+    if (gcry_mpi_test_bit(expo, i)) gcry_mpi_mulm(res, res, b, mod);
+  }
+  gcry_mpi_release(b);
+}
+
+/* Compare gcry_mpi_powm with the reference for random operands.  Odd
+   moduli use the Montgomery code, even ones the sliding window code.
+   The sizes cover the basecase and the Karatsuba range of the
+   generic multiplication.  A secure exponent selects the code path
+   for secret exponents.  */
+static void test_powm_random(void) {
+  static const unsigned int mbits[] = {64,  192,  521,  1023, 1024,
+                                       1088, 2048, 3072, 4160};
+  gcry_mpi_t base, expo, mod, res, ref;
+  unsigned int i, ebits;
+  int variant;
+
+  res = gcry_mpi_new(0);
+  ref = gcry_mpi_new(0);
+  for (i = 0; i < DIM(mbits); i++)
+    for (variant = 0; variant < 8; variant++) {
+      /* The exponent has the full size of the modulus for the
+         smaller moduli only, to keep the reference fast.  */
+      ebits = mbits[i] > 1088 ? 320 : mbits[i];
+      mod = gcry_mpi_new(mbits[i]);
+      gcry_mpi_randomize(mod, mbits[i]);
+      gcry_mpi_set_bit(mod, mbits[i] - 1);
+      if ((variant & 1))
+        gcry_mpi_clear_bit(mod, 0);
+      else
+        gcry_mpi_set_bit(mod, 0);
+      base = gcry_mpi_new(mbits[i] + 64);
+      gcry_mpi_randomize(base, (variant & 2) ? mbits[i] + 64 : mbits[i] - 1);
+      if ((variant & 4)) gcry_mpi_neg(base, base);
+      expo = (variant & 2) ? gcry_mpi_snew(ebits) : gcry_mpi_new(ebits);
+      gcry_mpi_randomize(expo, ebits);
+
+      reference_powm(ref, base, expo, mod);
+      gcry_mpi_powm(res, base, expo, mod);
+      if (gcry_mpi_cmp(res, ref)) {
+        if (verbose) {
+          gcry_log_debugmpi("mod", mod);
+          gcry_log_debugmpi("base", base);
+          gcry_log_debugmpi("expo", expo);
+          gcry_log_debugmpi("res", res);
+          gcry_log_debugmpi("ref", ref);
+        }
+        fail("test_powm_random failed for %u bits, variant %d\n", mbits[i],
+             variant);
+      }
+
+      /* Check using the base for the result.  */
+      gcry_mpi_powm(base, base, expo, mod);
+      if (gcry_mpi_cmp(base, ref))
+        fail("test_powm_random failed for %u bits, variant %d at %d\n",
+             mbits[i], variant, __LINE__);
+
+      gcry_mpi_release(base);
+      gcry_mpi_release(expo);
+      gcry_mpi_release(mod);
+    }
+  gcry_mpi_release(res);
+  gcry_mpi_release(ref);
+}
+
+int mpitests_main(int argc, char* argv[]) {
   if (argc > 1 && !strcmp(argv[1], "--verbose"))
     verbose = 1;
   else if (argc > 1 && !strcmp(argv[1], "--debug"))
     verbose = debug = 1;
 
-  if (!gcry_check_version(GCRYPT_VERSION)) {
-    fputs("version mismatch\n", stderr);
-    exit(1);
-  }
-  xgcry_control(GCRYCTL_DISABLE_SECMEM);
+  xgcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+  xgcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
 
   test_const_and_immutable();
   test_opaque();
@@ -518,6 +593,7 @@ int main(int argc, char* argv[]) {
   test_sub();
   test_mul();
   test_powm();
+  test_powm_random();
 
   return !!error_count;
 }
@@ -34,11 +34,10 @@
 #define N_TESTS 18
 
 static void print_mpi(const char *text, gcry_mpi_t a) {
-  gcry_error_t err;
-  char *buf;
-  void *bufaddr = &buf;
+  gpg_error_t err;
+  unsigned char *buf;
 
-  err = gcry_mpi_aprint(GCRYMPI_FMT_HEX, bufaddr, NULL, a);
+  err = gcry_mpi_aprint(GCRYMPI_FMT_HEX, &buf, NULL, a);
   if (err)
     fprintf(stderr, "%s: [error printing number: %s]\n", text,
             gpg_strerror(err));
@@ -71,7 +70,7 @@ static void *hex2buffer(const char *string, size_t *r_length) {
   unsigned char *buffer;
   size_t length;
 
-  buffer = xmalloc(strlen(string) / 2 + 1);
+  buffer = (unsigned char *)xmalloc(strlen(string) / 2 + 1);
   length = 0;
   for (s = string; *s; s += 2) {
     if (!hexdigitp(s) || !hexdigitp(s + 1))
@@ -123,7 +122,7 @@ static void test_cv(int testno, const char *k_str, const char *u_str,
     goto leave;
   }
 
-  reverse_buffer(buffer, buflen);
+  reverse_buffer((unsigned char *)buffer, buflen);
   if ((err = gcry_mpi_scan(&mpi_k, GCRYMPI_FMT_USG, buffer, buflen, NULL))) {
     fail("error converting MPI for test %d: %s", testno, gpg_strerror(err));
     goto leave;
@@ -169,14 +168,15 @@ static void test_cv(int testno, const char *k_str, const char *u_str,
     fail("gcry_pk_encrypt failed for test %d: %s", testno, gpg_strerror(err));
 
   s_tmp = gcry_sexp_find_token(s_result, "s", 0);
-  if (!s_tmp || !(res = gcry_sexp_nth_buffer(s_tmp, 1, &res_len)))
+  if (!s_tmp ||
+      !(res = (unsigned char *)gcry_sexp_nth_buffer(s_tmp, 1, &res_len)))
     fail("gcry_pk_encrypt failed for test %d: %s", testno, "missing value");
   else {
     char *r, *r0;
     int i;
 
     /* To skip the prefix 0x40, for-loop start with i=1 */
-    r0 = r = xmalloc(2 * (res_len) + 1);
+    r0 = r = (char *)xmalloc(2 * (res_len) + 1);
     if (!r0) {
       fail("memory allocation for test %d", testno);
       goto leave;
@@ -233,7 +233,7 @@ static void test_it(int testno, const char *k_str, int iter,
          "invalid hex string");
     goto leave;
   }
-  reverse_buffer(buffer, buflen);
+  reverse_buffer((unsigned char *)buffer, buflen);
   if ((err = gcry_mpi_scan(&mpi_x, GCRYMPI_FMT_USG, buffer, buflen, NULL))) {
     fail("error scanning MPI for test %d, %s: %s", testno, "x",
          gpg_strerror(err));
@@ -274,7 +274,7 @@ static void test_it(int testno, const char *k_str, int iter,
     gcry_mpi_print(GCRYMPI_FMT_USG, res, 32, NULL, mpi_k);
     reverse_buffer(res, 32);
 
-    r0 = r = xmalloc(65);
+    r0 = r = (char *)xmalloc(65);
     if (!r0) {
       fail("memory allocation for test %d", testno);
       goto leave;
@@ -457,7 +457,7 @@ static void check_cv25519(void) {
     show_note("%d tests done\n", ntests);
 }
 
-int main(int argc, char **argv) {
+int cv25519_main(int argc, char **argv) {
   int last_argc = -1;
 
   if (argc) {
@@ -493,9 +493,7 @@ int main(int argc, char **argv) {
   }
 
   xgcry_control(GCRYCTL_DISABLE_SECMEM, 0);
-  if (!gcry_check_version(GCRYPT_VERSION)) die("version mismatch\n");
   if (debug) xgcry_control(GCRYCTL_SET_DEBUG_FLAGS, 1u, 0);
-  xgcry_control(GCRYCTL_ENABLE_QUICK_RANDOM, 0);
   xgcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
 
   start_timer();
@@ -0,0 +1,145 @@
+/* t-ecdh.c - Check the ECDH primitive with NIST P-256
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PGM "t-ecdh"
+#include "t-common.h"
+
+/* Test vectors from the NIST CAVS "ECC CDH Primitive" test data.  */
+static struct {
+  const char *curve;
+  const char *qcavs; /* The peer's public key (uncompressed).  */
+  const char *diut;  /* Our secret scalar.  */
+  const char *qiut;  /* Our public key (uncompressed).  */
+  const char *ziut;  /* The shared secret (x-coordinate).  */
+} tv[] = {
+    {"NIST P-256",
+     "04700c48f77f56584c5cc632ca65640db91b6bacce3a4df6b42ce7cc838833d287"
+     "db71e509e3fd9b060ddb20ba5c51dcc5948d46fbf640dfe0441782cab85fa4ac",
+     "7d7dc5f71eb29ddaf80d6214632eeae03d9058af1fb6d22ed80badb62bc1a534",
+     "04ead218590119e8876b29146ff89ca61770c4edbbf97d38ce385ed281d8a6b230"
+     "28af61281fd35e2fa7002523acc85a429cb06ee6648325389f59edfce1405141",
+     "46fc62106420ff012e54a434fbdd2d25ccc5852060561e68040dd7778997bd7b"}};
+
+/* Convert STRING consisting of hex characters into its binary
+   representation and return it as an allocated buffer. The valid
+   length of the buffer is returned at R_LENGTH.  */
+static unsigned char *hex2buffer(const char *string, size_t *r_length) {
+  const char *s;
+  unsigned char *buffer;
+  size_t length;
+
+  buffer = (unsigned char *)xmalloc(strlen(string) / 2 + 1);
+  length = 0;
+  for (s = string; *s; s += 2) {
+    if (!hexdigitp(s) || !hexdigitp(s + 1))
+      die("error parsing hex string `%s'\n", string);
+    buffer[length++] = xtoi_2(s);
+  }
+  *r_length = length;
+  return buffer;
+}
+
+/* Return true if the value of TOKEN in SEXP equals the hex string
+   EXPECT.  If XONLY is set, only the x-coordinate of the point in
+   TOKEN is compared.  */
+static int check_value(gcry_sexp_t sexp, const char *token, const char *expect,
+                       int xonly) {
+  gcry_sexp_t l;
+  unsigned char *value, *buffer;
+  size_t valuelen, buflen;
+  int ok;
+
+  l = gcry_sexp_find_token(sexp, token, 0);
+  value = l ? (unsigned char *)gcry_sexp_nth_buffer(l, 1, &valuelen) : NULL;
+  gcry_sexp_release(l);
+  if (!value) return 0;
+
+  buffer = hex2buffer(expect, &buflen);
+  if (xonly)
+    ok = valuelen == 1 + 2 * buflen && value[0] == 0x04 &&
+         !memcmp(value + 1, buffer, buflen);
+  else
+    ok = valuelen == buflen && !memcmp(value, buffer, buflen);
+  xfree(buffer);
+  xfree(value);
+  return ok;
+}
+
+static void check_ecdh(void) {
+  gpg_error_t err;
+  gcry_sexp_t s_pk, s_data, s_result;
+  gcry_mpi_t d;
+  unsigned char *buffer;
+  size_t buflen;
+  int i;
+
+  for (i = 0; i < DIM(tv); i++) {
+    buffer = hex2buffer(tv[i].qcavs, &buflen);
+    err = gcry_sexp_build(&s_pk, NULL,
+                          "(public-key (ecc (curve %s) (q %b)))", tv[i].curve,
+                          (int)buflen, buffer);
+    xfree(buffer);
+    if (err) die("building public key %d failed: %s\n", i, gpg_strerror(err));
+
+    err = gcry_mpi_scan(&d, GCRYMPI_FMT_HEX, tv[i].diut, 0, NULL);
+    if (err) die("scanning scalar %d failed: %s\n", i, gpg_strerror(err));
+    err = gcry_sexp_build(&s_data, NULL, "%m", d);
+    if (err) die("building data %d failed: %s\n", i, gpg_strerror(err));
+
+    /* ECDH is implemented as encryption with the scalar as data: S
+       is the shared point and E our public key.  */
+    err = gcry_pk_encrypt(&s_result, s_data, s_pk);
+    if (err)
+      fail("gcry_pk_encrypt failed for test %d: %s", i, gpg_strerror(err));
+    else {
+      if (!check_value(s_result, "s", tv[i].ziut, 1))
+        fail("wrong shared secret for test %d", i);
+      if (!check_value(s_result, "e", tv[i].qiut, 0))
+        fail("wrong public key for test %d", i);
+      gcry_sexp_release(s_result);
+    }
+
+    gcry_mpi_release(d);
+    gcry_sexp_release(s_data);
+    gcry_sexp_release(s_pk);
+  }
+}
+
+int ecdh_main(int argc, char **argv) {
+  if (argc > 1 && !strcmp(argv[1], "--verbose"))
+    verbose = 1;
+  else if (argc > 1 && !strcmp(argv[1], "--debug"))
+    verbose = debug = 1;
+
+  xgcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+  xgcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+  if (debug) xgcry_control(GCRYCTL_SET_DEBUG_FLAGS, 1u, 0);
+
+  check_ecdh();
+
+  return error_count ? 1 : 0;
+}
@@ -0,0 +1,476 @@
+/* t-eddsa-batch.c - Check the batch verification of EdDSA signatures
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+/* _gcry_mpi_ec_mul_points is internal, thus we use the internal
+   headers in place of gcrypt.h and t-common.h.  */
+#include "../src/cipher.h"
+
+#include "../src/context.h"
+#include "../src/ec-context.h"
+#include "../src/mpi.h"
+
+#define PGM "t-eddsa-batch"
+
+static int verbose;
+static int error_count;
+
+static void fail(const char *format, ...) {
+  va_list arg_ptr;
+
+  fflush(stdout);
+  fprintf(stderr, "%s: ", PGM);
+  va_start(arg_ptr, format);
+  vfprintf(stderr, format, arg_ptr);
+  va_end(arg_ptr);
+  error_count++;
+}
+
+/* The encodings of the points of small order on Ed25519.  */
+static const struct {
+  int order;
+  const char *hex;
+} small_order[] = {
+    {1, "0100000000000000000000000000000000000000000000000000000000000000"},
+    {2, "ecffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f"},
+    {4, "0000000000000000000000000000000000000000000000000000000000000000"},
+    {4, "0000000000000000000000000000000000000000000000000000000000000080"},
+    {8, "26e8958fc2b227b045c3f489f2ef98f0d5dfac05d3c63339b13802886d53fc05"},
+    {8, "26e8958fc2b227b045c3f489f2ef98f0d5dfac05d3c63339b13802886d53fc85"},
+    {8, "c7176a703d4dd84fba3c0b760d10670f2a2053fa2c39ccc64ec7fd7792ac037a"},
+    {8, "c7176a703d4dd84fba3c0b760d10670f2a2053fa2c39ccc64ec7fd7792ac03fa"}};
+
+/* The identity with y = p + 1, a non-canonical encoding.  */
+#define IDENTITY_PLUS_P \
+  "eeffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f"
+
+static gcry_ctx_t ec;
+static gcry_mpi_point_t G;
+static gcry_mpi_t n;
+
+/* A signature together with its key and message.  */
+struct batch_sig {
+  std::string pk, msg, r, s;
+  int good; /* The expected result, or -1 if not known.  */
+};
+
+static std::string hex2str(const char *hex) {
+  std::string s;
+
+  for (; hex[0] && hex[1]; hex += 2) {
+    char buf[3] = {hex[0], hex[1], 0};
+
+    s += (char)strtoul(buf, NULL, 16);
+  }
+  return s;
+}
+
+/* Return the EdDSA encoding of POINT.  */
+static std::string encode_point(gcry_mpi_point_t point) {
+  gcry_mpi_t q;
+  const void *buf;
+  unsigned int nbits;
+  std::string s;
+
+  gcry_mpi_ec_set_point("q", point, ec);
+  q = gcry_mpi_ec_get_mpi("q@eddsa", ec, 1);
+  if (!q) {
+    fail("encoding a point failed\n");
+    return s;
+  }
+  buf = gcry_mpi_get_opaque(q, &nbits);
+  s = std::string((const char *)buf, (nbits + 7) / 8);
+  gcry_mpi_release(q);
+  return s;
+}
+
+static gcry_mpi_point_t decode_point(const std::string &enc) {
+  gcry_mpi_point_t point = gcry_mpi_point_new(0);
+  gcry_mpi_t value;
+
+  value = gcry_mpi_set_opaque_copy(NULL, enc.data(), enc.size() * 8);
+  if (gcry_mpi_ec_decode_point(point, value, ec)) fail("decoding failed\n");
+  gcry_mpi_release(value);
+  return point;
+}
+
+/* Return X as 32 octets in little endian order.  */
+static std::string encode_scalar(gcry_mpi_t x) {
+  unsigned char buf[32];
+  size_t len, i;
+  std::string s(32, 0);
+
+  if (gcry_mpi_print(GCRYMPI_FMT_USG, buf, sizeof buf, &len, x)) {
+    fail("scalar too large\n");
+    return s;
+  }
+  for (i = 0; i < len; i++) s[i] = buf[len - 1 - i];
+  return s;
+}
+
+/* Return H(R + PK + MSG) as a scalar.  */
+static gcry_mpi_t hash_scalar(const std::string &r, const std::string &pk,
+                              const std::string &msg) {
+  std::string buf = r + pk + msg;
+  unsigned char digest[64], tmp;
+  gcry_mpi_t h;
+  int i;
+
+  gcry_md_hash_buffer(GCRY_MD_SHA512, digest, buf.data(), buf.size());
+  for (i = 0; i < 32; i++) {
+    tmp = digest[i];
+    digest[i] = digest[63 - i];
+    digest[63 - i] = tmp;
+  }
+  gcry_mpi_scan(&h, GCRYMPI_FMT_USG, digest, 64, NULL);
+  return h;
+}
+
+static gcry_mpi_t random_scalar(void) {
+  gcry_mpi_t x = gcry_mpi_new(0);
+
+  gcry_mpi_randomize(x, 256);
+  gcry_mpi_mod(x, x, n);
+  return x;
+}
+
+static int is_identity(gcry_mpi_point_t point) {
+  gcry_mpi_t x = gcry_mpi_new(0);
+  gcry_mpi_t y = gcry_mpi_new(0);
+  int res;
+
+  res = !gcry_mpi_ec_get_affine(x, y, point, ec) && !gcry_mpi_cmp_ui(x, 0) &&
+        !gcry_mpi_cmp_ui(y, 1);
+  gcry_mpi_release(x);
+  gcry_mpi_release(y);
+  return res;
+}
+
+/* Sign MSG with the secret scalar A of the key PK, which is a·G plus
+   possibly a point of small order.  R is r·G plus TR unless TR is
+   NULL.  */
+static batch_sig make_sig(gcry_mpi_t a, const std::string &pk,
+                          gcry_mpi_point_t tr, const std::string &msg,
+                          int good) {
+  gcry_mpi_t r = random_scalar();
+  gcry_mpi_t h, s = gcry_mpi_new(0);
+  gcry_mpi_point_t R = gcry_mpi_point_new(0);
+  batch_sig sig;
+
+  gcry_mpi_ec_mul(R, r, G, ec);
+  if (tr) gcry_mpi_ec_add(R, R, tr, ec);
+  sig.pk = pk;
+  sig.msg = msg;
+  sig.r = encode_point(R);
+  h = hash_scalar(sig.r, pk, msg);
+  gcry_mpi_mulm(s, h, a, n);
+  gcry_mpi_addm(s, s, r, n);
+  sig.s = encode_scalar(s);
+  sig.good = good;
+
+  gcry_mpi_release(h);
+  gcry_mpi_release(s);
+  gcry_mpi_release(r);
+  gcry_mpi_point_release(R);
+  return sig;
+}
+
+/* Verify SIGS with gcry_pk_verify_batch and one by one with
+   gcry_pk_verify and check that the results agree.  */
+static void check_batch(const char *what, const std::vector<batch_sig> &sigs) {
+  size_t i, count = sigs.size();
+  std::vector<gcry_sexp_t> s_sigs(count), s_data(count), s_keys(count);
+  std::vector<gpg_error_t> rcs(count);
+  gpg_error_t err, single, first = 0;
+
+  for (i = 0; i < count; i++) {
+    const batch_sig &sig = sigs[i];
+
+    if (gcry_sexp_build(&s_keys[i], NULL,
+                        "(public-key(ecc(curve Ed25519)(flags eddsa)(q%b)))",
+                        (int)sig.pk.size(), sig.pk.data()) ||
+        gcry_sexp_build(&s_data[i], NULL,
+                        "(data(flags eddsa)(hash-algo sha512)(value %b))",
+                        (int)sig.msg.size(), sig.msg.data()) ||
+        gcry_sexp_build(&s_sigs[i], NULL, "(sig-val(eddsa(r%b)(s%b)))",
+                        (int)sig.r.size(), sig.r.data(), (int)sig.s.size(),
+                        sig.s.data()))
+      fail("%s: building the S-expressions failed\n", what);
+  }
+
+  err = gcry_pk_verify_batch(s_sigs.data(), s_data.data(), s_keys.data(),
+                             rcs.data(), count);
+  for (i = 0; i < count; i++) {
+    single = gcry_pk_verify(s_sigs[i], s_data[i], s_keys[i]);
+    if (rcs[i] != single)
+      fail("%s: signature %d: batch says %s, single says %s\n", what, (int)i,
+           gpg_strerror(rcs[i]), gpg_strerror(single));
+    if (sigs[i].good != -1 && !single != sigs[i].good)
+      fail("%s: signature %d: unexpected result %s\n", what, (int)i,
+           gpg_strerror(single));
+    if (!first) first = single;
+  }
+  if (err != first)
+    fail("%s: batch returned %s instead of %s\n", what, gpg_strerror(err),
+         gpg_strerror(first));
+
+  for (i = 0; i < count; i++) {
+    gcry_sexp_release(s_sigs[i]);
+    gcry_sexp_release(s_data[i]);
+    gcry_sexp_release(s_keys[i]);
+  }
+}
+
+/* Check that the table of the points of small order is right.  */
+static void check_small_order(void) {
+  gcry_mpi_point_t P, Q = gcry_mpi_point_new(0);
+  int i, order;
+
+  for (i = 0; i < (int)DIM(small_order); i++) {
+    P = decode_point(hex2str(small_order[i].hex));
+    /* The points with y = 0 are not recovered by the decoder.  They
+       are still used as encodings below.  */
+    if (!gcry_mpi_ec_curve_point(P, ec)) {
+      if (small_order[i].order != 4) fail("point %d is not on the curve\n", i);
+      gcry_mpi_point_release(P);
+      continue;
+    }
+    gcry_mpi_ec_mul(Q, GCRYMPI_CONST_ONE, P, ec);
+    for (order = 1; order <= 8 && !is_identity(Q); order++)
+      gcry_mpi_ec_add(Q, Q, P, ec);
+    if (order != small_order[i].order)
+      fail("point %d has order %d, not %d\n", i, order, small_order[i].order);
+    gcry_mpi_point_release(P);
+  }
+  gcry_mpi_point_release(Q);
+}
+
+/* Compare _gcry_mpi_ec_mul_points with separate multiplications.  */
+static void check_mul_points(void) {
+  enum { NPOINTS = 7 };
+  mpi_ec_t ctx = (mpi_ec_t)_gcry_ctx_get_pointer(ec, CONTEXT_TYPE_EC);
+  gcry_mpi_point_t points[NPOINTS];
+  gcry_mpi_t scalars[NPOINTS];
+  gcry_mpi_point_t sum = gcry_mpi_point_new(0);
+  gcry_mpi_point_t tmp = gcry_mpi_point_new(0);
+  gcry_mpi_point_t res = gcry_mpi_point_new(0);
+  gcry_mpi_t x1 = gcry_mpi_new(0), y1 = gcry_mpi_new(0);
+  gcry_mpi_t x2 = gcry_mpi_new(0), y2 = gcry_mpi_new(0);
+  unsigned int i, count;
+
+  for (i = 0; i < NPOINTS; i++) {
+    gcry_mpi_t k = random_scalar();
+
+    points[i] = gcry_mpi_point_new(0);
+    gcry_mpi_ec_mul(points[i], k, G, ec);
+    gcry_mpi_release(k);
+    scalars[i] = random_scalar();
+  }
+  /* A small scalar, a zero scalar and a point of small order.  */
+  gcry_mpi_set_ui(scalars[1], 5);
+  gcry_mpi_set_ui(scalars[2], 0);
+  gcry_mpi_point_release(points[3]);
+  points[3] = decode_point(hex2str(small_order[6].hex));
+
+  for (count = 0; count <= NPOINTS; count++) {
+    gcry_mpi_ec_mul(sum, GCRYMPI_CONST_ONE, G, ec);
+    gcry_mpi_ec_sub(sum, sum, G, ec);
+    for (i = 0; i < count; i++) {
+      gcry_mpi_ec_mul(tmp, scalars[i], points[i], ec);
+      gcry_mpi_ec_add(sum, sum, tmp, ec);
+    }
+    _gcry_mpi_ec_mul_points(res, scalars, points, count, ctx);
+    if (gcry_mpi_ec_get_affine(x1, y1, sum, ec) ||
+        gcry_mpi_ec_get_affine(x2, y2, res, ec) || gcry_mpi_cmp(x1, x2) ||
+        gcry_mpi_cmp(y1, y2))
+      fail("mul_points with %u points differs\n", count);
+  }
+
+  for (i = 0; i < NPOINTS; i++) {
+    gcry_mpi_point_release(points[i]);
+    gcry_mpi_release(scalars[i]);
+  }
+  gcry_mpi_point_release(sum);
+  gcry_mpi_point_release(tmp);
+  gcry_mpi_point_release(res);
+  gcry_mpi_release(x1);
+  gcry_mpi_release(y1);
+  gcry_mpi_release(x2);
+  gcry_mpi_release(y2);
+}
+
+static void check_eddsa_batch(void) {
+  enum { NKEYS = 3, NGOOD = 12 };
+  gcry_mpi_t a[NKEYS];
+  std::string pk[NKEYS];
+  std::vector<batch_sig> good, sigs;
+  gcry_mpi_point_t A = gcry_mpi_point_new(0);
+  gcry_mpi_point_t T, T8;
+  gcry_mpi_t zero = gcry_mpi_new(0);
+  gcry_mpi_t h, s;
+  std::string msg, identity;
+  batch_sig sig;
+  int i, k;
+
+  for (i = 0; i < NKEYS; i++) {
+    a[i] = random_scalar();
+    gcry_mpi_ec_mul(A, a[i], G, ec);
+    pk[i] = encode_point(A);
+  }
+  for (i = 0; i < NGOOD; i++) {
+    msg = std::string(i * 7, 'a' + i);
+    good.push_back(make_sig(a[i % NKEYS], pk[i % NKEYS], NULL, msg, 1));
+  }
+  identity = hex2str(small_order[0].hex);
+
+  check_batch("good", good);
+  sigs.assign(good.begin(), good.begin() + 1);
+  check_batch("one", sigs);
+  sigs.clear();
+  check_batch("none", sigs);
+
+  /* Corrupted signatures and messages.  */
+  sigs = good;
+  sigs[3].s[5] ^= 1;
+  sigs[3].good = 0;
+  sigs[7].msg += "x";
+  sigs[7].good = 0;
+  sigs[8].r[0] ^= 4;
+  sigs[8].good = 0;
+  check_batch("corrupted", sigs);
+
+  /* An S which is not reduced is accepted by gcry_pk_verify.  */
+  sigs = good;
+  s = gcry_mpi_new(0);
+  {
+    std::string be(sigs[2].s.rbegin(), sigs[2].s.rend());
+
+    gcry_mpi_scan(&h, GCRYMPI_FMT_USG, be.data(), be.size(), NULL);
+    gcry_mpi_add(s, h, n);
+    gcry_mpi_release(h);
+  }
+  sigs[2].s = encode_scalar(s);
+  sigs[2].good = -1;
+  gcry_mpi_release(s);
+  check_batch("unreduced s", sigs);
+
+  /* R with a component of small order.  The equation holds when
+     multiplied by the cofactor but not without, as used by
+     gcry_pk_verify.  */
+  for (i = 1; i < (int)DIM(small_order); i++) {
+    T = decode_point(hex2str(small_order[i].hex));
+    sigs = good;
+    sigs[i] = make_sig(a[i % NKEYS], pk[i % NKEYS], T, "small order R", 0);
+    check_batch("mixed order R", sigs);
+    gcry_mpi_point_release(T);
+  }
+
+  /* Keys and R of small order with S = 0.  The identity as key and R
+     gives a good signature.  */
+  for (i = 0; i < (int)DIM(small_order); i++)
+    for (k = 0; k < (int)DIM(small_order); k += 3) {
+      sigs = good;
+      sig.pk = hex2str(small_order[i].hex);
+      sig.r = hex2str(small_order[k].hex);
+      sig.s = std::string(32, 0);
+      sig.msg = "small order key";
+      sig.good = (!i && !k) ? 1 : -1;
+      sigs.push_back(sig);
+      check_batch("small order key", sigs);
+    }
+
+  /* A non-canonical encoding of R.  */
+  sigs = good;
+  sig.pk = identity;
+  sig.r = hex2str(IDENTITY_PLUS_P);
+  sig.s = std::string(32, 0);
+  sig.msg = "non-canonical R";
+  sig.good = 0;
+  sigs.insert(sigs.begin() + 4, sig);
+  check_batch("non-canonical R", sigs);
+
+  /* A key of mixed order.  With R = r·G + k·T8 the signature is good
+     if k = -h mod 8, else bad.  Try until a good one is found.  */
+  T8 = decode_point(hex2str(small_order[4].hex));
+  gcry_mpi_ec_mul(A, a[0], G, ec);
+  gcry_mpi_ec_add(A, A, T8, ec);
+  sig.pk = encode_point(A);
+  for (i = 0, k = 0; k < 2 && i < 200; i++) {
+    gcry_mpi_t kk = gcry_mpi_set_ui(NULL, i % 8);
+    gcry_mpi_point_t TR = gcry_mpi_point_new(0);
+
+    gcry_mpi_ec_mul(TR, kk, T8, ec);
+    msg = "mixed order key " + std::to_string(i / 8);
+    sig = make_sig(a[0], sig.pk, TR, msg, -1);
+    h = hash_scalar(sig.r, sig.pk, msg);
+    gcry_mpi_add_ui(h, h, i % 8);
+    gcry_mpi_mod(h, h, GCRYMPI_CONST_EIGHT);
+    sig.good = !gcry_mpi_cmp_ui(h, 0);
+    gcry_mpi_release(h);
+    gcry_mpi_release(kk);
+    gcry_mpi_point_release(TR);
+    if (sig.good) k++;
+
+    sigs = good;
+    sigs.push_back(sig);
+    check_batch("mixed order key", sigs);
+  }
+  if (k < 2) fail("no good signature with a mixed order key found\n");
+  gcry_mpi_point_release(T8);
+
+  for (i = 0; i < NKEYS; i++) gcry_mpi_release(a[i]);
+  gcry_mpi_release(zero);
+  gcry_mpi_point_release(A);
+}
+
+int eddsa_batch_main(int argc, char **argv) {
+  gpg_error_t err;
+
+  if (argc > 1 && !strcmp(argv[1], "--verbose")) verbose = 1;
+
+  gcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+  gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+
+  err = gcry_mpi_ec_new(&ec, NULL, "Ed25519");
+  if (err) {
+    fail("gcry_mpi_ec_new failed: %s\n", gpg_strerror(err));
+    return 1;
+  }
+  G = gcry_mpi_ec_get_point("g", ec, 1);
+  n = gcry_mpi_ec_get_mpi("n", ec, 1);
+
+  check_small_order();
+  check_mul_points();
+  check_eddsa_batch();
+
+  gcry_mpi_release(n);
+  gcry_mpi_point_release(G);
+  gcry_ctx_release(ec);
+  return error_count ? 1 : 0;
+}
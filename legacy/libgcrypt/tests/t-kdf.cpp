@@ -493,8 +493,7 @@ static void check_openpgp(void) {
 
   for (tvidx = 0; tvidx < DIM(tv); tvidx++) {
     if (tv[tvidx].disabled) continue;
-    /* MD5 isn't supported in fips mode */
-    if (gcry_fips_mode_active() && tv[tvidx].hashalgo == GCRY_MD_MD5) continue;
+    if (gcry_md_test_algo(tv[tvidx].hashalgo)) continue;
     if (verbose) fprintf(stderr, "checking S2K test vector %d\n", tvidx);
     assert(tv[tvidx].dklen <= sizeof outbuf);
     err = gcry_kdf_derive(tv[tvidx].p, tv[tvidx].plen, tv[tvidx].algo,
@@ -511,6 +510,102 @@ static void check_openpgp(void) {
   }
 }
 
+/* Compute the OpenPGP S2K of PASSPHRASE the plain way, one byte of
+   the repeated salt and passphrase at a time, as a reference for the
+   chunked implementation.  */
+static void reference_s2k(const char *passphrase, size_t passphraselen,
+                          int algo, int hashalgo, const char *salt,
+                          unsigned long count, size_t keylen,
+                          unsigned char *key) {
+  gcry_md_hd_t md;
+  gpg_error_t err;
+  size_t dlen, used, n, len2, i;
+  int pass;
+
+  dlen = gcry_md_get_algo_dlen(hashalgo);
+  len2 = passphraselen + (salt ? 8 : 0);
+  if (algo != GCRY_KDF_ITERSALTED_S2K || count < len2) count = len2;
+
+  for (pass = 0, used = 0; used < keylen; pass++, used += n) {
+    err = gcry_md_open(&md, hashalgo, 0);
+    if (err) die("gcry_md_open failed: %s\n", gpg_strerror(err));
+    for (i = 0; i < (size_t)pass; i++) gcry_md_putc(md, 0);
+    for (i = 0; i < count; i++)
+      if (salt && i % len2 < 8)
+        gcry_md_putc(md, salt[i % len2]);
+      else
+        gcry_md_putc(md, passphrase[i % len2 - (salt ? 8 : 0)]);
+    n = keylen - used < dlen ? keylen - used : dlen;
+    memcpy(key + used, gcry_md_read(md, hashalgo), n);
+    gcry_md_close(md);
+  }
+}
+
+/* Check the S2K at the edges of the chunked implementation, which
+   hashes the pattern of salt and passphrase expanded into a buffer
+   of a few KiB and runs the passes of long keys side by side.  */
+static void check_openpgp_chunks(void) {
+  static struct {
+    size_t plen; /* Length of the passphrase.  */
+    int algo;
+    int hashalgo;
+    unsigned long c; /* Iterations.  */
+    size_t dklen;    /* Requested key length.  */
+  } tv[] = {
+      /* The count is less than the length of the salt and passphrase,
+         thus they are hashed once.  */
+      {16, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 10, 16},
+      {16, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 23, 16},
+      {16, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 24, 16},
+      /* The count is not a multiple of the pattern length, thus the
+         last copy is cut short, once within the first chunk and once
+         after a number of whole chunks.  */
+      {16, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 1000, 16},
+      {13, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA256, 65011, 32},
+      {5, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 2048 * 3 + 1, 16},
+      /* The pattern is longer than a chunk.  */
+      {3000, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 1024, 16},
+      {3000, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 10000, 16},
+      {3000, GCRY_KDF_SALTED_S2K, GCRY_MD_SHA256, 0, 32},
+      {3000, GCRY_KDF_SIMPLE_S2K, GCRY_MD_SHA1, 0, 16},
+      /* The key is longer than the digest, thus several passes over
+         the same data are needed.  */
+      {16, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 65536, 32},
+      {16, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA1, 4099, 64},
+      {7, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_RMD160, 1000, 41},
+      {3000, GCRY_KDF_ITERSALTED_S2K, GCRY_MD_SHA256, 10000, 64},
+      {16, GCRY_KDF_SALTED_S2K, GCRY_MD_SHA1, 0, 32},
+      {16, GCRY_KDF_SIMPLE_S2K, GCRY_MD_SHA1, 0, 60},
+  };
+  static const char salt[8] = {'\x01', '\x23', '\x45', '\x67',
+                               '\x89', '\xab', '\xcd', '\xef'};
+  char passphrase[3000];
+  unsigned char outbuf[64], expect[64];
+  const char *s;
+  gpg_error_t err;
+  int tvidx;
+  size_t i;
+
+  for (i = 0; i < sizeof passphrase; i++) passphrase[i] = 'a' + i % 26;
+
+  for (tvidx = 0; tvidx < DIM(tv); tvidx++) {
+    if (gcry_md_test_algo(tv[tvidx].hashalgo)) continue;
+    if (verbose) fprintf(stderr, "checking S2K edge case %d\n", tvidx);
+    assert(tv[tvidx].dklen <= sizeof outbuf);
+    s = tv[tvidx].algo == GCRY_KDF_SIMPLE_S2K ? NULL : salt;
+    reference_s2k(passphrase, tv[tvidx].plen, tv[tvidx].algo,
+                  tv[tvidx].hashalgo, s, tv[tvidx].c, tv[tvidx].dklen,
+                  expect);
+    err = gcry_kdf_derive(passphrase, tv[tvidx].plen, tv[tvidx].algo,
+                          tv[tvidx].hashalgo, s, s ? 8 : 0, tv[tvidx].c,
+                          tv[tvidx].dklen, outbuf);
+    if (err)
+      fail("s2k edge case %d failed: %s\n", tvidx, gpg_strerror(err));
+    else if (memcmp(outbuf, expect, tv[tvidx].dklen))
+      fail("s2k edge case %d failed: mismatch\n", tvidx);
+  }
+}
+
 static void check_pbkdf2(void) {
   /* Test vectors are from RFC-6070.  */
   static struct {
@@ -624,6 +719,7 @@ static void check_pbkdf2(void) {
 
   for (tvidx = 0; tvidx < DIM(tv); tvidx++) {
     if (tv[tvidx].disabled) continue;
+    if (gcry_md_test_algo(tv[tvidx].hashalgo)) continue;
     if (verbose)
       fprintf(stderr, "checking PBKDF2 test vector %d algo %d\n", tvidx,
               tv[tvidx].hashalgo);
@@ -703,7 +799,7 @@ static void check_scrypt(void) {
   }
 }
 
-int main(int argc, char **argv) {
+int kdf_main(int argc, char **argv) {
   int last_argc = -1;
   unsigned long s2kcount = 0;
 
@@ -750,8 +846,6 @@ int main(int argc, char **argv) {
     if (!s2kcount) die("t-kdf: S2KCOUNT must be positive\n");
   }
 
-  if (!gcry_check_version(GCRYPT_VERSION)) die("version mismatch\n");
-
   xgcry_control(GCRYCTL_DISABLE_SECMEM, 0);
   xgcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
   if (debug) xgcry_control(GCRYCTL_SET_DEBUG_FLAGS, 1u, 0);
@@ -760,6 +854,7 @@ int main(int argc, char **argv) {
     bench_s2k(s2kcount);
   else {
     check_openpgp();
+    check_openpgp_chunks();
     check_pbkdf2();
     check_scrypt();
   }
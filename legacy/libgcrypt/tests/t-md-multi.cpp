@@ -0,0 +1,121 @@
+/* t-md-multi.c - Check hashing of many messages at once
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PGM "t-md-multi"
+#include "t-common.h"
+
+/* The message lengths around the padding boundaries of one and two
+   64 byte blocks, with a few others in between.  */
+static const int lengths[] = {0,  1,  3,   55,  56,  57,  63,   64,
+                              65, 119, 120, 121, 127, 128, 1000};
+
+/* Hash the first NMSGS messages of IOV with gcry_md_hash_buffers_multi
+   and compare each digest to the one of gcry_md_hash_buffer.  */
+static void check_one_md_multi(int algo, gcry_buffer_t *iov, int nmsgs) {
+  unsigned char digests[64 * 32];
+  unsigned char expect[32];
+  gpg_error_t err;
+  int i, mdlen;
+
+  mdlen = gcry_md_get_algo_dlen(algo);
+  memset(digests, 0, sizeof digests);
+  err = gcry_md_hash_buffers_multi(algo, 0, digests, iov, nmsgs);
+  if (err) {
+    fail("algo %d, gcry_md_hash_buffers_multi failed: %s\n", algo,
+         gpg_strerror(err));
+    return;
+  }
+
+  for (i = 0; i < nmsgs; i++) {
+    gcry_md_hash_buffer(algo, expect, (char *)iov[i].data + iov[i].off,
+                        iov[i].len);
+    if (memcmp(digests + i * mdlen, expect, mdlen))
+      fail("algo %d, mismatch for message %d of %d with length %d\n", algo,
+           i, nmsgs, (int)iov[i].len);
+  }
+}
+
+static void check_md_multi(void) {
+  static const int algos[] = {GCRY_MD_SHA1, GCRY_MD_SHA256, GCRY_MD_RMD160};
+  enum { NMSGS = 64 };
+  unsigned char data[1000 + 64];
+  gcry_buffer_t iov[NMSGS];
+  unsigned char digest[32];
+  gpg_error_t err;
+  int i, j, k;
+
+  for (i = 0; i < DIM(data); i++) data[i] = i * 7 + 1;
+
+  /* More messages than lanes, so that lanes get refilled while the
+     others are still busy with longer messages.  */
+  memset(iov, 0, sizeof iov);
+  for (i = 0; i < NMSGS; i++) {
+    iov[i].data = data;
+    iov[i].off = i % 64;
+    iov[i].len = lengths[i % DIM(lengths)];
+  }
+
+  for (j = 0; j < DIM(algos); j++) {
+    if (gcry_md_test_algo(algos[j])) continue;
+
+    check_one_md_multi(algos[j], iov, NMSGS);
+    /* Fewer messages than lanes.  */
+    check_one_md_multi(algos[j], iov + 3, 3);
+    check_one_md_multi(algos[j], iov, 0);
+    /* All messages with the same length.  */
+    for (i = 0; i < DIM(lengths); i++) {
+      gcry_buffer_t same[20];
+
+      memset(same, 0, sizeof same);
+      for (k = 0; k < DIM(same); k++) {
+        same[k].data = data;
+        same[k].off = k;
+        same[k].len = lengths[i];
+      }
+      check_one_md_multi(algos[j], same, DIM(same));
+    }
+  }
+
+  err = gcry_md_hash_buffers_multi(GCRY_MD_SHA1, 1, digest, iov, 1);
+  if (err != GPG_ERR_INV_ARG)
+    fail("gcry_md_hash_buffers_multi accepted invalid flags\n");
+}
+
+int md_multi_main(int argc, char **argv) {
+  if (argc > 1 && !strcmp(argv[1], "--verbose"))
+    verbose = 1;
+  else if (argc > 1 && !strcmp(argv[1], "--debug"))
+    verbose = debug = 1;
+
+  xgcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+  xgcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+  if (debug) xgcry_control(GCRYCTL_SET_DEBUG_FLAGS, 1u, 0);
+
+  check_md_multi();
+
+  return error_count ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+/* t-pubkey-util.c - Check the parsers of the public key helpers
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The helpers are internal, thus we use the internal headers in place
+   of gcrypt.h and t-common.h.  */
+#include "../src/cipher.h"
+
+#include "../cipher/pubkey-internal.h"
+
+#define PGM "t-pubkey-util"
+
+static int verbose;
+static int error_count;
+
+static void fail(const char *format, ...) {
+  va_list arg_ptr;
+
+  fflush(stdout);
+  fprintf(stderr, "%s: ", PGM);
+  va_start(arg_ptr, format);
+  vfprintf(stderr, format, arg_ptr);
+  va_end(arg_ptr);
+  error_count++;
+}
+
+enum parser {
+  DATA,   /* _gcry_pk_util_data_to_mpi; VALUE is the encoding.  */
+  SIGVAL, /* _gcry_pk_util_preparse_sigval; VALUE is the ECC flags.  */
+  ENCVAL, /* _gcry_pk_util_preparse_encval; VALUE is the flags.  */
+  NBITS,  /* _gcry_pk_util_get_nbits; VALUE is the number of bits.  */
+  USE_E   /* _gcry_pk_util_get_rsa_use_e; VALUE is the exponent.  */
+};
+
+/* The SHA-1 and SHA-256 digests of "abc".  */
+#define SHA1_ABC "#a9993e364706816aba3e25717850c26c9cd0d89d#"
+#define SHA256_ABC \
+  "#ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad#"
+
+static struct {
+  enum parser parser;
+  enum pk_operation op;
+  const char *sexp;
+  gpg_error_t rc;
+  unsigned long value; /* Checked on success only.  */
+} tv[] = {
+    /* Data for signing and encryption.  */
+    {DATA, PUBKEY_OP_SIGN, "(data (flags raw) (value #01020304#))", 0,
+     PUBKEY_ENC_RAW},
+    {DATA, PUBKEY_OP_SIGN, "(data (value #0102#))", 0, PUBKEY_ENC_RAW},
+    {DATA, PUBKEY_OP_SIGN, "(outer (data (value #0102#)))", 0,
+     PUBKEY_ENC_RAW},
+    {DATA, PUBKEY_OP_SIGN, "(#0102#)", 0, PUBKEY_ENC_UNKNOWN},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags raw))", GPG_ERR_INV_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags raw) (value))", GPG_ERR_INV_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags bogus) (value #01#))",
+     GPG_ERR_INV_FLAG},
+    /* The flags are parsed from the end.  */
+    {DATA, PUBKEY_OP_SIGN, "(data (flags bogus igninvflag) (value #01#))", 0,
+     PUBKEY_ENC_RAW},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags igninvflag bogus) (value #01#))",
+     GPG_ERR_INV_FLAG},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags rfc6979) (value #01#))",
+     GPG_ERR_CONFLICT},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags rfc6979) (hash sha256 " SHA256_ABC
+                           "))",
+     0, PUBKEY_ENC_RAW},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags raw) (hash foo #01#))",
+     GPG_ERR_DIGEST_ALGO},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags raw) (hash sha1))", GPG_ERR_INV_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (hash sha1 " SHA1_ABC "))",
+     GPG_ERR_CONFLICT},
+    {DATA, PUBKEY_OP_SIGN,
+     "(data (flags eddsa) (hash-algo sha512) (value #01#))", 0,
+     PUBKEY_ENC_RAW},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags eddsa) (hash-algo sha512) (value))",
+     0, PUBKEY_ENC_RAW},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags eddsa) (value #01#))",
+     GPG_ERR_INV_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags eddsa) (hash-algo) (value #01#))",
+     GPG_ERR_NO_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags pkcs1) (hash sha1 " SHA1_ABC "))", 0,
+     PUBKEY_ENC_PKCS1},
+    {DATA, PUBKEY_OP_VERIFY, "(data (flags pkcs1) (hash sha1 " SHA1_ABC "))",
+     0, PUBKEY_ENC_PKCS1},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags pkcs1) (hash sha1 " SHA1_ABC " #01#))",
+     GPG_ERR_INV_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags pkcs1) (value #01#))",
+     GPG_ERR_CONFLICT},
+    {DATA, PUBKEY_OP_ENCRYPT, "(data (flags pkcs1) (value #01020304#))", 0,
+     PUBKEY_ENC_PKCS1},
+    {DATA, PUBKEY_OP_ENCRYPT,
+     "(data (flags pkcs1) (value #01#) (random-override))", GPG_ERR_NO_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags pkcs1-raw) (value #0102#))", 0,
+     PUBKEY_ENC_PKCS1_RAW},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags pkcs1-raw) (value #0102# #03#))",
+     GPG_ERR_INV_OBJ},
+    {DATA, PUBKEY_OP_ENCRYPT,
+     "(data (flags oaep) (value #0102#) (hash-algo sha256) (label \"x\"))", 0,
+     PUBKEY_ENC_OAEP},
+    {DATA, PUBKEY_OP_ENCRYPT,
+     "(data (flags oaep) (value #0102#) (hash-algo nope))",
+     GPG_ERR_DIGEST_ALGO},
+    {DATA, PUBKEY_OP_ENCRYPT, "(data (flags oaep) (value #0102#) (label))",
+     GPG_ERR_NO_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags pss) (hash sha256 " SHA256_ABC "))", 0,
+     PUBKEY_ENC_PSS},
+    {DATA, PUBKEY_OP_SIGN,
+     "(data (flags pss) (hash sha256 " SHA256_ABC ") (salt-length))",
+     GPG_ERR_NO_OBJ},
+    {DATA, PUBKEY_OP_SIGN, "(data (flags pss raw) (value #01#))",
+     GPG_ERR_INV_FLAG},
+
+    /* Signature values.  */
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val (rsa (s #01#)))", 0, 0},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val (RSA (s #01#)))", 0, 0},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val (flags raw) (rsa (s #01#)))", 0, 0},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(outer (sig-val (rsa (s #01#))))", 0, 0},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val (eddsa (r #01#) (s #02#)))", 0,
+     PUBKEY_FLAG_EDDSA},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val (dsa (r #01#) (s #02#)))",
+     GPG_ERR_CONFLICT},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val)", GPG_ERR_NO_OBJ},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val (flags))", GPG_ERR_INV_OBJ},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val (flags) ((rsa)))", GPG_ERR_INV_OBJ},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(sig-val ((rsa) (s #01#)))", GPG_ERR_INV_OBJ},
+    {SIGVAL, PUBKEY_OP_VERIFY, "(foo (rsa (s #01#)))", GPG_ERR_INV_OBJ},
+
+    /* Encrypted values.  */
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (rsa (a #01#)))", 0,
+     PUBKEY_FLAG_LEGACYRESULT},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (flags) (rsa (a #01#)))", 0, 0},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (flags pkcs1) (elg (a #01#)))", 0,
+     PUBKEY_FLAG_FIXEDLEN},
+    {ENCVAL, PUBKEY_OP_DECRYPT,
+     "(enc-val (flags oaep) (hash-algo sha256) (label \"lbl\") (rsa (a #01#)))",
+     0, PUBKEY_FLAG_FIXEDLEN},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (flags pss) (rsa (a #01#)))",
+     GPG_ERR_CONFLICT},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (flags bogus) (rsa (a #01#)))",
+     GPG_ERR_INV_FLAG},
+    {ENCVAL, PUBKEY_OP_DECRYPT,
+     "(enc-val (flags oaep) (hash-algo foo) (rsa (a #01#)))",
+     GPG_ERR_DIGEST_ALGO},
+    {ENCVAL, PUBKEY_OP_DECRYPT,
+     "(enc-val (flags oaep) (hash-algo) (rsa (a #01#)))", GPG_ERR_NO_OBJ},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (flags oaep) (label) (rsa (a #01#)))",
+     GPG_ERR_NO_OBJ},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (flags raw))", GPG_ERR_NO_OBJ},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (flags raw) (hash-algo sha1))",
+     GPG_ERR_NO_OBJ},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (flags raw) ((rsa)))",
+     GPG_ERR_INV_OBJ},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val)", GPG_ERR_NO_OBJ},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val ((rsa) (a #01#)))", GPG_ERR_INV_OBJ},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(enc-val (dsa (a #01#)))", GPG_ERR_CONFLICT},
+    {ENCVAL, PUBKEY_OP_DECRYPT, "(foo (rsa (a #01#)))", GPG_ERR_INV_OBJ},
+
+    /* Key generation parameters.  */
+    {NBITS, PUBKEY_OP_SIGN, "(rsa (nbits 4:2048))", 0, 2048},
+    {NBITS, PUBKEY_OP_SIGN, "(genkey (rsa (nbits 4:1024)))", 0, 1024},
+    {NBITS, PUBKEY_OP_SIGN, "(rsa)", 0, 0},
+    {NBITS, PUBKEY_OP_SIGN, "(rsa (nbits))", GPG_ERR_INV_OBJ},
+    {NBITS, PUBKEY_OP_SIGN, "(rsa (nbits (4:2048)))", GPG_ERR_INV_OBJ},
+    {USE_E, PUBKEY_OP_SIGN, "(rsa (nbits 4:2048) (rsa-use-e 2:41))", 0, 41},
+    {USE_E, PUBKEY_OP_SIGN, "(rsa (nbits 4:2048))", 0, 65537},
+    {USE_E, PUBKEY_OP_SIGN, "(rsa (rsa-use-e))", GPG_ERR_INV_OBJ},
+};
+
+static void check_pubkey_util(void) {
+  static const char *algo_names[] = {"rsa", "openpgp-rsa", "eddsa", "elg",
+                                     NULL};
+  struct pk_encoding_ctx ctx;
+  gcry_sexp_t sexp, parms;
+  gcry_mpi_t mpi;
+  gpg_error_t rc;
+  unsigned long value;
+  unsigned int nbits;
+  int eccflags;
+  unsigned int tvidx;
+
+  for (tvidx = 0; tvidx < DIM(tv); tvidx++) {
+    if (verbose) fprintf(stderr, "checking %s\n", tv[tvidx].sexp);
+    rc = sexp_new(&sexp, tv[tvidx].sexp, 0, 1);
+    if (rc) {
+      fail("test %u: building the S-expression failed: %s\n", tvidx,
+           gpg_strerror(rc));
+      continue;
+    }
+
+    _gcry_pk_util_init_encoding_ctx(&ctx, tv[tvidx].op, 1024);
+    mpi = NULL;
+    parms = NULL;
+    value = 0;
+    switch (tv[tvidx].parser) {
+      case DATA:
+        rc = _gcry_pk_util_data_to_mpi(sexp, &mpi, &ctx);
+        value = ctx.encoding;
+        if (!rc && !mpi) fail("test %u: no MPI returned\n", tvidx);
+        break;
+      case SIGVAL:
+        rc = _gcry_pk_util_preparse_sigval(sexp, algo_names, &parms,
+                                           &eccflags);
+        value = eccflags;
+        break;
+      case ENCVAL:
+        rc = _gcry_pk_util_preparse_encval(sexp, algo_names, &parms, &ctx);
+        value = ctx.flags;
+        break;
+      case NBITS:
+        rc = _gcry_pk_util_get_nbits(sexp, &nbits);
+        value = nbits;
+        break;
+      case USE_E:
+        rc = _gcry_pk_util_get_rsa_use_e(sexp, &value);
+        break;
+    }
+
+    if (rc != tv[tvidx].rc)
+      fail("test %u: expected %s but got %s\n", tvidx,
+           gpg_strerror(tv[tvidx].rc), gpg_strerror(rc));
+    else if (!rc && value != tv[tvidx].value)
+      fail("test %u: expected value %lu but got %lu\n", tvidx,
+           tv[tvidx].value, value);
+
+    /* The parameter list starts with the name of the algorithm.  */
+    if (!rc && (tv[tvidx].parser == SIGVAL || tv[tvidx].parser == ENCVAL)) {
+      size_t n;
+      const char *name = parms ? sexp_nth_data(parms, 0, &n) : NULL;
+
+      if (!name || (strncasecmp(name, "rsa", 3) && strncmp(name, "eddsa", 5) &&
+                    strncmp(name, "elg", 3)))
+        fail("test %u: wrong parameter list returned\n", tvidx);
+    } else if (parms)
+      fail("test %u: parameter list returned on error\n", tvidx);
+
+    _gcry_mpi_release(mpi);
+    sexp_release(parms);
+    _gcry_pk_util_free_encoding_ctx(&ctx);
+    sexp_release(sexp);
+  }
+}
+
+int pubkey_util_main(int argc, char **argv) {
+  if (argc > 1 && !strcmp(argv[1], "--verbose")) verbose = 1;
+
+  gcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+  gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+
+  check_pubkey_util();
+
+  return error_count ? 1 : 0;
+}
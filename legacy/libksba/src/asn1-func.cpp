@@ -197,6 +197,7 @@ static AsnNode copy_node(const AsnNode s) {
 
   if (s->name) d->name = xstrdup(s->name);
   d->flags = s->flags;
+  d->flags.in_arena = 0;
   copy_value(d, s);
   return d;
 }
@@ -205,6 +206,7 @@ static AsnNode copy_node(const AsnNode s) {
    NAME may be NULL */
 void _ksba_asn_set_name(AsnNode node, const char *name) {
   return_if_fail(node);
+  return_if_fail(!node->flags.in_arena); /* The name is borrowed.  */
 
   if (node->name) {
     xfree(node->name);
@@ -1041,6 +1043,65 @@ AsnNode _ksba_asn_insert_copy(AsnNode node) {
   return n;
 }
 
+static size_t count_nodes(AsnNode node) {
+  size_t n = 1;
+
+  for (node = node->down; node; node = node->right) n += count_nodes(node);
+  return n;
+}
+
+/* Copy NODE and its children to the block at *NEXTP, advancing it. */
+static AsnNode clone_nodes(AsnNode node, AsnNode *nextp) {
+  AsnNode d, s, x, prev = NULL;
+
+  d = (*nextp)++;
+  *d = *node;
+  d->valuetype = VALTYPE_NULL;
+  copy_value(d, node);
+  d->flags.in_arena = 1;
+  d->flags.tag_seen = 0;
+  d->flags.skip_this = 0;
+  d->down = d->right = d->left = NULL;
+
+  for (s = node->down; s; s = s->right) {
+    x = clone_nodes(s, nextp);
+    if (prev) {
+      prev->right = x;
+      x->left = prev;
+    } else {
+      d->down = x;
+      x->left = d;
+    }
+    prev = x;
+  }
+  return d;
+}
+
+/* Return a copy of the expanded tree TMPL ready for decoding.  All
+   nodes are taken from a single block which starts with the returned
+   root and the names are borrowed from TMPL, which must thus outlive
+   the copy.  Values are copied and nodes inserted later on by
+   _ksba_asn_insert_copy are allocated as usual;
+   _ksba_asn_release_nodes takes care of both.  Returns NULL if out
+   of core.  */
+AsnNode _ksba_asn_clone_tree(AsnNode tmpl) {
+  AsnNode block, next;
+  size_t i, n;
+
+  return_null_if_fail(tmpl);
+
+  n = count_nodes(tmpl);
+  block = (AsnNode)xtrymalloc(n * sizeof *block);
+  if (!block) return NULL;
+
+  next = block;
+  clone_nodes(tmpl, &next);
+  for (i = 0; i + 1 < n; i++) block[i].link_next = block + i + 1;
+  block[n - 1].link_next = NULL;
+
+  return block;
+}
+
 /* Locate a type value sequence like
 
   SEQUENCE {
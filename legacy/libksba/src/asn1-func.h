@@ -113,6 +113,7 @@ struct node_flag_s {
   int help_right : 1; /* helper for create_tree */
   int tag_seen : 1;
   int skip_this : 1; /* helper */
+  int in_arena : 1;  /* node is part of a block from _ksba_asn_clone_tree */
 };
 
 enum asn_value_type {
@@ -194,6 +195,7 @@ void _ksba_asn_set_default_tag(AsnNode node);
 void _ksba_asn_type_set_config(AsnNode node);
 AsnNode _ksba_asn_expand_tree(AsnNode parse_tree, const char *name);
 AsnNode _ksba_asn_insert_copy(AsnNode node);
+AsnNode _ksba_asn_clone_tree(AsnNode tmpl);
 
 int _ksba_asn_is_primitive(node_type_t type);
 AsnNode _ksba_asn_new_node(node_type_t type);
@@ -206,7 +208,9 @@ AsnNode _ksba_asn_find_type_value(const unsigned char *image, AsnNode root,
 int _ksba_asn_delete_structure(AsnNode root);
 
 /*-- asn2-func.c --*/
-/*(functions are all declared in ksba.h)*/
+/*(the public functions are declared in ksba.h)*/
+int _ksba_asn_get_template(const char *mod_name, const char *name,
+                           AsnNode *r_root);
 
 /*-- asn1-tables.c (generated) --*/
 const static_asn *_ksba_asn_lookup_table(const char *name,
@@ -42,6 +42,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mutex>
 
 #include "asn1-func.h"
 #include "ksba.h"
@@ -186,3 +187,60 @@ gpg_error_t ksba_asn_create_tree(const char *mod_name,
 
   return rc;
 }
+
+/* The expanded trees handed out by _ksba_asn_get_template.  They are
+   never modified or released.  */
+struct asn_template_s {
+  struct asn_template_s *next;
+  AsnNode root;
+  const char *mod_name; /* Points into NAME.  */
+  char name[1];         /* Type name followed by the module name.  */
+};
+
+static std::mutex template_lock;
+static struct asn_template_s *template_list;
+
+/* Return in R_ROOT the expanded tree for the type NAME of the builtin
+   module MOD_NAME.  The tree is created on first use and shared by
+   all callers, which must not modify it; use _ksba_asn_clone_tree to
+   get a copy which can be decoded into.  This saves creating and
+   expanding the entire module for each object.  */
+int _ksba_asn_get_template(const char *mod_name, const char *name,
+                           AsnNode *r_root) {
+  std::lock_guard<std::mutex> lock(template_lock);
+  struct asn_template_s *t;
+  ksba_asn_tree_t tree;
+  AsnNode root;
+  gpg_error_t err;
+
+  *r_root = NULL;
+  if (!mod_name || !name) return GPG_ERR_INV_VALUE;
+
+  for (t = template_list; t; t = t->next)
+    if (!strcmp(t->name, name) && !strcmp(t->mod_name, mod_name)) {
+      *r_root = t->root;
+      return 0;
+    }
+
+  err = ksba_asn_create_tree(mod_name, &tree);
+  if (err) return err;
+  root = _ksba_asn_expand_tree(tree->parse_tree, name);
+  ksba_asn_tree_release(tree);
+  if (!root) return GPG_ERR_ELEMENT_NOT_FOUND;
+
+  t = (struct asn_template_s *)xtrymalloc(sizeof *t + strlen(name) +
+                                          strlen(mod_name) + 1);
+  if (!t) {
+    _ksba_asn_release_nodes(root);
+    return GPG_ERR_ENOMEM;
+  }
+  t->root = root;
+  strcpy(t->name, name);
+  t->mod_name = t->name + strlen(name) + 1;
+  strcpy((char *)t->mod_name, mod_name);
+  t->next = template_list;
+  template_list = t;
+
+  *r_root = root;
+  return 0;
+}
@@ -893,23 +893,30 @@ new_node (struct parser_control_s *parsectl, node_type_t type)
   return node;
 }
 
+/* Nodes created by _ksba_asn_clone_tree borrow their names and share
+   one block, which starts with the first of them.  */
 static void
 release_all_nodes (AsnNode node)
 {
-  AsnNode node2;
+  AsnNode node2, block = NULL;
 
   for (; node; node = node2)
     {
       node2 = node->link_next;
-      xfree (node->name);
+      if (!node->flags.in_arena)
+        xfree (node->name);
 
       if (node->valuetype == VALTYPE_CSTR)
         xfree (node->value.v_cstr);
       else if (node->valuetype == VALTYPE_MEM)
         xfree (node->value.v_mem.buf);
 
-      xfree (node);
+      if (!node->flags.in_arena)
+        xfree (node);
+      else if (!block)
+        block = node;
     }
+  xfree (block);
 }
 
 static void
@@ -68,7 +68,8 @@ typedef struct decoder_state_s *DECODER_STATE;
 
 /* Context for a decoder. */
 struct ber_decoder_s {
-  AsnNode module; /* the ASN.1 structure */
+  AsnNode module;          /* the ASN.1 structure */
+  const char *module_name; /* or the name of a builtin module */
   ksba_reader_t reader;
   const char *last_errdesc; /* string with the error description */
   int non_der;              /* set if the encoding is not DER conform */
@@ -287,12 +288,27 @@ void _ksba_ber_decoder_release(BerDecoder d) { xfree(d); }
  **/
 gpg_error_t _ksba_ber_decoder_set_module(BerDecoder d, ksba_asn_tree_t module) {
   if (!d || !module) return GPG_ERR_INV_VALUE;
-  if (d->module) return GPG_ERR_CONFLICT; /* module already set */
+  if (d->module || d->module_name)
+    return GPG_ERR_CONFLICT; /* module already set */
 
   d->module = module->parse_tree;
   return 0;
 }
 
+/* Use the builtin ASN.1 module MOD_NAME instead of a parse tree set
+   by _ksba_ber_decoder_set_module.  The expanded tree for the start
+   element is then created only once per process and each decoder run
+   works on a copy of it.  */
+gpg_error_t _ksba_ber_decoder_set_module_name(BerDecoder d,
+                                              const char *mod_name) {
+  if (!d || !mod_name) return GPG_ERR_INV_VALUE;
+  if (d->module || d->module_name)
+    return GPG_ERR_CONFLICT; /* module already set */
+
+  d->module_name = mod_name;
+  return 0;
+}
+
 gpg_error_t _ksba_ber_decoder_set_reader(BerDecoder d, ksba_reader_t r) {
   if (!d || !r) return GPG_ERR_INV_VALUE;
   if (d->reader) return GPG_ERR_CONFLICT; /* reader already set */
@@ -580,10 +596,20 @@ static int match_der(AsnNode root, const struct tag_info *ti, DECODER_STATE ds,
 }
 
 static gpg_error_t decoder_init(BerDecoder d, const char *start_name) {
-  d->ds = new_decoder_state();
+  AsnNode tmpl;
+  gpg_error_t err;
 
-  d->root = _ksba_asn_expand_tree(d->module, start_name);
-  clear_help_flags(d->root);
+  if (d->module_name) {
+    err = _ksba_asn_get_template(d->module_name, start_name, &tmpl);
+    if (err) return err;
+    d->root = _ksba_asn_clone_tree(tmpl);
+    if (!d->root) return GPG_ERR_ENOMEM;
+  } else {
+    d->root = _ksba_asn_expand_tree(d->module, start_name);
+    clear_help_flags(d->root);
+  }
+
+  d->ds = new_decoder_state();
   d->bypass = 0;
   if (d->debug)
     fprintf(stderr, "DECODER_INIT for `%s'\n",
@@ -592,6 +618,8 @@ static gpg_error_t decoder_init(BerDecoder d, const char *start_name) {
 }
 
 static void decoder_deinit(BerDecoder d) {
+  _ksba_asn_release_nodes(d->root);
+  d->root = NULL;
   release_decoder_state(d->ds);
   d->ds = NULL;
   d->val.node = NULL;
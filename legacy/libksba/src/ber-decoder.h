@@ -42,6 +42,8 @@ BerDecoder _ksba_ber_decoder_new(void);
 void _ksba_ber_decoder_release(BerDecoder d);
 
 gpg_error_t _ksba_ber_decoder_set_module(BerDecoder d, ksba_asn_tree_t module);
+gpg_error_t _ksba_ber_decoder_set_module_name(BerDecoder d,
+                                              const char *mod_name);
 gpg_error_t _ksba_ber_decoder_set_reader(BerDecoder d, ksba_reader_t r);
 
 gpg_error_t _ksba_ber_decoder_dump(BerDecoder d, FILE *fp);
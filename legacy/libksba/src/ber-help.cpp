@@ -37,6 +37,7 @@
 
 #include "asn1-func.h" /* need some constants */
 #include "ber-help.h"
+#include "reader.h"
 
 /* Fixme: The parser functions should check that primitive types don't
    have the constructed bit set (which is not allowed).  This saves us
@@ -79,6 +80,21 @@ static gpg_error_t eof_or_error(ksba_reader_t reader, struct tag_info *ti,
 gpg_error_t _ksba_ber_read_tl(ksba_reader_t reader, struct tag_info *ti) {
   int c;
   unsigned long tag;
+  const unsigned char *buf, *p;
+  size_t avail, n;
+
+  /* With a memory reader parse the header right from its buffer.  If
+     that fails we take the slow path below to get the same error
+     description and reader position.  */
+  buf = _ksba_reader_peek(reader, &avail);
+  if (buf) {
+    p = buf;
+    n = avail;
+    if (!_ksba_ber_parse_tl(&p, &n, ti)) {
+      _ksba_reader_skip(reader, p - buf);
+      return 0;
+    }
+  }
 
   ti->length = 0;
   ti->ndef = 0;
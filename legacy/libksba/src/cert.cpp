@@ -113,7 +113,6 @@ void ksba_cert_release(ksba_cert_t cert) {
   }
 
   _ksba_asn_release_nodes(cert->root);
-  ksba_asn_tree_release(cert->asn_tree);
 
   xfree(cert->image);
 
@@ -229,12 +228,7 @@ gpg_error_t ksba_cert_read_der(ksba_cert_t cert, ksba_reader_t reader) {
     return GPG_ERR_CONFLICT; /* Fixme: should remove the old one */
 
   _ksba_asn_release_nodes(cert->root);
-  ksba_asn_tree_release(cert->asn_tree);
   cert->root = NULL;
-  cert->asn_tree = NULL;
-
-  err = ksba_asn_create_tree("tmttv2", &cert->asn_tree);
-  if (err) goto leave;
 
   decoder = _ksba_ber_decoder_new();
   if (!decoder) {
@@ -245,7 +239,7 @@ gpg_error_t ksba_cert_read_der(ksba_cert_t cert, ksba_reader_t reader) {
   err = _ksba_ber_decoder_set_reader(decoder, reader);
   if (err) goto leave;
 
-  err = _ksba_ber_decoder_set_module(decoder, cert->asn_tree);
+  err = _ksba_ber_decoder_set_module_name(decoder, "tmttv2");
   if (err) goto leave;
 
   err = _ksba_ber_decoder_decode(decoder, "TMTTv2.Certificate", 0, &cert->root,
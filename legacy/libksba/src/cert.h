@@ -83,7 +83,6 @@ struct ksba_cert_s {
      modified. */
   int ref_count;
 
-  ksba_asn_tree_t asn_tree;
   AsnNode root; /* Root of the tree with the values */
 
   unsigned char *image;
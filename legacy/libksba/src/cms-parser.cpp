@@ -79,37 +79,18 @@ static gpg_error_t create_and_run_decoder(ksba_reader_t reader,
                                           unsigned char **r_image,
                                           size_t *r_imagelen) {
   gpg_error_t err;
-  ksba_asn_tree_t cms_tree;
   BerDecoder decoder;
 
-  err = ksba_asn_create_tree("cms", &cms_tree);
-  if (err) return err;
-
   decoder = _ksba_ber_decoder_new();
-  if (!decoder) {
-    ksba_asn_tree_release(cms_tree);
-    return GPG_ERR_ENOMEM;
-  }
+  if (!decoder) return GPG_ERR_ENOMEM;
 
   err = _ksba_ber_decoder_set_reader(decoder, reader);
-  if (err) {
-    ksba_asn_tree_release(cms_tree);
-    _ksba_ber_decoder_release(decoder);
-    return err;
-  }
-
-  err = _ksba_ber_decoder_set_module(decoder, cms_tree);
-  if (err) {
-    ksba_asn_tree_release(cms_tree);
-    _ksba_ber_decoder_release(decoder);
-    return err;
-  }
-
-  err = _ksba_ber_decoder_decode(decoder, elem_name, flags, r_root, r_image,
-                                 r_imagelen);
+  if (!err) err = _ksba_ber_decoder_set_module_name(decoder, "cms");
+  if (!err)
+    err = _ksba_ber_decoder_decode(decoder, elem_name, flags, r_root, r_image,
+                                   r_imagelen);
 
   _ksba_ber_decoder_release(decoder);
-  ksba_asn_tree_release(cms_tree);
   return err;
 }
 
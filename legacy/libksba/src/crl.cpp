@@ -569,37 +569,18 @@ static gpg_error_t create_and_run_decoder(ksba_reader_t reader,
                                           unsigned char **r_image,
                                           size_t *r_imagelen) {
   gpg_error_t err;
-  ksba_asn_tree_t crl_tree;
   BerDecoder decoder;
 
-  err = ksba_asn_create_tree("tmttv2", &crl_tree);
-  if (err) return err;
-
   decoder = _ksba_ber_decoder_new();
-  if (!decoder) {
-    ksba_asn_tree_release(crl_tree);
-    return GPG_ERR_ENOMEM;
-  }
+  if (!decoder) return GPG_ERR_ENOMEM;
 
   err = _ksba_ber_decoder_set_reader(decoder, reader);
-  if (err) {
-    ksba_asn_tree_release(crl_tree);
-    _ksba_ber_decoder_release(decoder);
-    return err;
-  }
-
-  err = _ksba_ber_decoder_set_module(decoder, crl_tree);
-  if (err) {
-    ksba_asn_tree_release(crl_tree);
-    _ksba_ber_decoder_release(decoder);
-    return err;
-  }
-
-  err = _ksba_ber_decoder_decode(decoder, elem_name, 0, r_root, r_image,
-                                 r_imagelen);
+  if (!err) err = _ksba_ber_decoder_set_module_name(decoder, "tmttv2");
+  if (!err)
+    err = _ksba_ber_decoder_decode(decoder, elem_name, 0, r_root, r_image,
+                                   r_imagelen);
 
   _ksba_ber_decoder_release(decoder);
-  ksba_asn_tree_release(crl_tree);
   return err;
 }
 
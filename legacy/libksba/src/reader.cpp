@@ -338,6 +338,24 @@ gpg_error_t ksba_reader_read(ksba_reader_t r, char *buffer, size_t length,
   return 0;
 }
 
+/* If R reads from memory and nothing has been pushed back, return a
+   pointer to the next octets and store their number at R_LENGTH.
+   The octets are consumed only by a following _ksba_reader_skip.
+   Returns NULL for all other readers.  */
+const unsigned char *_ksba_reader_peek(ksba_reader_t r, size_t *r_length) {
+  if (!r || r->type != READER_TYPE_MEM || (r->unread.buf && r->unread.length))
+    return NULL;
+
+  *r_length = r->u.mem.size - r->u.mem.readpos;
+  return r->u.mem.buffer + r->u.mem.readpos;
+}
+
+/* Consume N octets returned by _ksba_reader_peek.  */
+void _ksba_reader_skip(ksba_reader_t r, size_t n) {
+  r->u.mem.readpos += n;
+  r->nread += n;
+}
+
 gpg_error_t ksba_reader_unread(ksba_reader_t r, const void *buffer,
                                size_t count) {
   if (!r || !buffer) return GPG_ERR_INV_VALUE;
@@ -69,4 +69,8 @@ struct ksba_reader_s {
   void *notify_cb_value;
 };
 
+/*-- reader.c --*/
+const unsigned char *_ksba_reader_peek(ksba_reader_t r, size_t *r_length);
+void _ksba_reader_skip(ksba_reader_t r, size_t n);
+
 #endif /*READER_H*/
@@ -0,0 +1,391 @@
+/* t-mem-reader.c - Check decoding from memory against decoding from files
+ * Copyright (C) 2018 The NeoPG developers
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KSBA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "../src/asn1-func.h"
+#include "../src/ber-help.h"
+#include "../src/ksba.h"
+
+#include "t-common.h"
+
+#define PGM "t-mem-reader"
+#define DIM(v) (sizeof(v) / sizeof((v)[0]))
+
+static int errors;
+
+/* A function which reads from the reader R and returns a transcript
+   of what it got.  */
+typedef std::string (*transcript_fnc_t)(ksba_reader_t r);
+
+static void append(std::string &s, const char *format, unsigned long value) {
+  char buf[50];
+
+  snprintf(buf, sizeof buf, format, value);
+  s += buf;
+}
+
+static void append_data(std::string &s, const void *data, size_t length) {
+  append(s, " [%lu]", (unsigned long)length);
+  if (data) s.append((const char *)data, length);
+}
+
+/* Read LENGTH octets from R and return the error.  */
+static gpg_error_t skip(ksba_reader_t r, size_t length) {
+  char buf[256];
+  size_t n, nread;
+  gpg_error_t err;
+
+  while (length) {
+    n = length < sizeof buf ? length : sizeof buf;
+    err = ksba_reader_read(r, buf, n, &nread);
+    if (err) return err;
+    length -= nread;
+  }
+  return 0;
+}
+
+/* Walk through all headers, entering constructed values and skipping
+   primitive ones.  */
+static std::string read_headers(ksba_reader_t r) {
+  std::string s;
+  struct tag_info ti;
+  gpg_error_t err;
+
+  for (;;) {
+    err = _ksba_ber_read_tl(r, &ti);
+    append(s, " err=%lu", err);
+    append(s, " pos=%lu", ksba_reader_tell(r));
+    if (err) {
+      s += ti.err_string ? ti.err_string : "-";
+      break;
+    }
+    append(s, " class=%lu", ti.klasse);
+    append(s, " cons=%lu", ti.is_constructed);
+    append(s, " tag=%lu", ti.tag);
+    append(s, " len=%lu", ti.length);
+    append(s, " ndef=%lu", ti.ndef);
+    append(s, " nonder=%lu", ti.non_der);
+    append_data(s, ti.buf, ti.nhdr);
+    if (ti.err_string) s += ti.err_string;
+
+    if (!ti.is_constructed && !ti.ndef) {
+      err = skip(r, ti.length);
+      append(s, " skip=%lu", err);
+      if (err) break;
+    }
+  }
+  return s;
+}
+
+static std::string read_cert(ksba_reader_t r) {
+  std::string s;
+  ksba_cert_t cert;
+  const unsigned char *image;
+  gpg_error_t err;
+  size_t n;
+  char *p;
+  int idx;
+
+  err = ksba_cert_new(&cert);
+  fail_if_err(err);
+  err = ksba_cert_read_der(cert, r);
+  append(s, "err=%lu", err);
+  append(s, " pos=%lu", ksba_reader_tell(r));
+  if (!err) {
+    /* The decoder accepts some truncated certificates but then has no
+       image for them.  */
+    image = ksba_cert_get_image(cert, &n);
+    if (image)
+      append_data(s, image, n);
+    else
+      s += " no image";
+    for (idx = 0; (p = ksba_cert_get_issuer(cert, idx)); idx++) {
+      s += p;
+      xfree(p);
+    }
+    for (idx = 0; (p = ksba_cert_get_subject(cert, idx)); idx++) {
+      s += p;
+      xfree(p);
+    }
+  }
+  /* The decoder has inserted nodes for the SEQUENCE OF values of the
+     names into the tree copied from the template; they are released
+     along with it.  */
+  ksba_cert_release(cert);
+  return s;
+}
+
+/* Return the length of the canonical S-expression SEXP.  */
+static size_t sexp_len(ksba_const_sexp_t sexp) {
+  const char *p = (const char *)sexp;
+  char *end;
+  unsigned long n;
+
+  if (!p || *p != '(') return 0;
+  n = strtoul(p + 1, &end, 10);
+  return end - p + 1 + n + 1;
+}
+
+static std::string read_crl(ksba_reader_t r) {
+  std::string s;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  ksba_sexp_t serial;
+  ksba_isotime_t this_x, next;
+  ksba_crl_reason_t reason;
+  gpg_error_t err;
+  char *issuer;
+
+  err = ksba_crl_new(&crl);
+  fail_if_err(err);
+  err = ksba_crl_set_reader(crl, r);
+  fail_if_err(err);
+
+  do {
+    err = ksba_crl_parse(crl, &stopreason);
+    append(s, " err=%lu", err);
+    append(s, " pos=%lu", ksba_reader_tell(r));
+    if (err) break;
+    append(s, " sr=%lu", stopreason);
+    if (stopreason == KSBA_SR_BEGIN_ITEMS) {
+      if (!ksba_crl_get_issuer(crl, &issuer)) {
+        s += issuer;
+        xfree(issuer);
+      }
+      if (!ksba_crl_get_update_times(crl, this_x, next)) {
+        s += this_x;
+        s += next;
+      }
+    } else if (stopreason == KSBA_SR_GOT_ITEM) {
+      if (!ksba_crl_get_item(crl, &serial, this_x, &reason)) {
+        append_data(s, serial, sexp_len(serial));
+        s += this_x;
+        append(s, " reason=%lu", reason);
+        ksba_free(serial);
+      }
+    }
+  } while (stopreason != KSBA_SR_READY);
+
+  ksba_crl_release(crl);
+  return s;
+}
+
+/* Return a transcript of FNC reading the LENGTH octets at BUFFER from
+   a memory reader.  */
+static std::string from_mem(transcript_fnc_t fnc, const unsigned char *buffer,
+                            size_t length) {
+  std::string s;
+  ksba_reader_t r;
+  gpg_error_t err;
+
+  err = ksba_reader_new(&r);
+  fail_if_err(err);
+  err = ksba_reader_set_mem(r, buffer, length);
+  fail_if_err(err);
+  s = fnc(r);
+  ksba_reader_release(r);
+  return s;
+}
+
+/* Same as from_mem but with a file reader.  */
+static std::string from_file(transcript_fnc_t fnc,
+                             const unsigned char *buffer, size_t length) {
+  std::string s;
+  ksba_reader_t r;
+  gpg_error_t err;
+  FILE *fp;
+
+  fp = tmpfile();
+  if (!fp || (length && fwrite(buffer, length, 1, fp) != 1) ||
+      fseek(fp, 0, SEEK_SET))
+    fail("can't create temporary file");
+
+  err = ksba_reader_new(&r);
+  fail_if_err(err);
+  err = ksba_reader_set_file(r, fp);
+  fail_if_err(err);
+  s = fnc(r);
+  ksba_reader_release(r);
+  fclose(fp);
+  return s;
+}
+
+static void compare(const char *what, transcript_fnc_t fnc,
+                    const unsigned char *buffer, size_t length) {
+  std::string mem, file;
+
+  mem = from_mem(fnc, buffer, length);
+  file = from_file(fnc, buffer, length);
+  if (mem != file) {
+    fprintf(stderr, PGM ": %s, %lu octets: memory and file reader differ\n",
+            what, (unsigned long)length);
+    errors++;
+  }
+}
+
+/* Check single headers, including invalid and truncated ones, which
+   are not handled by the fast path for memory readers.  */
+static void check_headers(void) {
+  static struct {
+    const char *buf;
+    size_t len;
+  } tests[] = {
+      {"\x02\x01\x05", 3},
+      {"\x30\x80\x00\x00", 4},
+      {"\x04\x82\x01\x00", 4},
+      {"\x04\x81\x05", 3}, /* Not DER.  */
+      {"\x1f\x81\x01\x00", 4},
+      {"\x04\x84\xff\xff\xff\xff", 6},
+      {"", 0},
+      {"\x30", 1},
+      {"\x04\x82\x01", 3},
+      {"\x1f\x81", 2},
+      {"\x04\x85\x01\x02\x03\x04\x05", 7},
+      {"\x04\xff", 2},
+      {"\x1f\x81\x82\x83\x84\x85\x86\x87\x88\x89\x01\x00", 12},
+  };
+  unsigned int i;
+
+  for (i = 0; i < DIM(tests); i++)
+    compare("header", read_headers, (const unsigned char *)tests[i].buf,
+            tests[i].len);
+}
+
+/* Decode all prefixes of FNAME from memory and from a file.  */
+static void check_file(const char *srcdir, const char *fname,
+                       transcript_fnc_t fnc) {
+  unsigned char *buffer;
+  char *path;
+  size_t length, n;
+  FILE *fp;
+
+  path = (char *)xmalloc(strlen(srcdir) + 1 + strlen(fname) + 1);
+  strcpy(path, srcdir);
+  strcat(path, "/");
+  strcat(path, fname);
+  fp = fopen(path, "rb");
+  if (!fp) {
+    fprintf(stderr, "%s:%d: can't open `%s': %s\n", __FILE__, __LINE__, path,
+            strerror(errno));
+    exit(1);
+  }
+  buffer = (unsigned char *)xmalloc(4096);
+  length = fread(buffer, 1, 4096, fp);
+  fclose(fp);
+  xfree(path);
+
+  for (n = 0; n <= length; n++) {
+    compare(fname, read_headers, buffer, n);
+    compare(fname, fnc, buffer, n);
+  }
+
+  if (from_mem(fnc, buffer, length).find("err=0 ") == std::string::npos) {
+    fprintf(stderr, PGM ": %s: can't be decoded\n", fname);
+    errors++;
+  }
+  xfree(buffer);
+}
+
+/* Check that CLONE is a copy of the tree TMPL.  */
+static void compare_trees(AsnNode tmpl, AsnNode clone) {
+  AsnNode n, m;
+  size_t count = 0;
+
+  for (n = tmpl, m = clone; n && m; n = _ksba_asn_walk_tree(tmpl, n),
+      m = _ksba_asn_walk_tree(clone, m), count++) {
+    if (n == m || m->name != n->name || m->type != n->type ||
+        m->valuetype != n->valuetype || !m->flags.in_arena ||
+        m->flags.in_array != n->flags.in_array ||
+        m->flags.is_optional != n->flags.is_optional)
+      fail("clone does not match the template");
+  }
+  if (n || m) fail("clone has a different number of nodes");
+
+  for (m = clone; m; m = m->link_next) count--;
+  if (count) fail("not all nodes of the clone are linked");
+}
+
+static void check_templates(void) {
+  AsnNode tmpl, tmpl2, clone, clone2, node, copy;
+  int err, i;
+
+  err = _ksba_asn_get_template("tmttv2", "TMTTv2.Certificate", &tmpl);
+  fail_if_err(err);
+  err = _ksba_asn_get_template("tmttv2", "TMTTv2.Certificate", &tmpl2);
+  fail_if_err(err);
+  if (!tmpl || tmpl != tmpl2) fail("template is not shared");
+
+  err = _ksba_asn_get_template("tmttv2", "TMTTv2.NoSuchType", &tmpl2);
+  if (err != GPG_ERR_ELEMENT_NOT_FOUND || tmpl2)
+    fail("template of an unknown type");
+  err = _ksba_asn_get_template("nosuchmodule", "TMTTv2.Certificate", &tmpl2);
+  if (!err || tmpl2) fail("template of an unknown module");
+  err = _ksba_asn_get_template(NULL, "TMTTv2.Certificate", &tmpl2);
+  if (err != GPG_ERR_INV_VALUE) fail("template without a module");
+
+  clone = _ksba_asn_clone_tree(tmpl);
+  clone2 = _ksba_asn_clone_tree(tmpl);
+  if (!clone || !clone2 || clone == clone2) fail("can't clone template");
+  compare_trees(tmpl, clone);
+  compare_trees(tmpl, clone2);
+
+  /* Append elements to a SEQUENCE OF like the decoder does.  The new
+     nodes are allocated on their own and have their own names, if
+     any.  */
+  for (node = clone; node && !node->flags.in_array;
+       node = _ksba_asn_walk_tree(clone, node))
+    ;
+  if (!node) fail("no SEQUENCE OF in the template");
+  for (i = 0; i < 3; i++) {
+    copy = _ksba_asn_insert_copy(node);
+    if (!copy || node->right != copy || copy->left != node ||
+        copy->flags.in_arena ||
+        (node->name &&
+         (copy->name == node->name || strcmp(copy->name, node->name))))
+      fail("insertion into the clone failed");
+    node = copy;
+  }
+  _ksba_asn_release_nodes(clone);
+
+  /* Neither the template nor the other clone are affected.  */
+  compare_trees(tmpl, clone2);
+  _ksba_asn_release_nodes(clone2);
+}
+
+int mem_reader_main(int argc, char **argv) {
+  const char *srcdir = getenv("srcdir");
+  const char *certs[] = {"cert_dfn_pca01.der", "cert_dfn_pca15.der",
+                         "cert_g10code_test1.der"};
+  unsigned int i;
+
+  if (!srcdir) srcdir = CMAKE_SOURCE_DIR;
+
+  check_headers();
+  for (i = 0; i < DIM(certs); i++) check_file(srcdir, certs[i], read_cert);
+  check_file(srcdir, "crl_testpki_testpca.der", read_crl);
+  check_templates();
+
+  return errors ? 1 : 0;
+}